@@ -0,0 +1,53 @@
+---
+-- \file       examples/t_ael_dispatch_bench.lua
+--             Measure the cost of dispatching readiness events to handlers.
+--             Observes many idle UDP sockets plus a few hot ones.  Each hot
+--             socket has a datagram waiting which never gets read, so the
+--             level triggered loop fires its handler on every iteration.
+--             Half of the hot handlers take an argument, the other half is
+--             a plain function.  Reports events per second; run it against
+--             different builds to compare.
+--             Needs a descriptor limit above idle+hot sockets:
+--             ulimit -n 12000
+--             lua t_ael_dispatch_bench.lua [idle=10000] [hot=100] [seconds=5]
+
+local Loop, Socket = require't.Loop', require't.Net.Socket'
+local idle   = tonumber( arg[1] ) or 10000
+local hot    = tonumber( arg[2] ) or 100
+local secs   = tonumber( arg[3] ) or 5
+local l      = Loop( )
+local snd    = Socket( 'udp' )
+local sckts  = { }
+local cnt    = 0
+
+local never  = function( s ) error( "Idle socket shouldn't fire: " .. tostring( s ) ) end
+local count  = function( ) cnt = cnt + 1 end
+local countS = function( s ) cnt = cnt + 1 end
+
+for i=1,idle do
+	local s = Socket( 'udp' )
+	s:bind( '127.0.0.1', 0 )
+	l:addHandle( s, 'read', never, s )
+	sckts[ #sckts+1 ] = s
+end
+for i=1,hot do
+	local s = Socket( 'udp' )
+	s:bind( '127.0.0.1', 0 )
+	snd:send( 'x', s:getsockname( ) )
+	if i%2 == 0 then
+		l:addHandle( s, 'read', countS, s )
+	else
+		l:addHandle( s, 'read', count )
+	end
+	sckts[ #sckts+1 ] = s
+end
+
+local start = Loop.hrtime( )
+l:addTask( secs*1000, function( )
+	local ns = Loop.hrtime( ) - start
+	print( ("%d idle, %d hot sockets: %d events in %.3fs -> %.0f events/s"):format(
+		idle, hot, cnt, ns/1e9, cnt/(ns/1e9) ) )
+	l:stop( )
+end )
+l:run( )
+for _,s in ipairs( sckts ) do s:close( ) end
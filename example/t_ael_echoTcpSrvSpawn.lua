@@ -0,0 +1,32 @@
+Socket,Interface,Loop  = require't.Net.Socket', require't.Net.Interface',require't.Loop'
+host   = Interface.default( ).address.ip
+port   = 8888
+l      = Loop( 10 )
+
+-- same as t_ael_echoTcpSrv.lua but each client runs in its own coroutine
+echo = function( c )
+	local msg,cnt = c:recv( )
+	while msg do
+		print( "RCVD:", cnt, msg:sub(1,39) )
+		print( "RSPD:", c:send( msg ) )
+		msg,cnt = c:recv( )
+	end
+	print( "Close Client" )
+	c:shutdown( 'write' )
+	c:close( )
+end
+
+accept = function( s )
+	while true do
+		local c,cAdr = s:accept( )
+		c.nonblock = true
+		print( c, cAdr )
+		l:spawn( echo, c )
+	end
+end
+
+sSck,sAdr = Socket.listen( host, port, 5 )
+sSck.nonblock = true
+print( sSck, sAdr, l )
+l:spawn( accept, sSck )
+l:run( )
@@ -0,0 +1,32 @@
+---
+-- \file       examples/t_ael_process.lua
+--             Fan out child processes from one loop.  Each child gets its
+--             stdout piped into a socket; output and exit status arrive as
+--             loop events, nothing blocks on a child.
+--             lua t_ael_process.lua [count=100]
+
+local Loop   = require't.Loop'
+local Socket = require't.Net.Socket'   -- registers the socket type for the pipes
+local count  = tonumber( arg[1] ) or 100
+local l      = Loop( )
+local bytes, done, failed = 0, 0, 0
+
+for i = 1, count do
+	local prc, _, out = l:spawnProcess( { 'sh', '-c', ('echo child %d; exit %d'):format( i, i % 3 ), stdout = true },
+		function( ok )
+			done   = done + 1
+			failed = failed + (ok and 0 or 1)
+		end )
+	l:addHandle( out, 'read', function( )
+		local s = out:recv( )
+		if s then
+			bytes = bytes + #s
+		else
+			l:removeHandle( out, 'read' )
+			out:close( )
+		end
+	end )
+end
+
+l:run( )
+print( ("%d processes exited, %d failed, %d bytes of output"):format( done, failed, bytes ) )
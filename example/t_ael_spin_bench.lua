@@ -0,0 +1,73 @@
+---
+-- \file       examples/t_ael_spin_bench.lua
+--             Measure the wakeup latency of T.Loop with a local UDP
+--             ping-pong.  Starts a second process which echoes datagrams;
+--             each round trip covers a wakeup of both loops.  Run it once
+--             blocking and once spinning to compare:
+--             lua t_ael_spin_bench.lua [rounds=20000] [spin=0] [busypoll=0]
+--             spin sets loop.spin, busypoll sets sck.busypoll and
+--             sck.preferbusypoll; both in microseconds.
+
+local Loop, Socket, Address = require't.Loop', require't.Net.Socket', require't.Net.Address'
+local rounds = tonumber( arg[1] ) or 20000
+local spin   = tonumber( arg[2] ) or 0
+local bpoll  = tonumber( arg[3] ) or 0
+local peer   = tonumber( arg[4] )     -- port of the ping side; pong only
+
+local setup  = function( )
+	local l, s = Loop( ), Socket( 'udp' )
+	s:bind( '127.0.0.1', 0 )
+	s.nonblock      = true
+	l.spin, l.stats = spin, true
+	if bpoll > 0 then
+		s.busypoll, s.preferbusypoll = bpoll, true
+	end
+	return l, s
+end
+
+if peer then   -- pong; echo until told to stop
+	local l, s = setup( )
+	s:connect( Address( '127.0.0.1', peer ) )
+	l:addHandle( s, 'read', function( )
+		local msg = s:recv( )
+		if 'stop' == msg then l:stop( ) else s:send( msg ) end
+	end )
+	s:send( 'ready' )
+	l:run( )
+	s:close( )
+	return
+end
+
+local l, s   = setup( )
+local rtt    = { }
+local adr    = Address( )
+local start
+
+local ping   = function( )
+	start = Loop.hrtime( )
+	s:send( 'ping' )
+end
+
+local pong   = io.popen( ('lua %s %d %d %d %d'):format(
+	arg[0], rounds, spin, bpoll, s:getsockname( ).port ), 'w' )
+
+l:addHandle( s, 'read', function( )
+	local msg = s:recv( adr )
+	if 'ready' == msg then
+		s:connect( adr )
+	else
+		rtt[ #rtt+1 ] = Loop.hrtime( ) - start
+	end
+	if #rtt < rounds then ping( ) else s:send( 'stop' ); l:stop( ) end
+end )
+l:run( )
+pong:close( )
+s:close( )
+
+table.sort( rtt )
+local pct = function( q ) return rtt[ math.max( 1, math.floor( q * #rtt + 0.5 ) ) ] / 1000 end
+local st  = l:stats( )
+print( ("spin=%dus busypoll=%dus  %d round trips; us: p50 %.1f  p90 %.1f  p99 %.1f  p999 %.1f  max %.1f"):format(
+	spin, bpoll, #rtt, pct( 0.5 ), pct( 0.9 ), pct( 0.99 ), pct( 0.999 ), rtt[ #rtt ] / 1000 ) )
+print( ("spin hits %d, blocking waits %d, cpu %.2fs"):format(
+	st.spinHits, st.blockingWaits, os.clock( ) ) )
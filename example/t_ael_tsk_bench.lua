@@ -0,0 +1,37 @@
+---
+-- \file       examples/t_ael_tsk_bench.lua
+--             Schedule and cancel a large number of tasks on a loop.  Measures
+--             the cost of addTask() and cancelTask() on a full task heap and
+--             the cost of executing them in order.
+--             lua t_ael_tsk_bench.lua [number of tasks]
+
+local Loop  = require't.Loop'
+local n     = tonumber( arg[1] ) or 1000000
+local l     = Loop( )
+local tasks = { }
+local cnt   = 0
+local f     = function( ) cnt = cnt + 1 end
+
+local bench = function( name, fnc )
+	local s = os.clock( )
+	fnc( )
+	local e = os.clock( ) - s
+	print( ("%-30s %8.3fs  %10.0f ops/s"):format( name, e, n/e ) )
+end
+
+-- random deadlines between 1 and 2 seconds; distributes tasks across the heap
+bench( ("addTask( %d )"):format( n ), function( )
+	for i=1,n do tasks[ i ] = l:addTask( math.random( 1000, 2000 ), f ) end
+end )
+bench( ("cancelTask( %d )"):format( n ), function( )
+	for i=1,n do l:cancelTask( tasks[ i ] ) end
+end )
+print( l )
+
+-- add again, cancel every second one and execute the rest
+for i=1,n do tasks[ i ] = l:addTask( math.random( 1, 1000 ), f ) end
+bench( ("cancelTask( %d ) every 2nd"):format( n//2 ), function( )
+	for i=1,n,2 do l:cancelTask( tasks[ i ] ) end
+end )
+bench( ("run( %d )"):format( n - n//2 ), function( ) l:run( ) end )
+assert( cnt == n - n//2, ("Expected %d executed tasks, got %d"):format( n - n//2, cnt ) )
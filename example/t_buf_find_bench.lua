@@ -0,0 +1,38 @@
+---
+-- \file       examples/t_buf_find_bench.lua
+--             Compare Buffer:find(), findByte(), count() and compare() against
+--             their string library equivalents on a 1MB input.  The needle
+--             sits at the very end so each search scans the whole input.
+--             lua t_buf_find_bench.lua [iterations=200]
+
+local Buffer = require't.Buffer'
+local n      = tonumber( arg[1] ) or 200
+local size   = 1024*1024
+local ndl    = 'needle in a haystack'
+local s      = ('abcdefghijklmnopqrstuvwxyz 0123456789'):rep( size // 37 + 1 ):sub( 1, size - #ndl ) .. ndl
+local b      = Buffer( s )
+local seg    = b:Segment( 2 )
+
+local bench = function( name, fnc )
+	local r
+	local s = os.clock( )
+	for i=1,n do r = fnc( ) end
+	local e = os.clock( ) - s
+	print( ("%-34s %8.3fs  %8.1f MB/s"):format( name, e, n*size/e/1024/1024 ) )
+	return r
+end
+
+print( ("Buffer.Simd = %s; %d iterations over %d bytes"):format( Buffer.Simd, n, size ) )
+local x = bench( "string.find( plain )",       function( ) return s:find( ndl, 1, true ) end )
+local y = bench( "Buffer:find( )",             function( ) return b:find( ndl ) end )
+assert( x == y, ("Expected same position; got %s and %s"):format( x, y ) )
+bench( "Buffer.Segment:find( )",               function( ) return seg:find( ndl ) end )
+x = bench( "string.find( '[!?]' )",            function( ) return s:find( '[!?]' ) end )
+y = bench( "Buffer:findByte( '!?' )",          function( ) return b:findByte( '!?' ) end )
+assert( x == y, "Expected nothing found" )
+x = bench( "select( 2, string.gsub( ' ' ) )",  function( ) return select( 2, s:gsub( ' ', ' ' ) ) end )
+y = bench( "Buffer:count( ' ' )",              function( ) return b:count( ' ' ) end )
+assert( x == y, ("Expected same count; got %s and %s"):format( x, y ) )
+local c = Buffer( b )
+bench( "Buffer == Buffer",                     function( ) return b == c end )
+bench( "Buffer:compare( Buffer )",             function( ) return b:compare( c ) end )
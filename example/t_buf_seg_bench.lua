@@ -0,0 +1,48 @@
+---
+-- \file       examples/t_buf_seg_bench.lua
+--             Walk a large Buffer in fixed size windows.  Compares creating
+--             a Segment per window with moving one Segment by seg:next() and
+--             seg:iterate().  Each window gets read by a Pack to exercise
+--             the byte access of the Segment.
+--             lua t_buf_seg_bench.lua [MB=100] [window=4096]
+
+local Buffer = require't.Buffer'
+local Pack   = require't.Pack'
+local mb     = tonumber( arg[1] ) or 100
+local win    = tonumber( arg[2] ) or 4096
+local b      = Buffer( mb*1024*1024 )
+local p      = Pack( '>I4' )
+local n      = 0
+
+local bench = function( name, fnc )
+	n = 0
+	collectgarbage( )
+	local s = os.clock( )
+	fnc( )
+	local e = os.clock( ) - s
+	print( ("%-32s %8.3fs  %10.0f windows/s  %8.1f MB/s"):format( name, e, n/e, mb/e ) )
+end
+
+print( ("%d MB Buffer; %d byte windows"):format( mb, win ) )
+bench( "Buffer:Segment( ) per window", function( )
+	for i=1,#b,win do
+		local s = b:Segment( i, (i+win-1 > #b) and #b-i+1 or win )
+		n = n + p( s )+1
+	end
+end )
+bench( "seg:next( )", function( )
+	local s = b:Segment( 1, win )
+	repeat
+		n = n + p( s )+1
+	until not s:next( )
+end )
+bench( "seg:iterate( )", function( )
+	for s in b:Segment( 1, win ):iterate( ) do
+		n = n + p( s )+1
+	end
+end )
+bench( "seg:iterate( ) and seg:count( )", function( )
+	for s in b:Segment( 1, win ):iterate( ) do
+		n = n + s:count( 0 )//win
+	end
+end )
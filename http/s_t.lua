@@ -84,20 +84,41 @@ local callback = function( req, res )
 	end
 end
 
-local httpServer = Server( Loop(), callback )
-
-local host,port = '0.0.0.0',8000
+local host,port,workers = '0.0.0.0',8000,1
 if arg[ 1 ] then
 	port = tonumber( arg[ 1 ] )
 end
 if arg[ 2 ] then
 	host = arg[ 2 ]
 end
+if arg[ 3 ] then
+	workers = tonumber( arg[ 3 ] )
+end
 
---httpServer:on( 'connection', function( stream )
---	print("Connected new connection:", stream.socket.descriptor)
---end )
+-- each worker runs its own loop and server; the listening sockets share the
+-- port via SO_REUSEPORT and the kernel balances connections across them
+local serve = function( id )
+	local httpServer = Server( Loop(), callback )
+
+	--httpServer:on( 'connection', function( stream )
+	--	print("Connected new connection:", stream.socket.descriptor)
+	--end )
+
+	local srv, adr   = httpServer:listen( host, port )
+	print( ("Started `%s` at `%s` (%s) worker %d"):format( srv, adr, srv.family, id ) )
+	-- finish in-flight responses before exiting
+	httpServer.ael:addSignal( 'SIGTERM', httpServer.shutdown, httpServer )
+	httpServer.ael:addSignal( 'SIGINT',  httpServer.shutdown, httpServer )
+	httpServer.ael:run( )
+end
 
-local srv, adr   = httpServer:listen( host, port )
-print( ("Started `%s` at `%s` (%s)"):format( srv, adr, srv.family ) )
-httpServer.ael:run( )
+if workers > 1 then
+	-- users created via /newUser are only known to one worker; seed the
+	-- benchmark user for all of them
+	users[ 'mickey' ] = rot47( 'goofey' )
+	local wrk = Loop.Worker( workers, serve )
+	print( ("Started %s"):format( wrk ) )
+	wrk:join( )  -- Ctrl-C reaches all workers; each shuts down gracefully
+else
+	serve( 1 )
+end
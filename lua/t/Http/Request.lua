@@ -28,8 +28,13 @@ local State = {
 }
 
 -- receive
+-- @param  data string or T.Buffer.Ring; a ring keeps the unparsed tail itself
 -- @return boolean true if done, else false
 local receive = function( self, data )
+	if 'string' ~= type( data ) then
+		self:parse( data, self.state )
+		return State.Done == self.state
+	end
 	-- parse( ) calls C code that fills up self.* properties such as
 	-- query, url, headers etc.
 	local tail = self:parse( self.tail and (self.tail .. data) or data, self.state )
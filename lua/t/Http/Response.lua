@@ -5,9 +5,10 @@
 
 local setmetatable, pairs =
       setmetatable, pairs
-local t_insert    , t_concat    ,  o_time,  o_date,      s_format =
-      table.insert, table.concat, os.time, os.date, string.format
+local o_time , o_date , s_format =
+      os.time, os.date, string.format
 local Status, Version = require't.Http.Status', require't.Http.Version'
+local Chain           = require't.Buffer'.Chain
 
 local _mt
 
@@ -30,23 +31,32 @@ local now = (function( )
 	end
 end) ( )
 
+-- body parts get referenced by the chain, not copied
+local writeBody = function( self, msg )
+	if self.chunked then
+		self.buf:write( s_format( "%X\r\n", #msg ), msg, "\r\n" )
+	else
+		self.buf:write( msg )
+	end
+end
+
 local formHeader = function( self, msg )
 	if self.contentLength then self.chunked = false end
-	self.buf = {
+	self.buf = Chain(
 		Version[ self.version ] .." ".. self.statusCode .." ".. self.statusMessage ..
 		"\r\nDate: ".. now( ) ..
 		"\r\nConnection: " .. (self.keepAlive and "keep-alive" or "close") ..
 		(self.keepAlive and "\r\nKeep-Alive: timeout=5" or "") ..
 		(self.contentLength and "\r\nContent-Length: " .. self.contentLength or "\r\nTransfer-Encoding: chunked") ..
-		"\r\n" .. (self.headers and '' or '\r\n') ..
-		((not self.headers and msg) and (self.chunked and s_format( "%X\r\n%s\r\n", #msg, msg ) or msg) or '' )
-	}
+		"\r\n" .. (self.headers and '' or '\r\n')
+	)
 	if self.headers then
 		for k,v in pairs( self.headers ) do
-			t_insert( self.buf, k .. ": " ..v.. "\r\n" )
+			self.buf:write( k .. ": " ..v.. "\r\n" )
 		end
-		t_insert( self.buf, msg and "\r\n"..msg or "\r\n" )
+		self.buf:write( "\r\n" )
 	end
+	if msg then writeBody( self, msg ) end
 end
 
 -- this takes different parameters in different positions
@@ -74,7 +84,7 @@ local write = function( self, msg )
 	if self.state < State.Written then
 		formHeader( self, msg )
 	else
-		t_insert( self.buf, self.chunked and s_format( "%X\r\n%s\r\n", #msg, msg ) or msg )
+		writeBody( self, msg )
 	end
 	self.state = State.Written
 	self.stream:addResponse( self )
@@ -91,28 +101,20 @@ local finish = function( self, code, msg )
 		self.contentLength = msg and #msg or 0
 		formHeader( self, msg )
 	else
-		if msg and self.chunked then
-			t_insert( self.buf, s_format( "%X\r\n%s\r\n0\r\n\r\n", #msg, msg ) )
-		elseif msg then
-			t_insert( self.buf, msg )
-		elseif self.chunked then
-			t_insert( self.buf, "0\r\n\r\n" )
+		if msg then
+			writeBody( self, msg )
+		end
+		if self.chunked then
+			self.buf:write( "0\r\n\r\n" )
 		end
 	end
 	self.state = State.Done
 	self.stream:addResponse( self )
 end
 
+-- Buffer.Chain; Net.Socket:send( ) consumes what got sent
 local getBuffer = function( self )
-	return t_concat( self.buf )
-end
-
-local setBuffer = function( self, buf )
-	if buf then
-		self.buf = { buf }
-	else
-		self.buf = { }
-	end
+	return self.buf
 end
 
 -- ---------------------------- Instance metatable --------------------
@@ -123,7 +125,6 @@ _mt = {       -- local _mt at top of file
 	, finish     = finish
 	-- considered internal
 	, getBuffer  = getBuffer
-	, setBuffer  = setBuffer
 }
 _mt.__index     = _mt
 
@@ -13,16 +13,19 @@ local t_type  = require't'.type
 local s_format,t_insert = string.format,os.time,table.insert
 
 local _mt
-local timeout = 5000
+local timeout   = 5000   -- idle streams get closed; see Stream idle task
+local acceptMax = 64     -- accept() calls per readable event; the rest next iteration
 
 -- ---------------------------- general helpers  --------------------
 local accept_cb = function( self )
 	local ac_count = 0
-	-- greedily accept() as much as we can to favour high concurrency
+	-- greedily accept() to favour high concurrency but leave the loop to the
+	-- established connections after acceptMax; the listener stays readable
 	repeat
 		local cli, adr      = self.sck:accept( )
 		if cli then
 			ac_count = ac_count + 1
+			self.accepted       = self.accepted + 1
 			cli.nonblock        = true
 			self.streams[ cli ] = Stream( self, cli, adr )
 			if self._event_handlers.connection then
@@ -35,7 +38,7 @@ local accept_cb = function( self )
 				--print( s_format( "Accepted simultaniously: %d", ac_count ) )
 			end
 		end
-	until not cli
+	until not cli or ac_count >= acceptMax
 end
 
 local listen = function( self, host, port, bl )
@@ -59,6 +62,32 @@ local removeStream = function( self, stream )
 	self.streams[ stream.cli ] = nil
 end
 
+-- stop accepting connections and close each stream once it is done; the loop
+-- ends once all streams are gone
+local shutdown = function( self )
+	if self.sck then
+		self.ael:removeHandle( self.sck, 'read' )
+		self.sck:close( )
+		self.sck = nil
+	end
+	self.closing = true
+	for _,stream in pairs( self.streams ) do
+		stream:shutdown( )
+	end
+end
+
+-- connection counters and the loops statistics; the latter only if loop.stats
+-- is enabled
+local stats = function( self, reset )
+	local cnt = 0
+	for _ in pairs( self.streams ) do cnt = cnt + 1 end
+	return {
+		  accepted    = self.accepted
+		, connections = cnt
+		, loop        = self.ael:stats( reset )
+	}
+end
+
 local on = function( self, event_name, handler )
 	self._event_handlers[ event_name ] = handler
 end
@@ -68,6 +97,8 @@ _mt = {       -- local _mt at top of file
 	-- essentials
 	  __name     = "t.Http.Server"
 	, listen     = listen
+	, shutdown   = shutdown
+	, stats      = stats
 	, on         = on
 }
 
@@ -95,37 +126,11 @@ return setmetatable( {
 			  ael              = ael
 			, callback         = cb
 			, streams          = { }
+			, closing          = false
+			, accepted         = 0
+			, timeout          = timeout   -- ms a stream may idle before it gets closed
 			, _event_handlers  = { }
 		}
-		-- crude keepAlive handling, rudely remove staleish sockets
-		--[[
-		local timer   = Time( timeout )
-		local remover = (function( srv )
-			local str = srv.streams
-			return function( )
-				local t          = srv.ael:time() - timeout
-				print('rinse', srv.ael)
-				local candidates = { }
-				for k,v in pairs( str ) do
-					if v.lastAction < t then
-						print(" Overdue:",v.lastAction, t,  t - v.lastAction)
-						t_insert( candidates, v.sck )
-					end
-				end
-				for k,v in pairs( candidates ) do
-					print("############# Timeout CLOSE Socket:", v, str[ v ] )
-					ael:removeHandle( v, 'readwrite' )
-					v:close( )
-					str[ v ] = nil
-				end
-				--dR()
-				--collectgarbage()
-				return timeout
-			end
-		end)( srv )
-		ael:addTask( timeout, remover )
-		--]]
-
 		return setmetatable( srv, _mt )
 	end
 } )
@@ -7,7 +7,7 @@
 -- \author    tkieslich
 -- \copyright See Copyright notice at the end of src/t.h
 
-local Loop, T = require't.Loop', require't'
+local Loop, T, Buffer = require't.Loop', require't', require't.Buffer'
 local t_insert    , t_remove     =
       table.insert, table.remove
 local getmetatable, setmetatable, assert, type =
@@ -15,6 +15,8 @@ local getmetatable, setmetatable, assert, type =
 
 local Request, Response  = require't.Http.Request', require't.Http.Response'
 
+local EAGAIN = 11  -- EAGAIN/EWOULDBLOCK; socket buffer drained or full
+local SLACK  = 250 -- ms; idle timeouts within that window expire together
 
 local _mt
 
@@ -37,6 +39,8 @@ local destroy = function( self )
 		print( ("LONG RUNNING STREAM: `%s`  %f seconds"):format( self.socket, dur/1000 ) )
 	end
 	--print( "DESTROY:", self, self.socket )
+	self.srv.ael:cancelTask( self.idle )
+	self.srv.ael:removeHandle( self.socket, 'readwrite' )
 	self.requests  = nil
 	self.responses = nil
 	self.srv.streams[ self.socket ] = nil
@@ -44,30 +48,50 @@ local destroy = function( self )
 	self.socket    = nil
 end
 
+--  ************************************************************************
+--- Called via t.Loop once the stream didn't receive or send anything for
+--- srv.timeout.  A response the application still works on keeps it alive
+--  ************************************************************************
+local idle = function( self )
+	if not self.socket then return end
+	if next( self.responses ) then return self.srv.timeout end
+	destroy( self )
+end
+
+--  ************************************************************************
+--- Called via t.Loop when socket got readable
+--- The socket is observed edge triggered; read until the kernel buffer is
+--- drained, otherwise the remaining data won't be reported again
+--  ************************************************************************
 local recv = function( self )
-	local data, rcvd = self.socket:recv( )
-	local now = Loop.time( )
-	if not data then
-		-- it means the other side hung up; No more responses
-		if 0 ~= rcvd and self._event_handlers.error then
-			self._event_handlers.error(
-			   ("Socket(%s) receive error -> remove client Socket. Reason: (%s)"):format(
-			   self.socket, rcvd )
-			)
+	while self.socket and self.isReading do
+		-- received data gets appended to the streams ring; the parser consumes
+		-- what it could parse and leaves a partial request in there
+		local data, rcvd, eNo = self.socket:recv( self.buffer )
+		if not data then
+			if EAGAIN == eNo then return end -- drained; wait for next edge
+			-- it means the other side hung up; No more responses
+			if 0 ~= rcvd and self._event_handlers.error then
+				self._event_handlers.error(
+				   ("Socket(%s) receive error -> remove client Socket. Reason: (%s)"):format(
+				   self.socket, rcvd )
+				)
+			end
+			-- dispose of itself ... clear requests, buffer etc...
+			destroy( self )
+			return
 		end
-		-- dispose of itself ... clear requests, buffer etc...
-		self.srv.ael:removeHandle( self.socket, 'readwrite' )
-		destroy( self )
-	else
+		local now = Loop.time( )
 		self.lastAction, self.lastIn = now, now
+		self.srv.ael:touchTask( self.idle, self.srv.timeout )
 		local id, request = getRequest( self )
-		if request:receive( data ) then
+		if request:receive( self.buffer ) then
 			--print("REQUEST DONE")
 			t_remove( self.requests, request.id )
-			self.keepAlive = request.keepAlive
+			self.keepAlive = request.keepAlive and not self.srv.closing
 			if 0 == #self.requests and not self.keepAlive then
-				--print( "-----REMOVE read handler", self.socket)
-				self.srv.ael:removeHandle( self.socket, 'read' )
+				--print( "-----STOP reading", self.socket)
+				self.isReading = false
 			end
 		end
 		if request.state > Request.State.Headers then
@@ -82,28 +106,33 @@ end
 --  ************************************************************************
 local send  --- forward declaration
 local respond = function( self )
-	local destroyStream, removeFromLoop, stopSending = true, true, false
+	local destroyStream, stopSending = true, false
 	for k,v in pairs( self.responses ) do
-		local rspDone, sckRemove, stopSend = send( self, v )
-		if     stopSend   then stopSending    = true; break end -- socket is on the loop; wait for readyness
+		local rspDone, stopSend = send( self, v )
+		if     stopSend   then stopSending    = true; break end -- wait for socket to be writable
 		if not rspDone    then destroyStream  = false end -- when any not done, don't destroy
-		if not sckRemove  then removeFromLoop = false end -- when any not done, don't destroy
 	end
 	--[[
 	print( destroyStream    and "destroyStream"  or "keepStream",
-			 removeFromLoop   and "removeFromLoop" or "stayObserved",
 			 stopSending      and "stopSending"    or "sendNext",
-			 self.isOnOutLoop and "isInLoop"       or "notInLoop",
+			 self.isOnOutLoop and "isWaiting"      or "notWaiting",
 			 self.keepAlive   and "keepAlive"       or "close" )
 	--]]
-	if not stopSending then
-		if not self.keepAlive and destroyStream then
-			destroy( self )
-		end
-		if self.isOnOutLoop and removeFromLoop then
-			self.srv.ael:removeHandle( self.socket, "write" )
-			self.isOnOutLoop = true
-		end
+	if not stopSending and not self.keepAlive and destroyStream then
+		destroy( self )
+	end
+end
+
+--  ************************************************************************
+--- Called via t.Loop when socket got writable
+--- The socket is observed edge triggered for writing all the time; the edge
+--- is reported along with any read edge as well.  Only resume sending if a
+--- previous send() hit a full socket buffer.
+--  ************************************************************************
+local resume = function( self )
+	if self.isOnOutLoop then
+		self.isOnOutLoop = false
+		respond( self )
 	end
 end
 
@@ -115,37 +144,28 @@ end
 -- *************************************************************
 -- forward declared above
 send = function( self, response )
-	local responseDone, removeSocket, stopSending   = false, false, false
+	local responseDone, stopSending = false, false
 	local buf            = response:getBuffer( )
 	local snt, eMsg, eNo = self.socket:send( buf )
 	if snt then
 		local now            = Loop.time( )
 		self.lastAction, self.lastOut = now, now
-		if #buf == snt then
-			removeSocket = true
-			if Response.State.Done == response.state then
-				self.responses[ response.id ] = nil   -- release response
-				responseDone = true
-			else
-				response:setBuffer( nil )
-			end
-		else
-			response:setBuffer( buf:sub( snt+1 ) )
+		self.srv.ael:touchTask( self.idle, self.srv.timeout )
+		-- send( ) trimmed the sent bytes off the chain
+		if 0 == #buf and Response.State.Done == response.state then
+			self.responses[ response.id ] = nil   -- release response
+			responseDone = true
 		end
 	else
 		stopSending = true
-		if (11 == eNo) then --EAGAIN/EWOULDBLOCK -> put on loop
-			if not self.isOnOutLoop then
-				self.srv.ael:addHandle( self.socket, 'write', respond, self )
-				self.isOnOutLoop = true
-			end
+		if EAGAIN == eNo then -- socket is observed already; wait for the write edge
+			self.isOnOutLoop = true
 		else
 			print( "Failed to send:", eMsg, eNo )
-			self.srv.ael:removeHandle( self.socket, 'readwrite' )
 			destroy( self )
 		end
 	end
-	return responseDone, removeSocket, stopSending
+	return responseDone, stopSending
 end
 
 -- only run the response
@@ -162,6 +182,17 @@ local on = function( self, event_name, handler )
 	self._event_handlers[ event_name ] = handler
 end
 
+--  ************************************************************************
+--- Stop keeping the connection alive.  An idle stream gets closed right away,
+--- otherwise it gets closed once the in-flight responses are sent
+--  ************************************************************************
+local shutdown = function( self )
+	self.keepAlive = false
+	if 0 == #self.requests and not next( self.responses ) then
+		destroy( self )
+	end
+end
+
 -- ---------------------------- Instance metatable --------------------
 _mt = {       -- local _mt at top of file
 	-- essentials
@@ -169,6 +200,7 @@ _mt = {       -- local _mt at top of file
 	, __index     = _mt
 	, recv        = recv
 	, addResponse = addResponse
+	, shutdown    = shutdown
 }
 _mt.__index     = _mt
 
@@ -187,8 +219,10 @@ return setmetatable( {
 			, address          = adr     -- client Net.Address
 			, requests         = { }
 			, responses        = { }
+			, buffer           = Buffer.Ring( )
 			, strategy         = 1       -- 1=HTTP1.1; 2=HTTP2
 			, keepAlive        = true
+			, isReading        = true    -- false once a non keepAlive request is done
 			, isOnOutLoop      = false   -- we must wait for writing to resume again
 			, lastAction       = now
 			, lastOut          = now
@@ -197,8 +231,14 @@ return setmetatable( {
 			, _event_handlers  = { }
 		}
 
-		--print( "+++++ADDING read handler", sck)
-		srv.ael:addHandle( sck, 'read', recv, stream )
+		-- observe both directions edge triggered once; sending and receiving
+		-- never has to modify the observation of the socket
+		--print( "+++++ADDING read/write handler", sck)
+		srv.ael:addHandle( sck, Loop.READ  | Loop.EDGE | Loop.RDHUP, recv,   stream )
+		srv.ael:addHandle( sck, Loop.WRITE | Loop.EDGE | Loop.RDHUP, resume, stream )
+		-- refreshed by each receive and send; pushing the deadline back is O(1)
+		stream.idle = srv.ael:addTask( srv.timeout, idle, stream )
+		srv.ael:touchTask( stream.idle, srv.timeout, SLACK )
 		return setmetatable( stream, _mt )
 	end
 } )
@@ -12,6 +12,8 @@
  * \copyright See Copyright notice at the end of t.h
  */
 
+#define _POSIX_C_SOURCE 200809L   // struct itimerspec
+
 #include "t_ael_l.h"
 #include <sys/time.h>         // struct timeval
 
@@ -19,11 +21,19 @@
 #include "t_dbg.h"
 #endif
 
-#include <unistd.h>           // close
+#include <errno.h>            // errno, ENOENT, EBADF
+#include <unistd.h>           // close, read
+#include <limits.h>           // INT_MAX
+#include <stdint.h>           // uint64_t
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define P_AEL_EPL_SLOTSZ   64    // how many events can be returned for ONE call to epoll_wait()
+                                 // NOT how many fd can be observed, which is limited by ulimit!
+#define P_AEL_EPL_SLOTMAX  65536 // the events array doesn't grow beyond that
 
-#define P_AEL_EPL_SLOTSZ 1024 // how many events can be returned for ONE call to epoll_wait()
-                              // NOT how many fd can be observed, which is limited by ulimit!
+// backends of this unit for T.Loop( sz, impl )
+const char *const p_ael_impl_lst[ ] = { "epoll", NULL };
 
 static const char* t_ael_msk_lst[ ] = {
 	  "NONE"
@@ -32,9 +42,28 @@ static const char* t_ael_msk_lst[ ] = {
 	, "READWRITE"
 };
 
+// Each epoll_event carries the struct t_ael_dnd pointer of the node.  It is
+// valid as long as the node is referenced by the loops descriptor table.  If
+// a handler removes a descriptor entirely, events of the same batch which
+// still point to that node get invalidated (data.ptr = NULL), including the
+// event currently dispatched.
+// Edge triggered nodes which are readable and writable get both handlers
+// executed from the same event since the edge won't be reported again.
+// If the loops budget is spent the rest of the batch stays in events[] and
+// gets dispatched in the next iteration before epoll_wait() is called again.
+// events[] is sized by Loop( sz ) and lives in a userdata which is the
+// uservalue of the state.  If epoll_wait() fills it, it gets doubled before
+// the next call, once no events are carried over anymore.
 struct p_ael_ste {
 	int                 epfd;
-	struct epoll_event events[ P_AEL_EPL_SLOTSZ ];
+	int                 tfd;      ///< timerfd for hires timeouts; -1 if unused
+	int                 tarm;     ///< boolean; is tfd armed
+	int                 evCur;    ///< index of currently dispatched event
+	int                 evCnt;    ///< number of events in current batch; > evCur
+	                              ///< between iterations if batch got carried
+	int                 evMax;    ///< capacity of events
+	int                 grow;     ///< boolean; last epoll_wait() filled events
+	struct epoll_event *events;
 };
 
 
@@ -55,18 +84,66 @@ static inline struct p_ael_ste
 }
 
 
+/**--------------------------------------------------------------------------
+ * (Re-)allocate the events array of the state.
+ * The previous array is left to the garbage collector.
+ * \param   L       Lua state.
+ * \param   state   struct p_ael_ste*; epoll state.
+ * \param   stepos  int; position of state on the stack.
+ * \param   sz      int; number of events.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+p_ael_setEvents( lua_State *L, struct p_ael_ste *state, int stepos, int sz )
+{
+	stepos        = lua_absindex( L, stepos );
+	sz            = (sz < 1) ? 1 : (sz > P_AEL_EPL_SLOTMAX) ? P_AEL_EPL_SLOTMAX : sz;
+	state->events = (struct epoll_event *) lua_newuserdatauv( L,
+	                   sz * sizeof( struct epoll_event ), 0 );
+	state->evMax  = sz;
+	lua_setiuservalue( L, stepos, 1 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Translate direction and mode of a node into epoll event bits.
+ * \param   msk   enum t_ael_msk; directions to observe.
+ * \param   mod   enum t_ael_msk; mode bits of the node.
+ * \return  uint32_t epoll events.
+ * --------------------------------------------------------------------------*/
+static inline uint32_t
+p_ael_events( enum t_ael_msk msk, enum t_ael_msk mod )
+{
+	uint32_t events = 0;
+	if (msk & T_AEL_RD) events |= EPOLLIN;
+	if (msk & T_AEL_WR) events |= EPOLLOUT;
+	if (mod & T_AEL_ET) events |= EPOLLET;
+	if (mod & T_AEL_OS) events |= EPOLLONESHOT;
+	if (mod & T_AEL_HU) events |= EPOLLRDHUP;
+	return events;
+}
+
+
 /**--------------------------------------------------------------------------
  * epoll specific initialization of t_ael->state.
- * \param   L   Lua state.
- * \param   ael struct t_ael*; pointer to userdata on Lua Stack.
+ * \param   L    Lua state.
+ * \param  *ael  struct t_ael*; the loop; impl gets set.
+ * \param   sz   int; number of events per epoll_wait(); 0 for default.
  * \return  int
  * --------------------------------------------------------------------------*/
 void
-p_ael_create_ud_impl( lua_State *L )
+p_ael_create_ud_impl( lua_State *L, struct t_ael *ael, int sz )
 {
 	struct p_ael_ste *state;
-	state = (struct p_ael_ste *) lua_newuserdata( L, sizeof( struct p_ael_ste ) );
+	state = (struct p_ael_ste *) lua_newuserdatauv( L, sizeof( struct p_ael_ste ), 1 );
+	ael->impl    = 0;
 
+	state->tfd   = -1;
+	state->tarm  = 0;
+	state->evCur = 0;
+	state->evCnt = 0;
+	state->grow  = 0;
+	p_ael_setEvents( L, state, -1, (sz > 0) ? sz : P_AEL_EPL_SLOTSZ );
 	state->epfd = epoll_create1( 0 );
 	if (state->epfd == -1)
 		luaL_error( L, "couldn't create event socket for epoll loop" );
@@ -82,6 +159,8 @@ void
 p_ael_free_impl( lua_State *L, int aelpos )
 {
 	struct p_ael_ste *state = p_ael_getState( L, aelpos );
+	if (-1 != state->tfd)
+		close( state->tfd );
 	close( state->epfd );
 }
 
@@ -112,11 +191,12 @@ p_ael_addhandle_impl( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int fd, e
 	                           : EPOLL_CTL_MOD;
 	struct epoll_event ee    = {0,{0}}; // avoid valgrind warning
 
-	ee.events = 0;
-	if (addmsk & T_AEL_RD) ee.events |= EPOLLIN;
-	if (addmsk & T_AEL_WR) ee.events |= EPOLLOUT;
-	ee.data.fd = fd;
-	if (-1 == epoll_ctl( state->epfd, op, fd, &ee ))
+	ee.events   = p_ael_events( addmsk, dnd->mod );
+	ee.data.ptr = dnd;
+	// a descriptor closed while observed left the set; it's a new one now
+	if (-1 == epoll_ctl( state->epfd, op, fd, &ee ) &&
+	    (EPOLL_CTL_MOD != op || ENOENT != errno ||
+	     -1 == epoll_ctl( state->epfd, (op = EPOLL_CTL_ADD), fd, &ee )))
 		return t_push_error( L, 1, 1, "Error %s descriptor [%d:%s] to set",
 				(op == EPOLL_CTL_MOD) ? "modifying" : "adding",
 				fd, t_ael_msk_lst[ addmsk ] );
@@ -146,11 +226,15 @@ p_ael_removehandle_impl( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int fd
 	delmsk = dnd->msk & (~delmsk);
 	int op = (T_AEL_NO != delmsk) ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
 	struct epoll_event ee    = {0,{0}}; // avoid valgrind warning
-	ee.events = 0;
-	if (delmsk & T_AEL_RD) ee.events |= EPOLLIN;
-	if (delmsk & T_AEL_WR) ee.events |= EPOLLOUT;
-	ee.data.fd = fd;
-	if (-1 == epoll_ctl( state->epfd, op, fd, &ee ))
+	int                i;
+	ee.events   = p_ael_events( delmsk, dnd->mod );
+	ee.data.ptr = dnd;
+	if (EPOLL_CTL_DEL == op)  // node might get collected; invalidate pending events
+		for (i = state->evCur; i < state->evCnt; i++)
+			if (dnd == state->events[ i ].data.ptr)
+				state->events[ i ].data.ptr = NULL;
+	// a descriptor closed while observed has left the set already
+	if (-1 == epoll_ctl( state->epfd, op, fd, &ee ) && EBADF != errno && ENOENT != errno)
 		return t_push_error( L, 1, 1, "Error %s descriptor [%d:%s] in set",
 				(op == EPOLL_CTL_MOD) ? "modifying" : "removing",
 				fd, t_ael_msk_lst[ delmsk ] );
@@ -158,61 +242,182 @@ p_ael_removehandle_impl( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int fd
 }
 
 
+/**--------------------------------------------------------------------------
+ * Calculate timeout for epoll_wait() and arm the timerfd in hires mode.
+ * epoll_wait() only takes milliseconds.  In regular mode the timeout gets
+ * rounded up to the next millisecond so tasks never fire early.  In hires
+ * mode a timerfd armed with the nanosecond timeout is part of the epoll set
+ * and epoll_wait() blocks until it or another descriptor fires.
+ * \param   L       Lua state.
+ * \param   state   struct p_ael_ste*; epoll state.
+ * \param   hires   int; boolean; use timerfd for sub-millisecond precision.
+ * \param   timeout lua_Integer; timeout in nanoseconds or T_AEL_NOTIMEOUT.
+ * \return  int     timeout in milliseconds for epoll_wait().
+ * --------------------------------------------------------------------------*/
+static int
+p_ael_timeout( lua_State *L, struct p_ael_ste *state, int hires, lua_Integer timeout )
+{
+	struct itimerspec  its   = {{0,0},{0,0}};
+	struct epoll_event ee    = {0,{0}};
+
+	if (hires && timeout > 0)
+	{
+		if (-1 == state->tfd)
+		{
+			state->tfd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+			ee.events   = EPOLLIN;
+			ee.data.ptr = state;    // marks timer events
+			if (-1 == state->tfd || -1 == epoll_ctl( state->epfd, EPOLL_CTL_ADD, state->tfd, &ee ))
+			{
+				if (-1 != state->tfd)   // don't arm a timer which isn't in the set
+					close( state->tfd );
+				state->tfd = -1;
+				return t_push_error( L, 1, 1, "couldn't create timer for hires loop" );
+			}
+		}
+		its.it_value.tv_sec  = timeout / T_AEL_NSEC_SEC;
+		its.it_value.tv_nsec = timeout % T_AEL_NSEC_SEC;
+		timerfd_settime( state->tfd, 0, &its, NULL );
+		state->tarm = 1;
+		return -1;
+	}
+	if (state->tarm)     // disarm, avoids spurious wakeups
+	{
+		timerfd_settime( state->tfd, 0, &its, NULL );
+		state->tarm = 0;
+	}
+	if (timeout < 0)
+		return -1;
+	return (timeout / T_AEL_NSEC_MSEC >= INT_MAX)
+		? INT_MAX
+		: (int) ((timeout + T_AEL_NSEC_MSEC - 1) / T_AEL_NSEC_MSEC);
+}
+
+
+/**--------------------------------------------------------------------------
+ * Busy poll for events before blocking.
+ * Calls epoll_wait() without timeout until events arrive, loop.spin
+ * microseconds passed or the next task is due.  A wakeup that way costs no
+ * context switch.  The remaining timeout is left for the blocking wait.
+ * \param   state   struct p_ael_ste*; epoll state.
+ * \param  *ael     struct t_ael*; the loop.
+ * \param  *timeout lua_Integer*; timeout in nanoseconds or T_AEL_NOTIMEOUT.
+ * \return  int     number of events; 0 if the window passed without any.
+ * --------------------------------------------------------------------------*/
+static int
+p_ael_spin( struct p_ael_ste *state, struct t_ael *ael, lua_Integer *timeout )
+{
+	lua_Integer start = t_ael_now( );
+	lua_Integer win   = (lua_Integer) ael->spin * T_AEL_NSEC_USEC;
+	lua_Integer now   = start;
+	int         r;
+
+	win = (*timeout >= 0 && *timeout < win) ? *timeout : win;
+	while (0 == (r = epoll_wait( state->epfd, state->events, state->evMax, 0 ))
+	       && (now = t_ael_now( )) - start < win)
+		;
+	if (*timeout > 0)
+		*timeout = (now - start < *timeout) ? *timeout - (now - start) : 0;
+	if (r > 0 && NULL != ael->sts)
+		ael->sts->spin++;
+	return r;
+}
+
+
 /**--------------------------------------------------------------------------
  * Set up a epoll_wait() call for all events in the T.Loop
  * \param   L       Lua state.
+ * \param   timeout lua_Integer; timeout for next fallthrough in nanoseconds.
  * \param   aelpos  int; position of t_ael loop struct on stack.
- * \param   timeout int; timeout for next fallthrough in milliseconds.
  * \return  int     number returns from select.
  * --------------------------------------------------------------------------*/
 int
-p_ael_poll_impl( lua_State *L, int timeout, int aelpos )
+p_ael_poll_impl( lua_State *L, lua_Integer timeout, int aelpos )
 {
 	struct p_ael_ste   *state = p_ael_getState( L, aelpos );
+	struct t_ael       *ael   = (struct t_ael *) lua_touserdata( L, aelpos );
 	struct epoll_event *e;
+	struct t_ael_dnd   *dnd;
 	int                 i,r,c = 0;
-	int                 msk;
+	int                 msk, hds;
+	uint64_t            exp;
+	lua_Integer         start;
 
 	//printf("EPOLL TIMEOUT: %lld -- ", timeout); t_stackDump(L);
-	r = epoll_wait(
-	   state->epfd,
-	   state->events,
-	   P_AEL_EPL_SLOTSZ,
-	   (timeout > T_AEL_NOTIMEOUT)
-	      ? timeout
-	      : -1
-	);
+	if (state->evCur >= state->evCnt)   // nothing carried over; wait for events
+	{
+		if (state->grow)
+		{
+			lua_getiuservalue( L, aelpos, T_AEL_STEIDX );
+			p_ael_setEvents( L, state, -1, 2 * state->evMax );
+			lua_pop( L, 1 );
+			state->grow = 0;
+		}
+		r = (ael->spin > 0 && 0 != timeout) ? p_ael_spin( state, ael, &timeout ) : 0;
+		if (0 == r)
+		{
+			r = epoll_wait(
+			   state->epfd,
+			   state->events,
+			   state->evMax,
+			   p_ael_timeout( L, state, ael->hires, timeout )
+			);
+			if (0 != timeout && NULL != ael->sts)
+				ael->sts->blk++;
+		}
+		else if (state->tarm)   // timer armed by an earlier iteration is stale
+			p_ael_timeout( L, state, 0, T_AEL_NOTIMEOUT );
 #if PRINT_DEBUGS == 1
-	printf( "    &&&&&&&&&&&& POLL RETURNED: %d &&&&&&&&&&&&&&&&&&\n", r );
+		printf( "    &&&&&&&&&&&& POLL RETURNED: %d &&&&&&&&&&&&&&&&&&\n", r );
 #endif
-	if (r<0)
-		return t_push_error( L, 1, 1, "epoll_wait() failed" );
+		if (r<0)
+			return t_push_error( L, 1, 1, "epoll_wait() failed" );
+		state->evCur = 0;
+		state->evCnt = r;
+		state->grow  = (r == state->evMax && r < P_AEL_EPL_SLOTMAX);
+	}
+	start = (ael->budgetTime > 0) ? t_ael_now( ) : 0;
+	lua_getiuservalue( L, aelpos, T_AEL_HDSIDX );        //S: … hds
+	hds   = lua_gettop( L );
 
-	if (r > 0)
+	for (i=state->evCur; i<state->evCnt; i++)
 	{
-		lua_getiuservalue( L, aelpos, T_AEL_DSCIDX );
-		for (i=0; i<r; i++)
-		{
-			msk = T_AEL_NO;
-			e   = state->events + i;
+		if ((ael->budget > 0 || ael->budgetTime > 0) &&
+		    t_ael_budgetSpent( ael, c, start, state->evCnt - i ))
+			break;
+		msk = T_AEL_NO;
+		e   = state->events + i;
 
-			if (e->events & EPOLLIN)  msk |= T_AEL_RD;
-			if (e->events & EPOLLOUT || e->events & EPOLLERR || e->events & EPOLLHUP) msk |= T_AEL_WR;
-			if (T_AEL_NO != msk)
-			{
+		if (state == e->data.ptr)    // hires timer expired; tasks get processed by loop
+		{
+			state->tarm = (read( state->tfd, &exp, sizeof( exp ) ) < 0) ? state->tarm : 0;
+			continue;
+		}
+		if (NULL == e->data.ptr)     // descriptor got removed by previous handler
+			continue;
+		if (e->events & EPOLLIN || e->events & EPOLLRDHUP) msk |= T_AEL_RD;
+		if (e->events & EPOLLOUT || e->events & EPOLLERR || e->events & EPOLLHUP) msk |= T_AEL_WR;
+		if (T_AEL_NO != msk)
+		{
 #if PRINT_DEBUGS == 1
-				printf( "  _____ FD: %d triggered[%s]____\n", e->data.fd, t_ael_msk_lst[ msk ] );
+			printf( "  _____ DND: %p triggered[%s]____\n", e->data.ptr, t_ael_msk_lst[ msk ] );
 #endif
-				//printf("EPOLL DND  ");t_stackDump(L);
-				lua_rawgeti( L, -1, e->data.fd );           //S: ael nds dnd
-				t_ael_dnd_execute( L, t_ael_dnd_check_ud( L, -1, 1 ), msk );
-				lua_pop( L, 1 );
-				c++;
+			state->evCur = i;
+			dnd          = (struct t_ael_dnd *) e->data.ptr;
+			if (T_AEL_RW == msk && dnd->mod & T_AEL_ET)
+			{
+				t_ael_dnd_execute( L, ael, hds, dnd, T_AEL_RD );
+				if (dnd == e->data.ptr)   // not removed by the read handler
+					t_ael_dnd_execute( L, ael, hds, dnd, T_AEL_WR );
 			}
+			else
+				t_ael_dnd_execute( L, ael, hds, dnd, msk );
+			c++;
 		}
-		lua_pop( L, 1 );
 	}
+	lua_pop( L, 1 );                                     //S: …
+	state->evCur = (i < state->evCnt) ? i : 0;
+	state->evCnt = (i < state->evCnt) ? state->evCnt : 0;
 	//printf("EPOLLED TIMEOUT: %lld -- ", timeout); t_stackDump(L);
 	return c;
 }
-
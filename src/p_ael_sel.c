@@ -37,6 +37,12 @@ static const char* t_ael_msk_lst[ ] = {
 // allows it to be excluded from any resize efforts/necessities.  If there is a
 // system where FD_SETSIZE is manipulated and much bigger, using the select()
 // based Loop is probably the wrong choice to begin with.
+// select() is level triggered only.  The mode bits of a node (T.Loop.EDGE,
+// T.Loop.ONESHOT, T.Loop.RDHUP) are ignored; level triggered notifications are
+// a superset of edge triggered ones and a hang up makes a socket readable.
+// backends of this unit for T.Loop( sz, impl )
+const char *const p_ael_impl_lst[ ] = { "select", NULL };
+
 struct p_ael_ste {
 	fd_set rfds;
 	fd_set wfds;
@@ -67,18 +73,21 @@ static inline struct p_ael_ste
 /* --------------------------------------------------------------------------
  * select() specific initialization of t_ael->state.
  * \param   L      Lua state.
- * \param   struct t_ael * pointer to new userdata on Lua Stack
+ * \param  *ael    struct t_ael*; the loop; impl gets set.
+ * \param   sz     int; size hint; select() reports all descriptors anyway.
  * \return  int
  * --------------------------------------------------------------------------*/
 void
-p_ael_create_ud_impl( lua_State *L )
+p_ael_create_ud_impl( lua_State *L, struct t_ael *ael, int sz )
 {
 	struct p_ael_ste *state;
 	state = (struct p_ael_ste *) lua_newuserdata( L, sizeof( struct p_ael_ste ) );
+	ael->impl = 0;
 	FD_ZERO( &state->rfds );
 	FD_ZERO( &state->wfds );
 	FD_ZERO( &state->rfds_w );
 	FD_ZERO( &state->wfds_w );
+	UNUSED( sz );
 }
 
 
@@ -168,23 +177,25 @@ p_ael_removehandle_impl( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int fd
  * Set up a select call for all events in the T.Loop
  * \param   L       Lua state.
  * \param   aelpos  int; position of t_ael loop struct on stack.
- * \param   timeout int; timeout for next fallthrough in milliseconds.
+ * \param   timeout lua_Integer; timeout for next fallthrough in nanoseconds.
  * \return  int  number returns from select.
  * --------------------------------------------------------------------------*/
 int
-p_ael_poll_impl( lua_State *L, int timeout, int aelpos )
+p_ael_poll_impl( lua_State *L, lua_Integer timeout, int aelpos )
 {
 	UNUSED( L );
 	struct p_ael_ste *state = p_ael_getState( L, aelpos );
+	struct t_ael     *ael   = (struct t_ael *) lua_touserdata( L, aelpos );
 	struct t_ael_dnd *dnd;
 	struct timeval   tv     = {-1, 0};
 	int               i,r,c = 0;
 	int                 msk;
 
-	if (timeout > T_AEL_NOTIMEOUT)
+	if (timeout > T_AEL_NOTIMEOUT)   // round up to microseconds
 	{
-		tv.tv_sec  = (timeout / 1000);
-		tv.tv_usec = (timeout % 1000) * 1000;
+		timeout    = (timeout + 999) / 1000;
+		tv.tv_sec  = (timeout / 1000000);
+		tv.tv_usec = (timeout % 1000000);
 	}
 
 	memcpy( &state->rfds_w, &state->rfds, sizeof( fd_set ) );
@@ -200,6 +211,7 @@ p_ael_poll_impl( lua_State *L, int timeout, int aelpos )
 
 	if (r>0)
 	{
+		lua_getiuservalue( L, aelpos, T_AEL_HDSIDX );
 		lua_getiuservalue( L, aelpos, T_AEL_DSCIDX );
 		for (i=0; r>0 && i <= state->fdMax; i++)
 		{
@@ -218,12 +230,13 @@ p_ael_poll_impl( lua_State *L, int timeout, int aelpos )
 				msk |= T_AEL_WR;
 			if (T_AEL_NO != msk)
 			{
-				t_ael_dnd_execute( L, dnd, msk );
+				t_ael_dnd_execute( L, ael, -3, dnd, msk );
 				r--;
+				c++;
 			}
 			lua_pop( L, 1 );
 		}
-		lua_pop( L, 1 );
+		lua_pop( L, 2 );
 	}
 
 	return c;
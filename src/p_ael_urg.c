@@ -0,0 +1,510 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      p_ael_urg.c
+ * \brief     io_uring specific implementation for T.Loop.
+ * \detail    Handles implmentation specific functions such as registering
+ *            events and executing the loop.  Readiness is observed with
+ *            IORING_OP_POLL_ADD requests.  All requests queued while
+ *            handlers run are submitted in a single io_uring_enter() call
+ *            which also waits for the next completions.  This saves the
+ *            epoll_ctl() syscall per added/removed handle.
+ *            Poll requests are one-shot and get re-armed after the handler
+ *            ran which keeps the level triggered semantics of the epoll
+ *            implementation.  T.Loop.EDGE handles use multishot poll
+ *            requests (Linux 5.13) which stay armed and post a completion
+ *            per wakeup, so they don't get re-armed at all.  Older kernels
+ *            reject them and the handles get served level triggered by
+ *            one-shot requests.  T.Loop.ONESHOT handles don't get re-armed.
+ *            Only readiness is observed.  Completion based recv, send and
+ *            accept are NOT implemented: Net.Socket in a T.Loop:spawn()
+ *            coroutine still yields via t_await() on EAGAIN and repeats the
+ *            syscall once the poll completed.  Submitting IORING_OP_RECV,
+ *            _SEND and _ACCEPT from that suspension point would save that
+ *            syscall, but needs buffers pinned until the completion arrived
+ *            and cancellation of coroutines which are collected meanwhile.
+ *            Talks to the kernel via raw syscalls; there is
+ *            no dependency on liburing.  Requires Linux 5.11
+ *            (IORING_FEAT_EXT_ARG).  On older kernels, or if io_uring is
+ *            disabled, it falls back to the epoll implementation which is
+ *            compiled into this unit.  T.Loop( sz, "epoll" ) picks epoll for
+ *            a single loop; ael->impl tells each loop which state it has.
+ *            Build with: make AEL=uring
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#define _GNU_SOURCE               // syscall()
+
+// epoll is the fallback for kernels without (sufficient) io_uring support.
+// Compile it into this unit with prefixed function names.
+#define p_ael_impl_lst            p_ael_epl_impl_lst
+#define p_ael_create_ud_impl      p_ael_epl_create_ud_impl
+#define p_ael_free_impl           p_ael_epl_free_impl
+#define p_ael_addhandle_impl      p_ael_epl_addhandle_impl
+#define p_ael_removehandle_impl   p_ael_epl_removehandle_impl
+#define p_ael_poll_impl           p_ael_epl_poll_impl
+#include "p_ael_epl.c"            // includes t_ael_l.h
+#undef p_ael_impl_lst
+#undef p_ael_create_ud_impl
+#undef p_ael_free_impl
+#undef p_ael_addhandle_impl
+#undef p_ael_removehandle_impl
+#undef p_ael_poll_impl
+
+#include <errno.h>
+#include <poll.h>                 // POLLIN, POLLOUT
+#include <string.h>               // memset
+#include <sys/mman.h>             // mmap, munmap
+#include <sys/syscall.h>          // __NR_io_uring_*
+#include <linux/io_uring.h>
+
+#define P_AEL_URG_ENTRIES 1024    // submission queue size; a full queue gets
+                                  // flushed, NOT a limit of observed fd
+#define P_AEL_URG_MULTI   0x80000000  // token bit marking multishot requests
+
+#ifndef IORING_POLL_ADD_MULTI     // Linux < 5.13 headers
+#define IORING_POLL_ADD_MULTI     (1U << 0)
+#endif
+#ifndef IORING_CQE_F_MORE
+#define IORING_CQE_F_MORE         (1U << 1)
+#endif
+
+#define p_ael_urg_load( p )       __atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define p_ael_urg_store( p, v )   __atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+#define p_ael_urg_ud( fd, tok )   (((uint64_t) (unsigned int) (fd) << 32) | (tok))
+
+// backends of this unit for T.Loop( sz, impl ); index is stored in ael->impl
+const char *const p_ael_impl_lst[ ] = { "uring", "epoll", NULL };
+#define P_AEL_URG_IMPL   0
+#define P_AEL_EPL_IMPL   1
+
+// default backend; -1 not probed yet; 0 use epoll; 1 use io_uring
+static int p_ael_urg_on = -1;
+
+#define p_ael_urg_is( L, aelpos ) \
+	(P_AEL_URG_IMPL == ((struct t_ael *) lua_touserdata( (L), (aelpos) ))->impl)
+
+struct p_ael_urg_ste {
+	int                  rfd;       ///< io_uring descriptor
+	unsigned int         tok;       ///< token of last poll request
+	int                  multi;     ///< boolean; kernel takes multishot polls
+	// submission queue
+	unsigned int        *sqHead;
+	unsigned int        *sqTail;
+	unsigned int        *sqMask;
+	unsigned int        *sqArray;
+	unsigned int         sqEntries;
+	struct io_uring_sqe *sqes;
+	// completion queue
+	unsigned int        *cqHead;
+	unsigned int        *cqTail;
+	unsigned int        *cqMask;
+	struct io_uring_cqe *cqes;
+	// mappings
+	void                *sqRing;
+	void                *cqRing;
+	size_t               sqSz;
+	size_t               cqSz;
+	size_t               sqesSz;
+};
+
+
+/**--------------------------------------------------------------------------
+ * get the state struct from the loop userdata.
+ * \param   L       Lua state.
+ * \param   aelpos  int; position of loop on the stack.
+ * \return  state struct to state.
+ * --------------------------------------------------------------------------*/
+static inline struct p_ael_urg_ste
+*p_ael_urg_getState( lua_State *L, int aelpos )
+{
+	struct p_ael_urg_ste *state;
+	lua_getiuservalue(L, aelpos, T_AEL_STEIDX );
+	state = (struct p_ael_urg_ste *) lua_touserdata( L, -1 );
+	lua_pop( L, 1 );
+	return state;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create the ring and map submission and completion queues.
+ * \param   state   struct p_ael_urg_ste*; state to initialize.
+ * \return  int     1 on success; 0 if io_uring is not (sufficiently)
+ *                  supported.
+ * --------------------------------------------------------------------------*/
+static int
+p_ael_urg_setup( struct p_ael_urg_ste *state )
+{
+	struct io_uring_params p;
+
+	memset( &p, 0, sizeof( p ) );
+	memset( state, 0, sizeof( struct p_ael_urg_ste ) );
+	state->rfd = syscall( __NR_io_uring_setup, P_AEL_URG_ENTRIES, &p );
+	if (state->rfd < 0)
+		return 0;
+	if (! (p.features & IORING_FEAT_EXT_ARG) || ! (p.features & IORING_FEAT_NODROP))
+		goto fail;
+
+	state->sqSz   = p.sq_off.array + p.sq_entries * sizeof( unsigned int );
+	state->cqSz   = p.cq_off.cqes  + p.cq_entries * sizeof( struct io_uring_cqe );
+	state->sqesSz = p.sq_entries * sizeof( struct io_uring_sqe );
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		state->sqSz = state->cqSz = (state->sqSz > state->cqSz) ? state->sqSz : state->cqSz;
+
+	state->sqRing = mmap( NULL, state->sqSz, PROT_READ | PROT_WRITE, MAP_SHARED,
+	                      state->rfd, IORING_OFF_SQ_RING );
+	if (MAP_FAILED == state->sqRing)
+		goto fail;
+	state->cqRing = (p.features & IORING_FEAT_SINGLE_MMAP)
+		? state->sqRing
+		: mmap( NULL, state->cqSz, PROT_READ | PROT_WRITE, MAP_SHARED,
+		        state->rfd, IORING_OFF_CQ_RING );
+	if (MAP_FAILED == state->cqRing)
+		goto fail;
+	state->sqes   = mmap( NULL, state->sqesSz, PROT_READ | PROT_WRITE, MAP_SHARED,
+	                      state->rfd, IORING_OFF_SQES );
+	if (MAP_FAILED == state->sqes)
+		goto fail;
+
+	state->sqHead    = (unsigned int *) ((char *) state->sqRing + p.sq_off.head);
+	state->sqTail    = (unsigned int *) ((char *) state->sqRing + p.sq_off.tail);
+	state->sqMask    = (unsigned int *) ((char *) state->sqRing + p.sq_off.ring_mask);
+	state->sqArray   = (unsigned int *) ((char *) state->sqRing + p.sq_off.array);
+	state->sqEntries = p.sq_entries;
+	state->cqHead    = (unsigned int *) ((char *) state->cqRing + p.cq_off.head);
+	state->cqTail    = (unsigned int *) ((char *) state->cqRing + p.cq_off.tail);
+	state->cqMask    = (unsigned int *) ((char *) state->cqRing + p.cq_off.ring_mask);
+	state->cqes      = (struct io_uring_cqe *) ((char *) state->cqRing + p.cq_off.cqes);
+	state->multi     = 1;     // until the kernel rejects the first one
+	return 1;
+
+fail:
+	if (NULL != state->sqRing && MAP_FAILED != state->sqRing)
+		munmap( state->sqRing, state->sqSz );
+	if (NULL != state->cqRing && MAP_FAILED != state->cqRing && state->cqRing != state->sqRing)
+		munmap( state->cqRing, state->cqSz );
+	close( state->rfd );
+	state->rfd = -1;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Submit all queued requests and optionally wait for completions.
+ * \param   state   struct p_ael_urg_ste*; io_uring state.
+ * \param   wait    unsigned int; minimum completions to wait for.
+ * \param   timeout lua_Integer; max time(ns) to wait or T_AEL_NOTIMEOUT.
+ * \return  int     result of io_uring_enter(); -1 on error and errno set.
+ * --------------------------------------------------------------------------*/
+static int
+p_ael_urg_enter( struct p_ael_urg_ste *state, unsigned int wait, lua_Integer timeout )
+{
+	struct __kernel_timespec       ts;
+	struct io_uring_getevents_arg  arg;
+	unsigned int                   sub = *state->sqTail - p_ael_urg_load( state->sqHead );
+
+	memset( &arg, 0, sizeof( arg ) );
+	if (timeout > T_AEL_NOTIMEOUT)
+	{
+		ts.tv_sec  = timeout / T_AEL_NSEC_SEC;
+		ts.tv_nsec = timeout % T_AEL_NSEC_SEC;
+		arg.ts     = (uint64_t) (uintptr_t) &ts;
+	}
+	return syscall( __NR_io_uring_enter, state->rfd, sub, wait,
+	                IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof( arg ) );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the next free submission queue entry.
+ * If the queue is full, all queued requests get submitted first.
+ * \param   L       Lua state.
+ * \param   state   struct p_ael_urg_ste*; io_uring state.
+ * \return  struct io_uring_sqe*  zeroed entry; already queued.
+ * --------------------------------------------------------------------------*/
+static struct io_uring_sqe
+*p_ael_urg_sqe( lua_State *L, struct p_ael_urg_ste *state )
+{
+	unsigned int         tail = *state->sqTail;
+	unsigned int         idx;
+	struct io_uring_sqe *sqe;
+
+	if (tail - p_ael_urg_load( state->sqHead ) >= state->sqEntries)
+		while (p_ael_urg_enter( state, 0, 0 ) < 0)
+			if (EINTR != errno)
+				t_push_error( L, 1, 1, "Failed to submit io_uring requests" );
+
+	idx = tail & *state->sqMask;
+	sqe = state->sqes + idx;
+	memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+	state->sqArray[ idx ] = idx;
+	p_ael_urg_store( state->sqTail, tail + 1 );
+	return sqe;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Queue a poll request for one direction of a descriptor.
+ * Edge triggered handles get a multishot request if the kernel supports it.
+ * The token of a multishot request carries P_AEL_URG_MULTI.
+ * \param   L       Lua state.
+ * \param   state   struct p_ael_urg_ste*; io_uring state.
+ * \param   dnd     struct t_ael_dnd*; descriptor node.
+ * \param   fd      int; descriptor.
+ * \param   d       int; 0 read, 1 write.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+p_ael_urg_arm( lua_State *L, struct p_ael_urg_ste *state, struct t_ael_dnd *dnd, int fd, int d )
+{
+	struct io_uring_sqe *sqe = p_ael_urg_sqe( L, state );
+
+	unsigned int         tok;
+
+	state->tok = (state->tok + 1) & ~P_AEL_URG_MULTI;
+	if (0 == state->tok)    // 0 is reserved for "no request pending"
+		state->tok = 1;
+	tok = state->tok;
+	if (state->multi && (dnd->mod & T_AEL_ET) && ! (dnd->mod & T_AEL_OS))
+	{
+		tok     |= P_AEL_URG_MULTI;
+		sqe->len = IORING_POLL_ADD_MULTI;
+	}
+	dnd->pnd[ d ]      = tok;
+	sqe->opcode        = IORING_OP_POLL_ADD;
+	sqe->fd            = fd;
+	sqe->poll32_events = (0 == d)                        // little endian only
+	                   ? POLLIN | ((dnd->mod & T_AEL_HU) ? POLLRDHUP : 0)
+	                   : POLLOUT;
+	sqe->user_data     = p_ael_urg_ud( fd, tok );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Queue removal of a pending poll request.
+ * The request gets identified by its user_data; the descriptor may be
+ * closed already.
+ * \param   L       Lua state.
+ * \param   state   struct p_ael_urg_ste*; io_uring state.
+ * \param   dnd     struct t_ael_dnd*; descriptor node.
+ * \param   fd      int; descriptor.
+ * \param   d       int; 0 read, 1 write.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+p_ael_urg_disarm( lua_State *L, struct p_ael_urg_ste *state, struct t_ael_dnd *dnd, int fd, int d )
+{
+	struct io_uring_sqe *sqe = p_ael_urg_sqe( L, state );
+
+	sqe->opcode    = IORING_OP_POLL_REMOVE;
+	sqe->fd        = -1;
+	sqe->addr      = p_ael_urg_ud( fd, dnd->pnd[ d ] );
+	sqe->user_data = 0;     // completions with user_data 0 get ignored
+	dnd->pnd[ d ]  = 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * io_uring specific initialization of t_ael->state.
+ * By default probes io_uring support on first use and falls back to epoll.
+ * A loop which asked for "uring" explicitly fails instead of falling back.
+ * \param   L    Lua state.
+ * \param  *ael  struct t_ael*; the loop; impl is requested and gets set.
+ * \param   sz   int; number of events per poll; used by the epoll fallback.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+p_ael_create_ud_impl( lua_State *L, struct t_ael *ael, int sz )
+{
+	struct p_ael_urg_ste *state;
+
+	if (P_AEL_EPL_IMPL == ael->impl || (-1 == ael->impl && 0 == p_ael_urg_on))
+	{
+		p_ael_epl_create_ud_impl( L, ael, sz );
+		ael->impl = P_AEL_EPL_IMPL;
+		return;
+	}
+	state = (struct p_ael_urg_ste *) lua_newuserdata( L, sizeof( struct p_ael_urg_ste ) );
+	if (p_ael_urg_setup( state ))
+	{
+		p_ael_urg_on = 1;
+		ael->impl    = P_AEL_URG_IMPL;
+	}
+	else if (-1 == ael->impl && -1 == p_ael_urg_on)   // first probe failed -> use epoll from now on
+	{
+		p_ael_urg_on = 0;
+		lua_pop( L, 1 );
+		p_ael_epl_create_ud_impl( L, ael, sz );
+		ael->impl    = P_AEL_EPL_IMPL;
+	}
+	else
+		luaL_error( L, "couldn't create io_uring for loop" );
+}
+
+
+/**--------------------------------------------------------------------------
+ * io_uring specific destruction of t_ael->state.
+ * Closing the ring cancels all pending requests.
+ * \param   L       Lua state.
+ * \param   aelpos  int; position of loop on the stack.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+p_ael_free_impl( lua_State *L, int aelpos )
+{
+	struct p_ael_urg_ste *state;
+
+	if (! p_ael_urg_is( L, aelpos ))
+	{
+		p_ael_epl_free_impl( L, aelpos );
+		return;
+	}
+	state = p_ael_urg_getState( L, aelpos );
+	if (-1 == state->rfd)
+		return;
+	munmap( state->sqes, state->sqesSz );
+	if (state->cqRing != state->sqRing)
+		munmap( state->cqRing, state->cqSz );
+	munmap( state->sqRing, state->sqSz );
+	close( state->rfd );
+	state->rfd = -1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Add a File/Socket event handler to the T.Loop.
+ * Only queues the poll requests; they get submitted with the next poll.
+ * \param  L      lua_State.
+ * \param  aelpos int; position of struct t_ael ud on stack.
+ * \param  dnd    struct assiciated with fd.
+ * \param  fd     int  Socket/file descriptor.
+ * \param  addmsk enum t_ael_msk - direction of descriptor to be observed.
+ * \return int    success/fail;
+ * --------------------------------------------------------------------------*/
+int
+p_ael_addhandle_impl( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int fd, enum t_ael_msk addmsk )
+{
+	struct p_ael_urg_ste *state;
+
+	if (! p_ael_urg_is( L, aelpos ))
+		return p_ael_epl_addhandle_impl( L, aelpos, dnd, fd, addmsk );
+	state = p_ael_urg_getState( L, aelpos );
+	if ((addmsk & T_AEL_RD) && ! dnd->pnd[ 0 ])
+		p_ael_urg_arm( L, state, dnd, fd, 0 );
+	if ((addmsk & T_AEL_WR) && ! dnd->pnd[ 1 ])
+		p_ael_urg_arm( L, state, dnd, fd, 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove a File/Socket event handler from the T.Loop.
+ * \param  L      lua_State.
+ * \param  aelpos int; position of struct t_ael ud on stack.
+ * \param  dnd    struct assiciated with fd.
+ * \param  fd     int  Socket/file descriptor.
+ * \param  delmsk enum t_ael_msk - direction of descriptor to stop observing.
+ * \return int    success/fail;
+ * --------------------------------------------------------------------------*/
+int
+p_ael_removehandle_impl( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int fd, enum t_ael_msk delmsk )
+{
+	struct p_ael_urg_ste *state;
+
+	if (! p_ael_urg_is( L, aelpos ))
+		return p_ael_epl_removehandle_impl( L, aelpos, dnd, fd, delmsk );
+	state = p_ael_urg_getState( L, aelpos );
+	if ((delmsk & T_AEL_RD) && dnd->pnd[ 0 ])
+		p_ael_urg_disarm( L, state, dnd, fd, 0 );
+	if ((delmsk & T_AEL_WR) && dnd->pnd[ 1 ])
+		p_ael_urg_disarm( L, state, dnd, fd, 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Submit queued requests, wait for completions and execute handlers.
+ * \param   L       Lua state.
+ * \param   timeout lua_Integer; timeout for next fallthrough in nanoseconds.
+ * \param   aelpos  int; position of t_ael loop struct on stack.
+ * \return  int     number of executed handlers.
+ * --------------------------------------------------------------------------*/
+int
+p_ael_poll_impl( lua_State *L, lua_Integer timeout, int aelpos )
+{
+	struct p_ael_urg_ste *state;
+	struct t_ael         *ael = (struct t_ael *) lua_touserdata( L, aelpos );
+	struct t_ael_dnd     *dnd;
+	struct io_uring_cqe  *cqe;
+	uint64_t              ud;
+	unsigned int          head, tok, flags;
+	int                   r, fd, d, c = 0;
+	lua_Integer           start;
+
+	if (P_AEL_URG_IMPL != ael->impl)
+		return p_ael_epl_poll_impl( L, timeout, aelpos );
+	state = p_ael_urg_getState( L, aelpos );
+
+	r = p_ael_urg_enter( state, (0 == timeout) ? 0 : 1, timeout );
+	if (r < 0 && ETIME != errno && EINTR != errno)
+		return t_push_error( L, 1, 1, "io_uring_enter() failed" );
+	start = (ael->budgetTime > 0) ? t_ael_now( ) : 0;
+
+	lua_getiuservalue( L, aelpos, T_AEL_HDSIDX );          //S: ael hds
+	lua_getiuservalue( L, aelpos, T_AEL_DSCIDX );          //S: ael hds nds
+	head = *state->cqHead;
+	while (head != p_ael_urg_load( state->cqTail ))
+	{
+		// completions left in the ring get reaped in the next iteration
+		if ((ael->budget > 0 || ael->budgetTime > 0) &&
+		    t_ael_budgetSpent( ael, c, start, (int) (p_ael_urg_load( state->cqTail ) - head) ))
+			break;
+		cqe = state->cqes + (head & *state->cqMask);
+		ud    = cqe->user_data;
+		r     = cqe->res;
+		flags = cqe->flags;
+		p_ael_urg_store( state->cqHead, ++head );       // handlers may queue requests
+		if (0 == ud)               // removals
+			continue;
+		fd  = (int) (ud >> 32);
+		tok = (unsigned int) ud;
+		lua_rawgeti( L, -1, fd );                       //S: ael hds nds dnd
+		dnd = (struct t_ael_dnd *) lua_touserdata( L, -1 );
+		// stale completion of removed handle or previous owner of fd
+		if (NULL == dnd || (tok != dnd->pnd[ 0 ] && tok != dnd->pnd[ 1 ]))
+		{
+			lua_pop( L, 1 );
+			continue;
+		}
+		d             = (tok == dnd->pnd[ 0 ]) ? 0 : 1;
+		if (! (flags & IORING_CQE_F_MORE))   // request is done; multishot isn't
+			dnd->pnd[ d ] = 0;
+		if (r < 0)
+		{
+			// failed request; kernels before 5.13 reject multishot polls
+			if (-EINVAL == r && (tok & P_AEL_URG_MULTI))
+			{
+				state->multi = 0;
+				p_ael_urg_arm( L, state, dnd, fd, d );
+			}
+			lua_pop( L, 1 );
+			continue;
+		}
+		if (dnd->msk & (1 << d))
+		{
+			t_ael_dnd_execute( L, ael, -3, dnd, (enum t_ael_msk) (1 << d) );
+			c++;
+		}
+		lua_pop( L, 1 );                                //S: ael hds nds
+		// re-arm if the handler didn't remove the handle; one shot handles get
+		// re-armed by adding them again
+		lua_rawgeti( L, -1, fd );                       //S: ael hds nds dnd
+		if (dnd == lua_touserdata( L, -1 ) && (dnd->msk & (1 << d)) && ! dnd->pnd[ d ]
+		    && ! (dnd->mod & T_AEL_OS))
+			p_ael_urg_arm( L, state, dnd, fd, d );
+		lua_pop( L, 1 );                                //S: ael hds nds
+	}
+	lua_pop( L, 2 );                                      //S: ael
+	return c;
+}
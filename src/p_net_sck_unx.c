@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>    // struct iovec
 #include <sys/select.h>
 #include <sys/time.h>   // struct timeval
 #include <signal.h>     // signal( SIGPIPE, SIG_IGN )
@@ -171,6 +172,37 @@ p_net_sck_send( struct t_net_sck *sck, struct sockaddr_storage *adr,
 }
 
 
+/** -------------------------------------------------------------------------
+ * Send data from multiple buffers via socket in one call.
+ * \param   sck     struct t_net_sck        pointer userdata.
+ * \param   adr     struct sockaddr_storage pointer userdata.
+ * \param   buf     char*[n] buffers.
+ * \param   len     size_t[n] how many bytes to send from each buffer.
+ * \param   n       number of buffers; at most T_NET_SCK_IOV_MAX.
+ * \return  snt    int; number of bytes sent out.
+ *-------------------------------------------------------------------------*/
+ssize_t
+p_net_sck_sendv( struct t_net_sck *sck, struct sockaddr_storage *adr,
+                 char **buf, size_t *len, int n )
+{
+	struct iovec  iov[ T_NET_SCK_IOV_MAX ];
+	struct msghdr msg;
+	int           i;
+
+	for (i=0; i<n; i++)
+	{
+		iov[ i ].iov_base = buf[ i ];
+		iov[ i ].iov_len  = len[ i ];
+	}
+	memset( &msg, 0, sizeof( struct msghdr ) );
+	msg.msg_name    = SOCK_ADDR_PTR( adr );
+	msg.msg_namelen = (NULL == adr) ? 0 : SOCK_ADDR_SS_LEN( adr );
+	msg.msg_iov     = iov;
+	msg.msg_iovlen  = (size_t) n;
+	return sendmsg( sck->fd, &msg, 0 );
+}
+
+
 /** -------------------------------------------------------------------------
  * Recieve some data from socket.
  * \param   sck     struct t_net_sck        pointer userdata.
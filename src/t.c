@@ -50,6 +50,69 @@ t_getLoadedValue( lua_State *L, size_t len, int pos, ... )
 }
 
 
+/** -------------------------------------------------------------------------
+ * Can the running code wait for a handle instead of failing with EAGAIN?
+ * True if L is a coroutine which got started by T.Loop:spawn().  Preserves
+ * errno.
+ * \param  L     The Lua intepretter object.
+ * \return int   boolean; can t_await() be used.
+ *-------------------------------------------------------------------------*/
+int
+t_isAwaitable( lua_State *L )
+{
+	int err = errno;
+	int awt = 0;
+
+	if (lua_isyieldable( L ))
+	{
+		if (LUA_TTABLE == lua_getfield( L, LUA_REGISTRYINDEX, T_AWT_KEY ))
+		{
+			lua_pushthread( L );
+			awt = (LUA_TNIL != lua_rawget( L, -2 ));
+			lua_pop( L, 1 );
+		}
+		lua_pop( L, 1 );
+	}
+	errno = err;
+	return awt;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Retry a function once the loop reports the handle as ready.
+ * \param  L     The Lua intepretter object.
+ * \param  ctx   lua_KContext; the lua_CFunction to retry.
+ * \return int   # of values pushed onto the stack.
+ *-------------------------------------------------------------------------*/
+static int
+t_await_k( lua_State *L, int status, lua_KContext ctx )
+{
+	(void) status;
+	return ((lua_CFunction) ctx)( L );
+}
+
+
+/** -------------------------------------------------------------------------
+ * Yield to the T.Loop running the coroutine until a handle is ready.
+ * Must only be called if t_isAwaitable() and used as return expression.  The
+ * handle must be the first argument of fnc.  Once the handle is ready fnc gets
+ * called again with the same nargs arguments.
+ * \param  L     The Lua intepretter object.
+ * \param  nargs int; number of arguments of fnc; everything above is dropped.
+ * \param  msk   int; 1 wait for readable; 2 wait for writable.
+ * \param  fnc   lua_CFunction; function to retry.
+ * \return int   never returns.
+ *-------------------------------------------------------------------------*/
+int
+t_await( lua_State *L, int nargs, int msk, lua_CFunction fnc )
+{
+	lua_settop( L, nargs );
+	lua_pushvalue( L, 1 );
+	lua_pushinteger( L, msk );
+	return lua_yieldk( L, 2, (lua_KContext) fnc, t_await_k );
+}
+
+
 /** -------------------------------------------------------------------------
  * Returns an error string to the Lua script.
  * Expands luaL_error by errno support which is useful when system functions
@@ -65,6 +128,7 @@ int
 t_push_error( lua_State *L, int fail, int ops, const char *fmt, ... )
 {
 	va_list argp;
+	int     err = errno;   // pushing strings might clobber errno
 	if (fail)
 		luaL_where( L, 1 );
 	else
@@ -75,15 +139,15 @@ t_push_error( lua_State *L, int fail, int ops, const char *fmt, ... )
 			lua_pushnil( L );
 	}
 	if (NULL == fmt)
-		lua_pushstring( L, (errno) ? "" : "Unknown Error" );
+		lua_pushstring( L, (err) ? "" : "Unknown Error" );
 	else
 	{
 		va_start( argp, fmt );
 		lua_pushvfstring( L, fmt, argp );
 		va_end( argp );
 	}
-	if (errno) lua_pushfstring( L, " (%s)", strerror( errno ));
-	lua_concat( L, (fail && errno) ? 3 : (fail || errno) ? 2 : 1 );
+	if (err) lua_pushfstring( L, " (%s)", strerror( err ));
+	lua_concat( L, (fail && err) ? 3 : (fail || err) ? 2 : 1 );
 	return ((fail) ? lua_error( L ) : 2);
 }
 
@@ -16,10 +16,15 @@
 #ifndef T_HELPERLIB_H
 #define T_HELPERLIB_H
 
+// registry key of weak table; coroutines run by T.Loop:spawn() -> T.Loop.Coroutine
+#define T_AWT_KEY   "t.await"
+
 // global helpers
 int         t_getLoadedValue( lua_State *L, size_t len, int pos, ... );
 int         t_push_error    ( lua_State *L, int fail, int ops, const char *fmt, ... );
 int         t_typeerror     ( lua_State *L, int arg, const char *tname );
+int         t_isAwaitable   ( lua_State *L );
+int         t_await         ( lua_State *L, int nargs, int msk, lua_CFunction fnc );
 #endif //T_HELPERLIB_H
 
 
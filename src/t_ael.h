@@ -15,12 +15,33 @@
 #define T_AEL_IDNT       "ael"
 #define T_AEL_DND_IDNT   "dnd"
 #define T_AEL_TSK_IDNT   "tsk"
+#define T_AEL_WRK_IDNT   "wrk"
+#define T_AEL_PST_IDNT   "pst"
+#define T_AEL_SIG_IDNT   "sig"
+#define T_AEL_CRT_IDNT   "crt"
+#define T_AEL_STS_IDNT   "sts"
+#define T_AEL_THP_IDNT   "thp"
+#define T_AEL_PRC_IDNT   "prc"
 
 #define T_AEL_NAME       "Loop"
 #define T_AEL_DND_NAME   "Node"
 #define T_AEL_TSK_NAME   "Task"
+#define T_AEL_WRK_NAME   "Worker"
+#define T_AEL_PST_NAME   "Post"
+#define T_AEL_SIG_NAME   "Signal"
+#define T_AEL_CRT_NAME   "Coroutine"
+#define T_AEL_STS_NAME   "Stats"
+#define T_AEL_THP_NAME   "Pool"
+#define T_AEL_PRC_NAME   "Process"
 
 #define T_AEL_TYPE       "T."T_AEL_NAME
 #define T_AEL_DND_TYPE   T_AEL_TYPE"."T_AEL_DND_NAME
 #define T_AEL_TSK_TYPE   T_AEL_TYPE"."T_AEL_TSK_NAME
+#define T_AEL_WRK_TYPE   T_AEL_TYPE"."T_AEL_WRK_NAME
+#define T_AEL_PST_TYPE   T_AEL_TYPE"."T_AEL_PST_NAME
+#define T_AEL_SIG_TYPE   T_AEL_TYPE"."T_AEL_SIG_NAME
+#define T_AEL_CRT_TYPE   T_AEL_TYPE"."T_AEL_CRT_NAME
+#define T_AEL_STS_TYPE   T_AEL_TYPE"."T_AEL_STS_NAME
+#define T_AEL_THP_TYPE   T_AEL_TYPE"."T_AEL_THP_NAME
+#define T_AEL_PRC_TYPE   T_AEL_TYPE"."T_AEL_PRC_NAME
 
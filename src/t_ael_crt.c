@@ -0,0 +1,278 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_crt.c
+ * \brief     Coroutines driven by T.Loop
+ * \detail    T.Loop:spawn() runs a function as coroutine.  Socket operations
+ *            which would block yield the socket and the direction to the
+ *            loop, T.Loop.sleep() yields the time to sleep.  The loop
+ *            observes the socket, or schedules a task, with the coroutines
+ *            T.Loop.Coroutine userdata as handler.  Calling that userdata
+ *            resumes the coroutine and the socket operation gets retried.
+ *            Waiting doesn't allocate anything; after waking up the node
+ *            stays observed as long as the coroutine waits for the same
+ *            socket and direction again.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t_ael_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+
+/**--------------------------------------------------------------------------
+ * Stop observing the handle the coroutine waited for.
+ * The handle might have been closed or observed by someone else meanwhile,
+ * only the direction which is still handled by this coroutine gets removed.
+ * \param   L        Lua state.
+ * \param  *crt      struct t_ael_crt*; coroutine.
+ * \param   p        int; position of crt on stack; loop is at p+1.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_crt_unwait( lua_State *L, struct t_ael_crt *crt, int p )
+{
+	struct t_ael_dnd *dnd;
+	int               d   = (T_AEL_RD & crt->msk) ? 0 : 1;
+
+	if (-1 == crt->fd)
+		return;
+	lua_getiuservalue( L, p+1, T_AEL_DSCIDX );          //S: … crt ael nds
+	lua_rawgeti( L, -1, crt->fd );                      //S: … crt ael nds dnd
+	dnd = t_ael_dnd_check_ud( L, -1, 0 );
+	if (NULL != dnd && (dnd->msk & crt->msk))
+	{
+		lua_getiuservalue( L, -1, T_AEL_DSC_FRDIDX + d );
+		if (lua_rawequal( L, -1, p ))                    // still our node
+			t_ael_dnd_remove( L, p+1, crt->fd, crt->msk );
+		lua_pop( L, 1 );
+	}
+	lua_pop( L, 2 );                                    //S: … crt ael
+	crt->fd  = -1;
+	crt->msk = T_AEL_NO;
+	lua_pushnil( L );
+	lua_setiuservalue( L, p, T_AEL_CRT_HDLIDX );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make the loop resume the coroutine once what it yielded for is ready.
+ * (hdl, msk) observes the handle; (ms) schedules a task.  The crt itself
+ * parks the coroutine, eg. T.Loop:offload() resumes it once its job is done.
+ * Anything else, such as a plain coroutine.yield(), resumes on the next loop
+ * iteration.
+ * \param   L        Lua state.
+ * \param   co       lua_State*; the suspended coroutine.
+ * \param  *crt      struct t_ael_crt*; coroutine.
+ * \param   p        int; position of crt on stack; loop is at p+1.
+ * \param   n        int; number of values yielded onto co.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_crt_wait( lua_State *L, lua_State *co, struct t_ael_crt *crt, int p, int n )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, p+1, 1 );
+	struct t_ael_tsk *tsk;
+	enum t_ael_msk    msk;
+	lua_Integer       ns  = 0;
+	int               fd;
+
+	if (2 == n && lua_isinteger( co, -1 ) && ! lua_isnil( co, -2 ))
+	{
+		lua_xmove( co, L, 2 );                           //S: … crt ael hdl msk
+		msk = (enum t_ael_msk) lua_tointeger( L, -1 ) & T_AEL_RW;
+		fd  = t_ael_getHandle( L, -2, 1 );
+		lua_getiuservalue( L, p, T_AEL_CRT_HDLIDX );     //S: … crt ael hdl msk cur
+		if (fd != crt->fd || msk != crt->msk || ! lua_rawequal( L, -1, -3 ))
+		{
+			t_ael_crt_unwait( L, crt, p );
+			lua_pushvalue( L, p );                        //S: … crt ael hdl msk cur crt
+			t_ael_dnd_add( L, p+1, p+2, fd, msk, 0 );     //S: … crt ael hdl msk cur
+			crt->fd  = fd;
+			crt->msk = msk;
+			lua_pushvalue( L, p+2 );
+			lua_setiuservalue( L, p, T_AEL_CRT_HDLIDX );
+		}
+		lua_pop( L, 3 );                                 //S: … crt ael
+		return;
+	}
+	if (1 == n && lua_touserdata( co, -1 ) == (void *) crt)
+	{
+		// yielded itself; parked until whoever holds crt resumes it
+		lua_pop( co, 1 );
+		t_ael_crt_unwait( L, crt, p );
+		return;
+	}
+	if (1 == n)
+		ns = t_ael_tons( co, -1 );
+	lua_pop( co, n );
+	t_ael_crt_unwait( L, crt, p );
+	tsk = t_ael_tsk_create_ud( L, t_ael_now( ) + ns );  //S: … crt ael tsk
+	lua_pushvalue( L, p );
+	lua_setiuservalue( L, -2, T_AEL_TSK_FNCIDX );
+	t_ael_tsk_insert( L, ael, tsk );                    //S: … crt ael
+}
+
+
+/**--------------------------------------------------------------------------
+ * Resume the coroutine and let the loop wait for whatever it yielded.
+ * Errors inside the coroutine get raised with its traceback.
+ * \param   L        Lua state.
+ * \param   n        int; number of values already moved onto the coroutine.
+ * \lparam  crt      T.Loop.Coroutine; popped.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_crt_resume( lua_State *L, int n )
+{
+	int               p   = lua_gettop( L );
+	struct t_ael_crt *crt = t_ael_crt_check_ud( L, p, 1 );
+	lua_State        *co;
+	int               status, nres;
+
+	lua_getiuservalue( L, p, T_AEL_CRT_AELIDX );        //S: … crt ael
+	lua_getiuservalue( L, p, T_AEL_CRT_THDIDX );        //S: … crt ael co
+	co = lua_tothread( L, -1 );
+	lua_pop( L, 1 );                                    //S: … crt ael
+	status = lua_resume( co, L, n, &nres );
+	if (LUA_YIELD == status)
+		t_ael_crt_wait( L, co, crt, p, nres );
+	else
+	{
+		t_ael_crt_unwait( L, crt, p );
+		if (LUA_OK != status)
+		{
+			luaL_traceback( L, co, lua_tostring( co, -1 ), 0 );
+			lua_error( L );
+		}
+		lua_settop( co, 0 );
+	}
+	lua_settop( L, p-1 );                               //S: …
+}
+
+
+/**--------------------------------------------------------------------------
+ * Run a function with its arguments as coroutine driven by the loop.
+ * The coroutine runs right away until it waits for the first time.
+ * \param   L        Lua state.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   n        int; number of arguments.
+ * \lparam  fnc      function to run; popped.
+ * \lparam  …        n arguments to fnc; popped.
+ * \lreturn co       thread; the coroutine.
+ * \return  lua_State*; the coroutine.
+ * --------------------------------------------------------------------------*/
+lua_State
+*t_ael_crt_spawn( lua_State *L, int aelpos, int n )
+{
+	struct t_ael_crt *crt;
+	lua_State        *co;
+
+	aelpos = lua_absindex( L, aelpos );
+	co     = lua_newthread( L );                        //S: … fnc … co
+	lua_insert( L, -(n+2) );                            //S: … co fnc …
+	lua_xmove( L, co, n+1 );                            //S: … co
+	crt    = (struct t_ael_crt *) lua_newuserdatauv( L, sizeof( struct t_ael_crt ), 3 );
+	crt->fd  = -1;
+	crt->msk = T_AEL_NO;
+	luaL_getmetatable( L, T_AEL_CRT_TYPE );
+	lua_setmetatable( L, -2 );                          //S: … co crt
+	lua_pushvalue( L, -2 );
+	lua_setiuservalue( L, -2, T_AEL_CRT_THDIDX );
+	lua_pushvalue( L, aelpos );
+	lua_setiuservalue( L, -2, T_AEL_CRT_AELIDX );
+
+	// mark as awaitable; sockets wait instead of failing with EAGAIN
+	lua_getfield( L, LUA_REGISTRYINDEX, T_AWT_KEY );    //S: … co crt awt
+	lua_pushvalue( L, -3 );
+	lua_pushvalue( L, -3 );
+	lua_rawset( L, -3 );
+	lua_pop( L, 1 );                                    //S: … co crt
+	t_ael_crt_resume( L, n );                           //S: … co
+	return co;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check a value on the stack for being a struct t_ael_crt
+ * \param   L      Lua state.
+ * \param   int    position on the stack
+ * \param   int    check(boolean): if true error out on fail
+ * \return  struct t_ael_crt*  pointer to userdata on stack
+ * --------------------------------------------------------------------------*/
+struct t_ael_crt
+*t_ael_crt_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_AEL_CRT_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_AEL_CRT_TYPE );
+	return (NULL==ud) ? NULL : (struct t_ael_crt *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Resume the coroutine.  This is how nodes and tasks wake it up.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Coroutine userdata instance.                  // 1
+ * \return  int  # of values pushed onto the stack.
+ * -------------------------------------------------------------------------*/
+static int
+lt_ael_crt__call( lua_State *L )
+{
+	lua_settop( L, 1 );
+	t_ael_crt_resume( L, 0 );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Prints the Coroutine.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop.Coroutine userdata instance.                  // 1
+ * \lreturn string formatted string representing T.Loop.Coroutine.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_crt__tostring( lua_State *L )
+{
+	struct t_ael_crt *crt = t_ael_crt_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_AEL_CRT_TYPE"{%d}: %p", crt->fd, crt );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_ael_crt_m [] = {
+	// metamethods
+	  { "__call",        lt_ael_crt__call        }
+	, { "__tostring",    lt_ael_crt__tostring    }
+	, { NULL,            NULL                    }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Makes the Loop.Coroutine metatable known and creates the registry table of
+ * awaitable coroutines; there is no class to push.
+ * \param   L     The lua state.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_ael_crt( lua_State *L )
+{
+	luaL_newmetatable( L, T_AEL_CRT_TYPE );
+	luaL_setfuncs( L, t_ael_crt_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+
+	// coroutine -> T.Loop.Coroutine; weak keys, finished coroutines vanish
+	lua_newtable( L );
+	lua_createtable( L, 0, 1 );
+	lua_pushstring( L, "k" );
+	lua_setfield( L, -2, "__mode" );
+	lua_setmetatable( L, -2 );
+	lua_setfield( L, LUA_REGISTRYINDEX, T_AWT_KEY );
+	return 0;
+}
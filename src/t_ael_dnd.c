@@ -33,40 +33,252 @@ struct t_ael_dnd
 
 	dnd = (struct t_ael_dnd *) lua_newuserdatauv( L, sizeof( struct t_ael_dnd ), 3 );
 	dnd->msk    = 0;
+	dnd->mod    = 0;
+	dnd->arg[0] = 0;
+	dnd->arg[1] = 0;
+	dnd->pnd[0] = 0;
+	dnd->pnd[1] = 0;
 	luaL_getmetatable( L, T_AEL_DND_TYPE );
 	lua_setmetatable( L, -2 );
 	return dnd;
 }
 
 
+/**--------------------------------------------------------------------------
+ * Set handler for one direction of the node in the loops handler table.
+ * Replaces a previously set handler.
+ * \param   L        Lua state.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param  *dnd      Descriptor node.
+ * \param   d        int; 0 read, 1 write.
+ * \param   n        int; number of arguments; 0 if handler is a function.
+ * \lparam  fnc      function or {fnc, arg, …} table; nil to release; popped.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_dnd_setFunction( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int d, int n )
+{
+	aelpos = lua_absindex( L, aelpos );
+	lua_getiuservalue( L, aelpos, T_AEL_HDSIDX );       //S: … fnc hds
+	lua_rotate( L, -2, 1 );                             //S: … hds fnc
+	lua_rawsetp( L, -2, &dnd->arg[ d ] );               //S: … hds
+	lua_pop( L, 1 );                                    //S: …
+	dnd->arg[ d ] = n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Observe a handle in one direction; creates the node on first use.
+ * The mode applies to the whole descriptor, epoll can't set EPOLLET or
+ * EPOLLONESHOT per direction.  Hence adding a direction with a mode other
+ * than the one the other observed direction uses raises an error.
+ * \param   L        Lua state.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   hdlpos   int; position of handle on the stack.
+ * \param   fd       int; descriptor of handle.
+ * \param   msk      enum t_ael_msk; one direction plus mode bits.
+ * \param   n        int; number of arguments; 0 if handler is a function.
+ * \lparam  fnc      function, {fnc, arg, …} table or callable; popped.
+ * \return  struct t_ael_dnd*; the node.
+ * --------------------------------------------------------------------------*/
+struct t_ael_dnd
+*t_ael_dnd_add( lua_State *L, int aelpos, int hdlpos, int fd, enum t_ael_msk msk, int n )
+{
+	struct t_ael     *ael;
+	struct t_ael_dnd *dnd;
+	int               d   = (T_AEL_RD & msk) ? 0 : 1;  ///< direction 0 read; 1 write
+
+	aelpos = lua_absindex( L, aelpos );
+	hdlpos = lua_absindex( L, hdlpos );
+	ael    = t_ael_check_ud( L, aelpos, 1 );
+	lua_getiuservalue( L, aelpos, T_AEL_DSCIDX );       //S: … fnc nds
+	if (LUA_TNIL == lua_rawgeti( L, -1, fd ))           //S: … fnc nds ???
+	{
+		lua_pop( L, 1 );
+		dnd = t_ael_dnd_create_ud( L );                  //S: … fnc nds dnd
+		lua_pushvalue( L, -1 );
+		lua_rawseti( L, -3, fd );
+		(ael->fdCount)++;
+	}
+	else
+		dnd = t_ael_dnd_check_ud( L, -1, 1 );            //S: … fnc nds dnd
+
+	if ((dnd->msk & T_AEL_RW & ~msk) && (dnd->mod & T_AEL_MD) != (msk & T_AEL_MD))
+		luaL_error( L, "%s is observed in another mode", (0==d) ? "write" : "read" );
+
+	// implementation specific handling; mode applies to the whole descriptor
+	dnd->mod = msk & T_AEL_MD;
+	msk     &= T_AEL_RW;
+	p_ael_addhandle_impl( L, aelpos, dnd, fd, msk );
+	dnd->msk |= msk;
+
+	lua_pushvalue( L, hdlpos );
+	lua_setiuservalue( L, -2, T_AEL_DSC_HDLIDX );
+	lua_rotate( L, -3, -1 );                            //S: … nds dnd fnc
+	lua_pushvalue( L, -1 );                             //S: … nds dnd fnc fnc
+	t_ael_dnd_setFunction( L, aelpos, dnd, d, n );      //S: … nds dnd fnc
+	lua_setiuservalue( L, -2, T_AEL_DSC_FRDIDX + d );   //S: … nds dnd
+	lua_pop( L, 2 );                                    //S: …
+	return dnd;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Stop observing a handle; removes the node once no direction is left.
+ * \param   L        Lua state.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   fd       int; descriptor of handle.
+ * \param   msk      enum t_ael_msk; direction(s) to stop observing.
+ * \return  int      boolean; was the descriptor observed.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_dnd_remove( lua_State *L, int aelpos, int fd, enum t_ael_msk msk )
+{
+	struct t_ael     *ael;
+	struct t_ael_dnd *dnd;
+	int               d;
+
+	aelpos = lua_absindex( L, aelpos );
+	ael    = t_ael_check_ud( L, aelpos, 1 );
+	lua_getiuservalue( L, aelpos, T_AEL_DSCIDX );       //S: … nds
+	if (LUA_TNIL == lua_rawgeti( L, -1, fd ))           //S: … nds ???
+	{
+		lua_pop( L, 2 );
+		return 0;
+	}
+	dnd = t_ael_dnd_check_ud( L, -1, 1 );               //S: … nds dnd
+
+	p_ael_removehandle_impl( L, aelpos, dnd, fd, msk );
+
+	dnd->msk = dnd->msk & (~msk);
+	// release handlers for directions which are not observed anymore
+	for (d=0; d<2; d++)
+	{
+		if (! (msk & (1 << d)))
+			continue;
+		lua_pushnil( L );                                //S: … nds dnd nil
+		lua_setiuservalue( L, -2, T_AEL_DSC_FRDIDX + d );
+		lua_pushnil( L );                                //S: … nds dnd nil
+		t_ael_dnd_setFunction( L, aelpos, dnd, d, 0 );
+	}
+	if (T_AEL_NO == dnd->msk)
+	{
+		lua_pushnil( L );                                //S: … nds dnd nil
+		lua_rawseti( L, -3, fd );                        //S: … nds dnd
+		(ael->fdCount)--;
+	}
+	lua_pop( L, 2 );                                    //S: …
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Observe a descriptor owned by the loop itself such as an eventfd.
+ * The node is stored in the descriptor table like any other but does not
+ * count as observed handle.  The userdata on top of the stack becomes the
+ * handle of the node and the only argument to the read handler.
+ * \param   L        Lua state.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   fd       int; descriptor to be observed for reading.
+ * \param   fnc      lua_CFunction; read handler.
+ * \lparam  ud       userdata; handle of node; stays on stack.
+ * \return  struct t_ael_dnd*; the node.
+ * --------------------------------------------------------------------------*/
+struct t_ael_dnd
+*t_ael_dnd_addInternal( lua_State *L, int aelpos, int fd, lua_CFunction fnc )
+{
+	struct t_ael_dnd *dnd;
+
+	aelpos = lua_absindex( L, aelpos );
+	lua_getiuservalue( L, aelpos, T_AEL_DSCIDX );       //S: … ud nds
+	dnd = t_ael_dnd_create_ud( L );                     //S: … ud nds dnd
+	lua_pushvalue( L, -3 );                             //S: … ud nds dnd ud
+	lua_setiuservalue( L, -2, T_AEL_DSC_HDLIDX );
+	lua_createtable( L, 2, 0 );                         //S: … ud nds dnd tbl
+	lua_pushcfunction( L, fnc );
+	lua_rawseti( L, -2, 1 );
+	lua_pushvalue( L, -4 );
+	lua_rawseti( L, -2, 2 );
+	lua_pushvalue( L, -1 );                             //S: … ud nds dnd tbl tbl
+	t_ael_dnd_setFunction( L, aelpos, dnd, 0, 1 );      //S: … ud nds dnd tbl
+	lua_setiuservalue( L, -2, T_AEL_DSC_FRDIDX );       //S: … ud nds dnd
+	dnd->mod = T_AEL_IN;
+	p_ael_addhandle_impl( L, aelpos, dnd, fd, T_AEL_RD );
+	dnd->msk = T_AEL_RD;
+	lua_rawseti( L, -2, fd );                           //S: … ud nds
+	lua_pop( L, 1 );                                    //S: … ud
+	return dnd;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Call the handler of one direction.
+ * This is the hot path; one lookup in the handler table and exactly one
+ * lua_call().  The arguments get unpacked from the {fnc, arg, …} table with
+ * the cached argument count.
+ * \param   L        Lua state.
+ * \param   hdspos   int; absolute position of loops handler table on stack.
+ * \param  *dnd      Descriptor node.
+ * \param   d        int; 0 read, 1 write.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static inline void
+t_ael_dnd_call( lua_State *L, int hdspos, struct t_ael_dnd *dnd, int d )
+{
+	int n = dnd->arg[ d ];
+	int p,i;
+
+	if (LUA_TNIL == lua_rawgetp( L, hdspos, &dnd->arg[ d ] ))  //S: … fnc/tbl
+	{
+		lua_pop( L, 1 );
+		return;
+	}
+	if (n > 0)
+	{
+		p = lua_gettop( L );
+		for (i=1; i<=n+1; i++)
+			lua_rawgeti( L, p, i );                       //S: … tbl fnc arg …
+		lua_remove( L, p );                              //S: …     fnc arg …
+	}
+	lua_call( L, n, 0 );
+}
+
+
 /**--------------------------------------------------------------------------
  * Executes a handle event function for the file/socket handles.
+ * Does not require the node on the stack; the node must not be touched
+ * after the handler ran since it could have been removed and collected.
  * \param   L        Lua state.
+ * \param  *ael      the loop; records the duration if statistics are enabled.
+ * \param   hdspos   int; position of the loops handler table on the stack.
  * \param  *dnd      Descriptor node.
  * \param   msk      execute read or write or both.
  * \return  void.
   --------------------------------------------------------------------------*/
 void
-t_ael_dnd_execute( lua_State *L, struct t_ael_dnd *dnd, enum t_ael_msk msk )
+t_ael_dnd_execute( lua_State *L, struct t_ael *ael, int hdspos, struct t_ael_dnd *dnd, enum t_ael_msk msk )
 {
-	int rf = 0;      ///< was read() event fired for this descriptor?
+	struct t_ael_sts *sts = ael->sts;
+	lua_Integer       t   = (NULL == sts) ? 0 : t_ael_now( );
+
+	hdspos = lua_absindex( L, hdspos );
+
 	if (msk & T_AEL_RD & dnd->msk)
 	{
 #if PRINT_DEBUGS == 1
 		//printf( ">>>>> EXECUTE DESCRIPTOR(READ) FOR DESCRIPTOR: %d\n", ael->fdExc[ i ] );
 #endif
-		lua_getiuservalue( L, -1, T_AEL_DSC_FRDIDX );     //S: ael dnd tbl
-		t_ael_doFunction( L, 0 );                         //S: ael dnd
-		rf = 1;
+		t_ael_dnd_call( L, hdspos, dnd, 0 );
 	}
-	if ((msk & T_AEL_WR & dnd->msk) && !rf)
+	else if (msk & T_AEL_WR & dnd->msk)
 	{
 #if PRINT_DEBUGS == 1
 		//printf( "<<<<< EXECUTE DESCRIPTOR(WRITE) FOR DESCRIPTOR: %d\n", ael->fdExc[ i ] );
 #endif
-		lua_getiuservalue( L, -1, T_AEL_DSC_FWRIDX );     //S: ael dnd tbl
-		t_ael_doFunction( L, 0 );
+		t_ael_dnd_call( L, hdspos, dnd, 1 );
 	}
+	if (NULL != sts)
+		t_ael_sts_record( &sts->hdl, t_ael_now( ) - t );
 }
 
 
@@ -87,9 +299,9 @@ struct t_ael_dnd
 
 
 /**--------------------------------------------------------------------------
- * Garbage Collector. Free events in allocated spots.
+ * Garbage Collector.
  * \param   L    Lua state.
- * \lparam  ud   T.Loop userdata instance.                   // 1
+ * \lparam  ud   T.Loop.Node userdata instance.              // 1
  * \return  int  # of values pushed onto the stack.
  * -------------------------------------------------------------------------*/
 static int
@@ -19,6 +19,11 @@
 #endif
 
 #include <sys/time.h>             // gettimeofday(); struct timeval
+#include <time.h>                 // clock_gettime(); struct timespec
+#include <stdlib.h>               // bsearch()
+#include <string.h>               // strcmp()
+#include <limits.h>               // INT_MAX
+#include <signal.h>               // SIGRTMAX, SIGKILL, SIGSTOP
 
 #include "t_net.h"
 #include "t_ael_l.h"
@@ -27,16 +32,6 @@
 #include "t_dbg.h"
 #endif
 
-#define timesub(a, b, result)                           \
-	do {                                                 \
-	  (result)->tv_sec = (a)->tv_sec - (b)->tv_sec;      \
-	  (result)->tv_usec = (a)->tv_usec - (b)->tv_usec;   \
-	  if ((result)->tv_usec < 0) {                       \
-	    --(result)->tv_sec;                              \
-	    (result)->tv_usec += 1000000;                    \
-	  }                                                  \
-	} while (0)
-
 #ifdef _WIN32
 // PostgreSQL's implementattion of gettimeofday()
 /* FILETIME of Jan 1 1970 00:00:00. */
@@ -66,6 +61,82 @@ gettimeofday( struct timeval *tv, struct timezone * tzp)
 	return 0;
 }
 #endif
+// bsearch() is used on this array.  Order keys (name) alphabetically!
+static const struct t_ael_option t_ael_options[ ] =
+{
+	{ "budget"     , offsetof( struct t_ael, budget )     , T_AEL_OTP_INT  , 1 , 1 } ,
+	{ "budgetHits" , offsetof( struct t_ael, budgetHits ) , T_AEL_OTP_INT  , 1 , 0 } ,
+	{ "budgetTime" , offsetof( struct t_ael, budgetTime ) , T_AEL_OTP_INT  , 1 , 1 } ,
+	{ "carried"    , offsetof( struct t_ael, carried )    , T_AEL_OTP_INT  , 1 , 0 } ,
+	{ "hires"      , offsetof( struct t_ael, hires )      , T_AEL_OTP_BOOL , 1 , 1 } ,
+	{ "jobs"       , offsetof( struct t_ael, jobs )       , T_AEL_OTP_INT  , 1 , 0 } ,
+	{ "poolSize"   , offsetof( struct t_ael, poolSize )   , T_AEL_OTP_INT  , 1 , 1 } ,
+	{ "spin"       , offsetof( struct t_ael, spin )       , T_AEL_OTP_INT  , 1 , 1 } ,
+	{ "stats"      , offsetof( struct t_ael, stats )      , T_AEL_OTP_BOOL , 1 , 1 } ,
+};
+
+#define T_AEL_OPTS_MAX       (sizeof(t_ael_options) / sizeof(struct t_ael_option))
+
+// names of the phases of enum t_ael_phs
+static const char *const t_ael_phs_lst[ ] = { "prepare", "check", "idle", NULL };
+
+
+/**----------------------------------------------------------------------------
+ * Get monotonic time in nanoseconds.  Reference for all task deadlines.
+ * \return  lua_Integer  nanoseconds of CLOCK_MONOTONIC.
+ * --------------------------------------------------------------------------*/
+lua_Integer
+t_ael_now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (lua_Integer) ts.tv_sec * T_AEL_NSEC_SEC + ts.tv_nsec;
+}
+
+
+/**----------------------------------------------------------------------------
+ * Convert a millisecond value on the stack to nanoseconds.
+ * Accepts integers and floats which allows for sub-millisecond precision.
+ * \param   L     Lua state.
+ * \param   pos   int; position of value on the stack.
+ * \return  lua_Integer  nanoseconds; 0 if value is not a number.
+ * --------------------------------------------------------------------------*/
+lua_Integer
+t_ael_tons( lua_State *L, int pos )
+{
+	if (LUA_TNUMBER != lua_type( L, pos ))
+		return 0;
+	return (lua_isinteger( L, pos ))
+		? lua_tointeger( L, pos ) * T_AEL_NSEC_MSEC
+		: (lua_Integer) (lua_tonumber( L, pos ) * T_AEL_NSEC_MSEC);
+}
+
+
+/**----------------------------------------------------------------------------
+ * Check if the dispatch budget of the current iteration is spent.
+ * If so it gets counted and the poll implementation carries the events not
+ * dispatched yet into the next iteration.  At least one event gets
+ * dispatched per iteration.
+ * \param  *ael    struct t_ael*; the loop.
+ * \param   c      int; events dispatched in this iteration so far.
+ * \param   start  lua_Integer; time(ns) dispatching started.
+ * \param   left   int; events not dispatched yet.
+ * \return  int    boolean; stop dispatching.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_budgetSpent( struct t_ael *ael, int c, lua_Integer start, int left )
+{
+	if (c > 0 && ((ael->budget > 0 && c >= ael->budget) ||
+	    (ael->budgetTime > 0 && t_ael_now( ) - start >= (lua_Integer) ael->budgetTime * 1000)))
+	{
+		ael->budgetHits++;
+		ael->carried += left;
+		return 1;
+	}
+	return 0;
+}
+
+
 /**----------------------------------------------------------------------------
  * Get descriptor handle from the stack.
  * Discriminate if Socket or file handle
@@ -75,7 +146,7 @@ gettimeofday( struct timeval *tv, struct timezone * tzp)
  * \return  check Number of arguments to be called by function.
  * \return  int   Descriptor number.
  * --------------------------------------------------------------------------*/
-static inline int
+int
 t_ael_getHandle( lua_State *L, int pos, int check )
 {
 	struct t_net_sck *sck = t_net_sck_check_ud( L, pos, 0 );
@@ -97,9 +168,57 @@ t_ael_getHandle( lua_State *L, int pos, int check )
 	return fd;
 }
 
+
+/**----------------------------------------------------------------------------
+ * Get direction and mode of observation from the stack.
+ * Either a name such as "read" which gets resolved via the T.Loop class, or an
+ * integer combining T.Loop.READ/WRITE with the mode bits T.Loop.EDGE,
+ * T.Loop.ONESHOT and T.Loop.RDHUP.
+ * \param   L     Lua state.
+ * \param   pos   int; Reference positon on the stack.
+ * \return  msk   enum t_ael_msk; direction and mode bits.
+ * --------------------------------------------------------------------------*/
+static inline enum t_ael_msk
+t_ael_checkDirection( lua_State *L, int pos )
+{
+	lua_Integer msk;
+
+	if (! lua_isinteger( L, pos ))
+		luaL_argcheck( L, t_getLoadedValue( L, 1, pos, "t."T_AEL_IDNT ),
+		      pos, "must specify direction" );
+	msk = luaL_checkinteger( L, pos );
+	luaL_argcheck( L, (msk & T_AEL_RW) && !(msk & ~(T_AEL_RW | T_AEL_MD)),
+	      pos, "must specify direction" );
+	return (enum t_ael_msk) msk;
+}
+
+
+/**----------------------------------------------------------------------------
+ * Get signal number from the stack.
+ * Either a name such as "SIGTERM" which gets resolved via the T.Loop class, or
+ * an integer.
+ * \param   L     Lua state.
+ * \param   pos   int; Reference positon on the stack.
+ * \return  sig   int; signal number.
+ * --------------------------------------------------------------------------*/
+static inline int
+t_ael_checkSignal( lua_State *L, int pos )
+{
+	lua_Integer sig;
+
+	if (! lua_isinteger( L, pos ))
+		luaL_argcheck( L, t_getLoadedValue( L, 1, pos, "t."T_AEL_IDNT ),
+		      pos, "must specify signal" );
+	sig = luaL_checkinteger( L, pos );
+	luaL_argcheck( L, sig > 0 && sig <= SIGRTMAX && sig != SIGKILL && sig != SIGSTOP,
+	      pos, "must specify signal that can be caught" );
+	return (int) sig;
+}
+
+
 /**----------------------------------------------------------------------------
  * Takes refPosition and gets table onto the stack.  Executes function.
- * Stack before: {fnc, p1, p2, p3, … }
+ * Stack before: {fnc, p1, p2, p3, … }  or  fnc  (no arguments)
  * Stack after:   fnc  p1  p2  p3  …
  * \param   L     Lua state.
  * \param   pos   int; Reference positon on the stack.
@@ -115,6 +234,11 @@ t_ael_doFunction( lua_State *L, int exc )
 
 	if (lua_isnil( L, -1 ))
 		lua_pop( L, 1);
+	else if (! lua_istable( L, -1 ))   // function or T.Loop.Coroutine
+	{
+		if (exc > -1)
+			lua_call( L, 0, exc );
+	}
 	else
 	{
 		p = lua_gettop( L );
@@ -133,14 +257,20 @@ t_ael_doFunction( lua_State *L, int exc )
  * \param   L      Lua state.
  * \lparam  CLASS  table t.Loop.
  * \lparam  sz,fix int,bool; descriptor capacity of Loop or automatic mode.
+ * \lparam  impl   string; backend such as "epoll"; default if omitted.
  * \return  int    # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
 static int lt_ael__Call( lua_State *L )
 {
 	struct t_ael __attribute__ ((unused)) *ael;
+	lua_Integer                           sz;
+	int                                   impl;
 	lua_remove( L, 1 );   // remove CLASS table
 
-	ael = t_ael_create_ud( L );
+	sz   = luaL_optinteger( L, 1, 0 );
+	luaL_argcheck( L, sz >= 0 && sz <= INT_MAX, 1, "size must be a positive integer" );
+	impl = (lua_isnoneornil( L, 2 )) ? -1 : luaL_checkoption( L, 2, NULL, p_ael_impl_lst );
+	ael  = t_ael_create_ud( L, (int) sz, impl );
 	return 1;
 }
 
@@ -149,19 +279,41 @@ static int lt_ael__Call( lua_State *L )
  * Create a new t_ael userdata and push to LuaStack.
  * \param   L    Lua state.
  * \param   sz   size_t; how many slots for file/socket events to be created.
+ * \param   impl int; index in p_ael_impl_lst of backend; -1 for default.
  * \return  ael  struct t_ael * pointer to new userdata on Lua Stack.
  * --------------------------------------------------------------------------*/
 struct t_ael
-*t_ael_create_ud( lua_State *L )
+*t_ael_create_ud( lua_State *L, int sz, int impl )
 {
 	struct t_ael    *ael;
 
-	ael = (struct t_ael *) lua_newuserdatauv( L, sizeof( struct t_ael ), 3 );
-	ael->fdCount = 0;
-	ael->tout    = T_AEL_NOTIMEOUT;
+	ael = (struct t_ael *) lua_newuserdatauv( L, sizeof( struct t_ael ), 10 );
+	ael->fdCount  = 0;
+	ael->pst      = NULL;
+	ael->sig      = NULL;
+	ael->sts      = NULL;
+	ael->thp      = NULL;
+	ael->hires    = 0;
+	ael->stats    = 0;
+	ael->budget     = 0;
+	ael->budgetTime = 0;
+	ael->budgetHits = 0;
+	ael->carried    = 0;
+	ael->spin       = 0;
+	ael->poolSize   = 4;
+	ael->jobs       = 0;
+	ael->impl       = impl;
+	ael->tskCount = 0;
+	ael->tskSeq   = 0;
+	ael->tout     = T_AEL_NOTIMEOUT;
+	lua_newtable( L );                               //S: ael tbl
+	lua_setiuservalue( L, -2, T_AEL_DSCIDX );        //S; ael
 	lua_newtable( L );                               //S: ael tbl
-	lua_setiuservalue( L, 1, T_AEL_DSCIDX );         //S; ael
-	p_ael_create_ud_impl( L );                       //S: ael ste
+	lua_setiuservalue( L, -2, T_AEL_TSKIDX );        //S; ael
+	lua_newtable( L );                               //S: ael tbl
+	lua_setiuservalue( L, -2, T_AEL_HDSIDX );        //S; ael
+	t_ael_phs_clear( L, ael, -1 );
+	p_ael_create_ud_impl( L, ael, sz );              //S: ael ste
 	lua_setiuservalue( L, -2, T_AEL_STEIDX );        //S: ael
 	luaL_getmetatable( L, T_AEL_TYPE );
 	lua_setmetatable( L, -2 );
@@ -191,6 +343,7 @@ struct t_ael
  * \lparam  ud     T.Loop userdata instance.                          // 1
  * \lparam  ud     T.Net.Socket or LUA_FILEHANDLE userdata instance.  // 2
  * \lparam  string r,rd,read incoming, w,wr,write outgoing            // 3
+ *                 or int T.Loop.READ|T.Loop.EDGE etc.
  * \lparam  func   to be executed when event handler fires.           // 4
  * \lparam  …      parameters to function when executed.              // 5 …
  * \return  int    # of values pushed onto the stack.
@@ -198,51 +351,23 @@ struct t_ael
 static int
 lt_ael_addhandle( lua_State *L )
 {
-	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );      //S: ael hdl dir fnc …
+	struct t_ael __attribute__ ((unused)) *ael = t_ael_check_ud( L, 1, 1 );
 	int               fd  = t_ael_getHandle( L, 2, 1 );     //S: ael hdl dir fnc …
-	struct t_ael_dnd *dnd;
 	int               n   = lua_gettop( L ) + 1;    ///< iterator for arguments
-	enum t_ael_msk    msk;
+	int               a   = n - 5;                  ///< number of arguments
+	enum t_ael_msk    msk = t_ael_checkDirection( L, 3 );   //S: ael hdl msk fnc …
 
-	luaL_argcheck( L, t_getLoadedValue( L, 1, 3, "t."T_AEL_IDNT ),
-	      3, "must specify direction" );
-	msk = luaL_checkinteger( L, 3 );                        //S: ael hdl msk fnc …
 	luaL_checktype( L, 4, LUA_TFUNCTION );
 
-	// get/create dnd userdata
-	lua_getiuservalue( L, 1, T_AEL_DSCIDX );     //S: ael hdl msk fnc … nds
-	//printf("FD: %d  ", fd); t_stackDump(L);
-	lua_rawgeti( L, -1, fd );                    //S: ael hdl msk fnc … nds ???
-	if (lua_isnil( L, -1 ))
+	// create function reference; the function itself if there are no arguments
+	if (a > 0)
 	{
-		lua_pop( L, 1 );
-		dnd = t_ael_dnd_create_ud( L );           //S: ael hdl msk fnc … nds dnd
-		lua_pushvalue( L, -1 );                   //S: ael hdl msk fnc … nds dnd dnd
-		lua_rawseti( L, -3, fd );                 //S: ael hdl msk fnc … nds dnd
-		(ael->fdCount)++;
-	}
-	else
-		dnd = t_ael_dnd_check_ud( L, -1, 1 );     //S: ael hdl msk fnc … nds dnd
-	lua_rotate( L, 2, 1 );                       //S: ael dnd hdl msk fnc … nds
-	lua_pop( L, 1 );                             //S: ael dnd hdl msk fnc …
-
-	// implementation specific handling
-	p_ael_addhandle_impl( L, 1, dnd, fd, msk );
-
-	// create function reference
-	lua_createtable( L, n-4, 0 );                //S: ael dnd hdl msk fnc … tbl
-	lua_rotate( L, 5, 1 );                       //S: ael dnd hdl msk tbl fnc …
-	while (n > 4)
-		lua_rawseti( L, 5, (n--)-4 );             // add arguments and function (pops each item)
-                                                //S: ael dnd hdl msk tbl
-	dnd->msk    |= msk;
-	if (T_AEL_RD & msk)                          //S: ael dnd hdl msk tbl
-		lua_setiuservalue( L, 2, T_AEL_DSC_FRDIDX );
-	else
-		lua_setiuservalue( L, 2, T_AEL_DSC_FWRIDX );
-
-	lua_pop( L, 1 );                             //S: ael dnd hdl       // pop the msk
-	lua_setiuservalue( L, -2, T_AEL_DSC_HDLIDX );//S: ael dnd hdl       // hdl uservalue of dnd
+		lua_createtable( L, n-4, 0 );             //S: ael hdl msk fnc … tbl
+		lua_rotate( L, 4, 1 );                    //S: ael hdl msk tbl fnc …
+		while (n > 4)
+			lua_rawseti( L, 4, (n--)-4 );          // add arguments and function (pops each item)
+	}                                            //S: ael hdl msk tbl
+	t_ael_dnd_add( L, 1, 2, fd, msk, a );        //S: ael hdl msk
 
 	lua_pushboolean( L, 1 );
 	return  1;
@@ -261,41 +386,16 @@ lt_ael_addhandle( lua_State *L )
 static int
 lt_ael_removehandle( lua_State *L )
 {
-	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );   //S: ael hdl dir
+	struct t_ael __attribute__ ((unused)) *ael = t_ael_check_ud( L, 1, 1 );
 	int                fd = t_ael_getHandle( L, 2, 1 );  //S: ael hdl dir
-	struct t_ael_dnd *dnd;
-	enum t_ael_msk    msk;
-
-	luaL_argcheck( L, t_getLoadedValue( L, 1, 3, "t."T_AEL_IDNT ),
-	      3, "must specify direction" );
-	msk = luaL_checkinteger( L, 3 );                     //S: ael hdl msk
 
-	// get dnd userdata
-	lua_getiuservalue( L, 1, T_AEL_DSCIDX );             //S: ael hdl msk nds
-	lua_rawgeti( L, -1, fd );
-	if (lua_isnil( L, -1 ))
+	if (! t_ael_dnd_remove( L, 1, fd, t_ael_checkDirection( L, 3 ) & T_AEL_RW ))
 	{
 		lua_pushboolean( L, 0 );
 		lua_pushstring( L, "Descriptor not observed in Loop -> ignoring" );
 		return 2;
 		//return luaL_error( L, "Descriptor must be observed in Loop" );
 	}
-	else
-		dnd = t_ael_dnd_check_ud( L, -1, 1 );             //S: ael hnd msk nds dnd
-
-	p_ael_removehandle_impl( L, 1, dnd, fd, msk );       //S: ael hnd msk nds dnd
-
-	dnd->msk = dnd->msk & (~msk);
-	lua_pushnil( L );                                    //S: ael hnd msk nds dnd nil
-	if (T_AEL_NO != dnd->msk)
-		// if dnd->msk still writeable then set read function to nil!
-		lua_setiuservalue( L, -1 , (T_AEL_WR & dnd->msk) ? T_AEL_DSC_FRDIDX : T_AEL_DSC_FWRIDX );
-	else
-	{
-		lua_rawseti( L, -3, fd );                         //S: ael hnd msk nds dnd
-		(ael->fdCount)--;
-	}
-	lua_pop( L, 2 );                                     //S: ael hnd msk
 	return 0;
 }
 
@@ -304,7 +404,7 @@ lt_ael_removehandle( lua_State *L )
  * Create a Task handler, add to T.Loop.
  * \param   L   Lua state.
  * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
- * \lparam  ms  int; milliseconds until execution                  // 2
+ * \lparam  ms  number; milliseconds until execution; float allowed // 2
  * \lparam  fnc function; to be executed when event handler fires. // 3
  * \lparam  …   parameters to function when executed.              // 4 …
  * \return  int # of values pushed onto the stack.
@@ -314,15 +414,20 @@ lt_ael_addtask( lua_State *L )
 {
 	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );  //S: ael ms fnc …
 	int               n   = lua_gettop( L ) + 1;    ///< iterator for arguments
-	struct t_ael_tsk *tsk = t_ael_tsk_create_ud( L, luaL_checkinteger( L, 2 ) ); //S: ael ms fnc … tsk
+	struct t_ael_tsk *tsk;
+
+	luaL_checknumber( L, 2 );
+	tsk = t_ael_tsk_create_ud( L, t_ael_now( ) + t_ael_tons( L, 2 ) ); //S: ael ms fnc … tsk
 
 	lua_replace( L, 2 );                         //S: ael tsk fnc …
 	luaL_checktype( L, 3, LUA_TFUNCTION );
-	lua_createtable( L, n-3, 0 );                //S: ael tsk fnc … tbl
-	lua_rotate( L, 3, 1 );                       //S: ael tsk tbl fnc …
-	while (n > 3)      // add args and fnc (pops each item) reversely (fnc is last)
-		lua_rawseti( L, 3, (n--)-3 );
-	                                             //S: ael tsk tbl
+	if (n > 4)         // the function itself if there are no arguments
+	{
+		lua_createtable( L, n-3, 0 );             //S: ael tsk fnc … tbl
+		lua_rotate( L, 3, 1 );                    //S: ael tsk tbl fnc …
+		while (n > 3)   // add args and fnc (pops each item) reversely (fnc is last)
+			lua_rawseti( L, 3, (n--)-3 );
+	}                                            //S: ael tsk tbl
 	lua_setiuservalue( L, -2, T_AEL_TSK_FNCIDX );//S: ael tsk
 	lua_pushvalue( L, -1 );                      //S: ael tsk tsk
 	lua_rotate( L, -3, 1 );                      //S: tsk ael tsk
@@ -338,6 +443,7 @@ lt_ael_addtask( lua_State *L )
  * \param   L    Lua state.
  * \lparam  ud   T.Loop userdata instance.                   // 1
  * \lparam  ud   T.Loop.Task userdata instance.              // 2
+ * \lreturn bool true if task was scheduled and got removed.
  * \return  int  # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
 static int
@@ -346,7 +452,39 @@ lt_ael_canceltask( lua_State *L )
 	struct t_ael      *ael = t_ael_check_ud( L, 1, 1 );
 	struct t_ael_tsk *tCnd = t_ael_tsk_check_ud( L, 2, 1 ); //S: ael cnd
 
-	t_ael_tsk_remove( L, ael, tCnd );                        //S: ael cnd
+	lua_settop( L, 2 );
+	lua_pushboolean( L, t_ael_tsk_remove( L, ael, tCnd ) );  //S: ael cnd bool
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Reschedule a Task of the T.Loop; schedule it if it isn't.
+ * Meant for timeouts which get refreshed frequently.  Pushing the deadline
+ * back costs O(1) and allocates nothing.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop userdata instance.                   // 1
+ * \lparam  ud   T.Loop.Task userdata instance.              // 2
+ * \lparam  ms   number; milliseconds until execution.       // 3
+ * \lparam  sl   number; slack in milliseconds; optional.    // 4
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_touchtask( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_ael_tsk *tsk = t_ael_tsk_check_ud( L, 2, 1 ); //S: ael tsk ms sl
+	lua_Integer       ns;
+
+	luaL_checknumber( L, 3 );
+	ns = t_ael_tons( L, 3 );
+	if (! lua_isnoneornil( L, 4 ))
+	{
+		luaL_argcheck( L, luaL_checknumber( L, 4 ) >= 0, 4, "slack must not be negative" );
+		tsk->slack = t_ael_tons( L, 4 );
+	}
+	lua_settop( L, 2 );
+	t_ael_tsk_touch( L, ael, tsk, ns );                    //S: ael
 	return 0;
 }
 
@@ -371,6 +509,277 @@ lt_ael__gc( lua_State *L )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Post a function to be executed by the loop as soon as possible.
+ * Posted functions get executed in posting order after the current handler
+ * returned.  Thread safe posting of messages is available to C code via
+ * t_ael_pst_push().
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  fnc function; to be executed.                          // 2
+ * \lparam  …   parameters to function when executed.              // 3 …
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_post( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );  //S: ael fnc …
+	int               n   = lua_gettop( L ) + 1;    ///< iterator for arguments
+	struct t_ael_pst *pst;
+
+	luaL_checktype( L, 2, LUA_TFUNCTION );
+	pst = t_ael_pst_get( L, ael, 1 );
+	if (n > 3)         // the function itself if there are no arguments
+	{
+		lua_createtable( L, n-2, 0 );             //S: ael fnc … tbl
+		lua_rotate( L, 2, 1 );                    //S: ael tbl fnc …
+		while (n > 2)   // add args and fnc (pops each item) reversely (fnc is last)
+			lua_rawseti( L, 2, (n--)-2 );
+	}                                            //S: ael tbl
+	t_ael_pst_post( L, pst );                    //S: ael
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Defer a function until the current batch of handlers is done.
+ * Deferred functions run in the order they were deferred, before the loop
+ * polls again.  Cheaper than addTask( 0, … ) since there is no heap involved.
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  fnc function; to be executed.                          // 2
+ * \lparam  …   parameters to function when executed.              // 3 …
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_defer( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );  //S: ael fnc …
+	int               n   = lua_gettop( L ) + 1;    ///< iterator for arguments
+
+	luaL_checktype( L, 2, LUA_TFUNCTION );
+	if (n > 3)         // the function itself if there are no arguments
+	{
+		lua_createtable( L, n-2, 0 );             //S: ael fnc … tbl
+		lua_rotate( L, 2, 1 );                    //S: ael tbl fnc …
+		while (n > 2)   // add args and fnc (pops each item) reversely (fnc is last)
+			lua_rawseti( L, 2, (n--)-2 );
+	}                                            //S: ael tbl
+	t_ael_phs_defer( L, ael, 1 );                //S: ael
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Execute a function in each loop iteration at a certain phase.
+ * 'prepare' runs before polling, 'check' after handlers and tasks ran and
+ * 'idle' at the start of each iteration and keeps poll from blocking.
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  phs string; 'prepare', 'check' or 'idle'.             // 2
+ * \lparam  fnc function; to be executed.                          // 3
+ * \lparam  …   parameters to function when executed.              // 4 …
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_addhook( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );  //S: ael phs fnc …
+	int               n   = lua_gettop( L ) + 1;    ///< iterator for arguments
+	enum t_ael_phs    phs = (enum t_ael_phs) luaL_checkoption( L, 2, NULL, t_ael_phs_lst );
+
+	luaL_checktype( L, 3, LUA_TFUNCTION );
+	if (n > 4)         // the function itself if there are no arguments
+	{
+		lua_createtable( L, n-3, 0 );             //S: ael phs fnc … tbl
+		lua_rotate( L, 3, 1 );                    //S: ael phs tbl fnc …
+		while (n > 3)   // add args and fnc (pops each item) reversely (fnc is last)
+			lua_rawseti( L, 3, (n--)-3 );
+	}                                            //S: ael phs tbl
+	t_ael_phs_add( L, ael, 1, phs );             //S: ael phs
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove a function from a phase of the loop iteration.
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  phs string; 'prepare', 'check' or 'idle'.             // 2
+ * \lparam  fnc function; to be removed.                           // 3
+ * \lreturn bool true if the function was a hook of the phase.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_removehook( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );  //S: ael phs fnc
+	enum t_ael_phs    phs = (enum t_ael_phs) luaL_checkoption( L, 2, NULL, t_ael_phs_lst );
+
+	luaL_checktype( L, 3, LUA_TFUNCTION );
+	lua_pushboolean( L, t_ael_phs_remove( L, ael, 1, phs, 3 ) );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Run a function as coroutine driven by the loop.
+ * Socket operations which would block and T.Loop.sleep() yield to the loop
+ * and continue once the socket is ready or the time has passed.
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  fnc function; to be run as coroutine.                 // 2
+ * \lparam  …   parameters to function.                           // 3 …
+ * \lreturn co  thread; the coroutine.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_spawn( lua_State *L )
+{
+	struct t_ael __attribute__ ((unused)) *ael = t_ael_check_ud( L, 1, 1 );
+
+	luaL_checktype( L, 2, LUA_TFUNCTION );
+	t_ael_crt_spawn( L, 1, lua_gettop( L ) - 2 ); //S: ael co
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Run a blocking operation on the thread pool of the loop.
+ * The result gets passed to the handler, after the handlers own arguments.
+ * Without a handler, inside a coroutine run by T.Loop:spawn(), the coroutine
+ * gets suspended and offload() returns the result.  Failed operations pass
+ * nil and an error message instead.
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  op  string; "read", "write", "fsync" or "crc".         // 2
+ * \lparam  …   arguments of the operation.
+ * \lparam  fnc function; handler executed when done.
+ * \lparam  …   parameters to function when executed.
+ * \lreturn …   result of operation if the coroutine got suspended.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_offload( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );
+
+	return t_ael_thp_offload( L, ael );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Spawn a child process observed by the loop.
+ * The handler gets executed with the exit status, after its own arguments.
+ * The process counts as observed handle until it exited.
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  opt table; {cmd, arg, …, stdin=, stdout=, stderr=}.     // 2
+ * \lparam  fnc function; handler executed on exit; optional.      // 3
+ * \lparam  …   parameters to function when executed.              // 4 …
+ * \lreturn prc T.Loop.Process userdata instance.
+ * \lreturn …   T.Net.Socket or nil for stdin, stdout and stderr.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_spawnprocess( lua_State *L )
+{
+	struct t_ael __attribute__ ((unused)) *ael = t_ael_check_ud( L, 1, 1 );
+	int               n   = lua_gettop( L ) + 1;    ///< iterator for arguments
+
+	luaL_checktype( L, 2, LUA_TTABLE );
+	if (n > 3)
+		luaL_checktype( L, 3, LUA_TFUNCTION );
+	if (n > 4)         // the function itself if there are no arguments
+	{
+		lua_createtable( L, n-3, 0 );             //S: ael opt fnc … tbl
+		lua_rotate( L, 3, 1 );                    //S: ael opt tbl fnc …
+		while (n > 3)   // add args and fnc (pops each item) reversely (fnc is last)
+			lua_rawseti( L, 3, (n--)-3 );
+	}
+	lua_settop( L, 3 );                          //S: ael opt fnc/tbl/nil
+	return t_ael_prc_spawn( L, 1, 2 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Execute a function when the process receives a signal.
+ * The signal gets blocked and is delivered via a signalfd as a regular loop
+ * event.  Observing signals doesn't keep the loop running.
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  sig int or string; signal number or name eg. "SIGTERM". // 2
+ * \lparam  fnc function; to be executed.                          // 3
+ * \lparam  …   parameters to function when executed.              // 4 …
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_addsignal( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );  //S: ael sig fnc …
+	int               n   = lua_gettop( L ) + 1;    ///< iterator for arguments
+	int               sig = t_ael_checkSignal( L, 2 );
+	struct t_ael_sig *sgl;
+
+	luaL_checktype( L, 3, LUA_TFUNCTION );
+	sgl = t_ael_sig_get( L, ael, 1 );
+	if (n > 4)         // the function itself if there are no arguments
+	{
+		lua_createtable( L, n-3, 0 );             //S: ael sig fnc … tbl
+		lua_rotate( L, 3, 1 );                    //S: ael sig tbl fnc …
+		while (n > 3)   // add args and fnc (pops each item) reversely (fnc is last)
+			lua_rawseti( L, 3, (n--)-3 );
+	}                                            //S: ael sig tbl
+	t_ael_sig_add( L, sgl, 1, sig );             //S: ael sig
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Stop observing a signal and restore its default disposition.
+ * \param   L   Lua state.
+ * \lparam  ael t_ael; T.Loop userdata instance.                   // 1
+ * \lparam  sig int or string; signal number or name eg. "SIGTERM". // 2
+ * \lreturn bool true if the signal was observed.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_removesignal( lua_State *L )
+{
+	struct t_ael     *ael = t_ael_check_ud( L, 1, 1 );  //S: ael sig
+	int               sig = t_ael_checkSignal( L, 2 );
+
+	lua_pushboolean( L, NULL != ael->sig && t_ael_sig_remove( L, ael->sig, 1, sig ) );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the statistics of the loop.  They are only collected while loop.stats
+ * is enabled.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop userdata instance.                       // 1
+ * \lparam  bool   reset statistics after reading them.            // 2
+ * \lreturn table  statistics; nil if they never got enabled.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_stats( lua_State *L )
+{
+	struct t_ael __attribute__ ((unused)) *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_ael_sts                      *sts;
+
+	lua_settop( L, 2 );
+	lua_getiuservalue( L, 1, T_AEL_STSIDX );             //S: ael rst sts
+	if (NULL == (sts = t_ael_sts_check_ud( L, -1, 0 )))
+		return 1;
+	t_ael_sts_push( L, sts );
+	if (lua_toboolean( L, 2 ))
+		t_ael_sts_reset( sts );
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Set up a poll call for all events in the T.Loop
  * \param   L    Lua state.
@@ -381,30 +790,71 @@ static int
 lt_ael_run( lua_State *L )
 {
 	struct t_ael      *ael = t_ael_check_ud( L, 1, 1 );
-	struct timeval tvs,tve;      ///< measure time for one iteration
+	struct t_ael_sts  *sts;      ///< statistics; NULL if disabled
+	lua_Integer        now;      ///< current time in ns
+	lua_Integer        tout;     ///< time(ns) until head of heap is due
+	lua_Integer        wait = 0; ///< time(ns) waited for events
+	lua_Integer        hdl  = 0; ///< time(ns) spent in handlers before poll
 	int                  n;      ///< how many file events?
 
+	lua_settop( L, 1 );
 	ael->run                = 1;
 	while (ael->run)
 	{
-		gettimeofday( &tvs, 0 );
-
-		if ((n = p_ael_poll_impl( L, ael->tout, 1 )) < 0)          //S: ael
+		if (ael->hks[ T_AEL_PHS_IDLE ] > 0)
+			t_ael_phs_run( L, ael, 1, T_AEL_PHS_IDLE );
+		if (ael->hks[ T_AEL_PHS_PREPARE ] > 0)
+			t_ael_phs_run( L, ael, 1, T_AEL_PHS_PREPARE );
+		if (ael->dfrTl > ael->dfrHd)
+			t_ael_phs_drain( L, ael, 1 );
+
+		now  = t_ael_now( );
+		tout = (T_AEL_NOTIMEOUT == ael->tout)
+			? T_AEL_NOTIMEOUT
+			: (ael->tout > now) ? ael->tout - now : 0;
+		tout = (ael->hks[ T_AEL_PHS_IDLE ] > 0) ? 0 : tout;
+
+		// poll waits and executes the handlers; handlers record their time
+		sts  = ael->sts;
+		hdl  = (NULL == sts) ? 0 : sts->hdl.sum;
+		if ((n = p_ael_poll_impl( L, tout, 1 )) < 0)               //S: ael
 			return t_push_error( L, 1, 1, "Failed to continue the loop" );
+		if (NULL != sts)
+		{
+			wait       = t_ael_now( ) - now - (sts->hdl.sum - hdl);
+			sts->poll += wait;
+			sts->evt  += n;
+			sts->evtMax = (n > sts->evtMax) ? n : sts->evtMax;
+			sts->itr++;
+		}
 
 #if PRINT_DEBUGS == 3
 		printf( "oooooooooooooooooooooo POLL RETURNED: %d oooooooooooooooooooo\n", n );
 #endif
 
-		gettimeofday( &tve, 0 );
+		// functions deferred by the handlers of this batch
+		if (ael->dfrTl > ael->dfrHd)
+			t_ael_phs_drain( L, ael, 1 );
 
-		// execute timer events
-		timesub( &tve, &tvs, &tve );
-		t_ael_tsk_process( L, ael, (tve.tv_sec*1000 + tve.tv_usec/1000) );
+		// execute timer events which are due
+		if (ael->tskCount > 0)
+			t_ael_tsk_process( L, ael, t_ael_now( ) );
+		if (ael->dfrTl > ael->dfrHd)
+			t_ael_phs_drain( L, ael, 1 );
+		if (ael->hks[ T_AEL_PHS_CHECK ] > 0)
+		{
+			t_ael_phs_run( L, ael, 1, T_AEL_PHS_CHECK );
+			if (ael->dfrTl > ael->dfrHd)
+				t_ael_phs_drain( L, ael, 1 );
+		}
+		if (NULL != sts)
+			t_ael_sts_record( &sts->bsy, t_ael_now( ) - now - wait );
 
 		// if there are no events left in the loop -> stop processing
 		//printf("RUN__ed: %lld -- ", ael->tout); t_stackDump(L);
-		ael->run = (ael->tout == T_AEL_NOTIMEOUT && ael->fdCount < 1) ? 0 : ael->run;
+		ael->run = (ael->tout == T_AEL_NOTIMEOUT && ael->fdCount < 1 && ael->jobs < 1 &&
+		            (NULL == ael->pst || 0 == __atomic_load_n( &ael->pst->pnd, __ATOMIC_RELAXED )))
+		         ? 0 : ael->run;
 	}
 
 	return 0;
@@ -441,11 +891,28 @@ lt_ael_time( lua_State *L )
 	return 1;
 }
 
+/**--------------------------------------------------------------------------
+ * Get nanoseconds of the monotonic clock the loop uses for its tasks.
+ * The value has no relation to the wall clock and is only useful to
+ * measure intervals.
+ * \param   L    Lua state.
+ * \lreturn ns   int; nanoseconds of monotonic clock.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_hrtime( lua_State *L )
+{
+	lua_pushinteger( L, t_ael_now( ) );
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * System call wrapper to sleep (Lua lacks that)
- *             Lua has no build in sleep method.
+ *             Lua has no build in sleep method.  Inside a coroutine run by
+ *             T.Loop:spawn() it yields and the loop resumes it later.
  * \param   L    Lua state.
- * \lparam  int  milliseconds to sleep
+ * \lparam  num  milliseconds to sleep; float allowed
  * \return  int  # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
 static int
@@ -455,11 +922,16 @@ lt_ael_sleep( lua_State *L )
 	fd_set dummy;
 	int s;
 #endif
-	int            ms = luaL_checkinteger( L, -1 );
+	lua_Integer    us = (lua_Integer) (luaL_checknumber( L, -1 ) * 1000);
 	struct timeval tv;
 
-	tv.tv_sec  = ms/1000;
-	tv.tv_usec = (ms % 1000) * 1000;
+	if (t_isAwaitable( L ))   // inside T.Loop:spawn(); let the loop wait
+	{
+		lua_pushnumber( L, luaL_checknumber( L, -1 ) );
+		return lua_yield( L, 1 );
+	}
+	tv.tv_sec  = us/1000000;
+	tv.tv_usec = us % 1000000;
 #ifdef _WIN32
 	s = socket( PF_INET, SOCK_STREAM, IPPROTO_TCP );
 	FD_ZERO( &dummy );
@@ -482,7 +954,7 @@ static int
 lt_ael__tostring( lua_State *L )
 {
 	struct t_ael *ael = t_ael_check_ud( L, 1, 1 );
-	lua_pushfstring( L, T_AEL_TYPE"{%d}[%d]: %p", ael->fdCount, ael->tout, ael );
+	lua_pushfstring( L, T_AEL_TYPE"{%d}[%d]: %p", ael->fdCount, (int) ael->tskCount, ael );
 	return 1;
 }
 
@@ -518,21 +990,20 @@ lt_ael_showloop( lua_State *L )
 	int               i   = 0;
 	int               n   = lua_gettop( L );
 	int               fd;
-	int               fail=40;
+	size_t            t;
 
-	printf( T_AEL_TYPE"{%d}[%lld]: %p TIMER LIST:\n", ael->fdCount, ael->tout, ael );
-	lua_getiuservalue( L, 1 ,T_AEL_TSKIDX );         //S: ael tsk
-	while (! lua_isnil( L, -1 ) && fail-- > 0)
+	printf( T_AEL_TYPE"{%d}[%lld]: %p TIMER HEAP:\n", ael->fdCount, ael->tout, ael );
+	lua_getiuservalue( L, 1 ,T_AEL_TSKIDX );         //S: ael hp
+	for (t=1; t<=ael->tskCount; t++)
 	{
+		lua_rawgeti( L, n+1, t );                     //S: ael hp tsk
 		tsk = t_ael_tsk_check_ud( L, -1, 0 );
-		printf( "%5d  {%5lldms}  ", ++i, tsk->tout );
-		lua_getiuservalue( L, -1, T_AEL_TSK_FNCIDX ); //S: ael tsk tbl
+		printf( "%5d  {%12lldns}  ", ++i, tsk->tout );
+		lua_getiuservalue( L, -1, T_AEL_TSK_FNCIDX ); //S: ael hp tsk tbl
 		t_ael_doFunction( L, -1 );
-		t_stackPrint( L, n+2, lua_gettop( L ), 0 );   //S: ael tsk fnc …
+		t_stackPrint( L, n+3, lua_gettop( L ), 0 );   //S: ael hp tsk fnc …
 		printf( "\n" );
-		lua_getiuservalue( L, 2, T_AEL_TSK_NXTIDX );  //S: ael prv fnc … nxt
-		lua_rotate( L, 2, 1 );                        //S: ael nxt prv fnc …
-		lua_pop( L, lua_gettop( L ) - 2 );            //S: ael nxt
+		lua_settop( L, n+1 );                         //S: ael hp
 	}
 	lua_pop( L, 1 );
 	printf( T_AEL_TYPE" %p HANDLE LIST:\n", ael );
@@ -585,9 +1056,12 @@ lt_ael_clean( lua_State *L )
 	//int               i   = 0;
 	//int               n   = lua_gettop( L );
 
-	lua_pushnil( L );
-	lua_setiuservalue( L, 1, T_AEL_TSKIDX );
-	ael->tout = T_AEL_NOTIMEOUT;
+	t_ael_tsk_clear( L, ael, 1 );
+	t_ael_phs_clear( L, ael, 1 );
+	if (NULL != ael->pst)
+		t_ael_pst_clear( L, ael->pst );
+	if (NULL != ael->sig)
+		t_ael_sig_clear( L, ael->sig, 1 );
 
 	// walk down nodes table an unref functions and handles
 	lua_getiuservalue( L, 1, T_AEL_DSCIDX );             //S: ael nds
@@ -595,7 +1069,17 @@ lt_ael_clean( lua_State *L )
 	while (lua_next( L, -2 ))
 	{
 		dnd = t_ael_dnd_check_ud( L, -1, 1 );             //S: ael nds fd dnd
+		if (dnd->mod & T_AEL_IN)
+		{
+			lua_pop( L, 1 );                               // keep internal nodes
+			continue;
+		}
 		p_ael_removehandle_impl( L, 1, dnd, luaL_checkinteger( L, -2 ), T_AEL_RW );
+		dnd->msk = T_AEL_NO;
+		lua_pushnil( L );                                 //S: ael nds fd dnd nil
+		t_ael_dnd_setFunction( L, 1, dnd, 0, 0 );
+		lua_pushnil( L );                                 //S: ael nds fd dnd nil
+		t_ael_dnd_setFunction( L, 1, dnd, 1, 0 );
 		lua_pushnil( L );                                 //S: ael nds fd dnd nil
 		lua_rawseti( L, -4, luaL_checkinteger( L, -3 ) ); //S: ael nds fd dnd
 		(ael->fdCount)--;
@@ -605,21 +1089,47 @@ lt_ael_clean( lua_State *L )
 }
 
 
+static int t_ael_optCompare( const void *needle, const void *haystack )
+{
+	const char                 *const key   = needle;
+	const struct t_ael_option  *const value = haystack;
+
+	return strcmp( key, value->name );
+}
+
+
 /**--------------------------------------------------------------------------
  * Get Element from Loop.
  * \param   L    Lua state.
  * \lparam  ud   T.Loop userdata instance.                                 // 1
  * \lparam  ud   T.Net.Socket, T.Time or LUA_FILEHANDLE userdata instance. // 2
+ *               or string; loop option name or function name.
  * \return  int  # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
 int
 lt_ael__index( lua_State *L )
 {
-	struct t_ael __attribute__ ((unused)) *ael = t_ael_check_ud( L, 1, 1 );
-	int               fd  = 0;
+	struct t_ael              *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_ael_option       *opt;
+	int                        fd  = 0;
 
-	if (LUA_TSTRING == lua_type( L, 2 )) // return method: run, stop, addHandle, …
+	if (LUA_TSTRING == lua_type( L, 2 )) // return option or method: run, stop, addHandle, …
 	{
+		if (0 == strcmp( lua_tostring( L, 2 ), "impl" ))
+		{
+			lua_pushstring( L, p_ael_impl_lst[ ael->impl ] );
+			return 1;
+		}
+		opt = bsearch( lua_tostring( L, 2 ), t_ael_options, T_AEL_OPTS_MAX,
+		               sizeof( struct t_ael_option ), t_ael_optCompare );
+		if (NULL != opt && opt->get)
+		{
+			if (T_AEL_OTP_BOOL == opt->type)
+				lua_pushboolean( L, *(int *) ((char *) ael + opt->offset) );
+			else
+				lua_pushinteger( L, *(int *) ((char *) ael + opt->offset) );
+			return 1;
+		}
 		lua_getmetatable( L, 1 );
 		lua_pushvalue( L, 2 );
 		lua_gettable( L, -2 );
@@ -643,6 +1153,39 @@ lt_ael__index( lua_State *L )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Set a Loop option.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop userdata instance.                        // 1
+ * \lparam  string loop option name.                                // 2
+ * \lparam  value  Lua value; loop option value.                    // 3
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael__newindex( lua_State *L )
+{
+	struct t_ael              *ael = t_ael_check_ud( L, 1, 1 );
+	struct t_ael_option       *opt = bsearch(
+	                                     luaL_checkstring( L, 2 )
+	                                   , t_ael_options
+	                                   , T_AEL_OPTS_MAX
+	                                   , sizeof( struct t_ael_option )
+	                                   , t_ael_optCompare
+	                                );
+
+	if (NULL == opt)
+		return luaL_error( L, "Can't set unknown loop option: `%s`", lua_tostring( L, 2 ) );
+	if (! opt->set)
+		return luaL_error( L, "Loop option: `%s` is read-only", lua_tostring( L, 2 ) );
+	*(int *) ((char *) ael + opt->offset) = (T_AEL_OTP_BOOL == opt->type)
+		? lua_toboolean( L, 3 )
+		: (int) luaL_checkinteger( L, 3 );
+	if (offsetof( struct t_ael, stats ) == opt->offset)
+		ael->sts = (ael->stats) ? t_ael_sts_get( L, 1 ) : NULL;
+	return 0;
+}
+
+
 /**--------------------------------------------------------------------------
  * Class metamethods library definition
  * --------------------------------------------------------------------------*/
@@ -656,6 +1199,7 @@ static const struct luaL_Reg t_ael_fm [] = {
  * --------------------------------------------------------------------------*/
 static const luaL_Reg t_ael_cf [] = {
 	  { "time",          lt_ael_time          }
+	, { "hrtime",        lt_ael_hrtime        }
 	, { "sleep",         lt_ael_sleep         }
 	, { NULL,  NULL }
 };
@@ -669,15 +1213,28 @@ static const struct luaL_Reg t_ael_m [] = {
 	, { "__len",         lt_ael__len          }
 	, { "__gc",          lt_ael__gc           }
 	, { "__index",       lt_ael__index        }
+	, { "__newindex",    lt_ael__newindex     }
 	// instance methods
 	, { "addTask",       lt_ael_addtask       }
 	, { "cancelTask",    lt_ael_canceltask    }
+	, { "touchTask",     lt_ael_touchtask     }
 	, { "addHandle",     lt_ael_addhandle     }
+	, { "post",          lt_ael_post          }
+	, { "defer",         lt_ael_defer         }
+	, { "addHook",       lt_ael_addhook       }
+	, { "removeHook",    lt_ael_removehook    }
+	, { "spawn",         lt_ael_spawn         }
+	, { "offload",       lt_ael_offload       }
+	, { "spawnProcess",  lt_ael_spawnprocess  }
+	, { "addSignal",     lt_ael_addsignal     }
+	, { "removeSignal",  lt_ael_removesignal  }
 	, { "removeHandle",  lt_ael_removehandle  }
+	, { "stats",         lt_ael_stats         }
 	, { "run",           lt_ael_run           }
 	, { "stop",          lt_ael_stop          }
 	, { "clean",         lt_ael_clean         }
 	, { "time",          lt_ael_time          }
+	, { "hrtime",        lt_ael_hrtime        }
 	, { "sleep",         lt_ael_sleep         }
 #ifdef DEBUG
 	, { "show",          lt_ael_showloop      }
@@ -704,6 +1261,11 @@ luaopen_t_ael( lua_State *L )
 	lua_setfield( L, -2, T_AEL_DND_NAME );
 	luaopen_t_ael_tsk( L );
 	lua_setfield( L, -2, T_AEL_TSK_NAME );
+	luaopen_t_ael_pst( L );
+	luaopen_t_ael_crt( L );
+	luaopen_t_ael_sts( L );
+	luaopen_t_ael_thp( L );
+	luaopen_t_ael_prc( L );
 
 	// Push the class onto the stack
 	luaL_newlib( L, t_ael_cf );
@@ -720,6 +1282,16 @@ luaopen_t_ael( lua_State *L )
 	lua_setfield( L, -2, "READWRITE" );
 	lua_pushstring( L, "READWRITE" );
 	lua_rawseti( L, -2, T_AEL_RW );
+	// modes; combine with direction such as T.Loop.READ | T.Loop.EDGE
+	lua_pushinteger( L, T_AEL_ET );     // Edge triggered; handler must drain
+	lua_setfield( L, -2, "EDGE" );
+	lua_pushinteger( L, T_AEL_OS );     // Fire once; addHandle() again to re-arm
+	lua_setfield( L, -2, "ONESHOT" );
+	lua_pushinteger( L, T_AEL_HU );     // Peer hang up makes handle readable
+	lua_setfield( L, -2, "RDHUP" );
+	luaopen_t_ael_wrk( L );
+	lua_setfield( L, -2, T_AEL_WRK_NAME );
+	luaopen_t_ael_sig( L );
 
 	// set the methods as metatable
 	// this is only avalable a <instance>:func()
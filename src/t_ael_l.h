@@ -25,6 +25,12 @@
 #include "t.h"                 // t_typ*
 
 #include <sys/time.h>          // struct timeval
+#include <stddef.h>            // offsetof
+#include <sys/types.h>         // pid_t
+
+#define T_AEL_NSEC_USEC   1000         ///< nanoseconds per microsecond
+#define T_AEL_NSEC_MSEC   1000000      ///< nanoseconds per millisecond
+#define T_AEL_NSEC_SEC    1000000000   ///< nanoseconds per second
 
 enum t_ael_msk {
 	// 00000000
@@ -35,69 +41,338 @@ enum t_ael_msk {
 	T_AEL_WR = 0x02,            ///< Write ready event on handle
 	// 00000011
 	T_AEL_RW = 0x03,            ///< Read and Write on handle
+	// 00000100
+	T_AEL_ET = 0x04,            ///< Mode: edge triggered
+	// 00001000
+	T_AEL_OS = 0x08,            ///< Mode: one shot; re-arm by adding again
+	// 00010000
+	T_AEL_HU = 0x10,            ///< Mode: report peer hang up as readable
+	// 00011100
+	T_AEL_MD = 0x1C,            ///< all mode bits
+	// 00100000
+	T_AEL_IN = 0x20,            ///< internal node of the loop (eventfd, signalfd)
 };
 
 // definition for file/socket descriptor node
 // It keeps a reference to the handle to make sure it won't be garbage collected
 // if the calling code looses its reference.  So if it gets called by the loop
 // it won't error out.
+// The read/write handlers are also kept in the handler table of the loop
+// (uservalue T_AEL_HDSIDX) keyed by the address of arg[ d ], so the poll
+// implementations can dispatch straight from a struct t_ael_dnd pointer
+// without looking up the node or its uservalues.  The loop owns that table,
+// hence handlers which capture the loop don't keep it from being collected.
+// A handler is either the function itself or, if arguments were passed, a
+// {fnc, arg, …} table.
 #define T_AEL_DSC_FRDIDX   1   ///< FUNCTION/ARGUMENTS READ INDEX
 #define T_AEL_DSC_FWRIDX   2   ///< FUNCTION/ARGUMENTS WRITE INDEX
 #define T_AEL_DSC_HDLIDX   3   ///< HANDLE INDEX
 struct t_ael_dnd {
-	enum t_ael_msk    msk;   ///< mask, for unset, readable, writable
+	enum t_ael_msk    msk;      ///< mask, for unset, readable, writable
+	enum t_ael_msk    mod;      ///< mode bits; edge triggered, one shot, hang up
+	int               arg[ 2 ]; ///< number of arguments of rd/wr handler; the
+	                            ///< address is the key in the handler table
+	unsigned int      pnd[ 2 ]; ///< implementation specific; pending requests (rd,wr)
 };
 
 // definition for timed task
-// The t_ael_tsk collection is implemented as a "linked list" where the "next"
-// task is a uservalue of the "previous" task.  In Lua 5.4 userdata can have
-// multiple uservalues.  We use index1 as uservalue of the "next" task and
-// index2 as uservalue for the function-table.  This has the benefit that if
-// tasks go out of scope all references get automatically garbage collected.
-#define T_AEL_TSK_NXTIDX   1   ///< NEXT TASK INDEX
-#define T_AEL_TSK_FNCIDX   2   ///< FUNCTION/ARGUMENTS TABLE INDEX
+// All task deadlines are absolute nanosecond values of CLOCK_MONOTONIC as
+// returned by t_ael_now().  Wall clock adjustments don't affect them.
+// The t_ael_tsk collection is implemented as a binary min-heap ordered by the
+// absolute deadline of each task.  The heap itself is a Lua table (uservalue
+// T_AEL_TSKIDX of the loop) holding the task userdata in slots 1..n, so Lua
+// keeps track of the references and unscheduled tasks get garbage collected.
+// Each task remembers its own heap slot which makes cancellation O(log n)
+// without searching.  A slot of 0 means the task is not scheduled.
+// Touching a task with a later deadline only records it in due; the heap
+// keeps the old deadline and the task gets re-inserted instead of executed
+// once that passes.  Refreshing a timeout is O(1) that way.  Deadlines of
+// tasks with slack get rounded up to a multiple of it, so they coincide.
+#define T_AEL_TSK_FNCIDX   1   ///< FUNCTION/ARGUMENTS TABLE INDEX
 struct t_ael_tsk {
-	//int                fR;      ///< func/arg table reference in LUA_REGISTRYINDEX
-	lua_Integer        tout;    ///< timeout in ms
+	lua_Integer        tout;    ///< absolute deadline in ns; heap order
+	lua_Integer        due;     ///< deadline it was touched to; >= tout
+	lua_Integer        slack;   ///< deadline granularity in ns; 0 is exact
+	lua_Integer        seq;     ///< insertion sequence; orders equal deadlines
+	size_t             pos;     ///< slot in loops task heap; 0 if unscheduled
+};
+
+// definition for posted message
+// Messages get posted from any thread.  exc() gets executed on the thread
+// running the loop and must release the message.  If L is NULL the message
+// only gets released because the loop is cleaned or collected.
+struct t_ael_msg {
+	struct t_ael_msg  *nxt;     ///< next message in stack/batch
+	void             (*exc)( lua_State *L, struct t_ael_msg *msg );
+	int                fnc;     ///< registry reference to fnc or {fnc, arg, …}
+};
+
+// definition for post queue; lock free multi producer single consumer
+// The eventfd gets observed by the loop as a regular descriptor node.
+struct t_ael_pst {
+	int                fd;      ///< eventfd to wake up the loop
+	unsigned int       pnd;     ///< posted but not executed messages; atomic
+	struct t_ael_msg  *hd;      ///< head of producers stack; atomic
+	struct t_ael_msg  *cur;     ///< consumers batch in posting order
+};
+
+// definition for signal state; defined in t_ael_sig.c to keep <signal.h>
+// and its feature test macros out of this header
+// Observed signals are blocked and get read from a signalfd which is observed
+// by the loop as a regular descriptor node.
+#define T_AEL_SIG_FNCIDX   1   ///< HANDLER TABLE INDEX; signal number -> fnc/tbl
+struct t_ael_sig;
+
+// definition for coroutine run by the loop
+// The coroutine yields (hdl, msk) from socket operations which would block
+// and (ms) from T.Loop.sleep().  While it waits the struct is the handler of
+// the node or task; calling it resumes the coroutine.  After waking up, the
+// node stays observed as long as the coroutine waits for the same handle and
+// direction again, which makes a read or write loop free of epoll_ctl() calls.
+#define T_AEL_CRT_THDIDX   1   ///< THREAD INDEX
+#define T_AEL_CRT_AELIDX   2   ///< LOOP INDEX
+#define T_AEL_CRT_HDLIDX   3   ///< HANDLE INDEX; handle currently observed
+struct t_ael_crt {
+	int                fd;      ///< descriptor currently observed; -1 if none
+	enum t_ael_msk     msk;     ///< direction currently observed
+};
+
+// definition for latency histogram; HDR style log-linear buckets
+// Values below 2^T_AEL_HST_SUB ns get a bucket each, above that every power
+// of two is split into 2^T_AEL_HST_SUB buckets which keeps the relative error
+// below 12.5%.  Values of 2^T_AEL_HST_BITS ns (~18 minutes) and more are
+// counted in the last bucket.
+#define T_AEL_HST_SUB      3
+#define T_AEL_HST_BITS     40
+#define T_AEL_HST_CNT      ((T_AEL_HST_BITS - T_AEL_HST_SUB + 1) << T_AEL_HST_SUB)
+struct t_ael_hst {
+	lua_Integer        cnt;     ///< number of recorded values
+	lua_Integer        sum;     ///< sum of recorded values in ns
+	lua_Integer        min;     ///< smallest recorded value in ns
+	lua_Integer        max;     ///< largest recorded value in ns
+	unsigned int       bkt[ T_AEL_HST_CNT ];
+};
+
+// definition for loop statistics; only collected if loop.stats is enabled
+// Poll time is the time spent waiting in the kernel, busy is the time each
+// iteration spent in handlers and tasks.  Lag is how late tasks got executed
+// relative to their deadline.
+struct t_ael_sts {
+	lua_Integer        itr;     ///< loop iterations
+	lua_Integer        evt;     ///< events dispatched
+	lua_Integer        evtMax;  ///< most events dispatched by a single poll
+	lua_Integer        poll;    ///< time(ns) spent waiting for events
+	lua_Integer        spin;    ///< polls which found events while spinning
+	lua_Integer        blk;     ///< polls which blocked in the kernel
+	struct t_ael_hst   bsy;     ///< busy time of iterations
+	struct t_ael_hst   hdl;     ///< duration of handle callbacks
+	struct t_ael_hst   tsk;     ///< duration of task callbacks
+	struct t_ael_hst   lag;     ///< lateness of tasks
+};
+
+// definition for thread pool; defined in t_ael_thp.c to keep <pthread.h>
+// and its feature test macros out of this header
+struct t_ael_thp;
+
+// definition for a job offloaded to the thread pool
+// The job gets queued by the loop, executed by a pool thread and posted back
+// to the loop via the post queue, hence the message must be the first member.
+// msg.fnc references {handler, arguments of operation …} which anchors the
+// buffers the thread works on until the job completed.
+struct t_ael_job {
+	struct t_ael_msg   msg;     ///< posted to the loop when done
+	struct t_ael_job  *nxt;     ///< next job in the pools queue
+	struct t_ael      *ael;     ///< loop which counts the job as pending
+	int                op;      ///< operation
+	int                fd;      ///< descriptor to operate on
+	char              *dat;     ///< data to operate on
+	size_t             len;     ///< length of data
+	lua_Integer        off;     ///< file offset; -1 for current position
+	void              *ctx;     ///< context of operation, eg. copy of struct
+	                            ///< t_enc_crc allocated behind the job
+	lua_Integer        res;     ///< result of operation
+	int                err;     ///< errno after operation
+};
+
+// phases of a loop iteration which can have hooks
+// Hooks are kept in arrays (uservalue T_AEL_HKSIDX of the loop, one per
+// phase), deferred functions in a table used as queue (uservalue
+// T_AEL_DFRIDX).  Both hold functions or {fnc, arg, …} tables.
+enum t_ael_phs {
+	T_AEL_PHS_PREPARE = 0,      ///< before polling
+	T_AEL_PHS_CHECK,            ///< after handlers and tasks ran
+	T_AEL_PHS_IDLE,             ///< each iteration; makes poll not block
+	T_AEL_PHS_MAX,
 };
 
 // t_ael general implementation; API specifics live behind the *state pointer
 #define T_AEL_STEIDX   1       ///< PLATFORM SPECIFIC STATE INDEX
 #define T_AEL_DSCIDX   2       ///< DESCRIPTOR TABLE INDEX
-#define T_AEL_TSKIDX   3       ///< TASK LINKED LIST HEAD INDEX
+#define T_AEL_TSKIDX   3       ///< TASK HEAP INDEX
+#define T_AEL_PSTIDX   4       ///< POST QUEUE INDEX
+#define T_AEL_SIGIDX   5       ///< SIGNAL STATE INDEX
+#define T_AEL_STSIDX   6       ///< STATISTICS INDEX
+#define T_AEL_HKSIDX   7       ///< PHASE HOOKS INDEX
+#define T_AEL_DFRIDX   8       ///< DEFERRED FUNCTIONS INDEX
+#define T_AEL_THPIDX   9       ///< THREAD POOL INDEX
+#define T_AEL_HDSIDX  10       ///< DESCRIPTOR HANDLER TABLE INDEX
 #define T_AEL_NOTIMEOUT   -1   ///< IF NO TIMER IS IN LIST
 struct t_ael {
 	int                run;      ///< boolean indicator to start/stop the loop
 	int                fdCount;  ///< how many descriptor observed
-	// for each call of poll it is necessary to reset the next time out
-	// it is expensive to get the linked head, extract the time and pop it
-	// keep a reference to the heads timeout value
-	lua_Integer        tout;     ///< timeout of taskHead
+	int                hires;    ///< boolean; poll with sub-millisecond timeout
+	int                stats;    ///< boolean; collect statistics
+	int                budget;   ///< events dispatched per iteration; 0 unlimited
+	int                budgetTime; ///< us spent dispatching per iteration; 0 unlimited
+	int                budgetHits; ///< how often the budget cut a batch short
+	int                carried;  ///< events carried over into the next iteration
+	int                spin;     ///< us to busy poll before blocking; 0 never
+	int                poolSize; ///< number of threads the pool starts with
+	int                jobs;     ///< offloaded jobs not completed yet
+	int                impl;     ///< index in p_ael_impl_lst of the backend
+	                             ///< in use; -1 until the state got created
+	size_t             tskCount; ///< how many tasks are in the heap
+	lua_Integer        tskSeq;   ///< sequence counter for task insertion
+	int                hks[ T_AEL_PHS_MAX ]; ///< number of hooks per phase
+	int                hksCur[ T_AEL_PHS_MAX ]; ///< slot of running hook; 0 if idle
+	size_t             dfrHd;    ///< queue slot of last executed deferred function
+	size_t             dfrTl;    ///< queue slot of last deferred function
+	// for each call of poll it is necessary to calculate the next time out
+	// it is expensive to get the heap head, extract the time and pop it
+	// keep a copy of the heads deadline
+	lua_Integer        tout;     ///< deadline of heap head; T_AEL_NOTIMEOUT if empty
+	struct t_ael_pst  *pst;      ///< post queue; NULL until first used
+	struct t_ael_sig  *sig;      ///< signal state; NULL until first used
+	struct t_ael_sts  *sts;      ///< statistics; NULL unless enabled
+	struct t_ael_thp  *thp;      ///< thread pool; NULL until first used
+};
+
+// definition for worker processes; each runs its own loop
+struct t_ael_wrk {
+	int                cnt;      ///< number of workers
+	int                run;      ///< number of workers not joined yet
+	pid_t              own;      ///< process which forked the workers
+	pid_t              pid[];    ///< process ids; 0 if not running
+};
+
+// definition for a child process spawned by the loop
+// The pidfd is observed like a handle; once readable the child gets reaped.
+// The handler, or the coroutine waiting in process:wait(), and the sockets
+// connected to the standard descriptors are kept as uservalues.
+#define T_AEL_PRC_AELIDX   1   ///< LOOP INDEX
+#define T_AEL_PRC_FNCIDX   2   ///< HANDLER INDEX; fnc/tbl or T.Loop.Coroutine
+#define T_AEL_PRC_STDIDX   3   ///< STDIN INDEX; STDOUT and STDERR follow
+struct t_ael_prc {
+	pid_t              pid;      ///< process id
+	int                pfd;      ///< pidfd; -1 once reaped
+	int                code;     ///< exit code
+	int                sig;      ///< signal which terminated the process; 0 if none
+};
+
+// Loop option handling; each option maps to an int member of struct t_ael
+enum t_ael_optionType {
+	T_AEL_OTP_BOOL,
+	T_AEL_OTP_INT,
+};
+
+struct t_ael_option
+{
+	const char *const             name;
+	const size_t                  offset;   ///< offsetof() member in t_ael
+	const enum t_ael_optionType   type;
+	const int                     get;
+	const int                     set;
 };
 
 // t_ael_l.c
 struct t_ael     *t_ael_check_ud   ( lua_State *L, int pos, int check );
-struct t_ael     *t_ael_create_ud  ( lua_State *L );
+struct t_ael     *t_ael_create_ud  ( lua_State *L, int sz, int impl );
 void              t_ael_doFunction( lua_State *L, int exc );
+lua_Integer       t_ael_now       ( void );
+lua_Integer       t_ael_tons      ( lua_State *L, int pos );
+int               t_ael_budgetSpent( struct t_ael *ael, int c, lua_Integer start, int left );
+int               t_ael_getHandle ( lua_State *L, int pos, int check );
 
 // t_ael_dnd.c
 struct t_ael_dnd *t_ael_dnd_create_ud( lua_State *L );
 struct t_ael_dnd *t_ael_dnd_check_ud ( lua_State *L, int pos, int check );
-void              t_ael_dnd_execute( lua_State *L, struct t_ael_dnd *dnd, enum t_ael_msk msk );
+void              t_ael_dnd_execute( lua_State *L, struct t_ael *ael, int hdspos, struct t_ael_dnd *dnd, enum t_ael_msk msk );
+void              t_ael_dnd_setFunction( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int d, int n );
+struct t_ael_dnd *t_ael_dnd_add    ( lua_State *L, int aelpos, int hdlpos, int fd, enum t_ael_msk msk, int n );
+int               t_ael_dnd_remove ( lua_State *L, int aelpos, int fd, enum t_ael_msk msk );
+struct t_ael_dnd *t_ael_dnd_addInternal( lua_State *L, int aelpos, int fd, lua_CFunction fnc );
 int               luaopen_t_ael_dnd  ( lua_State *L );
 
 // t_ael_tsk.c
-struct t_ael_tsk *t_ael_tsk_create_ud( lua_State *L, lua_Integer ms );
+struct t_ael_tsk *t_ael_tsk_create_ud( lua_State *L, lua_Integer ns );
 struct t_ael_tsk *t_ael_tsk_check_ud( lua_State *L, int pos, int check );
 void              t_ael_tsk_insert( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tIns );
-void              t_ael_tsk_remove( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tCnd );
-void              t_ael_tsk_process( lua_State *L, struct t_ael *ael, lua_Integer et );
+int               t_ael_tsk_remove( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tCnd );
+void              t_ael_tsk_touch ( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tsk, lua_Integer ns );
+void              t_ael_tsk_process( lua_State *L, struct t_ael *ael, lua_Integer now );
+void              t_ael_tsk_clear  ( lua_State *L, struct t_ael *ael, int aelpos );
 int               luaopen_t_ael_tsk  ( lua_State *L );
 
+// t_ael_pst.c
+struct t_ael_pst *t_ael_pst_get    ( lua_State *L, struct t_ael *ael, int aelpos );
+struct t_ael_pst *t_ael_pst_check_ud( lua_State *L, int pos, int check );
+void              t_ael_pst_push   ( struct t_ael_pst *pst, struct t_ael_msg *msg );
+void              t_ael_pst_post   ( lua_State *L, struct t_ael_pst *pst );
+void              t_ael_pst_clear  ( lua_State *L, struct t_ael_pst *pst );
+int               luaopen_t_ael_pst  ( lua_State *L );
+
+// t_ael_sig.c
+struct t_ael_sig *t_ael_sig_get    ( lua_State *L, struct t_ael *ael, int aelpos );
+struct t_ael_sig *t_ael_sig_check_ud( lua_State *L, int pos, int check );
+void              t_ael_sig_add    ( lua_State *L, struct t_ael_sig *sgl, int aelpos, int sig );
+int               t_ael_sig_remove ( lua_State *L, struct t_ael_sig *sgl, int aelpos, int sig );
+void              t_ael_sig_clear  ( lua_State *L, struct t_ael_sig *sgl, int aelpos );
+int               luaopen_t_ael_sig  ( lua_State *L );
+
+// t_ael_crt.c
+lua_State        *t_ael_crt_spawn  ( lua_State *L, int aelpos, int n );
+struct t_ael_crt *t_ael_crt_check_ud( lua_State *L, int pos, int check );
+void              t_ael_crt_resume ( lua_State *L, int n );
+int               luaopen_t_ael_crt  ( lua_State *L );
+
+// t_ael_phs.c
+void              t_ael_phs_add    ( lua_State *L, struct t_ael *ael, int aelpos, enum t_ael_phs phs );
+int               t_ael_phs_remove ( lua_State *L, struct t_ael *ael, int aelpos, enum t_ael_phs phs, int fncpos );
+void              t_ael_phs_run    ( lua_State *L, struct t_ael *ael, int aelpos, enum t_ael_phs phs );
+void              t_ael_phs_defer  ( lua_State *L, struct t_ael *ael, int aelpos );
+void              t_ael_phs_drain  ( lua_State *L, struct t_ael *ael, int aelpos );
+void              t_ael_phs_clear  ( lua_State *L, struct t_ael *ael, int aelpos );
+
+// t_ael_sts.c
+struct t_ael_sts *t_ael_sts_get    ( lua_State *L, int aelpos );
+struct t_ael_sts *t_ael_sts_check_ud( lua_State *L, int pos, int check );
+void              t_ael_sts_record ( struct t_ael_hst *hst, lua_Integer ns );
+void              t_ael_sts_reset  ( struct t_ael_sts *sts );
+void              t_ael_sts_push   ( lua_State *L, struct t_ael_sts *sts );
+int               luaopen_t_ael_sts  ( lua_State *L );
+
+// t_ael_thp.c
+struct t_ael_thp *t_ael_thp_get    ( lua_State *L, struct t_ael *ael, int aelpos );
+struct t_ael_thp *t_ael_thp_check_ud( lua_State *L, int pos, int check );
+int               t_ael_thp_offload( lua_State *L, struct t_ael *ael );
+int               luaopen_t_ael_thp  ( lua_State *L );
+
+// t_ael_prc.c
+struct t_ael_prc *t_ael_prc_check_ud( lua_State *L, int pos, int check );
+int               t_ael_prc_spawn  ( lua_State *L, int aelpos, int optpos );
+int               luaopen_t_ael_prc  ( lua_State *L );
+
+// t_ael_wrk.c
+struct t_ael_wrk *t_ael_wrk_create_ud( lua_State *L, int n );
+struct t_ael_wrk *t_ael_wrk_check_ud( lua_State *L, int pos, int check );
+int               luaopen_t_ael_wrk  ( lua_State *L );
+
 // p_ael_(impl).c   (Implementation specific functions) INTERFACE
-void p_ael_create_ud_impl   ( lua_State *L );
+// p_ael_impl_lst names the backends the unit can run; NULL terminated.
+extern const char *const p_ael_impl_lst[ ];
+void p_ael_create_ud_impl   ( lua_State *L, struct t_ael *ael, int sz );
 void p_ael_free_impl        ( lua_State *L, int aelpos );
 int  p_ael_addhandle_impl   ( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int fd, enum t_ael_msk msk );
 int  p_ael_removehandle_impl( lua_State *L, int aelpos, struct t_ael_dnd *dnd, int fd, enum t_ael_msk msk );
-int  p_ael_poll_impl        ( lua_State *L, int timeout, int aelpos );
+int  p_ael_poll_impl        ( lua_State *L, lua_Integer timeout, int aelpos );
 
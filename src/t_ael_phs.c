@@ -0,0 +1,193 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_phs.c
+ * \brief     Loop phases for T.Loop; prepare, check and idle hooks and
+ *            deferred functions
+ * \detail    Each loop iteration runs the idle and prepare hooks, polls and
+ *            dispatches the events, executes due tasks and finally runs the
+ *            check hooks.  Functions deferred by a handler run right after
+ *            the batch of handlers it belongs to.  Hooks are kept in one
+ *            array per phase, deferred functions in a table used as queue.
+ *            The loop keeps a count of hooks per phase and the bounds of the
+ *            queue, so phases without hooks don't touch any Lua table.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include "t_ael_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+
+/**--------------------------------------------------------------------------
+ * Add a hook to a phase.  Hooks run in the order they were added.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   phs      enum t_ael_phs; phase.
+ * \lparam  fnc      function or {fnc, arg, …} table; popped.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_phs_add( lua_State *L, struct t_ael *ael, int aelpos, enum t_ael_phs phs )
+{
+	aelpos = lua_absindex( L, aelpos );
+	lua_getiuservalue( L, aelpos, T_AEL_HKSIDX );       //S: … fnc hks
+	lua_rawgeti( L, -1, phs+1 );                        //S: … fnc hks hps
+	lua_rotate( L, -3, -1 );                            //S: … hks hps fnc
+	lua_rawseti( L, -2, ++(ael->hks[ phs ]) );
+	lua_pop( L, 2 );                                    //S: …
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove the first hook of a phase which executes function fnc.
+ * If the phase is running and the hook sits at or before the running one,
+ * the cursor of the run moves back with the closed gap.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   phs      enum t_ael_phs; phase.
+ * \param   fncpos   int; position of function on the stack.
+ * \return  int      boolean; was a hook removed.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_phs_remove( lua_State *L, struct t_ael *ael, int aelpos, enum t_ael_phs phs, int fncpos )
+{
+	int i, k, fnd = 0, n = ael->hks[ phs ];
+
+	aelpos = lua_absindex( L, aelpos );
+	fncpos = lua_absindex( L, fncpos );
+	lua_getiuservalue( L, aelpos, T_AEL_HKSIDX );       //S: … hks
+	lua_rawgeti( L, -1, phs+1 );                        //S: … hks hps
+	for (i=1; i<=n && ! fnd; i++)
+	{
+		if (LUA_TTABLE == lua_rawgeti( L, -1, i ))       //S: … hks hps fnc/tbl
+		{
+			lua_rawgeti( L, -1, 1 );                      //S: … hks hps tbl fnc
+			lua_remove( L, -2 );
+		}
+		fnd = lua_rawequal( L, -1, fncpos );
+		lua_pop( L, 1 );                                 //S: … hks hps
+	}
+	if (fnd)
+	{
+		k = i - 1;                                       // slot of removed hook
+		for (i=k; i<n; i++)     // close the gap
+		{
+			lua_rawgeti( L, -1, i+1 );
+			lua_rawseti( L, -2, i );
+		}
+		lua_pushnil( L );
+		lua_rawseti( L, -2, n );
+		ael->hks[ phs ]--;
+		if (k <= ael->hksCur[ phs ])
+			ael->hksCur[ phs ]--;
+	}
+	lua_pop( L, 2 );                                    //S: …
+	return fnd;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Run all hooks of a phase.
+ * Hooks added while the phase runs get executed in the same run, hooks
+ * removing themselves or others don't make others get skipped since
+ * t_ael_phs_remove() adjusts the cursor of the run.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   phs      enum t_ael_phs; phase.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_phs_run( lua_State *L, struct t_ael *ael, int aelpos, enum t_ael_phs phs )
+{
+	aelpos = lua_absindex( L, aelpos );
+	lua_getiuservalue( L, aelpos, T_AEL_HKSIDX );       //S: … hks
+	lua_rawgeti( L, -1, phs+1 );                        //S: … hks hps
+	lua_remove( L, -2 );                                //S: … hps
+	ael->hksCur[ phs ] = 0;
+	while (++(ael->hksCur[ phs ]) <= ael->hks[ phs ])
+	{
+		lua_rawgeti( L, -1, ael->hksCur[ phs ] );        //S: … hps fnc/tbl
+		t_ael_doFunction( L, 0 );                        //S: … hps
+	}
+	ael->hksCur[ phs ] = 0;
+	lua_pop( L, 1 );                                    //S: …
+}
+
+
+/**--------------------------------------------------------------------------
+ * Defer a function until the current batch of handlers is done.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \lparam  fnc      function or {fnc, arg, …} table; popped.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_phs_defer( lua_State *L, struct t_ael *ael, int aelpos )
+{
+	lua_getiuservalue( L, aelpos, T_AEL_DFRIDX );       //S: … fnc dfr
+	lua_insert( L, -2 );                                //S: … dfr fnc
+	lua_rawseti( L, -2, ++(ael->dfrTl) );
+	lua_pop( L, 1 );                                    //S: …
+}
+
+
+/**--------------------------------------------------------------------------
+ * Execute deferred functions until the queue is empty.
+ * Functions deferred meanwhile are executed as well.  Each function is
+ * taken off the queue before it runs, so an error leaves the queue intact.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_phs_drain( lua_State *L, struct t_ael *ael, int aelpos )
+{
+	lua_getiuservalue( L, aelpos, T_AEL_DFRIDX );       //S: … dfr
+	while (ael->dfrHd < ael->dfrTl)
+	{
+		lua_rawgeti( L, -1, ++(ael->dfrHd) );            //S: … dfr fnc/tbl
+		lua_pushnil( L );
+		lua_rawseti( L, -3, ael->dfrHd );
+		if (ael->dfrHd == ael->dfrTl)                    // empty; start over
+			ael->dfrHd = ael->dfrTl = 0;
+		t_ael_doFunction( L, 0 );                        //S: … dfr
+	}
+	lua_pop( L, 1 );                                    //S: …
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove all hooks and deferred functions.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_phs_clear( lua_State *L, struct t_ael *ael, int aelpos )
+{
+	int p;
+
+	aelpos = lua_absindex( L, aelpos );
+	lua_createtable( L, T_AEL_PHS_MAX, 0 );             //S: … hks
+	for (p=0; p<T_AEL_PHS_MAX; p++)
+	{
+		lua_newtable( L );
+		lua_rawseti( L, -2, p+1 );
+		ael->hks[ p ]    = 0;
+		ael->hksCur[ p ] = 0;
+	}
+	lua_setiuservalue( L, aelpos, T_AEL_HKSIDX );       //S: …
+	lua_newtable( L );
+	lua_setiuservalue( L, aelpos, T_AEL_DFRIDX );
+	ael->dfrHd = ael->dfrTl = 0;
+}
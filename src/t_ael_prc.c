@@ -0,0 +1,497 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_prc.c
+ * \brief     Child processes for T.Loop; spawned with posix_spawn()
+ * \detail    loop:spawnProcess() starts a program without forking the Lua
+ *            state.  Its stdin, stdout and stderr can be connected to
+ *            T.Net.Socket instances, one end of a non-blocking socketpair each,
+ *            which get observed like any other socket.  The exit of the child
+ *            is observed via a pidfd, so it is a regular loop event which
+ *            reaps the child and passes the exit status to a handler or a
+ *            waiting coroutine.  No SIGCHLD handler is involved and other
+ *            children of the process are left alone.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#define _GNU_SOURCE               // syscall, SOCK_CLOEXEC
+
+#include "t_ael_l.h"
+#include "t_net.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+#include <errno.h>            // errno
+#include <fcntl.h>            // fcntl, O_NONBLOCK
+#include <signal.h>           // kill, sigset_t, SIGTERM
+#include <spawn.h>            // posix_spawnp, posix_spawn_file_actions_*
+#include <unistd.h>           // close, syscall
+#include <sys/socket.h>       // socketpair
+#include <sys/syscall.h>      // SYS_pidfd_open
+#include <sys/wait.h>         // waitid, waitpid
+
+extern char **environ;
+
+// names of the standard descriptors; order of their numbers
+static const char *const t_ael_prc_std[ ] = { "stdin", "stdout", "stderr" };
+
+
+/**--------------------------------------------------------------------------
+ * Open a pidfd for a process.
+ * \param   pid      pid_t; process id.
+ * \return  int      descriptor; -1 on failure with errno set.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_prc_pidfd( pid_t pid )
+{
+#ifdef SYS_pidfd_open
+	return (int) syscall( SYS_pidfd_open, pid, 0 );
+#else
+	(void) pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push a T.Net.Socket for a descriptor.  Same as t_net_sck_create_ud() which
+ * lives in net.so; the metatable gets registered by requiring t.Net.Socket.
+ * \param   L        Lua state.
+ * \param   fd       int; descriptor; -1 for none.
+ * \lreturn ud       T.Net.Socket userdata instance.
+ * \return  struct t_net_sck*; the socket.
+ * --------------------------------------------------------------------------*/
+static struct t_net_sck
+*t_ael_prc_socket( lua_State *L, int fd )
+{
+	struct t_net_sck *sck = (struct t_net_sck *) lua_newuserdata( L, sizeof( struct t_net_sck ) );
+
+	sck->fd = fd;
+	luaL_getmetatable( L, T_NET_SCK_TYPE );
+	lua_setmetatable( L, -2 );
+	return sck;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push the exit status of a reaped process; same values as os.execute().
+ * \param   L        Lua state.
+ * \param  *prc      struct t_ael_prc*; the process.
+ * \lreturn ok       boolean true if it exited with 0; else nil.
+ * \lreturn what     string "exit" or "signal".
+ * \lreturn code     int; exit code or signal number.
+ * \return  int      # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_prc_status( lua_State *L, struct t_ael_prc *prc )
+{
+	if (prc->sig)
+	{
+		lua_pushnil( L );
+		lua_pushstring( L, "signal" );
+		lua_pushinteger( L, prc->sig );
+	}
+	else
+	{
+		if (0 == prc->code)
+			lua_pushboolean( L, 1 );
+		else
+			lua_pushnil( L );
+		lua_pushstring( L, "exit" );
+		lua_pushinteger( L, prc->code );
+	}
+	return 3;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Stop observing the pidfd of a process and close it.
+ * \param   L        Lua state.
+ * \param  *prc      struct t_ael_prc*; the process.
+ * \param   prcpos   int; position of process on the stack.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_prc_unwatch( lua_State *L, struct t_ael_prc *prc, int prcpos )
+{
+	if (-1 == prc->pfd)
+		return;
+	lua_getiuservalue( L, prcpos, T_AEL_PRC_AELIDX );   //S: … ael
+	if (NULL != t_ael_check_ud( L, -1, 0 ))
+		t_ael_dnd_remove( L, -1, prc->pfd, T_AEL_RD );
+	lua_pop( L, 1 );
+	close( prc->pfd );
+	prc->pfd = -1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Reap the process once its pidfd got readable.  This is the read handler
+ * of the pidfd node.  Executes the handler of the process or resumes the
+ * coroutine waiting for it with the exit status.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Process userdata instance.                   // 1
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_prc_exit( lua_State *L )
+{
+	struct t_ael_prc *prc = t_ael_prc_check_ud( L, 1, 1 );
+	siginfo_t         info;
+	lua_State        *co;
+	int               n;
+
+	info.si_pid = 0;
+	if (0 == waitid( P_PID, prc->pid, &info, WEXITED | WNOHANG ))
+	{
+		if (0 == info.si_pid)   // spurious; not exited yet
+			return 0;
+		prc->code = (CLD_EXITED == info.si_code) ? info.si_status : 0;
+		prc->sig  = (CLD_EXITED == info.si_code) ? 0 : info.si_status;
+	}
+	else                       // reaped by someone else; status is lost
+	{
+		prc->code = -1;
+		prc->sig  = 0;
+	}
+	t_ael_prc_unwatch( L, prc, 1 );
+
+	lua_getiuservalue( L, 1, T_AEL_PRC_FNCIDX );        //S: prc fnc/tbl/crt
+	lua_pushnil( L );
+	lua_setiuservalue( L, 1, T_AEL_PRC_FNCIDX );
+	if (NULL != t_ael_crt_check_ud( L, -1, 0 ))
+	{
+		lua_getiuservalue( L, -1, T_AEL_CRT_THDIDX );   //S: prc crt co
+		co = lua_tothread( L, -1 );
+		lua_pop( L, 1 );
+		n  = t_ael_prc_status( L, prc );                //S: prc crt ok what code
+		lua_xmove( L, co, n );                          //S: prc crt
+		t_ael_crt_resume( L, n );                       //S: prc
+		return 0;
+	}
+	if (lua_isnil( L, -1 ))
+		return 0;
+	n = lua_gettop( L );
+	t_ael_doFunction( L, -1 );                          //S: prc fnc arg …
+	n = lua_gettop( L ) - n + t_ael_prc_status( L, prc );
+	lua_call( L, n, 0 );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Spawn a process observed by the loop.
+ * The array part of the options table is the command line, the program gets
+ * looked up in PATH.  opt.stdin, opt.stdout and opt.stderr can be true to
+ * get a socketpair connected to the standard descriptor, a Lua file or
+ * T.Net.Socket to pass its descriptor or nil to inherit the one of the
+ * current process.  The process keeps the loop running until it exited.
+ * \param   L        Lua state.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   optpos   int; position of options table on the stack.
+ * \lparam  fnc      function, {fnc, arg, …} table, T.Loop.Coroutine or nil;
+ *                   handler executed with the exit status; popped.
+ * \lreturn ud       T.Loop.Process userdata instance.
+ * \lreturn sck      T.Net.Socket or nil; one per standard descriptor.
+ * \return  int      # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_prc_spawn( lua_State *L, int aelpos, int optpos )
+{
+	struct t_ael_prc           *prc;
+	struct t_net_sck           *sck[ 3 ] = { NULL, NULL, NULL };
+	int                         cfd[ 3 ] = { -1, -1, -1 };
+	int                         pair[ 2 ];
+	posix_spawn_file_actions_t  act;
+	posix_spawnattr_t           atr;
+	sigset_t                    set;
+	const char                **argv;
+	int                         argc, i, err = 0;
+
+	aelpos = lua_absindex( L, aelpos );
+	optpos = lua_absindex( L, optpos );
+	luaL_checktype( L, optpos, LUA_TTABLE );
+	argc   = (int) lua_rawlen( L, optpos );
+	luaL_argcheck( L, argc > 0, optpos, "command line expected" );
+	argv   = (const char **) lua_newuserdatauv( L, (argc+1) * sizeof( char * ), 0 );
+	for (i=0; i<argc; i++)                              // strings stay in opt
+	{
+		lua_rawgeti( L, optpos, i+1 );
+		luaL_argcheck( L, LUA_TSTRING == lua_type( L, -1 ), optpos, "command line must be strings" );
+		argv[ i ] = lua_tostring( L, -1 );
+		lua_pop( L, 1 );
+	}
+	argv[ argc ] = NULL;                                //S: … fnc argv
+
+	prc = (struct t_ael_prc *) lua_newuserdatauv( L, sizeof( struct t_ael_prc ), 5 );
+	prc->pid  = 0;
+	prc->pfd  = -1;
+	prc->code = 0;
+	prc->sig  = 0;
+	luaL_getmetatable( L, T_AEL_PRC_TYPE );
+	lua_setmetatable( L, -2 );                          //S: … fnc argv prc
+	lua_pushvalue( L, aelpos );
+	lua_setiuservalue( L, -2, T_AEL_PRC_AELIDX );
+	lua_rotate( L, -3, -1 );                            //S: … argv prc fnc
+	lua_setiuservalue( L, -2, T_AEL_PRC_FNCIDX );       //S: … argv prc
+
+	// check the standard descriptors and create the sockets before any
+	// descriptor gets opened; nothing below raises an error until spawned
+	for (i=0; i<3; i++)
+	{
+		lua_getfield( L, optpos, t_ael_prc_std[ i ] );   //S: … argv prc std
+		if (LUA_TBOOLEAN == lua_type( L, -1 ) && lua_toboolean( L, -1 ))
+		{
+			if (LUA_TNIL == luaL_getmetatable( L, T_NET_SCK_TYPE ))
+				return luaL_error( L, "require '"T_NET_SCK_TYPE"' to pipe %s", t_ael_prc_std[ i ] );
+			lua_pop( L, 2 );
+			sck[ i ] = t_ael_prc_socket( L, -1 );         //S: … argv prc sck
+		}
+		else
+		{
+			if (! lua_isnil( L, -1 ) && LUA_TBOOLEAN != lua_type( L, -1 ))
+				cfd[ i ] = t_ael_getHandle( L, -1, 1 );
+			lua_pop( L, 1 );
+			lua_pushnil( L );                             //S: … argv prc nil
+		}
+		lua_setiuservalue( L, -2, T_AEL_PRC_STDIDX + i );
+	}
+
+	posix_spawn_file_actions_init( &act );
+	for (i=0; i<3 && ! err; i++)
+	{
+		if (NULL != sck[ i ])
+		{
+			if (0 != socketpair( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair ))
+				err = errno;
+			else
+			{
+				sck[ i ]->fd = pair[ 0 ];
+				cfd[ i ]     = pair[ 1 ];
+				fcntl( pair[ 0 ], F_SETFL, fcntl( pair[ 0 ], F_GETFL ) | O_NONBLOCK );
+			}
+		}
+		if (! err && -1 != cfd[ i ])
+			err = posix_spawn_file_actions_adddup2( &act, cfd[ i ], i );
+	}
+
+	// the loop blocks signals it observes; the child starts with defaults
+	posix_spawnattr_init( &atr );
+	posix_spawnattr_setflags( &atr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF );
+	sigemptyset( &set );
+	posix_spawnattr_setsigmask( &atr, &set );
+	sigfillset( &set );
+	sigdelset( &set, SIGKILL );
+	sigdelset( &set, SIGSTOP );
+	posix_spawnattr_setsigdefault( &atr, &set );
+
+	if (! err)
+		err = posix_spawnp( &prc->pid, argv[ 0 ], &act, &atr, (char *const *) argv, environ );
+	posix_spawnattr_destroy( &atr );
+	posix_spawn_file_actions_destroy( &act );
+	for (i=0; i<3; i++)                                 // child ends
+		if (NULL != sck[ i ] && -1 != cfd[ i ])
+			close( cfd[ i ] );
+	if (! err && -1 == (prc->pfd = t_ael_prc_pidfd( prc->pid )))
+	{
+		err = errno;
+		kill( prc->pid, SIGKILL );
+		while (-1 == waitpid( prc->pid, NULL, 0 ) && EINTR == errno);
+	}
+	if (err)
+	{
+		for (i=0; i<3; i++)
+			if (NULL != sck[ i ] && -1 != sck[ i ]->fd)
+			{
+				close( sck[ i ]->fd );
+				sck[ i ]->fd = -1;
+			}
+		prc->pid = 0;
+		errno    = err;
+		return t_push_error( L, 0, 0, "couldn't spawn `%s`", argv[ 0 ] );
+	}
+
+	// observe the pidfd; counts as handle and keeps the loop running
+	lua_createtable( L, 2, 0 );                         //S: … argv prc tbl
+	lua_pushcfunction( L, lt_ael_prc_exit );
+	lua_rawseti( L, -2, 1 );
+	lua_pushvalue( L, -2 );
+	lua_rawseti( L, -2, 2 );
+	t_ael_dnd_add( L, aelpos, -2, prc->pfd, T_AEL_RD, 1 ); //S: … argv prc
+	for (i=0; i<3; i++)
+		lua_getiuservalue( L, -1 - i, T_AEL_PRC_STDIDX + i );
+	return 4;                                           //S: … prc in out err
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check a value on the stack for being a struct t_ael_prc
+ * \param   L      Lua state.
+ * \param   int    position on the stack
+ * \param   int    check(boolean): if true error out on fail
+ * \return  struct t_ael_prc*  pointer to userdata on stack
+ * --------------------------------------------------------------------------*/
+struct t_ael_prc
+*t_ael_prc_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_AEL_PRC_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_AEL_PRC_TYPE );
+	return (NULL==ud) ? NULL : (struct t_ael_prc *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Send a signal to the process.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Process userdata instance.                    // 1
+ * \lparam  int  signal number; default SIGTERM.                      // 2
+ * \lreturn bool true if the signal was sent; false if already reaped.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_prc_kill( lua_State *L )
+{
+	struct t_ael_prc *prc = t_ael_prc_check_ud( L, 1, 1 );
+	int               sig = luaL_optinteger( L, 2, SIGTERM );
+
+	if (-1 == prc->pfd)    // reaped; the pid might belong to someone else
+	{
+		lua_pushboolean( L, 0 );
+		return 1;
+	}
+	if (-1 == kill( prc->pid, sig ))
+		return t_push_error( L, 0, 0, "couldn't signal process %d", prc->pid );
+	lua_pushboolean( L, 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Wait for the process to exit.
+ * Inside a coroutine run by T.Loop:spawn() the coroutine gets suspended until
+ * the process exited.  Replaces the handler passed to spawnProcess().
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Process userdata instance.                    // 1
+ * \lreturn …    ok, what, code; same as os.execute().
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_prc_wait( lua_State *L )
+{
+	struct t_ael_prc *prc = t_ael_prc_check_ud( L, 1, 1 );
+
+	if (-1 == prc->pfd)
+		return t_ael_prc_status( L, prc );
+	if (! t_isAwaitable( L ))
+		return luaL_error( L, "can't wait for process outside of "T_AEL_TYPE":spawn()" );
+	lua_getfield( L, LUA_REGISTRYINDEX, T_AWT_KEY );
+	lua_pushthread( L );
+	lua_rawget( L, -2 );                               //S: prc awt crt
+	lua_pushvalue( L, -1 );
+	lua_setiuservalue( L, 1, T_AEL_PRC_FNCIDX );
+	// suspend; the loop won't resume a coroutine which yields itself
+	return lua_yield( L, 1 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the process id.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Process userdata instance.                    // 1
+ * \lreturn int  process id.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_prc_pid( lua_State *L )
+{
+	struct t_ael_prc *prc = t_ael_prc_check_ud( L, 1, 1 );
+	lua_pushinteger( L, prc->pid );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the exit status of the process without waiting.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Process userdata instance.                    // 1
+ * \lreturn …    ok, what, code; nothing if the process is still running.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_prc_status( lua_State *L )
+{
+	struct t_ael_prc *prc = t_ael_prc_check_ud( L, 1, 1 );
+	return (-1 == prc->pfd) ? t_ael_prc_status( L, prc ) : 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Garbage Collector.  Close the pidfd of a process which never got reaped;
+ * the process itself is left running.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Process userdata instance.                    // 1
+ * \return  int  # of values pushed onto the stack.
+ * -------------------------------------------------------------------------*/
+static int
+lt_ael_prc__gc( lua_State *L )
+{
+	struct t_ael_prc *prc = t_ael_prc_check_ud( L, 1, 1 );
+
+	if (-1 != prc->pfd)
+	{
+		close( prc->pfd );
+		prc->pfd = -1;
+	}
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Prints the Process.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop.Process userdata instance.                    // 1
+ * \lreturn string formatted string representing T.Loop.Process.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_prc__tostring( lua_State *L )
+{
+	struct t_ael_prc *prc = t_ael_prc_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_AEL_PRC_TYPE"{%d}: %p", prc->pid, prc );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_ael_prc_m [] = {
+	// metamethods
+	  { "__gc",          lt_ael_prc__gc          }
+	, { "__tostring",    lt_ael_prc__tostring    }
+	// instance methods
+	, { "kill",          lt_ael_prc_kill         }
+	, { "wait",          lt_ael_prc_wait         }
+	, { "pid",           lt_ael_prc_pid          }
+	, { "status",        lt_ael_prc_status       }
+	, { NULL,            NULL                    }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Makes the Loop.Process metatable known; there is no class to push.
+ * \param   L     The lua state.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_ael_prc( lua_State *L )
+{
+	luaL_newmetatable( L, T_AEL_PRC_TYPE );
+	luaL_setfuncs( L, t_ael_prc_m, 0 );
+	lua_setfield( L, -1, "__index" );    // pops the metatable
+	return 0;
+}
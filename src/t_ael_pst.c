@@ -0,0 +1,307 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_pst.c
+ * \brief     Post queue; wakes up T.Loop and hands messages to it
+ * \detail    Messages get pushed onto a lock free multi producer single
+ *            consumer stack from any thread.  Only the push which finds the
+ *            stack empty writes to the eventfd, so a single wakeup can carry
+ *            thousands of messages.  The loop takes the whole stack in one
+ *            atomic exchange and executes the batch in posting order.  The
+ *            eventfd is observed like any other descriptor of the loop.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "t_ael_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+#include <errno.h>            // errno, EAGAIN
+#include <stdint.h>           // uint64_t
+#include <stdlib.h>           // malloc, free
+#include <unistd.h>           // read, write, close
+#include <sys/eventfd.h>
+
+
+/**--------------------------------------------------------------------------
+ * Post a message to the loop.  Thread safe; doesn't touch any Lua state.
+ * \param  *pst      struct t_ael_pst*; post queue of the loop.
+ * \param  *msg      struct t_ael_msg*; message; owned by queue until executed.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_pst_push( struct t_ael_pst *pst, struct t_ael_msg *msg )
+{
+	uint64_t one = 1;
+
+	__atomic_add_fetch( &pst->pnd, 1, __ATOMIC_RELAXED );
+	msg->nxt = __atomic_load_n( &pst->hd, __ATOMIC_RELAXED );
+	while (! __atomic_compare_exchange_n( &pst->hd, &msg->nxt, msg, 1,
+	            __ATOMIC_RELEASE, __ATOMIC_RELAXED ))
+		;
+	if (NULL == msg->nxt)    // stack was empty; consumer might sleep
+		while (write( pst->fd, &one, sizeof( one ) ) < 0 && EINTR == errno)
+			;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Take all posted messages off the stack and return them in posting order.
+ * \param  *pst      struct t_ael_pst*; post queue of the loop.
+ * \return  struct t_ael_msg*; first message of batch; NULL if empty.
+ * --------------------------------------------------------------------------*/
+static struct t_ael_msg
+*t_ael_pst_take( struct t_ael_pst *pst )
+{
+	struct t_ael_msg *msg = __atomic_exchange_n( &pst->hd, NULL, __ATOMIC_ACQUIRE );
+	struct t_ael_msg *fst = NULL;
+	struct t_ael_msg *nxt;
+
+	while (NULL != msg)     // stack is LIFO; reverse it
+	{
+		nxt      = msg->nxt;
+		msg->nxt = fst;
+		fst      = msg;
+		msg      = nxt;
+	}
+	return fst;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Execute posted Lua function and release message.
+ * \param   L        Lua state; NULL to release message without execution.
+ * \param  *msg      struct t_ael_msg*; message.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_pst_call( lua_State *L, struct t_ael_msg *msg )
+{
+	int fnc = msg->fnc;
+
+	free( msg );
+	if (NULL == L)
+		return;
+	lua_rawgeti( L, LUA_REGISTRYINDEX, fnc );       //S: … fnc/tbl
+	luaL_unref( L, LUA_REGISTRYINDEX, fnc );
+	t_ael_doFunction( L, 0 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Post the Lua function or {fnc, arg, …} table on top of the stack.
+ * Must be called from the thread running the loop.
+ * \param   L        Lua state.
+ * \param  *pst      struct t_ael_pst*; post queue of the loop.
+ * \lparam  fnc      function or {fnc, arg, …} table; popped.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_pst_post( lua_State *L, struct t_ael_pst *pst )
+{
+	struct t_ael_msg *msg = (struct t_ael_msg *) malloc( sizeof( struct t_ael_msg ) );
+
+	if (NULL == msg)
+		luaL_error( L, "couldn't allocate message" );
+	msg->exc = t_ael_pst_call;
+	msg->fnc = luaL_ref( L, LUA_REGISTRYINDEX );
+	t_ael_pst_push( pst, msg );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Execute the current batch of posted messages.
+ * \param   L        Lua state.
+ * \lparam  ud       T.Loop.Post userdata instance.                   // 1
+ * \return  int      # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_pst_run( lua_State *L )
+{
+	struct t_ael_pst *pst = (struct t_ael_pst *) lua_touserdata( L, 1 );
+	struct t_ael_msg *msg;
+
+	while (NULL != (msg = pst->cur))
+	{
+		pst->cur = msg->nxt;
+		__atomic_sub_fetch( &pst->pnd, 1, __ATOMIC_RELAXED );
+		msg->exc( L, msg );
+	}
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Drain the eventfd and execute all posted messages.
+ * This is the read handler of the eventfd node.  If a message raises an
+ * error the rest of the batch stays queued.  The eventfd has been reset
+ * already, so it gets signalled again before the error is passed on and the
+ * rest of the batch runs on the next wakeup.
+ * \param   L        Lua state.
+ * \lparam  ud       T.Loop.Post userdata instance.                   // 1
+ * \return  int      # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_pst_drain( lua_State *L )
+{
+	struct t_ael_pst *pst = t_ael_pst_check_ud( L, 1, 1 );
+	uint64_t          cnt;
+	uint64_t          one = 1;
+
+	if (NULL == pst->cur)
+	{
+		// reset the eventfd before taking the batch; a concurrent push either
+		// makes it into this batch or writes the eventfd again
+		if (read( pst->fd, &cnt, sizeof( cnt ) ) < 0 && EAGAIN != errno)
+			return t_push_error( L, 1, 1, "couldn't read eventfd" );
+		pst->cur = t_ael_pst_take( pst );
+	}
+	lua_pushcfunction( L, t_ael_pst_run );
+	lua_pushvalue( L, 1 );
+	if (LUA_OK != lua_pcall( L, 1, 0, 0 ))              //S: pst err
+	{
+		if (NULL != pst->cur)
+			while (write( pst->fd, &one, sizeof( one ) ) < 0 && EINTR == errno)
+				;
+		return lua_error( L );
+	}
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Release all posted messages without executing them.
+ * \param   L        Lua state; NULL if the state is closing.
+ * \param  *pst      struct t_ael_pst*; post queue of the loop.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_pst_clear( lua_State *L, struct t_ael_pst *pst )
+{
+	struct t_ael_msg *msg;
+
+	if (NULL == pst->cur)
+		pst->cur = t_ael_pst_take( pst );
+	while (NULL != (msg = pst->cur))
+	{
+		pst->cur = msg->nxt;
+		__atomic_sub_fetch( &pst->pnd, 1, __ATOMIC_RELAXED );
+		if (NULL != L)                                   // all messages carry fnc
+			luaL_unref( L, LUA_REGISTRYINDEX, msg->fnc );
+		msg->exc( NULL, msg );
+	}
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the post queue of the loop; create and observe it on first use.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \return  struct t_ael_pst*; post queue of the loop.
+ * --------------------------------------------------------------------------*/
+struct t_ael_pst
+*t_ael_pst_get( lua_State *L, struct t_ael *ael, int aelpos )
+{
+	struct t_ael_pst *pst;
+
+	if (NULL != ael->pst)
+		return ael->pst;
+	aelpos = lua_absindex( L, aelpos );
+	pst    = (struct t_ael_pst *) lua_newuserdatauv( L, sizeof( struct t_ael_pst ), 0 );
+	pst->hd  = NULL;
+	pst->cur = NULL;
+	pst->pnd = 0;
+	pst->fd  = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	if (-1 == pst->fd)
+		t_push_error( L, 1, 1, "couldn't create eventfd for loop" );
+	luaL_getmetatable( L, T_AEL_PST_TYPE );
+	lua_setmetatable( L, -2 );                          //S: … pst
+	t_ael_dnd_addInternal( L, aelpos, pst->fd, lt_ael_pst_drain );
+	lua_setiuservalue( L, aelpos, T_AEL_PSTIDX );       //S: …
+	ael->pst = pst;
+	return pst;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check a value on the stack for being a struct t_ael_pst
+ * \param   L      Lua state.
+ * \param   int    position on the stack
+ * \param   int    check(boolean): if true error out on fail
+ * \return  struct t_ael_pst*  pointer to userdata on stack
+ * --------------------------------------------------------------------------*/
+struct t_ael_pst
+*t_ael_pst_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_AEL_PST_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_AEL_PST_TYPE );
+	return (NULL==ud) ? NULL : (struct t_ael_pst *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Garbage Collector. Release messages and close eventfd.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Post userdata instance.                   // 1
+ * \return  int  # of values pushed onto the stack.
+ * -------------------------------------------------------------------------*/
+static int
+lt_ael_pst__gc( lua_State *L )
+{
+	struct t_ael_pst *pst = t_ael_pst_check_ud( L, 1, 1 );
+
+	t_ael_pst_clear( NULL, pst );
+	if (-1 != pst->fd)
+		close( pst->fd );
+	pst->fd = -1;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Prints the Post queue.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop.Post userdata instance.                       // 1
+ * \lreturn string formatted string representing T.Loop.Post.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_pst__tostring( lua_State *L )
+{
+	struct t_ael_pst *pst = t_ael_pst_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_AEL_PST_TYPE"{%d}: %p",
+	   (int) __atomic_load_n( &pst->pnd, __ATOMIC_RELAXED ), pst );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_ael_pst_m [] = {
+	// metamethods
+	  { "__gc",          lt_ael_pst__gc          }
+	, { "__tostring",    lt_ael_pst__tostring    }
+	, { NULL,            NULL                    }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Makes the Loop.Post metatable known; there is no class to push.
+ * \param   L     The lua state.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_ael_pst( lua_State *L )
+{
+	luaL_newmetatable( L, T_AEL_PST_TYPE );
+	luaL_setfuncs( L, t_ael_pst_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+	return 0;
+}
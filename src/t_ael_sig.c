@@ -0,0 +1,281 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_sig.c
+ * \brief     Signal handling for T.Loop
+ * \detail    Signals observed by the loop get blocked and are delivered via a
+ *            single signalfd instead.  The signalfd is observed like any
+ *            other descriptor of the loop, so signal handlers run as regular
+ *            loop events and can safely call any Lua code.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#define _POSIX_C_SOURCE 200809L   // sigprocmask()
+
+#include "t_ael_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+#include <errno.h>            // errno, EAGAIN
+#include <signal.h>           // sigset_t, sig*set, sigprocmask
+#include <unistd.h>           // read, close
+#include <sys/signalfd.h>
+
+
+struct t_ael_sig {
+	int                fd;      ///< signalfd
+	int                cnt;     ///< number of observed signals
+	sigset_t           msk;     ///< observed signals
+};
+
+
+/**--------------------------------------------------------------------------
+ * Read all pending signals from the signalfd and execute their handlers.
+ * This is the read handler of the signalfd node.
+ * \param   L        Lua state.
+ * \lparam  ud       T.Loop.Signal userdata instance.                 // 1
+ * \return  int      # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_sig_dispatch( lua_State *L )
+{
+	struct t_ael_sig        *sgl = t_ael_sig_check_ud( L, 1, 1 );
+	struct signalfd_siginfo  ssi;
+
+	lua_getiuservalue( L, 1, T_AEL_SIG_FNCIDX );        //S: sgl hds
+	while (sizeof( ssi ) == read( sgl->fd, &ssi, sizeof( ssi ) ))
+	{
+		lua_rawgeti( L, 2, ssi.ssi_signo );              //S: sgl hds fnc/tbl
+		t_ael_doFunction( L, 0 );                        // nil if removed meanwhile
+	}
+	if (EAGAIN != errno)
+		return t_push_error( L, 1, 1, "couldn't read signalfd" );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get signal state of the loop; create and observe the signalfd on first use.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \return  struct t_ael_sig*; signal state of the loop.
+ * --------------------------------------------------------------------------*/
+struct t_ael_sig
+*t_ael_sig_get( lua_State *L, struct t_ael *ael, int aelpos )
+{
+	struct t_ael_sig *sgl;
+
+	if (NULL != ael->sig)
+		return ael->sig;
+	aelpos = lua_absindex( L, aelpos );
+	sgl    = (struct t_ael_sig *) lua_newuserdatauv( L, sizeof( struct t_ael_sig ), 1 );
+	sgl->cnt = 0;
+	sigemptyset( &sgl->msk );
+	sgl->fd  = signalfd( -1, &sgl->msk, SFD_NONBLOCK | SFD_CLOEXEC );
+	if (-1 == sgl->fd)
+		t_push_error( L, 1, 1, "couldn't create signalfd for loop" );
+	luaL_getmetatable( L, T_AEL_SIG_TYPE );
+	lua_setmetatable( L, -2 );                          //S: … sgl
+	lua_newtable( L );                                  //S: … sgl hds
+	lua_setiuservalue( L, -2, T_AEL_SIG_FNCIDX );
+	t_ael_dnd_addInternal( L, aelpos, sgl->fd, lt_ael_sig_dispatch );
+	lua_setiuservalue( L, aelpos, T_AEL_SIGIDX );       //S: …
+	ael->sig = sgl;
+	return sgl;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Observe or stop observing a signal.
+ * Observed signals get blocked so they are only delivered via the signalfd.
+ * \param   L        Lua state.
+ * \param  *sgl      struct t_ael_sig*; signal state of the loop.
+ * \param   sig      int; signal number.
+ * \param   add      int; boolean; observe or stop observing.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_sig_mask( lua_State *L, struct t_ael_sig *sgl, int sig, int add )
+{
+	sigset_t one;
+
+	sigemptyset( &one );
+	sigaddset( &one, sig );
+	if (add)
+		sigaddset( &sgl->msk, sig );
+	else
+		sigdelset( &sgl->msk, sig );
+	if (-1 == sigprocmask( (add) ? SIG_BLOCK : SIG_UNBLOCK, &one, NULL ) ||
+	    -1 == signalfd( sgl->fd, &sgl->msk, 0 ))
+		t_push_error( L, 1, 1, "couldn't update signal mask" );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Set the handler of a signal; replaces a previous handler.
+ * \param   L        Lua state.
+ * \param  *sgl      struct t_ael_sig*; signal state of the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   sig      int; signal number.
+ * \lparam  fnc      function or {fnc, arg, …} table; popped.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_sig_add( lua_State *L, struct t_ael_sig *sgl, int aelpos, int sig )
+{
+	aelpos = lua_absindex( L, aelpos );
+	lua_getiuservalue( L, aelpos, T_AEL_SIGIDX );       //S: … fnc sgl
+	lua_getiuservalue( L, -1, T_AEL_SIG_FNCIDX );       //S: … fnc sgl hds
+	if (LUA_TNIL == lua_rawgeti( L, -1, sig ))          //S: … fnc sgl hds old
+	{
+		t_ael_sig_mask( L, sgl, sig, 1 );
+		sgl->cnt++;
+	}
+	lua_pop( L, 1 );                                    //S: … fnc sgl hds
+	lua_rotate( L, -3, -1 );                            //S: … sgl hds fnc
+	lua_rawseti( L, -2, sig );                          //S: … sgl hds
+	lua_pop( L, 2 );                                    //S: …
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove the handler of a signal and restore its default disposition.
+ * \param   L        Lua state.
+ * \param  *sgl      struct t_ael_sig*; signal state of the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \param   sig      int; signal number.
+ * \return  int      boolean; was the signal observed.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_sig_remove( lua_State *L, struct t_ael_sig *sgl, int aelpos, int sig )
+{
+	int had;
+
+	aelpos = lua_absindex( L, aelpos );
+	lua_getiuservalue( L, aelpos, T_AEL_SIGIDX );       //S: … sgl
+	lua_getiuservalue( L, -1, T_AEL_SIG_FNCIDX );       //S: … sgl hds
+	had = (LUA_TNIL != lua_rawgeti( L, -1, sig ));      //S: … sgl hds fnc
+	if (had)
+	{
+		lua_pushnil( L );                                //S: … sgl hds fnc nil
+		lua_rawseti( L, -3, sig );
+		t_ael_sig_mask( L, sgl, sig, 0 );
+		sgl->cnt--;
+	}
+	lua_pop( L, 3 );                                    //S: …
+	return had;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove all signal handlers.
+ * \param   L        Lua state.
+ * \param  *sgl      struct t_ael_sig*; signal state of the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_sig_clear( lua_State *L, struct t_ael_sig *sgl, int aelpos )
+{
+	int sig;
+
+	for (sig=1; sgl->cnt > 0 && sig <= SIGRTMAX; sig++)
+		if (sigismember( &sgl->msk, sig ))
+			t_ael_sig_remove( L, sgl, aelpos, sig );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check a value on the stack for being a struct t_ael_sig
+ * \param   L      Lua state.
+ * \param   int    position on the stack
+ * \param   int    check(boolean): if true error out on fail
+ * \return  struct t_ael_sig*  pointer to userdata on stack
+ * --------------------------------------------------------------------------*/
+struct t_ael_sig
+*t_ael_sig_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_AEL_SIG_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_AEL_SIG_TYPE );
+	return (NULL==ud) ? NULL : (struct t_ael_sig *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Garbage Collector. Unblock signals and close signalfd.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Signal userdata instance.                 // 1
+ * \return  int  # of values pushed onto the stack.
+ * -------------------------------------------------------------------------*/
+static int
+lt_ael_sig__gc( lua_State *L )
+{
+	struct t_ael_sig *sgl = t_ael_sig_check_ud( L, 1, 1 );
+
+	if (sgl->cnt > 0)
+		sigprocmask( SIG_UNBLOCK, &sgl->msk, NULL );
+	sgl->cnt = 0;
+	if (-1 != sgl->fd)
+		close( sgl->fd );
+	sgl->fd = -1;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Prints the Signal state.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop.Signal userdata instance.                     // 1
+ * \lreturn string formatted string representing T.Loop.Signal.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_sig__tostring( lua_State *L )
+{
+	struct t_ael_sig *sgl = t_ael_sig_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_AEL_SIG_TYPE"{%d}: %p", sgl->cnt, sgl );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_ael_sig_m [] = {
+	// metamethods
+	  { "__gc",          lt_ael_sig__gc          }
+	, { "__tostring",    lt_ael_sig__tostring    }
+	, { NULL,            NULL                    }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Makes the Loop.Signal metatable known and adds signal numbers to the
+ * T.Loop class on top of the stack.
+ * \param   L     The lua state.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_ael_sig( lua_State *L )
+{
+	luaL_newmetatable( L, T_AEL_SIG_TYPE );
+	luaL_setfuncs( L, t_ael_sig_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+
+	// signal numbers; T.Loop.SIGTERM, …
+	lua_pushinteger( L, SIGHUP   ); lua_setfield( L, -2, "SIGHUP"   );
+	lua_pushinteger( L, SIGINT   ); lua_setfield( L, -2, "SIGINT"   );
+	lua_pushinteger( L, SIGQUIT  ); lua_setfield( L, -2, "SIGQUIT"  );
+	lua_pushinteger( L, SIGUSR1  ); lua_setfield( L, -2, "SIGUSR1"  );
+	lua_pushinteger( L, SIGUSR2  ); lua_setfield( L, -2, "SIGUSR2"  );
+	lua_pushinteger( L, SIGPIPE  ); lua_setfield( L, -2, "SIGPIPE"  );
+	lua_pushinteger( L, SIGALRM  ); lua_setfield( L, -2, "SIGALRM"  );
+	lua_pushinteger( L, SIGTERM  ); lua_setfield( L, -2, "SIGTERM"  );
+	lua_pushinteger( L, SIGCHLD  ); lua_setfield( L, -2, "SIGCHLD"  );
+	lua_pushinteger( L, SIGWINCH ); lua_setfield( L, -2, "SIGWINCH" );
+	return 0;
+}
@@ -0,0 +1,269 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_sts.c
+ * \brief     Statistics for T.Loop
+ * \detail    If loop.stats is enabled the loop counts its iterations and
+ *            events and records how long it waits in the poll, how long each
+ *            iteration, handle callback and task callback runs and how late
+ *            tasks get executed.  Durations are kept in log-linear
+ *            histograms with fixed buckets, recording a value is a few
+ *            arithmetic operations and doesn't allocate.  If disabled the
+ *            loop only checks a NULL pointer.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#include <string.h>           // memset
+
+#include "t_ael_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+
+/**--------------------------------------------------------------------------
+ * Get the bucket index of a value.
+ * \param   ns       lua_Integer; value in nanoseconds.
+ * \return  int      index of bucket.
+ * --------------------------------------------------------------------------*/
+static inline int
+t_ael_sts_index( lua_Integer ns )
+{
+	int b;
+
+	if (ns < (1 << T_AEL_HST_SUB))
+		return (ns < 0) ? 0 : (int) ns;
+	if (ns >= ((lua_Integer) 1 << T_AEL_HST_BITS))
+		return T_AEL_HST_CNT - 1;
+	b = 63 - __builtin_clzll( (unsigned long long) ns );   // most significant bit
+	return ((b - T_AEL_HST_SUB + 1) << T_AEL_HST_SUB)
+	     | (int) ((ns >> (b - T_AEL_HST_SUB)) & ((1 << T_AEL_HST_SUB) - 1));
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the smallest value a bucket holds.
+ * \param   idx      int; index of bucket.
+ * \return  lua_Integer; lower bound of bucket in nanoseconds.
+ * --------------------------------------------------------------------------*/
+static inline lua_Integer
+t_ael_sts_lower( int idx )
+{
+	int g = idx >> T_AEL_HST_SUB;
+
+	return (0 == g)
+		? idx
+		: (lua_Integer) ((1 << T_AEL_HST_SUB) | (idx & ((1 << T_AEL_HST_SUB) - 1))) << (g - 1);
+}
+
+
+/**--------------------------------------------------------------------------
+ * Record a value in a histogram.
+ * \param  *hst      struct t_ael_hst*; histogram.
+ * \param   ns       lua_Integer; value in nanoseconds.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_sts_record( struct t_ael_hst *hst, lua_Integer ns )
+{
+	hst->bkt[ t_ael_sts_index( ns ) ]++;
+	hst->min  = (0 == hst->cnt || ns < hst->min) ? ns : hst->min;
+	hst->max  = (ns > hst->max) ? ns : hst->max;
+	hst->sum += ns;
+	hst->cnt++;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the value below which a fraction of the recorded values fall.
+ * Returns the upper bound of the bucket which holds the percentile.
+ * \param  *hst      struct t_ael_hst*; histogram.
+ * \param   q        double; fraction between 0 and 1.
+ * \return  lua_Integer; percentile in nanoseconds.
+ * --------------------------------------------------------------------------*/
+static lua_Integer
+t_ael_sts_percentile( struct t_ael_hst *hst, double q )
+{
+	lua_Integer need = (lua_Integer) (q * hst->cnt + 0.5);
+	lua_Integer seen = 0;
+	lua_Integer up;
+	int         i;
+
+	need = (need < 1) ? 1 : need;
+	for (i=0; i < T_AEL_HST_CNT - 1; i++)
+	{
+		seen += hst->bkt[ i ];
+		if (seen >= need)
+		{
+			up = t_ael_sts_lower( i+1 ) - 1;
+			return (up < hst->max) ? up : hst->max;
+		}
+	}
+	return hst->max;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push a histogram summary as table onto the stack.
+ * \param   L        Lua state.
+ * \param  *hst      struct t_ael_hst*; histogram.
+ * \lreturn table    {count, min, max, mean, p50, p90, p99, p999} in ns.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_sts_pushHistogram( lua_State *L, struct t_ael_hst *hst )
+{
+	lua_createtable( L, 0, 8 );
+	lua_pushinteger( L, hst->cnt );
+	lua_setfield( L, -2, "count" );
+	lua_pushinteger( L, hst->min );
+	lua_setfield( L, -2, "min" );
+	lua_pushinteger( L, hst->max );
+	lua_setfield( L, -2, "max" );
+	lua_pushinteger( L, (hst->cnt > 0) ? hst->sum / hst->cnt : 0 );
+	lua_setfield( L, -2, "mean" );
+	lua_pushinteger( L, (hst->cnt > 0) ? t_ael_sts_percentile( hst, 0.5   ) : 0 );
+	lua_setfield( L, -2, "p50" );
+	lua_pushinteger( L, (hst->cnt > 0) ? t_ael_sts_percentile( hst, 0.9   ) : 0 );
+	lua_setfield( L, -2, "p90" );
+	lua_pushinteger( L, (hst->cnt > 0) ? t_ael_sts_percentile( hst, 0.99  ) : 0 );
+	lua_setfield( L, -2, "p99" );
+	lua_pushinteger( L, (hst->cnt > 0) ? t_ael_sts_percentile( hst, 0.999 ) : 0 );
+	lua_setfield( L, -2, "p999" );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push the statistics as table onto the stack.
+ * \param   L        Lua state.
+ * \param  *sts      struct t_ael_sts*; statistics of the loop.
+ * \lreturn table    statistics; times are in nanoseconds.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_sts_push( lua_State *L, struct t_ael_sts *sts )
+{
+	lua_createtable( L, 0, 13 );
+	lua_pushinteger( L, sts->itr );
+	lua_setfield( L, -2, "iterations" );
+	lua_pushinteger( L, sts->evt );
+	lua_setfield( L, -2, "events" );
+	lua_pushinteger( L, sts->evtMax );
+	lua_setfield( L, -2, "maxEvents" );
+	lua_pushinteger( L, sts->poll );
+	lua_setfield( L, -2, "pollTime" );
+	lua_pushinteger( L, sts->spin );
+	lua_setfield( L, -2, "spinHits" );
+	lua_pushinteger( L, sts->blk );
+	lua_setfield( L, -2, "blockingWaits" );
+	lua_pushinteger( L, sts->hdl.sum );
+	lua_setfield( L, -2, "handleTime" );
+	lua_pushinteger( L, sts->tsk.sum );
+	lua_setfield( L, -2, "taskTime" );
+	t_ael_sts_pushHistogram( L, &sts->bsy );
+	lua_setfield( L, -2, "busy" );
+	t_ael_sts_pushHistogram( L, &sts->hdl );
+	lua_setfield( L, -2, "handle" );
+	t_ael_sts_pushHistogram( L, &sts->tsk );
+	lua_setfield( L, -2, "task" );
+	t_ael_sts_pushHistogram( L, &sts->lag );
+	lua_setfield( L, -2, "lag" );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Reset all counters and histograms.
+ * \param  *sts      struct t_ael_sts*; statistics of the loop.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_sts_reset( struct t_ael_sts *sts )
+{
+	memset( sts, 0, sizeof( struct t_ael_sts ) );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get statistics of the loop; create them on first use.
+ * Statistics survive disabling and enabling loop.stats again.
+ * \param   L        Lua state.
+ * \param   aelpos   int; position of loop on the stack.
+ * \return  struct t_ael_sts*; statistics of the loop.
+ * --------------------------------------------------------------------------*/
+struct t_ael_sts
+*t_ael_sts_get( lua_State *L, int aelpos )
+{
+	struct t_ael_sts *sts;
+
+	aelpos = lua_absindex( L, aelpos );
+	lua_getiuservalue( L, aelpos, T_AEL_STSIDX );       //S: … sts/nil
+	sts = t_ael_sts_check_ud( L, -1, 0 );
+	lua_pop( L, 1 );
+	if (NULL != sts)
+		return sts;
+	sts = (struct t_ael_sts *) lua_newuserdatauv( L, sizeof( struct t_ael_sts ), 0 );
+	t_ael_sts_reset( sts );
+	luaL_getmetatable( L, T_AEL_STS_TYPE );
+	lua_setmetatable( L, -2 );                          //S: … sts
+	lua_setiuservalue( L, aelpos, T_AEL_STSIDX );       //S: …
+	return sts;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check a value on the stack for being a struct t_ael_sts
+ * \param   L      Lua state.
+ * \param   int    position on the stack
+ * \param   int    check(boolean): if true error out on fail
+ * \return  struct t_ael_sts*  pointer to userdata on stack
+ * --------------------------------------------------------------------------*/
+struct t_ael_sts
+*t_ael_sts_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_AEL_STS_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_AEL_STS_TYPE );
+	return (NULL==ud) ? NULL : (struct t_ael_sts *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Prints the Stats.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop.Stats userdata instance.                      // 1
+ * \lreturn string formatted string representing T.Loop.Stats.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_sts__tostring( lua_State *L )
+{
+	struct t_ael_sts *sts = t_ael_sts_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_AEL_STS_TYPE"{%I}: %p", sts->itr, sts );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_ael_sts_m [] = {
+	// metamethods
+	  { "__tostring",    lt_ael_sts__tostring    }
+	, { NULL,            NULL                    }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Makes the Loop.Stats metatable known; there is no class to push.
+ * \param   L     The lua state.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_ael_sts( lua_State *L )
+{
+	luaL_newmetatable( L, T_AEL_STS_TYPE );
+	luaL_setfuncs( L, t_ael_sts_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+	return 0;
+}
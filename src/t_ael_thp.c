@@ -0,0 +1,444 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_thp.c
+ * \brief     Thread pool for T.Loop; runs blocking operations off the loop
+ * \detail    A fixed set of threads takes jobs from a mutex protected FIFO
+ *            queue.  Each job runs a whitelisted C operation which doesn't
+ *            touch the Lua state, such as reading a file into a T.Buffer.
+ *            Once done the job is posted to the loops post queue, so the
+ *            completion handler or the waiting coroutine runs on the loop
+ *            thread like any other posted message.  The Lua values a job
+ *            works on are anchored in the registry until it completed.  State
+ *            the operation updates, such as a running CRC, gets copied into
+ *            the job and written back on completion by the loop thread.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#define _POSIX_C_SOURCE 200809L   // pread, pwrite, fsync, pthread_sigmask
+
+#include "t_ael_l.h"
+#include "t_buf.h"
+#include "t_enc_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+#include <errno.h>            // errno
+#include <stdlib.h>           // malloc, free
+#include <signal.h>           // sigfillset, pthread_sigmask
+#include <unistd.h>           // pread, pwrite, fsync
+#include <pthread.h>
+
+
+struct t_ael_thp {
+	pthread_mutex_t    mtx;     ///< protects the queue and stop
+	pthread_cond_t     cnd;     ///< signals queued jobs and stop
+	struct t_ael_job  *hd;      ///< first queued job
+	struct t_ael_job  *tl;      ///< last queued job
+	struct t_ael_pst  *pst;     ///< post queue of the loop; receives completions
+	int                stop;    ///< boolean; threads shall exit
+	int                cnt;     ///< number of running threads
+	pthread_t          thr[];   ///< the threads
+};
+
+// operations available to loop:offload(); order of enum t_ael_thp_op
+static const char *const t_ael_thp_lst[ ] = { "read", "write", "fsync", "crc", NULL };
+
+enum t_ael_thp_op {
+	T_AEL_THP_READ = 0,
+	T_AEL_THP_WRITE,
+	T_AEL_THP_FSYNC,
+	T_AEL_THP_CRC,
+};
+
+
+/**--------------------------------------------------------------------------
+ * Execute the operation of a job.  Runs on a pool thread.
+ * \param  *job      struct t_ael_job*; job.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_thp_run( struct t_ael_job *job )
+{
+	struct t_enc_crc *crc;
+
+	errno = 0;
+	switch ((enum t_ael_thp_op) job->op)
+	{
+		case T_AEL_THP_READ:
+			job->res = (job->off < 0)
+				? read(  job->fd, job->dat, job->len )
+				: pread( job->fd, job->dat, job->len, (off_t) job->off );
+			break;
+		case T_AEL_THP_WRITE:
+			job->res = (job->off < 0)
+				? write(  job->fd, job->dat, job->len )
+				: pwrite( job->fd, job->dat, job->len, (off_t) job->off );
+			break;
+		case T_AEL_THP_FSYNC:
+			job->res = fsync( job->fd );
+			break;
+		case T_AEL_THP_CRC:
+			crc      = (struct t_enc_crc *) job->ctx;
+			job->res = crc->calc( crc, job->dat, job->len );
+			break;
+	}
+	job->err = errno;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Pool thread; executes queued jobs and posts them back to the loop.
+ * \param  *arg      struct t_ael_thp*; the pool.
+ * \return  void*    NULL.
+ * --------------------------------------------------------------------------*/
+static void
+*t_ael_thp_work( void *arg )
+{
+	struct t_ael_thp *thp = (struct t_ael_thp *) arg;
+	struct t_ael_job *job;
+
+	pthread_mutex_lock( &thp->mtx );
+	while (1)
+	{
+		while (NULL == thp->hd && ! thp->stop)
+			pthread_cond_wait( &thp->cnd, &thp->mtx );
+		if (thp->stop)
+			break;
+		job     = thp->hd;
+		thp->hd = job->nxt;
+		thp->tl = (NULL == thp->hd) ? NULL : thp->tl;
+		pthread_mutex_unlock( &thp->mtx );
+		t_ael_thp_run( job );
+		t_ael_pst_push( thp->pst, &job->msg );
+		pthread_mutex_lock( &thp->mtx );
+	}
+	pthread_mutex_unlock( &thp->mtx );
+	return NULL;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push the result of a job onto the stack.
+ * \param   L        Lua state.
+ * \param  *job      struct t_ael_job*; finished job.
+ * \lreturn value    result; nil and error message on failure.
+ * \return  int      # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_thp_result( lua_State *L, struct t_ael_job *job )
+{
+	if (job->res < 0 && T_AEL_THP_CRC != job->op)
+	{
+		errno = job->err;
+		return t_push_error( L, 0, 0, "offloaded %s failed", t_ael_thp_lst[ job->op ] );
+	}
+	if (T_AEL_THP_FSYNC == job->op)
+		lua_pushboolean( L, 1 );
+	else
+		lua_pushinteger( L, job->res );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Complete a job on the loop thread.  This is the exc() of its message.
+ * Executes the handler with the result or resumes the waiting coroutine.
+ * \param   L        Lua state; NULL to release job without completing it.
+ * \param  *msg      struct t_ael_msg*; message of job.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_thp_done( lua_State *L, struct t_ael_msg *msg )
+{
+	struct t_ael_job *job = (struct t_ael_job *) msg;
+	lua_State        *co;
+	int               n, i;
+
+	job->ael->jobs--;
+	if (NULL == L)
+	{
+		free( job );
+		return;
+	}
+	lua_rawgeti( L, LUA_REGISTRYINDEX, msg->fnc );     //S: … anc
+	luaL_unref( L, LUA_REGISTRYINDEX, msg->fnc );
+	if (T_AEL_THP_CRC == job->op)                      // write back running crc
+	{
+		lua_rawgeti( L, -1, 2 );                        //S: … anc crc
+		((struct t_enc_crc *) lua_touserdata( L, -1 ))->crc32 = ((struct t_enc_crc *) job->ctx)->crc32;
+		lua_pop( L, 1 );                                //S: … anc
+	}
+	lua_rawgeti( L, -1, 1 );                           //S: … anc hdl
+	lua_remove( L, -2 );                               //S: … hdl
+	if (NULL != t_ael_crt_check_ud( L, -1, 0 ))
+	{
+		lua_getiuservalue( L, -1, T_AEL_CRT_THDIDX );   //S: … crt co
+		co = lua_tothread( L, -1 );
+		lua_pop( L, 1 );
+		n  = t_ael_thp_result( L, job );                //S: … crt res …
+		free( job );
+		lua_xmove( L, co, n );                          //S: … crt
+		t_ael_crt_resume( L, n );                       //S: …
+		return;
+	}
+	n = 0;
+	if (lua_istable( L, -1 ))                          // {fnc, arg, …}
+	{
+		n = (int) lua_rawlen( L, -1 ) - 1;
+		for (i=1; i<=n+1; i++)
+			lua_rawgeti( L, -i, i );                     //S: … tbl fnc arg …
+		lua_remove( L, -(n+2) );                        //S: … fnc arg …
+	}
+	n += t_ael_thp_result( L, job );                   //S: … fnc arg … res …
+	free( job );
+	lua_call( L, n, 0 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the thread pool of the loop; start it on first use.
+ * The threads get all signals blocked, so signals observed by the loop are
+ * still delivered via its signalfd.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \param   aelpos   int; position of loop on the stack.
+ * \return  struct t_ael_thp*; thread pool of the loop.
+ * --------------------------------------------------------------------------*/
+struct t_ael_thp
+*t_ael_thp_get( lua_State *L, struct t_ael *ael, int aelpos )
+{
+	struct t_ael_thp *thp;
+	sigset_t          all, old;
+	int               n = (ael->poolSize > 0) ? ael->poolSize : 1;
+
+	if (NULL != ael->thp)
+		return ael->thp;
+	aelpos = lua_absindex( L, aelpos );
+	thp    = (struct t_ael_thp *) lua_newuserdatauv( L,
+	            sizeof( struct t_ael_thp ) + n * sizeof( pthread_t ), 0 );
+	thp->hd   = NULL;
+	thp->tl   = NULL;
+	thp->stop = 0;
+	thp->cnt  = 0;
+	thp->pst  = t_ael_pst_get( L, ael, aelpos );
+	pthread_mutex_init( &thp->mtx, NULL );
+	pthread_cond_init( &thp->cnd, NULL );
+	luaL_getmetatable( L, T_AEL_THP_TYPE );
+	lua_setmetatable( L, -2 );                          //S: … thp
+	sigfillset( &all );
+	pthread_sigmask( SIG_SETMASK, &all, &old );
+	while (thp->cnt < n && 0 == pthread_create( &thp->thr[ thp->cnt ], NULL, t_ael_thp_work, thp ))
+		thp->cnt++;
+	pthread_sigmask( SIG_SETMASK, &old, NULL );
+	if (0 == thp->cnt)
+		t_push_error( L, 1, 1, "couldn't start thread pool for loop" );
+	lua_setiuservalue( L, aelpos, T_AEL_THPIDX );       //S: …
+	ael->thp = thp;
+	return thp;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Offload a blocking operation to the thread pool of the loop.
+ * Checks the arguments of the operation, anchors them and the handler in the
+ * registry and queues the job.  Without a handler the calling coroutine gets
+ * suspended until the job is done.
+ * \param   L        Lua state.
+ * \param  *ael      struct t_ael*; the loop.
+ * \lparam  ael      T.Loop userdata instance.                        // 1
+ * \lparam  op       string; operation.                               // 2
+ * \lparam  …        arguments of operation; function and arguments of handler.
+ * \lreturn value    result of operation if the coroutine got suspended.
+ * \return  int      # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_thp_offload( lua_State *L, struct t_ael *ael )
+{
+	struct t_ael_thp *thp;
+	struct t_ael_job *job;
+	struct t_ael_job  arg = { .off = -1, .ael = ael };
+	size_t            sz  = sizeof( struct t_ael_job );
+	int               nxt = 4;     ///< position after arguments of operation
+	int               cw  = 1;
+	int               n, i;
+
+	arg.op = luaL_checkoption( L, 2, NULL, t_ael_thp_lst );
+	if (T_AEL_THP_CRC == arg.op)
+	{
+		arg.ctx = luaL_checkudata( L, 3, T_ENC_CRC_TYPE );
+		sz     += sizeof( struct t_enc_crc );
+	}
+	else
+		arg.fd  = t_ael_getHandle( L, 3, 1 );
+	if (T_AEL_THP_FSYNC != arg.op)
+	{
+		arg.dat = t_buf_tolstring( L, 4, &arg.len, &cw );
+		if (T_AEL_THP_READ == arg.op)
+			luaL_argcheck( L, NULL != arg.dat && cw, 4,
+			   "`"T_BUF_TYPE"` or `"T_BUF_SEG_TYPE"` expected" );
+		else
+			luaL_argcheck( L, NULL != arg.dat, 4,
+			   "`"T_BUF_TYPE"`, `"T_BUF_SEG_TYPE"` or Lua string expected" );
+		nxt = 5;
+	}
+	if (T_AEL_THP_CRC != arg.op && T_AEL_THP_FSYNC != arg.op && LUA_TNUMBER == lua_type( L, 5 ))
+		arg.off = (lua_Integer) luaL_checkinteger( L, nxt++ );
+
+	// anchor: {handler, arguments of operation …}
+	n = lua_gettop( L );
+	lua_createtable( L, nxt-2, 0 );                     //S: ael op … anc
+	if (nxt <= n)
+	{
+		luaL_checktype( L, nxt, LUA_TFUNCTION );
+		if (n > nxt)     // the function itself if there are no arguments
+		{
+			lua_createtable( L, n-nxt+1, 0 );            //S: ael op … anc tbl
+			for (i=nxt; i<=n; i++)
+			{
+				lua_pushvalue( L, i );
+				lua_rawseti( L, -2, i-nxt+1 );
+			}
+		}
+		else
+			lua_pushvalue( L, nxt );                     //S: ael op … anc fnc
+	}
+	else if (t_isAwaitable( L ))
+	{
+		lua_getfield( L, LUA_REGISTRYINDEX, T_AWT_KEY );
+		lua_pushthread( L );
+		lua_rawget( L, -2 );                            //S: ael op … anc awt crt
+		lua_remove( L, -2 );                            //S: ael op … anc crt
+	}
+	else
+		return luaL_argerror( L, nxt, "handler function expected outside of "T_AEL_TYPE":spawn()" );
+	lua_rawseti( L, -2, 1 );                            //S: ael op … anc
+	for (i=3; i<nxt; i++)
+	{
+		lua_pushvalue( L, i );
+		lua_rawseti( L, -2, i-1 );
+	}
+	thp = t_ael_thp_get( L, ael, 1 );
+	if (NULL == (job = (struct t_ael_job *) malloc( sz )))
+		return luaL_error( L, "couldn't allocate job" );
+	*job         = arg;
+	if (T_AEL_THP_CRC == arg.op)   // the thread works on a copy behind the job
+	{
+		job->ctx = job + 1;
+		*((struct t_enc_crc *) job->ctx) = *((struct t_enc_crc *) arg.ctx);
+	}
+	job->msg.exc = t_ael_thp_done;
+	job->msg.fnc = luaL_ref( L, LUA_REGISTRYINDEX );   //S: ael op …
+	ael->jobs++;
+
+	pthread_mutex_lock( &thp->mtx );
+	if (NULL == thp->tl)
+		thp->hd = job;
+	else
+		thp->tl->nxt = job;
+	thp->tl = job;
+	pthread_cond_signal( &thp->cnd );
+	pthread_mutex_unlock( &thp->mtx );
+
+	if (nxt <= n)
+		return 0;
+	// suspend; the loop won't resume a coroutine which yields itself
+	lua_getfield( L, LUA_REGISTRYINDEX, T_AWT_KEY );
+	lua_pushthread( L );
+	lua_rawget( L, -2 );                               //S: ael op … awt crt
+	return lua_yield( L, 1 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check a value on the stack for being a struct t_ael_thp
+ * \param   L      Lua state.
+ * \param   int    position on the stack
+ * \param   int    check(boolean): if true error out on fail
+ * \return  struct t_ael_thp*  pointer to userdata on stack
+ * --------------------------------------------------------------------------*/
+struct t_ael_thp
+*t_ael_thp_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_AEL_THP_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_AEL_THP_TYPE );
+	return (NULL==ud) ? NULL : (struct t_ael_thp *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Garbage Collector. Stop and join the threads, drop queued jobs.
+ * Jobs which already ran are in the post queue and get released there.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Pool userdata instance.                   // 1
+ * \return  int  # of values pushed onto the stack.
+ * -------------------------------------------------------------------------*/
+static int
+lt_ael_thp__gc( lua_State *L )
+{
+	struct t_ael_thp *thp = t_ael_thp_check_ud( L, 1, 1 );
+	struct t_ael_job *job;
+	int               i;
+
+	pthread_mutex_lock( &thp->mtx );
+	thp->stop = 1;
+	pthread_cond_broadcast( &thp->cnd );
+	pthread_mutex_unlock( &thp->mtx );
+	for (i=0; i<thp->cnt; i++)
+		pthread_join( thp->thr[ i ], NULL );
+	thp->cnt = 0;
+	while (NULL != (job = thp->hd))
+	{
+		thp->hd = job->nxt;
+		free( job );
+	}
+	thp->tl = NULL;
+	pthread_cond_destroy( &thp->cnd );
+	pthread_mutex_destroy( &thp->mtx );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Prints the Pool.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop.Pool userdata instance.                       // 1
+ * \lreturn string formatted string representing T.Loop.Pool.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_thp__tostring( lua_State *L )
+{
+	struct t_ael_thp *thp = t_ael_thp_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_AEL_THP_TYPE"{%d}: %p", thp->cnt, thp );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_ael_thp_m [] = {
+	// metamethods
+	  { "__gc",          lt_ael_thp__gc          }
+	, { "__tostring",    lt_ael_thp__tostring    }
+	, { NULL,            NULL                    }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Makes the Loop.Pool metatable known; there is no class to push.
+ * \param   L     The lua state.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_ael_thp( lua_State *L )
+{
+	luaL_newmetatable( L, T_AEL_THP_TYPE );
+	luaL_setfuncs( L, t_ael_thp_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+	return 0;
+}
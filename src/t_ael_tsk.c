@@ -16,220 +16,354 @@
 
 
 // helpers
+// ordering of tasks in the heap; same deadline executes in insertion order
+#define t_ael_tsk_lt( a, b ) \
+	((a)->tout < (b)->tout || ((a)->tout == (b)->tout && (a)->seq < (b)->seq))
+
+
 /**--------------------------------------------------------------------------
- * Adjust amount of time in the loops timer event list.
- * Substract tAdj value from each timer in the list.
+ * Get the deadline of a task; rounded up to a multiple of its slack.
+ * \param  *tsk      struct t_ael_tsk*; task.
+ * \param   ns       lua_Integer; absolute deadline in nanoseconds.
+ * \return  lua_Integer; absolute deadline the task gets scheduled for.
+ * --------------------------------------------------------------------------*/
+static inline lua_Integer
+t_ael_tsk_deadline( struct t_ael_tsk *tsk, lua_Integer ns )
+{
+	return (tsk->slack > 0)
+		? ((ns + tsk->slack - 1) / tsk->slack) * tsk->slack
+		: ns;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Put a task into a heap slot and restore the heap property.
+ * The task bubbles up if it is smaller than its parent, otherwise it sinks
+ * down.  Every task that gets moved gets its position updated.
  * \param   L        Lua state.
- * \lparam  *ael     t_ael; pointer to loop.
- * \lparam  tskHead  t_ael_tsk; Head of task list on stack.
- * \param     tAdj   int; time(ms) value to be substracted from all nodes in
- *                   tasks linked list.
+ * \param   hp       int; position of heap table on the stack.
+ * \param   i        size_t; heap slot to put the task into.
+ * \param   n        size_t; number of tasks in the heap.
+ * \lparam  tsk      t_ael_tsk; task to be placed; gets popped.
  * \return  void.
  * --------------------------------------------------------------------------*/
-static inline void
-t_ael_tsk_adjust( lua_State *L, lua_Integer tAdj )
+static void
+t_ael_tsk_place( lua_State *L, int hp, size_t i, size_t n )
 {
+	struct t_ael_tsk *tsk = (struct t_ael_tsk *) lua_touserdata( L, -1 );
 	struct t_ael_tsk *tRun;
-	lua_pushvalue( L, -1 );     // copy task head    //S: ael hed hed
-	while (! lua_isnil( L, -1 ))                     //S: ael hed tsk
+	struct t_ael_tsk *tAlt;
+	size_t            c;
+
+	// sift up; parents bigger than tsk move down into the hole
+	while (i > 1)                                         //S: … hp … tsk
 	{
-		tRun       = t_ael_tsk_check_ud( L, -1, 0 );
-		//printf("ADJUST: %lld  %lld  -- ", tRun->tout, tAdj);
-		tRun->tout = (tRun->tout - tAdj > 0) ? tRun->tout - tAdj : 0;
-		//printf("%lld  -- ", tRun->tout); t_stackDump(L);
-		lua_getiuservalue( L, -1, T_AEL_TSK_NXTIDX ); //S: ael hed tsk tsk
-		lua_remove( L, -2);                           //S: ael hed tsk
-	}                                                //S: ael hed tsk
-	lua_pop( L, 1 );                                 //S: ael hed
+		lua_rawgeti( L, hp, i/2 );                         //S: … hp … tsk prn
+		tRun = (struct t_ael_tsk *) lua_touserdata( L, -1 );
+		if (! t_ael_tsk_lt( tsk, tRun ))
+		{
+			lua_pop( L, 1 );
+			break;
+		}
+		tRun->pos = i;
+		lua_rawseti( L, hp, i );                           //S: … hp … tsk
+		i = i/2;
+	}
+	// sift down; smaller children move up into the hole
+	while ((c = 2*i) <= n)
+	{
+		lua_rawgeti( L, hp, c );                           //S: … hp … tsk chd
+		tRun = (struct t_ael_tsk *) lua_touserdata( L, -1 );
+		if (c < n)
+		{
+			lua_rawgeti( L, hp, c+1 );                      //S: … hp … tsk chd alt
+			tAlt = (struct t_ael_tsk *) lua_touserdata( L, -1 );
+			if (t_ael_tsk_lt( tAlt, tRun ))
+			{
+				lua_remove( L, -2 );                         //S: … hp … tsk alt
+				tRun = tAlt;
+				c++;
+			}
+			else
+				lua_pop( L, 1 );                             //S: … hp … tsk chd
+		}
+		if (! t_ael_tsk_lt( tRun, tsk ))
+		{
+			lua_pop( L, 1 );
+			break;
+		}
+		tRun->pos = i;
+		lua_rawseti( L, hp, i );                           //S: … hp … tsk
+		i = c;
+	}
+	tsk->pos = i;
+	lua_rawseti( L, hp, i );                              //S: … hp …
+}
+
+
+/**--------------------------------------------------------------------------
+ * Take a task out of the heap.
+ * Moves the last task in the heap into the vacated slot and restores order.
+ * \param   L        Lua state.
+ * \param   ael      t_ael; the Loop.
+ * \param   hp       int; position of heap table on the stack.
+ * \param   tsk      t_ael_tsk; task to be removed; must be in the heap.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_tsk_unlink( lua_State *L, struct t_ael *ael, int hp, struct t_ael_tsk *tsk )
+{
+	size_t            i = tsk->pos;
+	size_t            n = ael->tskCount;
+	struct t_ael_tsk *tRun;
+
+	tsk->pos = 0;
+	ael->tskCount = --n;
+	lua_rawgeti( L, hp, n+1 );                            //S: … hp … lst
+	lua_pushnil( L );
+	lua_rawseti( L, hp, n+1 );
+	if (i <= n)     // the last task fills the hole
+		t_ael_tsk_place( L, hp, i, n );
+	else
+		lua_pop( L, 1 );                                   //S: … hp …
+
+	if (n > 0)
+	{
+		lua_rawgeti( L, hp, 1 );
+		tRun = (struct t_ael_tsk *) lua_touserdata( L, -1 );
+		ael->tout = tRun->tout;
+		lua_pop( L, 1 );
+	}
+	else
+		ael->tout = T_AEL_NOTIMEOUT;
 }
 
 
 /**--------------------------------------------------------------------------
  * Execute single task.
+ * If the function scheduled its own task again, by touchTask() or addTask(),
+ * and returns a timeout as well, the returned timeout wins.
  * \param   L        Lua state.
  * \lparam  *ael     t_ael; pointer to loop.
- * \lparam  *tsk     t_ael_tsk; pointer to task to execute.
+ * \lparam  *tsk     t_ael_tsk; task to execute; is removed from heap.
+ * \param   now      lua_Integer; time(ns) the tasks are processed for.
  * \return  void                                                             …
  * --------------------------------------------------------------------------*/
 static void
-t_ael_tsk_execute( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tsk )
+t_ael_tsk_execute( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tsk, lua_Integer now )
 {
-	lua_Integer        ms = 0;     ///< 0 means sentinel to remove from loop
+	lua_Integer        ns;         ///< 0 means sentinel to remove from loop
 
 	lua_getiuservalue( L, -1, T_AEL_TSK_FNCIDX );                //S: ael tsk tbl
 	t_ael_doFunction( L, 1 );                                    //S: ael tsk ms
-	ms = (lua_isinteger( L, -1 )) ? lua_tointeger( L, -1 ) : ms; //S: ael tsk ms
+	ns = t_ael_tons( L, -1 );                                    //S: ael tsk ms
 	lua_pop( L, 1 );  // pop the nil or millisecond value        //S: ael tsk
-	//printf("EXEC REMOVE: "); t_stackDump(L);
-	t_ael_tsk_remove( L, ael, tsk );                             //S: ael tsk
 
-	if (ms < 1 )      // remove from list
-		lua_pop( L, 1 );                                          //S: ael
-	else              // re-add node to list if function returned a timer
+	if (ns > 0)       // re-add node to heap if function returned a timer
 	{
-		tsk->tout = ms;                                           //S: ael tsk
-		//printf("EXEC INSERT: "); t_stackDump(L);
-		t_ael_tsk_insert( L, ael, tsk );                          //S: ael
+		tsk->tout = tsk->due = t_ael_tsk_deadline( tsk, now + ns ); //S: ael tsk
+		if (0 == tsk->pos)
+			t_ael_tsk_insert( L, ael, tsk );                       //S: ael
+		else              // function touched or re-added it; move its slot
+		{
+			lua_getiuservalue( L, -2, T_AEL_TSKIDX );               //S: ael tsk hp
+			lua_insert( L, -2 );                                    //S: ael hp tsk
+			t_ael_tsk_place( L, lua_gettop( L ) - 1, tsk->pos, ael->tskCount );
+			lua_rawgeti( L, -1, 1 );                                //S: ael hp hd
+			ael->tout = ((struct t_ael_tsk *) lua_touserdata( L, -1 ))->tout;
+			lua_pop( L, 2 );                                        //S: ael
+		}
 	}
+	else
+		lua_pop( L, 1 );                                          //S: ael
 }
 
 
 /**--------------------------------------------------------------------------
- * Pop timer list head, execute and re-add if needed.
+ * Pop all tasks from heap that are due, execute and re-add if needed.
  * \param   L        Lua state.
  * \lparam  ael      t_ael; the Loop userdata.
- * \param   et       int; execution time in milliseconds
+ * \param   now      lua_Integer; current time in nanoseconds.
  * \return  void.
  * --------------------------------------------------------------------------*/
 void
-t_ael_tsk_process( lua_State *L, struct t_ael *ael, lua_Integer et )
+t_ael_tsk_process( lua_State *L, struct t_ael *ael, lua_Integer now )
 {
 	struct t_ael_tsk *tRun;                               //S: ael
-	lua_getiuservalue( L, -1, T_AEL_TSKIDX );             //S: ael hed
-	//printf("PROC ADJUST: "); t_stackDump(L);
-	t_ael_tsk_adjust( L, et );                            //S: ael hed
+	struct t_ael_sts *sts = ael->sts;
+	lua_Integer       t   = 0;
 
-	//printf("PROC ADJUSTed: "); t_stackDump(L);
-	while (! lua_isnil( L, -1 ))                          //S: ael hed
+	// tasks may add, cancel or clean; always work of the current heap head
+	while (ael->tskCount > 0 && ael->tout <= now)
 	{
-		tRun = t_ael_tsk_check_ud( L, -1, 0 );
-		if (tRun->tout < 1)
+		lua_getiuservalue( L, -1, T_AEL_TSKIDX );          //S: ael hp
+		lua_rawgeti( L, -1, 1 );                           //S: ael hp tsk
+		tRun = (struct t_ael_tsk *) lua_touserdata( L, -1 );
+		lua_insert( L, -2 );                               //S: ael tsk hp
+		t_ael_tsk_unlink( L, ael, lua_gettop( L ), tRun );
+		lua_pop( L, 1 );                                   //S: ael tsk
+		if (tRun->due > tRun->tout)                        // touched; not due yet
 		{
-			//printf("PROC EXECUTE: "); t_stackDump(L);
-			t_ael_tsk_execute( L, ael, tRun );              //S: ael
+			tRun->tout = tRun->due;
+			t_ael_tsk_insert( L, ael, tRun );               //S: ael
+			continue;
 		}
-		else
-			break;
-		lua_getiuservalue( L, -1, T_AEL_TSKIDX );          //S: ael hed
-		//printf("PROC NEXT: "); t_stackDump(L);
-	}                                                     //S: ael hed
-	//printf("PROC FINALIZE: "); t_stackDump(L);
-	lua_pop( L, 1 );                                      //S: ael
+		if (NULL != sts)
+		{
+			t = t_ael_now( );
+			t_ael_sts_record( &sts->lag, t - tRun->tout );
+		}
+		t_ael_tsk_execute( L, ael, tRun, now );            //S: ael
+		if (NULL != sts)
+			t_ael_sts_record( &sts->tsk, t_ael_now( ) - t );
+	}
 }
 
 
 /**----------------------------------------------------------------------------
- * Slot in a task into the loops linked list of tasks.
- * Ordered insert; walks down linked list and inserts before the next bigger
- * task node.
+ * Slot in a task into the loops heap of tasks.
+ * Appends the task as last leaf and sifts it up; O(log n).
  * \param    L      Lua state.
  * \lparam  *ael    t_ael; the Loop userdata.
- * \lparam  *tIns   t_ael_tsk; task to be inserted into linked list.
+ * \lparam  *tIns   t_ael_tsk; task to be inserted into heap.
  * \lreturn *ael    t_ael; the Loop userdata.
  * \return   void.
  * --------------------------------------------------------------------------*/
 void
 t_ael_tsk_insert( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tIns )
 {
-	struct t_ael_tsk *tRun;                                    //S: ael ins
-
-	lua_getiuservalue( L, -2, T_AEL_TSKIDX );                  //S: ael ins hed
-	if (lua_isnil( L, -1 ))                                    //S: ael ins nil
-	{
-		//printf("INSERT NEW HEAD: "); t_stackDump(L);
-		lua_pop( L, 1 );                                        //S: ael ins (is now head)
-		lua_setiuservalue( L, -2, T_AEL_TSKIDX );               //S: ael
+	tIns->seq = ael->tskSeq++;                                 //S: ael ins
+	lua_getiuservalue( L, -2, T_AEL_TSKIDX );                  //S: ael ins hp
+	lua_insert( L, -2 );                                       //S: ael hp ins
+	ael->tskCount++;
+	t_ael_tsk_place( L, lua_gettop( L ) - 1, ael->tskCount, ael->tskCount );
+	lua_pop( L, 1 );                                           //S: ael
+	if (1 == tIns->pos)
 		ael->tout = tIns->tout;
-	}
-	else
-	{
-		tRun = t_ael_tsk_check_ud( L, -1, 0 );                  //S: ael ins hed
-		if (tRun->tout >= tIns->tout)  // ins becomes new head; prev head links to ins
-		{
-			//printf("INSERT HEAD: %lld %lld-", tRun->tout, tIns->tout); t_stackDump(L);
-			lua_setiuservalue( L, -2, T_AEL_TSK_NXTIDX );        //S: ael ins (is now head)
-			lua_setiuservalue( L, -2, T_AEL_TSKIDX );            //S: ael
-			ael->tout = tIns->tout;
-		}
-		else
-		{
-			while (LUA_TNIL != lua_getiuservalue( L, -1, T_AEL_TSK_NXTIDX ))
-			{
-				tRun = t_ael_tsk_check_ud( L, -1, 0 );            //S: ael ins prv nxt
-				//printf("ud->num: %d  %p ", ud->num, ud); t_stackDump(L);
-				if (tRun->tout >= tIns->tout)
-					break;
-				lua_remove( L, -2 );                              //S: ael ins nxt
-			}
-			//printf("INSERT TASK: %lld -", tRun->tout);t_stackDump(L);
-			                                                     //S: ael ins prv nxt/nil
-			lua_setiuservalue( L, -3, T_AEL_TSK_NXTIDX );        //S: ael ins prv
-			lua_rotate( L, -2, 1 );                              //S: ael prv ins
-			lua_setiuservalue( L, -2, T_AEL_TSK_NXTIDX );        //S: ael prv
-			lua_pop( L, 1 );                                     //S: ael
-		}
-	}
 }
 
 
 /**----------------------------------------------------------------------------
- * Remove a task from the loops linked list of tasks.
+ * Remove a task from the loops heap of tasks.
+ * Tasks which are not scheduled in this loop are ignored.
  * \param    L      Lua state.
  * \lparam  *ael    t_ael; the Loop userdata.
  * \lparam  *cnd    t_ael_tsk; Candidate to be removed.
  * \lreturn *ael    t_ael; the Loop userdata.
+ * \return   int    1 if task was removed, 0 if it wasn't scheduled.
+ * --------------------------------------------------------------------------*/
+int
+t_ael_tsk_remove( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tCnd )
+{
+	int rem = 0;
+
+	if (0 == tCnd->pos || tCnd->pos > ael->tskCount)
+		return rem;
+	lua_getiuservalue( L, -2, T_AEL_TSKIDX );             //S: ael cnd hp
+	lua_rawgeti( L, -1, tCnd->pos );                      //S: ael cnd hp tsk
+	rem = lua_rawequal( L, -1, -3 );
+	lua_pop( L, 1 );                                      //S: ael cnd hp
+	if (rem)
+		t_ael_tsk_unlink( L, ael, lua_gettop( L ), tCnd );
+	lua_pop( L, 1 );                                      //S: ael cnd
+	return rem;
+}
+
+
+/**----------------------------------------------------------------------------
+ * Reschedule a task to ns from now; schedule it if it isn't.
+ * A later deadline only gets recorded and the task stays in its heap slot;
+ * O(1) and no Lua table gets touched.  An earlier one sifts the task up.
+ * \param    L      Lua state.
+ * \lparam  *ael    t_ael; the Loop userdata.
+ * \lparam  *tsk    t_ael_tsk; task to be touched; gets popped.
+ * \param    ns     lua_Integer; nanoseconds from now.
+ * \lreturn *ael    t_ael; the Loop userdata.
  * \return   void.
  * --------------------------------------------------------------------------*/
 void
-t_ael_tsk_remove( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tCnd )
+t_ael_tsk_touch( lua_State *L, struct t_ael *ael, struct t_ael_tsk *tsk, lua_Integer ns )
 {
-	struct t_ael_tsk *tRun;
+	lua_Integer due = t_ael_tsk_deadline( tsk, t_ael_now( ) + ns );
+	int         scd = 0;
 
-	lua_getiuservalue( L, -2, T_AEL_TSKIDX );             //S: ael cnd hed
-	if (lua_isnil( L, -1 )) // head is nil, cop out
-	{ // clean nxt from cnd for good measure
-		lua_setiuservalue( L, -2, T_AEL_TSK_NXTIDX );      //S: ael cnd
-		return;              // no tasks in list
-	}
-	tRun = t_ael_tsk_check_ud( L, -1, 0 );                //S: ael cnd hed
-	lua_getiuservalue( L, -1, T_AEL_TSK_NXTIDX );         //S: ael cnd hed nxt
-	if (tCnd == tRun)      // head is the candidate
-	{                      // link next as head
-		//printf("REMOVE HEAD: %lld -", tRun->tout);t_stackDump(L);
-		if (lua_isnil( L, -1 ))                            //S: ael cnd hed nil
-			ael->tout = T_AEL_NOTIMEOUT;
-		else
+	if (tsk->pos > 0 && tsk->pos <= ael->tskCount)
+	{
+		if (due == tsk->due)                             // same bucket; nothing to do
 		{
-			tRun = t_ael_tsk_check_ud( L, -1, 0 );          //S: ael cnd hed nxt
-			ael->tout = tRun->tout;
+			lua_pop( L, 1 );                              //S: ael
+			return;
 		}
-		lua_setiuservalue( L, -4, T_AEL_TSKIDX );          //S: ael cnd hed
-		lua_pop( L, 1 );                                   //S: ael cnd
+		lua_getiuservalue( L, -2, T_AEL_TSKIDX );        //S: ael tsk hp
+		lua_rawgeti( L, -1, tsk->pos );                  //S: ael tsk hp cur
+		scd = lua_rawequal( L, -1, -3 );
+		lua_pop( L, 2 );                                 //S: ael tsk
 	}
-	else
+	if (! scd)
 	{
-		while (! lua_isnil( L, -1 ))                       //S: ael cnd prv nxt
-		{
-			tRun = t_ael_tsk_check_ud( L, -1, 0 );          //S: ael cnd prv run
-			lua_getiuservalue( L, -1, T_AEL_TSK_NXTIDX );   //S: ael cnd prv run nxt
-			if (tCnd == tRun)
-			{                // link nxt to prv
-				lua_setiuservalue( L, -3, T_AEL_TSK_NXTIDX );//S: ael cnd prv run
-				break;
-			}
-			else
-				lua_remove( L, -3 );                         //S: ael cnd run nxt
-		}
-		lua_pop( L, 2 );                                   //S: ael cnd
+		tsk->tout = tsk->due = due;
+		t_ael_tsk_insert( L, ael, tsk );                 //S: ael
+		return;
+	}
+	tsk->due = due;
+	if (due < tsk->tout)                                // earlier; sift up
+	{
+		tsk->tout = due;
+		lua_getiuservalue( L, -2, T_AEL_TSKIDX );        //S: ael tsk hp
+		lua_insert( L, -2 );                             //S: ael hp tsk
+		t_ael_tsk_place( L, lua_gettop( L ) - 1, tsk->pos, ael->tskCount );
+		if (1 == tsk->pos)
+			ael->tout = tsk->tout;
+	}
+	lua_pop( L, 1 );                                    //S: ael
+}
+
+
+/**----------------------------------------------------------------------------
+ * Remove all tasks from the loops heap.
+ * Resets the position of each task, so a later cancel is a no-op.
+ * \param    L      Lua state.
+ * \lparam  *ael    t_ael; the Loop userdata.
+ * \param    aelpos int; position of the Loop userdata on the stack.
+ * \return   void.
+ * --------------------------------------------------------------------------*/
+void
+t_ael_tsk_clear( lua_State *L, struct t_ael *ael, int aelpos )
+{
+	size_t i;
+
+	lua_getiuservalue( L, aelpos, T_AEL_TSKIDX );         //S: … hp
+	for (i=1; i<=ael->tskCount; i++)
+	{
+		lua_rawgeti( L, -1, i );                           //S: … hp tsk
+		((struct t_ael_tsk *) lua_touserdata( L, -1 ))->pos = 0;
+		lua_pop( L, 1 );
 	}
-	// remove "nxt" from "cnd"
-	lua_pushnil( L );                                     //S: ael cnd nil
-	lua_setiuservalue( L, -2, T_AEL_TSK_NXTIDX );         //S: ael cnd
+	lua_pop( L, 1 );                                      //S: …
+	lua_newtable( L );
+	lua_setiuservalue( L, aelpos, T_AEL_TSKIDX );
+	ael->tskCount = 0;
+	ael->tout     = T_AEL_NOTIMEOUT;
 }
 
 
 /**--------------------------------------------------------------------------
  * Create a new t_ael_ts userdata and push to LuaStack.
  * \param   L    Lua state.
+ * \param   ns   lua_Integer; absolute deadline in nanoseconds.
  * \return  tsk  struct t_ael_tsk * pointer to new userdata on Lua Stack.
  * --------------------------------------------------------------------------*/
 struct t_ael_tsk
-*t_ael_tsk_create_ud( lua_State *L, lua_Integer ms )
+*t_ael_tsk_create_ud( lua_State *L, lua_Integer ns )
 {
 	struct t_ael_tsk    *tsk;
 
-	tsk = (struct t_ael_tsk *) lua_newuserdatauv( L, sizeof( struct t_ael_tsk ), 2 );
-	tsk->tout   = ms;
+	tsk = (struct t_ael_tsk *) lua_newuserdatauv( L, sizeof( struct t_ael_tsk ), 1 );
+	tsk->tout   = ns;
+	tsk->due    = ns;
+	tsk->slack  = 0;
+	tsk->seq    = 0;
+	tsk->pos    = 0;
 	luaL_getmetatable( L, T_AEL_TSK_TYPE );
 	lua_setmetatable( L, -2 );
 	return tsk;
@@ -278,7 +412,7 @@ static int
 lt_ael_tsk__tostring( lua_State *L )
 {
 	struct t_ael_tsk *tsk = t_ael_tsk_check_ud( L, 1, 1 );
-	lua_pushfstring( L, T_AEL_TSK_TYPE"{%dms}: %p", tsk->tout, tsk );
+	lua_pushfstring( L, T_AEL_TSK_TYPE"{%Ins}: %p", tsk->tout, tsk );
 	return 1;
 }
 
@@ -0,0 +1,352 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_ael_wrk.c
+ * \brief     Worker processes; each runs its own T.Loop on its own core.
+ * \detail    lua-t is single threaded and a single T.Loop saturates a single
+ *            core.  T.Loop.Worker forks n processes which all execute the same
+ *            Lua function.  Each worker has its own copy of the Lua state and
+ *            is supposed to create its own T.Loop.  Listening sockets which
+ *            are bound with SO_REUSEPORT in each worker get sharded by the
+ *            kernel across the workers.  The parent starts, stops and joins
+ *            the workers.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#define _POSIX_C_SOURCE 200809L   // kill()
+
+#include "t_ael_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+#include <errno.h>            // errno, EINTR
+#include <signal.h>           // kill, SIGTERM, sigprocmask
+#include <stdio.h>            // fflush, fprintf
+#include <stdlib.h>           // EXIT_SUCCESS, EXIT_FAILURE
+#include <unistd.h>           // fork, _exit, getpid
+#include <sys/wait.h>         // waitpid
+
+
+/**--------------------------------------------------------------------------
+ * Run the worker function in the forked child process.  Never returns.
+ * The child exits without closing the Lua state, finalizers of the copied
+ * parent objects must not run twice.  Signals blocked by a T.Loop of the
+ * parent get unblocked; the child creates its own loop.
+ * \param   L    Lua state.
+ * \param   id   int; worker number 1 … n.
+ * \lparam  fnc  function to be executed by worker.                   // 1
+ * \lparam  …    parameters to function when executed.                // 2 …
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_ael_wrk_execute( lua_State *L, int id )
+{
+	int      r;
+	sigset_t msk;
+
+	sigemptyset( &msk );
+	sigprocmask( SIG_SETMASK, &msk, NULL );
+	lua_pushinteger( L, id );     //S: fnc … id
+	lua_insert( L, 2 );           //S: fnc id …
+	if (LUA_OK != (r = lua_pcall( L, lua_gettop( L ) - 1, 0, 0 )))
+		fprintf( stderr, T_AEL_WRK_TYPE"[%d]: %s\n", id, lua_tostring( L, -1 ) );
+	fflush( NULL );
+	_exit( (LUA_OK == r) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Wait for a worker process to terminate.
+ * \param   wrk   struct t_ael_wrk*; worker userdata.
+ * \param   i     int; index of worker.
+ * \return  int   exit status of worker; -1 if not running or terminated
+ *                by a signal.
+ * --------------------------------------------------------------------------*/
+static int
+t_ael_wrk_wait( struct t_ael_wrk *wrk, int i )
+{
+	int status;
+
+	if (0 == wrk->pid[ i ])
+		return -1;
+	while (-1 == waitpid( wrk->pid[ i ], &status, 0 ))
+		if (EINTR != errno)
+			return -1;
+	wrk->pid[ i ] = 0;
+	wrk->run--;
+	return (WIFEXITED( status )) ? WEXITSTATUS( status ) : -1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create workers and push them to the LuaStack.
+ * \param   L   Lua state.
+ * \lparam  CLASS table Loop.Worker.                                   // 1
+ * \lparam  n   int; number of workers to start.                       // 2
+ * \lparam  fnc function to be executed by each worker.                // 3
+ * \lparam  …   parameters to function when executed.                  // 4 …
+ * \lreturn wrk T.Loop.Worker userdata instance.
+ * \return  int # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_wrk__Call( lua_State *L )
+{
+	int               n = luaL_checkinteger( L, 2 );
+	int               i, err;
+	struct t_ael_wrk *wrk;
+
+	luaL_argcheck( L, n > 0, 2, "number of workers must be positive" );
+	luaL_checktype( L, 3, LUA_TFUNCTION );
+	lua_remove( L, 1 );                        //S: n fnc …
+	lua_remove( L, 1 );                        //S: fnc …
+	wrk = t_ael_wrk_create_ud( L, n );         //S: fnc … wrk
+	fflush( NULL );     // don't duplicate buffered output in each worker
+	for (i=0; i<n; i++)
+	{
+		wrk->pid[ i ] = fork( );
+		if (0 == wrk->pid[ i ])
+		{
+			lua_pop( L, 1 );                     //S: fnc …
+			t_ael_wrk_execute( L, i+1 );
+		}
+		if (-1 == wrk->pid[ i ])
+		{
+			err           = errno;
+			wrk->pid[ i ] = 0;
+			for (i=0; i<wrk->cnt; i++)
+				if (wrk->pid[ i ])
+					kill( wrk->pid[ i ], SIGTERM );
+			for (i=0; i<wrk->cnt; i++)
+				t_ael_wrk_wait( wrk, i );
+			errno = err;
+			return t_push_error( L, 1, 1, "Can't fork worker" );
+		}
+		wrk->run++;
+	}
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create a new t_ael_wrk userdata and push to LuaStack.
+ * \param   L    Lua state.
+ * \param   n    int; number of workers.
+ * \return  wrk  struct t_ael_wrk * pointer to new userdata on Lua Stack.
+ * --------------------------------------------------------------------------*/
+struct t_ael_wrk
+*t_ael_wrk_create_ud( lua_State *L, int n )
+{
+	struct t_ael_wrk    *wrk;
+	int                  i;
+
+	wrk = (struct t_ael_wrk *) lua_newuserdatauv( L,
+	          sizeof( struct t_ael_wrk ) + n * sizeof( pid_t ), 0 );
+	wrk->cnt = n;
+	wrk->run = 0;
+	wrk->own = getpid( );
+	for (i=0; i<n; i++)
+		wrk->pid[ i ] = 0;
+	luaL_getmetatable( L, T_AEL_WRK_TYPE );
+	lua_setmetatable( L, -2 );
+	return wrk;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check a value on the stack for being a struct t_ael_wrk
+ * \param   L      Lua state.
+ * \param   int    position on the stack
+ * \param   int    check(boolean): if true error out on fail
+ * \return  struct t_ael_wrk*  pointer to userdata on stack
+ * --------------------------------------------------------------------------*/
+struct t_ael_wrk
+*t_ael_wrk_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_AEL_WRK_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_AEL_WRK_TYPE );
+	return (NULL==ud) ? NULL : (struct t_ael_wrk *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Send a signal to all running workers.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Worker userdata instance.                     // 1
+ * \lparam  int  signal; default SIGTERM.                             // 2
+ * \lreturn int  number of workers signalled.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_wrk_stop( lua_State *L )
+{
+	struct t_ael_wrk *wrk = t_ael_wrk_check_ud( L, 1, 1 );
+	int               sig = luaL_optinteger( L, 2, SIGTERM );
+	int               i, c = 0;
+
+	for (i=0; i<wrk->cnt; i++)
+		if (wrk->pid[ i ] && 0 == kill( wrk->pid[ i ], sig ))
+			c++;
+	lua_pushinteger( L, c );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Wait for all workers to terminate.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Worker userdata instance.                     // 1
+ * \lreturn bool true if all workers exited successfully.
+ * \lreturn int  number of workers which failed.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_wrk_join( lua_State *L )
+{
+	struct t_ael_wrk *wrk = t_ael_wrk_check_ud( L, 1, 1 );
+	int               i, c = 0;
+
+	for (i=0; i<wrk->cnt; i++)
+		if (wrk->pid[ i ] && EXIT_SUCCESS != t_ael_wrk_wait( wrk, i ))
+			c++;
+	lua_pushboolean( L, 0 == c );
+	lua_pushinteger( L, c );
+	return 2;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Garbage Collector.  Terminate and reap workers which were not joined, so
+ * they don't keep running or linger as zombies.  Does nothing in a worker
+ * which closes its copy of the Lua state; its siblings are not its children.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Worker userdata instance.                     // 1
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_wrk__gc( lua_State *L )
+{
+	struct t_ael_wrk *wrk = t_ael_wrk_check_ud( L, 1, 1 );
+	int               i;
+
+	if (0 == wrk->run || getpid( ) != wrk->own)
+		return 0;
+	for (i=0; i<wrk->cnt; i++)
+		if (wrk->pid[ i ])
+			kill( wrk->pid[ i ], SIGTERM );
+	for (i=0; i<wrk->cnt; i++)
+		t_ael_wrk_wait( wrk, i );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the process id of a worker.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Worker userdata instance.                     // 1
+ * \lparam  int  worker number 1 … n.                                 // 2
+ * \lreturn int  process id; nil if worker is not running.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_wrk_pid( lua_State *L )
+{
+	struct t_ael_wrk *wrk = t_ael_wrk_check_ud( L, 1, 1 );
+	int               i   = luaL_checkinteger( L, 2 );
+
+	luaL_argcheck( L, i > 0 && i <= wrk->cnt, 2, "worker number out of range" );
+	if (wrk->pid[ i-1 ])
+		lua_pushinteger( L, wrk->pid[ i-1 ] );
+	else
+		lua_pushnil( L );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get number of workers.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Loop.Worker userdata instance.                     // 1
+ * \lreturn int  number of workers.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_wrk__len( lua_State *L )
+{
+	struct t_ael_wrk *wrk = t_ael_wrk_check_ud( L, 1, 1 );
+	lua_pushinteger( L, wrk->cnt );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Prints the Worker.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Loop.Worker userdata instance.                     // 1
+ * \lreturn string formatted string representing T.Loop.Worker.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_ael_wrk__tostring( lua_State *L )
+{
+	struct t_ael_wrk *wrk = t_ael_wrk_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_AEL_WRK_TYPE"{%d/%d}: %p", wrk->run, wrk->cnt, wrk );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Class metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_ael_wrk_fm [] = {
+	  { "__call",        lt_ael_wrk__Call        }
+	, { NULL,            NULL                    }
+};
+
+/**--------------------------------------------------------------------------
+ * Class functions library definition
+ * --------------------------------------------------------------------------*/
+static const luaL_Reg t_ael_wrk_cf [] = {
+	  { NULL,  NULL }
+};
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_ael_wrk_m [] = {
+	// metamethods
+	  { "__len",         lt_ael_wrk__len         }
+	, { "__tostring",    lt_ael_wrk__tostring    }
+	, { "__gc",          lt_ael_wrk__gc          }
+	// instance methods
+	, { "stop",          lt_ael_wrk_stop         }
+	, { "join",          lt_ael_wrk_join         }
+	, { "pid",           lt_ael_wrk_pid          }
+	, { NULL,            NULL                    }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Pushes the Loop.Worker library onto the stack
+ *          - creates Metatable with functions
+ *          - creates metatable with methods
+ * \param   L     The lua state.
+ * \lreturn table the library
+ * \return  int   # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_ael_wrk( lua_State *L )
+{
+	// T.Loop.Worker instance metatable
+	luaL_newmetatable( L, T_AEL_WRK_TYPE );
+	luaL_setfuncs( L, t_ael_wrk_m, 0 );
+	lua_setfield( L, -1, "__index" );    // pops the metatable
+
+	// T.Loop.Worker class
+	luaL_newlib( L, t_ael_wrk_cf );
+	luaL_newlib( L, t_ael_wrk_fm );
+	lua_setmetatable( L, -2 );
+	return 1;
+}
@@ -7,6 +7,10 @@
  * \copyright See Copyright notice at the end of t.h
  */
 
+#include <stdint.h>      // SIZE_MAX
+#include <stdlib.h>      // realloc
+#include <string.h>      // memcpy
+
 #include "t_buf.h"
 #include "t.h"           // t_typeerror
 
@@ -46,6 +50,341 @@ struct t_buf_seg
 }
 
 
+/**--------------------------------------------------------------------------
+ * Check if the item on stack position pos is an t_buf_rng struct and return it
+ * \param  L    the Lua State
+ * \param  pos  position on the stack
+ *
+ * \return struct t_buf_rng* pointer to t_buf_rng struct
+ * --------------------------------------------------------------------------*/
+struct t_buf_rng
+*t_buf_rng_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_BUF_RNG_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_BUF_RNG_TYPE );
+	return (NULL==ud) ? NULL : (struct t_buf_rng *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check if the item on stack position pos is an t_buf_chn struct and return it
+ * \param  L    the Lua State
+ * \param  pos  position on the stack
+ *
+ * \return struct t_buf_chn* pointer to t_buf_chn struct
+ * --------------------------------------------------------------------------*/
+struct t_buf_chn
+*t_buf_chn_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_BUF_CHN_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_BUF_CHN_TYPE );
+	return (NULL==ud) ? NULL : (struct t_buf_chn *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check if the item on stack position pos is an t_buf_map struct and return it
+ * \param  L    the Lua State
+ * \param  pos  position on the stack
+ *
+ * \return struct t_buf_map* pointer to t_buf_map struct
+ * --------------------------------------------------------------------------*/
+struct t_buf_map
+*t_buf_map_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_BUF_MAP_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_BUF_MAP_TYPE );
+	return (NULL==ud) ? NULL : (struct t_buf_map *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check if the item on stack position pos is an t_buf_pol struct and return it
+ * \param  L    the Lua State
+ * \param  pos  position on the stack
+ *
+ * \return struct t_buf_pol* pointer to t_buf_pol struct
+ * --------------------------------------------------------------------------*/
+struct t_buf_pol
+*t_buf_pol_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_BUF_POL_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_BUF_POL_TYPE );
+	return (NULL==ud) ? NULL : (struct t_buf_pol *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check if the item on stack position pos is an t_buf_slt struct and return it
+ * \param  L    the Lua State
+ * \param  pos  position on the stack
+ *
+ * \return struct t_buf_slt* pointer to t_buf_slt struct
+ * --------------------------------------------------------------------------*/
+struct t_buf_slt
+*t_buf_slt_check_ud( lua_State *L, int pos, int check )
+{
+	void *ud = luaL_testudata( L, pos, T_BUF_SLT_TYPE );
+	if (NULL == ud && check) t_typeerror( L , pos, T_BUF_SLT_TYPE );
+	return (NULL==ud) ? NULL : (struct t_buf_slt *) ud;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Hand out a buffer from a pool and push it to LuaStack.  It comes from the
+ * slab if a slot is free, otherwise it gets allocated separately.  The Slot
+ * userdata is new on each call.  Handing out released Slots again would let
+ * stale references release a buffer in use, and a Slot the pool keeps alive
+ * could never be returned by __gc.
+ * \param   L     Lua state.
+ * \param   pos   position of T.Buffer.Pool on stack.
+ * \lreturn ud    T.Buffer.Pool.Slot userdata instance.
+ * \return  struct t_buf_slt* pointer to the t_buf_slt struct
+ * --------------------------------------------------------------------------*/
+struct t_buf_slt
+*t_buf_pol_acquire( lua_State *L, int pos )
+{
+	struct t_buf_pol *pol = t_buf_pol_check_ud( L, pos, 1 );
+	struct t_buf_slt *slt;
+
+	pos      = lua_absindex( L, pos );
+	slt      = (struct t_buf_slt *) lua_newuserdatauv( L, sizeof( struct t_buf_slt ), 1 );
+	slt->len = 0;
+	slt->idx = pol->count;
+	slt->b   = NULL;
+	luaL_getmetatable( L, T_BUF_SLT_TYPE );
+	lua_setmetatable( L, -2 );
+	lua_pushvalue( L, pos );
+	lua_setiuservalue( L, -2, T_BUF_SLT_POLIDX );        //S: pol … slt
+	if (pol->nfree > 0)
+	{
+		slt->idx = pol->fre[ --pol->nfree ];
+		slt->b   = pol->slab + slt->idx * pol->size;
+		pol->hits++;
+	}
+	else
+	{
+		if (NULL == (slt->b = (char *) malloc( pol->size )))
+			luaL_error( L, "couldn't allocate "T_BUF_SLT_TYPE );
+		pol->misses++;
+	}
+	slt->len = pol->size;
+	pol->hwm = (++pol->used > pol->hwm) ? pol->used : pol->hwm;
+	return slt;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Give a buffer back to its pool.  Afterwards the slot is empty.
+ * \param   L     Lua state.
+ * \param   pos   position of T.Buffer.Pool.Slot on stack.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_slt_release( lua_State *L, int pos )
+{
+	struct t_buf_slt *slt = t_buf_slt_check_ud( L, pos, 1 );
+	struct t_buf_pol *pol;
+
+	if (NULL == slt->b)
+		return;
+	lua_getiuservalue( L, pos, T_BUF_SLT_POLIDX );       //S: slt … pol
+	pol = t_buf_pol_check_ud( L, -1, 1 );
+	lua_pop( L, 1 );
+	if (slt->idx < pol->count)
+	{
+		if (NULL != pol->fre)                              // pool not collected yet
+			pol->fre[ pol->nfree++ ] = slt->idx;
+	}
+	else
+		free( slt->b );
+	pol->used--;
+	slt->b   = NULL;
+	slt->len = 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Reverse a range of bytes in place.
+ * \param  *b    char*; first byte.
+ * \param   n    size_t; number of bytes.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_buf_rng_reverse( char *b, size_t n )
+{
+	char   c;
+	size_t i;
+
+	for (i=0; i < n/2; i++)
+	{
+		c          = b[ i ];
+		b[ i ]     = b[ n-1-i ];
+		b[ n-1-i ] = c;
+	}
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make the readable bytes of a ring contiguous.
+ * Only a ring whose readable bytes wrap around gets rotated in place, which
+ * costs one pass over the storage and no allocation.
+ * \param  *rng  struct t_buf_rng*; the ring.
+ * \return  char* pointer to first readable byte.
+ * --------------------------------------------------------------------------*/
+char
+*t_buf_rng_linearize( struct t_buf_rng *rng )
+{
+	if (rng->hd + rng->len > rng->cap)
+	{
+		t_buf_rng_reverse( rng->b, rng->hd );
+		t_buf_rng_reverse( rng->b + rng->hd, rng->cap - rng->hd );
+		t_buf_rng_reverse( rng->b, rng->cap );
+		rng->hd = 0;
+	}
+	return rng->b + rng->hd;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make room for n bytes and get the contiguous free space after the readable
+ * bytes.  The capacity doubles until n bytes fit.  The free space can wrap
+ * around, hence len can be smaller than n.
+ * \param  *rng  struct t_buf_rng*; the ring.
+ * \param   n    size_t; bytes which must fit into the ring.
+ * \param  *len  size_t*; receives length of contiguous free space.
+ * \return  char* pointer to free space; NULL if growing failed or the
+ *                capacity would overflow.
+ * --------------------------------------------------------------------------*/
+char
+*t_buf_rng_reserve( struct t_buf_rng *rng, size_t n, size_t *len )
+{
+	size_t  cap = rng->cap;
+	size_t  tl;
+	char   *b;
+
+	if (n > SIZE_MAX / 2 - rng->len)     // doubling cap would overflow
+		return NULL;
+	while (cap - rng->len < n)
+		cap <<= 1;
+	if (cap != rng->cap)
+	{
+		if (NULL == (b = (char *) realloc( rng->b, cap )))
+			return NULL;
+		if (rng->hd + rng->len > rng->cap)   // move wrapped bytes behind the old end
+			memcpy( b + rng->cap, b, rng->hd + rng->len - rng->cap );
+		rng->b   = b;
+		rng->cap = cap;
+	}
+	tl   = rng->hd + rng->len;
+	*len = (tl < rng->cap) ? rng->cap - tl : rng->hd - (tl - rng->cap);
+	return rng->b + (tl & (rng->cap - 1));
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make n bytes written to the free space readable.
+ * \param  *rng  struct t_buf_rng*; the ring.
+ * \param   n    size_t; number of bytes written.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_rng_commit( struct t_buf_rng *rng, size_t n )
+{
+	rng->len += n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Drop up to n readable bytes; just advances the head.
+ * \param  *rng  struct t_buf_rng*; the ring.
+ * \param   n    size_t; number of bytes.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_rng_consume( struct t_buf_rng *rng, size_t n )
+{
+	n         = (n < rng->len) ? n : rng->len;
+	rng->len -= n;
+	rng->hd   = (0 == rng->len) ? 0 : (rng->hd + n) & (rng->cap - 1);
+}
+
+
+/**--------------------------------------------------------------------------
+ * Get the readable bytes of a chain as list of pointers and lengths, eg. to
+ * fill an iovec.  Empty entries are skipped.  The pointers stay valid as long
+ * as the entries are in the chain.
+ * \param   L     Lua state.
+ * \param   pos   position of T.Buffer.Chain on stack.
+ * \param  *p     char*[max]; receives start of parts.
+ * \param  *l     size_t[max]; receives length of parts.
+ * \param   max   int; maximum number of parts.
+ * \return  int   number of parts filled in.
+ * --------------------------------------------------------------------------*/
+int
+t_buf_chn_parts( lua_State *L, int pos, char **p, size_t *l, int max )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, pos, 1 );
+	size_t            ofs = chn->ofs;
+	lua_Integer       i;
+	int               n   = 0;
+
+	lua_getiuservalue( L, pos, T_BUF_CHN_LSTIDX );         //S: chn … lst
+	for (i=chn->hd; i<chn->tl && n<max; i++, ofs=0)
+	{
+		lua_rawgeti( L, -1, i );                            //S: chn … lst ent
+		p[ n ] = t_buf_tolstring( L, -1, &(l[ n ]), NULL );
+		lua_pop( L, 1 );
+		if (l[ n ] > ofs)
+		{
+			p[ n ] += ofs;
+			l[ n ] -= ofs;
+			n++;
+		}
+	}
+	lua_pop( L, 1 );
+	return n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Drop bytes from the head of a chain.  Entries which are entirely consumed
+ * get released, a partially consumed entry just moves the offset.
+ * \param   L     Lua state.
+ * \param   pos   position of T.Buffer.Chain on stack.
+ * \param   n     size_t; number of bytes.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_chn_consume( lua_State *L, int pos, size_t n )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, pos, 1 );
+	size_t            len;
+
+	chn->len = (n < chn->len) ? chn->len - n : 0;
+	lua_getiuservalue( L, pos, T_BUF_CHN_LSTIDX );         //S: chn … lst
+	while (chn->hd < chn->tl)
+	{
+		lua_rawgeti( L, -1, chn->hd );                      //S: chn … lst ent
+		t_buf_tolstring( L, -1, &len, NULL );
+		lua_pop( L, 1 );
+		len = (len > chn->ofs) ? len - chn->ofs : 0;
+		if (n < len)
+		{
+			chn->ofs += n;
+			break;
+		}
+		n -= len;
+		lua_pushnil( L );
+		lua_rawseti( L, -2, chn->hd++ );
+		chn->ofs = 0;
+	}
+	if (chn->hd == chn->tl)
+		chn->hd = chn->tl = 1;
+	lua_pop( L, 1 );
+}
+
+
 /**--------------------------------------------------------------------------
  * Get the char *buffer from either a t.Buffer or a t.Buffer.Segment or Lua string.
  * \param   L     Lua state.
@@ -56,6 +395,12 @@ struct t_buf_seg
  *      OR
  * \lparam  seg  T.Buffer.Segment userdata instance.
  *      OR
+ * \lparam  rng  T.Buffer.Ring userdata instance; its readable bytes.
+ *      OR
+ * \lparam  map  T.Buffer.Map userdata instance.
+ *      OR
+ * \lparam  slt  T.Buffer.Pool.Slot userdata instance.
+ *      OR
  * \lparam  b    Lua string.
  * \return  char*  # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
@@ -64,6 +409,9 @@ char
 {
 	struct t_buf     *buf = t_buf_check_ud( L, pos, 0 );
 	struct t_buf_seg *seg = t_buf_seg_check_ud( L, pos, 0 );
+	struct t_buf_rng *rng;
+	struct t_buf_map *map;
+	struct t_buf_slt *slt;
 
 	if (NULL != buf)
 	{
@@ -77,10 +425,28 @@ char
 		if (len)
 			*len = seg->len;
 		if (NULL!=cw) *cw  = 1;
-		lua_getiuservalue( L, pos, T_BUF_SEG_BUFIDX );     //S: seg idx buf
-		buf = t_buf_check_ud( L, -1, 1 );
-		lua_pop( L, 1 );
-		return &(buf->b[ seg->idx - 1 ]);
+		return &(seg->buf->b[ seg->idx - 1 ]);
+	}
+	else if (NULL != (rng = t_buf_rng_check_ud( L, pos, 0 )))
+	{
+		if (len)
+			*len = rng->len;
+		if (NULL!=cw) *cw  = 1;
+		return t_buf_rng_linearize( rng );
+	}
+	else if (NULL != (map = t_buf_map_check_ud( L, pos, 0 )))
+	{
+		if (len)
+			*len = map->len;
+		if (NULL!=cw) *cw  = map->wr;
+		return (NULL == map->b) ? (char*) "" : map->b;
+	}
+	else if (NULL != (slt = t_buf_slt_check_ud( L, pos, 0 )))
+	{
+		if (len)
+			*len = slt->len;
+		if (NULL!=cw) *cw  = 1;
+		return (NULL == slt->b) ? (char*) "" : slt->b;
 	}
 	else if (LUA_TSTRING == lua_type( L, pos))
 	{
@@ -102,6 +468,12 @@ char
  *      OR
  * \lparam  seg  T.Buffer.Segment userdata instance.
  *      OR
+ * \lparam  rng  T.Buffer.Ring userdata instance; its readable bytes.
+ *      OR
+ * \lparam  map  T.Buffer.Map userdata instance.
+ *      OR
+ * \lparam  slt  T.Buffer.Pool.Slot userdata instance.
+ *      OR
  * \lparam  b    Lua string.
  * \return  char*  # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
@@ -124,6 +496,12 @@ char
  *      OR
  * \lparam  seg  T.Buffer.Segment userdata instance.
  *      OR
+ * \lparam  rng  T.Buffer.Ring userdata instance; its readable bytes.
+ *      OR
+ * \lparam  map  T.Buffer.Map userdata instance.
+ *      OR
+ * \lparam  slt  T.Buffer.Pool.Slot userdata instance.
+ *      OR
  * \lparam  b    Lua string.
  * \return  char*  # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
@@ -132,10 +510,13 @@ t_buf_isstring( lua_State *L, int pos, int *cw )
 {
 	struct t_buf     *buf = t_buf_check_ud( L, pos, 0 );
 	struct t_buf_seg *seg = t_buf_seg_check_ud( L, pos, 0 );
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, pos, 0 );
+	struct t_buf_map *map = t_buf_map_check_ud( L, pos, 0 );
+	struct t_buf_slt *slt = t_buf_slt_check_ud( L, pos, 0 );
 
-	if (NULL != buf || NULL != seg || lua_isstring( L , pos ))
+	if (NULL != buf || NULL != seg || NULL != rng || NULL != map || NULL != slt || lua_isstring( L , pos ))
 	{
-		*cw = (lua_isstring( L, pos )) ? 0 : 1;
+		*cw = (lua_isstring( L, pos )) ? 0 : (NULL != map) ? map->wr : 1;
 		return 1;
 	}
 	else
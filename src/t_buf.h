@@ -14,12 +14,27 @@
 
 #define T_BUF_IDNT "buf"
 #define T_BUF_SEG_IDNT  "seg"
+#define T_BUF_RNG_IDNT  "rng"
+#define T_BUF_CHN_IDNT  "chn"
+#define T_BUF_MAP_IDNT  "map"
+#define T_BUF_POL_IDNT  "pol"
+#define T_BUF_SLT_IDNT  "slt"
 
 #define T_BUF_NAME "Buffer"
 #define T_BUF_SEG_NAME  "Segment"
+#define T_BUF_RNG_NAME  "Ring"
+#define T_BUF_CHN_NAME  "Chain"
+#define T_BUF_MAP_NAME  "Map"
+#define T_BUF_POL_NAME  "Pool"
+#define T_BUF_SLT_NAME  "Slot"
 
 #define T_BUF_TYPE "T."T_BUF_NAME
 #define T_BUF_SEG_TYPE  T_BUF_TYPE"."T_BUF_SEG_NAME
+#define T_BUF_RNG_TYPE  T_BUF_TYPE"."T_BUF_RNG_NAME
+#define T_BUF_CHN_TYPE  T_BUF_TYPE"."T_BUF_CHN_NAME
+#define T_BUF_MAP_TYPE  T_BUF_TYPE"."T_BUF_MAP_NAME
+#define T_BUF_POL_TYPE  T_BUF_TYPE"."T_BUF_POL_NAME
+#define T_BUF_SLT_TYPE  T_BUF_POL_TYPE"."T_BUF_SLT_NAME
 
 /// The userdata struct for t.Buffer
 struct t_buf {
@@ -30,9 +45,72 @@ struct t_buf {
 #define T_BUF_SEG_BUFIDX   1       ///< Buffer uservalue index on segment
 
 /// The userdata struct for t.Buffer.Segment
+/// buf caches the parent T.Buffer which is also stored as uservalue.  The
+/// uservalue keeps the parent alive and it never gets replaced.  Lua doesn't
+/// move or resize userdata, so the pointer stays valid for the segment's
+/// lifetime and accessing the bytes needs no stack operations.
 struct t_buf_seg {
-	size_t   idx;   ///<  offset from buffer start
-	size_t   len;   ///<  length of segment
+	size_t        idx;   ///<  offset from buffer start
+	size_t        len;   ///<  length of segment
+	struct t_buf *buf;   ///<  parent buffer
+};
+
+/// The userdata struct for t.Buffer.Ring
+/// The readable bytes start at hd and may wrap around the end of b.  The
+/// capacity is a power of 2, so wrapping is a mask operation.  b is allocated
+/// separately since the ring grows.
+struct t_buf_rng {
+	size_t   cap;   ///<  capacity of b in bytes; power of 2
+	size_t   hd;    ///<  offset of first readable byte in b
+	size_t   len;   ///<  number of readable bytes
+	char    *b;     ///<  storage
+};
+
+#define T_BUF_CHN_LSTIDX   1       ///< entry list uservalue index on chain
+
+/// The userdata struct for t.Buffer.Chain
+/// The entries are Lua strings, Buffers or Segments, referenced from the list
+/// at uservalue T_BUF_CHN_LSTIDX at indexes hd to tl-1.  The first ofs bytes of
+/// the first entry are already consumed.
+struct t_buf_chn {
+	lua_Integer  hd;    ///<  list index of first entry
+	lua_Integer  tl;    ///<  list index behind last entry
+	size_t       ofs;   ///<  consumed bytes of first entry
+	size_t       len;   ///<  number of readable bytes in all entries
+};
+
+/// The userdata struct for t.Buffer.Map
+/// A file mapped into memory.  b is NULL for an empty file and once the
+/// mapping got closed.
+struct t_buf_map {
+	size_t   len;   ///<  length of the mapping in bytes
+	char    *b;     ///<  start of the mapping
+	int      wr;    ///<  mapping is writable
+};
+
+/// The userdata struct for t.Buffer.Pool
+/// count buffers of size bytes each are carved from a single slab.  Free
+/// slots are kept as a stack of indexes.  Once the slab is exhausted buffers
+/// get allocated one by one and freed again on release.
+struct t_buf_pol {
+	size_t   size;   ///<  size of each buffer in bytes
+	size_t   count;  ///<  number of buffers in the slab
+	size_t   nfree;  ///<  number of free slots on fre
+	size_t   used;   ///<  number of buffers handed out
+	size_t   hwm;    ///<  high water mark of used
+	size_t   hits;   ///<  acquires served from the slab
+	size_t   misses; ///<  acquires which had to allocate
+	size_t  *fre;    ///<  stack of free slot indexes
+	char    *slab;   ///<  count * size bytes
+};
+
+#define T_BUF_SLT_POLIDX   1       ///< Pool uservalue index on slot
+
+/// The userdata struct for t.Buffer.Pool.Slot, a buffer handed out by a pool
+struct t_buf_slt {
+	size_t   len;   ///<  length in use; at most the pools size
+	size_t   idx;   ///<  index in slab; the pools count if allocated separately
+	char    *b;     ///<  storage; NULL once released
 };
 
 /// Functions to check t.Buffer/Segments and retrieve the char* pointer from it
@@ -41,3 +119,16 @@ char         *t_buf_tolstring   ( lua_State *L, int pos, size_t *len, int *cw );
 char         *t_buf_checklstring( lua_State *L, int pos, size_t *len, int *cw );
 int           t_buf_isstring    ( lua_State *L, int pos, int *cw );
 struct t_buf_seg *t_buf_seg_check_ud  ( lua_State *L, int pos, int check );
+struct t_buf_rng *t_buf_rng_check_ud  ( lua_State *L, int pos, int check );
+char             *t_buf_rng_linearize ( struct t_buf_rng *rng );
+char             *t_buf_rng_reserve   ( struct t_buf_rng *rng, size_t n, size_t *len );
+void              t_buf_rng_commit    ( struct t_buf_rng *rng, size_t n );
+void              t_buf_rng_consume   ( struct t_buf_rng *rng, size_t n );
+struct t_buf_chn *t_buf_chn_check_ud  ( lua_State *L, int pos, int check );
+int               t_buf_chn_parts     ( lua_State *L, int pos, char **p, size_t *l, int max );
+void              t_buf_chn_consume   ( lua_State *L, int pos, size_t n );
+struct t_buf_map *t_buf_map_check_ud  ( lua_State *L, int pos, int check );
+struct t_buf_pol *t_buf_pol_check_ud  ( lua_State *L, int pos, int check );
+struct t_buf_slt *t_buf_slt_check_ud  ( lua_State *L, int pos, int check );
+struct t_buf_slt *t_buf_pol_acquire   ( lua_State *L, int pos );
+void              t_buf_slt_release   ( lua_State *L, int pos );
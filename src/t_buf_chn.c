@@ -0,0 +1,352 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_buf_chn.c
+ * \brief     OOP wrapper for a scatter/gather list T.Buffer.Chain
+ *            Collects Lua strings, Buffers and Segments by reference so a
+ *            message composed of many parts can be sent without
+ *            concatenating them first.
+ * \detail    Net.Socket:send() passes all entries to a single sendmsg() and
+ *            consumes what got sent.  Consuming releases entries which are
+ *            sent entirely and moves an offset into a partially sent one;
+ *            no data gets copied.  Buffers and Segments are referenced, so
+ *            changes to their content are visible in the chain.  They must
+ *            not change their size while they are in the chain.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+
+#include <string.h>               // strcmp
+
+#include "t_buf_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+
+/**--------------------------------------------------------------------------
+ * Push up to n readable bytes as Lua string.
+ * \param   L    Lua state.
+ * \param   pos  position of T.Buffer.Chain on stack.
+ * \param   n    size_t; number of bytes.
+ * \lreturn str  Lua string.
+ * \return  size_t number of bytes pushed.
+ * --------------------------------------------------------------------------*/
+static size_t
+t_buf_chn_push( lua_State *L, int pos, size_t n )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, pos, 1 );
+	size_t            ofs = chn->ofs;
+	size_t            len, cnt = 0;
+	lua_Integer       i;
+	int               lst;
+	char             *dat;
+	luaL_Buffer       lB;
+
+	n   = (n < chn->len) ? n : chn->len;
+	lua_getiuservalue( L, pos, T_BUF_CHN_LSTIDX );         //S: chn … lst
+	lst = lua_gettop( L );
+	luaL_buffinitsize( L, &lB, n );                        //S: chn … lst lB
+	for (i=chn->hd; i<chn->tl && cnt<n; i++, ofs=0)
+	{
+		lua_rawgeti( L, lst, i );                           //S: chn … lst lB ent
+		dat = t_buf_tolstring( L, -1, &len, NULL );
+		lua_pop( L, 1 );
+		if (len > ofs)
+		{
+			len = (len - ofs < n - cnt) ? len - ofs : n - cnt;
+			luaL_addlstring( &lB, dat + ofs, len );
+			cnt += len;
+		}
+	}
+	luaL_pushresult( &lB );                                //S: chn … lst str
+	lua_remove( L, -2 );
+	return cnt;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Append values to the chain by reference.
+ * \param   L    Lua state.
+ * \param   pos  position of T.Buffer.Chain on stack.
+ * \param   fst  position of first value to append.
+ * \param   lst  position of last value to append.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_buf_chn_append( lua_State *L, int pos, int fst, int lst )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, pos, 1 );
+	size_t            len;
+	int               i;
+
+	lua_getiuservalue( L, pos, T_BUF_CHN_LSTIDX );         //S: chn … lst
+	for (i=fst; i<=lst; i++)
+	{
+		luaL_argcheck( L, NULL == t_buf_rng_check_ud( L, i, 0 ) && NULL == t_buf_chn_check_ud( L, i, 0 ),
+			i, "can't reference a "T_BUF_RNG_TYPE" or "T_BUF_CHN_TYPE );
+		t_buf_checklstring( L, i, &len, NULL );
+		lua_pushvalue( L, i );
+		lua_rawseti( L, -2, chn->tl++ );
+		chn->len += len;
+	}
+	lua_pop( L, 1 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create a T.Buffer.Chain and push to LuaStack.
+ * \param   L    Lua state.
+ * \lreturn ud   T.Buffer.Chain userdata instance.
+ * \return  struct t_buf_chn* pointer to the t_buf_chn struct
+ * --------------------------------------------------------------------------*/
+struct t_buf_chn
+*t_buf_chn_create_ud( lua_State *L )
+{
+	struct t_buf_chn *chn = (struct t_buf_chn *) lua_newuserdatauv( L, sizeof( struct t_buf_chn ), 1 );
+
+	chn->hd  = 1;
+	chn->tl  = 1;
+	chn->ofs = 0;
+	chn->len = 0;
+	lua_newtable( L );
+	lua_setiuservalue( L, -2, T_BUF_CHN_LSTIDX );
+	luaL_getmetatable( L, T_BUF_CHN_TYPE );
+	lua_setmetatable( L, -2 );
+	return chn;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Constructor - creates the chain.
+ * \param   L      Lua state.
+ * \lparam  CLASS  table Buffer.Chain.
+ * \lparam  data   T.Buffer, T.Buffer.Segment or Lua string; any number.
+ * \lreturn ud     T.Buffer.Chain userdata instance.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_chn__Call( lua_State *L )
+{
+	int n = lua_gettop( L );
+
+	t_buf_chn_create_ud( L );
+	t_buf_chn_append( L, n+1, 2, n );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Append data to the chain; nothing gets copied.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Chain userdata instance.
+ * \lparam  data   T.Buffer, T.Buffer.Segment or Lua string; any number.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_chn_write( lua_State *L )
+{
+	t_buf_chn_check_ud( L, 1, 1 );
+	t_buf_chn_append( L, 1, 2, lua_gettop( L ) );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read and consume bytes from the chain.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Chain userdata instance.
+ * \lparam  int    maximum number of bytes; defaults to all readable bytes.
+ * \lreturn string Lua string.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_chn_read( lua_State *L )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, 1, 1 );
+	lua_Integer       n   = luaL_optinteger( L, 2, (lua_Integer) chn->len );
+
+	luaL_argcheck( L, n >= 0, 2, "length must not be negative" );
+	t_buf_chn_consume( L, 1, t_buf_chn_push( L, 1, (size_t) n ) );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read bytes from the chain without consuming them.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Chain userdata instance.
+ * \lparam  int    maximum number of bytes; defaults to all readable bytes.
+ * \lreturn string Lua string.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_chn_peek( lua_State *L )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, 1, 1 );
+	lua_Integer       n   = luaL_optinteger( L, 2, (lua_Integer) chn->len );
+
+	luaL_argcheck( L, n >= 0, 2, "length must not be negative" );
+	t_buf_chn_push( L, 1, (size_t) n );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Drop bytes from the head of the chain.  Nothing gets copied.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Chain userdata instance.
+ * \lparam  int    number of bytes.
+ * \lreturn int    number of bytes dropped.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_chn_consume( lua_State *L )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, 1, 1 );
+	lua_Integer       n   = luaL_checkinteger( L, 2 );
+
+	luaL_argcheck( L, n >= 0, 2, "length must not be negative" );
+	n = (n < (lua_Integer) chn->len) ? n : (lua_Integer) chn->len;
+	t_buf_chn_consume( L, 1, (size_t) n );
+	lua_pushinteger( L, n );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Release all entries.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Chain userdata instance.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_chn_clear( lua_State *L )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, 1, 1 );
+
+	lua_newtable( L );
+	lua_setiuservalue( L, 1, T_BUF_CHN_LSTIDX );
+	chn->hd  = 1;
+	chn->tl  = 1;
+	chn->ofs = 0;
+	chn->len = 0;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Returns number of readable bytes.
+ * \param   L    Lua state
+ * \lparam  ud   T.Buffer.Chain userdata instance.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_chn__len( lua_State *L )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, 1, 1 );
+
+	lua_pushinteger( L, (lua_Integer) chn->len );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * __index method for T.Buffer.Chain.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Chain userdata instance.
+ * \lparam  string Access key value; count or method name.
+ * \lreturn value  based on what's behind __index.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_chn__index( lua_State *L )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, 1, 1 );
+	const char       *key = luaL_checkstring( L, 2 );
+
+	if (0 == strcmp( key, "count" ))
+		lua_pushinteger( L, chn->tl - chn->hd );
+	else
+	{
+		lua_getmetatable( L, 1 );  //S: chn key _mt
+		lua_pushvalue( L, 2 );     //S: chn key _mt key
+		lua_gettable( L, -2 );     //S: chn key _mt val
+	}
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Return Tostring representation of a chain.
+ * \param   L      Lua state
+ * \lparam  ud     T.Buffer.Chain userdata instance.
+ * \lreturn string Formatted string representing chain.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_chn__tostring( lua_State *L )
+{
+	struct t_buf_chn *chn = t_buf_chn_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_BUF_CHN_TYPE"[%d/%d]: %p", chn->len, chn->tl - chn->hd, chn );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Class metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_buf_chn_fm [] = {
+	  { "__call"       , lt_buf_chn__Call }
+	, { NULL           , NULL }
+};
+
+/**--------------------------------------------------------------------------
+ * Class functions library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_buf_chn_cf [] = {
+	  { NULL           , NULL }
+};
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const luaL_Reg t_buf_chn_m [] = {
+	// metamethods
+	  { "__tostring"   , lt_buf_chn__tostring }
+	, { "__index"      , lt_buf_chn__index }
+	, { "__len"        , lt_buf_chn__len }
+	// instance methods
+	, { "write"        , lt_buf_chn_write }
+	, { "read"         , lt_buf_chn_read }
+	, { "peek"         , lt_buf_chn_peek }
+	, { "consume"      , lt_buf_chn_consume }
+	, { "clear"        , lt_buf_chn_clear }
+	, { NULL           , NULL }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Pushes this library onto the stack.
+ *          - creates Metatable with functions
+ *          - creates metatable with methods
+ * \param   L      The lua state.
+ * \lreturn table  the library
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_buf_chn( lua_State *L )
+{
+	// T.Buffer.Chain instance metatable
+	luaL_newmetatable( L, T_BUF_CHN_TYPE );
+	luaL_setfuncs( L, t_buf_chn_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+
+	// T.Buffer.Chain class
+	luaL_newlib( L, t_buf_chn_cf );
+	luaL_newlib( L, t_buf_chn_fm );
+	lua_setmetatable( L, -2 );
+	return 1;
+}
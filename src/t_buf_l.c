@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>               // memset,memcpy
+#include <ctype.h>                // isspace
 
 #include "t_buf_l.h"
 
@@ -183,20 +184,49 @@ lt_buf_toHexString( lua_State *L )
 {
 	size_t                   len; // length of buffer/segment/string
 	char                    *buf = t_buf_checklstring( L, 1, &len, NULL );
-	size_t                     n;
-	char              hexChars[] = "0123456789ABCDEF";
 	luaL_Buffer               lB;
-	luaL_buffinit( L, &lB );
 
-	for (n=0; n<len; n++)
+	if (0 == len)
 	{
-		luaL_addchar( &lB, hexChars[ buf[n] >> 4 & 0x0F ] );
-		luaL_addchar( &lB, hexChars[ buf[n]      & 0x0F ] );
-		if (n+1<len)
-			luaL_addchar( &lB, ' ' );
+		lua_pushliteral( L, "" );
+		return 1;
 	}
+	// encoder writes a blank after each byte; drop the last one
+	t_buf_smd_toHex( luaL_buffinitsize( L, &lB, 3 * len ), buf, len );
+	luaL_pushresultsize( &lB, 3 * len - 1 );
+	return 1;
+}
+
 
-	luaL_pushresult( &lB );
+/**--------------------------------------------------------------------------
+ * Create a T.Buffer from a string of hex digits.  Whitespace between pairs of
+ * digits is ignored, so the output of toHex() can be read back.
+ * \param   L       Lua state.
+ * \lparam  string  hex digits; also T.Buffer or T.Buffer.Segment.
+ * \lreturn ud      T.Buffer userdata instance.
+ * \return  int     # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_fromHex( lua_State *L )
+{
+	size_t        sLen;
+	char         *hex = t_buf_checklstring( L, 1, &sLen, NULL );
+	size_t        n   = 0;
+	size_t        i, d;
+	struct t_buf *buf;
+
+	for (i=0; i<sLen; i++)
+		n += ! isspace( (unsigned char) hex[ i ] );
+	luaL_argcheck( L, n > 0 && 0 == n % 2, 1, "must contain an even number of hex digits" );
+	buf = t_buf_create_ud( L, n / 2 );
+	for (i=0, n=0; i<sLen; i++)
+	{
+		d  = t_buf_smd_fromHex( buf->b + n, hex + i, sLen - i );
+		n += d / 2;
+		i += d;
+		if (i < sLen && ! isspace( (unsigned char) hex[ i ] ))
+			return luaL_argerror( L, 1, lua_pushfstring( L, "invalid hex digit at position %d", (int) i+1 ) );
+	}
 	return 1;
 }
 
@@ -213,18 +243,10 @@ lt_buf_toBinString( lua_State *L )
 {
 	size_t                   len; // length of buffer/segment/string
 	char                    *buf = t_buf_checklstring( L, 1, &len, NULL );
-	size_t                  n, x;
 	luaL_Buffer               lB;
-	luaL_buffinit( L, &lB );
 
-	for (n=0; n<len; n++)
-	{
-		for (x=CHAR_BIT; x>0; x--)
-			luaL_addchar( &lB, ((buf[ n ] >> (x-1)) & 0x01) ? '1' : '0' );
-		luaL_addchar( &lB, ' ' );
-	}
-
-	luaL_pushresult( &lB );
+	t_buf_smd_toBin( luaL_buffinitsize( L, &lB, 9 * len ), buf, len );
+	luaL_pushresultsize( &lB, 9 * len );
 	return 1;
 }
 
@@ -253,6 +275,334 @@ lt_buf__eq( lua_State *L )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Find a sequence of bytes in a T.Buffer.  Works like a plain string.find().
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance or string.
+ * \lparam  string needle; Lua string, T.Buffer or T.Buffer.Segment.
+ * \lparam  int    position where the search starts; may be negative.
+ * \lreturn int    position of first byte of the needle or nil.
+ * \lreturn int    position of last byte of the needle.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_find( lua_State *L )
+{
+	size_t        bLen;
+	size_t        nLen;
+	char         *buf  = t_buf_checklstring( L, 1, &bLen, NULL );
+	char         *ndl  = t_buf_checklstring( L, 2, &nLen, NULL );
+	lua_Integer start  = lua_posrelate( luaL_optinteger( L, 3,  1 ), (lua_Integer) bLen );
+	size_t        pos;
+
+	if (start < 1) start = 1;
+	if (start > (lua_Integer) bLen + 1
+	 || T_BUF_SMD_NONE == (pos = t_buf_smd_find( buf + start - 1, bLen - start + 1, ndl, nLen )))
+	{
+		lua_pushnil( L );
+		return 1;
+	}
+	lua_pushinteger( L, start + (lua_Integer) pos );
+	lua_pushinteger( L, start + (lua_Integer) (pos + nLen) - 1 );
+	return 2;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Find the first byte in a T.Buffer which is any of a set of bytes.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance or string.
+ * \lparam  string set of bytes to look for.
+ * \lparam  int    position where the search starts; may be negative.
+ * \lreturn int    position of the byte found or nil.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_findByte( lua_State *L )
+{
+	size_t        bLen;
+	size_t        sLen;
+	char         *buf  = t_buf_checklstring( L, 1, &bLen, NULL );
+	const char   *set  = luaL_checklstring( L, 2, &sLen );
+	lua_Integer start  = lua_posrelate( luaL_optinteger( L, 3,  1 ), (lua_Integer) bLen );
+	size_t        pos;
+
+	if (start < 1) start = 1;
+	if (start > (lua_Integer) bLen
+	 || T_BUF_SMD_NONE == (pos = t_buf_smd_findSet( buf + start - 1, bLen - start + 1, set, sLen )))
+		lua_pushnil( L );
+	else
+		lua_pushinteger( L, start + (lua_Integer) pos );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Count the occurences of a byte in a T.Buffer.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance or string.
+ * \lparam  int    byte value to count; alternatively a single char string.
+ * \lreturn int    number of occurences.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_count( lua_State *L )
+{
+	size_t        bLen;
+	size_t        cLen = 1;
+	char         *buf  = t_buf_checklstring( L, 1, &bLen, NULL );
+	lua_Integer   c;
+
+	if (LUA_TSTRING == lua_type( L, 2 ))
+		c = (unsigned char) *(luaL_checklstring( L, 2, &cLen ));
+	else
+		c = luaL_checkinteger( L, 2 );
+	luaL_argcheck( L, 1 == cLen && c >= 0 && c <= 255, 2, "must be a single byte" );
+	lua_pushinteger( L, (lua_Integer) t_buf_smd_count( buf, bLen, (char) c ) );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Compare two T.Buffer byte by byte.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance or string.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance or string.
+ * \lreturn int    -1, 0 or 1 if first is smaller, equal or greater than second.
+ * \lreturn int    position of first differing byte or nil if equal.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_compare( lua_State *L )
+{
+	size_t        lenA;
+	char         *bufA = t_buf_checklstring( L, 1, &lenA, NULL );
+	size_t        lenB;
+	char         *bufB = t_buf_checklstring( L, 2, &lenB, NULL );
+	size_t        len  = (lenA < lenB) ? lenA : lenB;
+	size_t        pos  = t_buf_smd_mismatch( bufA, bufB, len );
+
+	if (pos < len)
+		lua_pushinteger( L, ((unsigned char) bufA[ pos ] < (unsigned char) bufB[ pos ]) ? -1 : 1 );
+	else if (lenA == lenB)
+	{
+		lua_pushinteger( L, 0 );
+		return 1;
+	}
+	else
+		lua_pushinteger( L, (lenA < lenB) ? -1 : 1 );
+	lua_pushinteger( L, (lua_Integer) pos + 1 );
+	return 2;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check optional start and length arguments against a buffer length.
+ * \param   L      Lua state.
+ * \param   pos    int; stack position of the start argument.
+ * \param   bLen   size_t; length of buffer.
+ * \param  *len    size_t*; length of range; defaults to remainder of buffer.
+ * \return  size_t offset of range start within the buffer.
+ * --------------------------------------------------------------------------*/
+static size_t
+t_buf_checkrange( lua_State *L, int pos, size_t bLen, size_t *len )
+{
+	lua_Integer start  = lua_posrelate( luaL_optinteger( L, pos,  1 ), (lua_Integer) bLen );
+	lua_Integer   n    = luaL_optinteger( L, pos+1, (lua_Integer) bLen-start+1 );
+
+	luaL_argcheck( L, 1 <= start && start <= (lua_Integer) bLen + 1, pos, "index out of range" );
+	luaL_argcheck( L, 0 <= n && start + n - 1 <= (lua_Integer) bLen, pos+1, "requested length out of range" );
+	*len = (size_t) n;
+	return (size_t) start - 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Xor the content of T.Buffer with a repeating key in place.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance.
+ * \lparam  string key; Lua string, T.Buffer or T.Buffer.Segment.
+ * \lparam  pos    Position in T.Buffer where the key gets applied first.
+ * \lparam  len    How many bytes shall be modified.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_xor( lua_State *L )
+{
+	size_t        bLen, kLen, len;
+	int           cw   = 0;
+	char         *buf  = t_buf_checklstring( L, 1, &bLen, &cw );
+	char         *key  = t_buf_checklstring( L, 2, &kLen, NULL );
+	size_t        ofs  = t_buf_checkrange( L, 3, bLen, &len );
+
+	luaL_argcheck( L, cw != 0, 1, "must be "T_BUF_TYPE" or "T_BUF_SEG_TYPE );
+	luaL_argcheck( L, kLen > 0, 2, "key must not be empty" );
+	t_buf_smd_xor( buf + ofs, len, key, kLen );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Fill T.Buffer with a byte value.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance.
+ * \lparam  int    byte value; alternatively a single char string.
+ * \lparam  pos    Position in T.Buffer where filling starts.
+ * \lparam  len    How many bytes shall be filled.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_fill( lua_State *L )
+{
+	size_t        bLen, len;
+	size_t        cLen = 1;
+	int           cw   = 0;
+	char         *buf  = t_buf_checklstring( L, 1, &bLen, &cw );
+	size_t        ofs  = t_buf_checkrange( L, 3, bLen, &len );
+	lua_Integer   c;
+
+	luaL_argcheck( L, cw != 0, 1, "must be "T_BUF_TYPE" or "T_BUF_SEG_TYPE );
+	if (LUA_TSTRING == lua_type( L, 2 ))
+		c = (unsigned char) *(luaL_checklstring( L, 2, &cLen ));
+	else
+		c = luaL_checkinteger( L, 2 );
+	luaL_argcheck( L, 1 == cLen && c >= 0 && c <= 255, 2, "must be a single byte" );
+	memset( buf + ofs, (int) c, len );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Reverse the order of bytes in T.Buffer in place.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance.
+ * \lparam  pos    Position in T.Buffer where the range starts.
+ * \lparam  len    How many bytes shall be reversed.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_reverse( lua_State *L )
+{
+	size_t        bLen, len;
+	int           cw   = 0;
+	char         *buf  = t_buf_checklstring( L, 1, &bLen, &cw );
+	size_t        ofs  = t_buf_checkrange( L, 2, bLen, &len );
+
+	luaL_argcheck( L, cw != 0, 1, "must be "T_BUF_TYPE" or "T_BUF_SEG_TYPE );
+	t_buf_smd_reverse( buf + ofs, len );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Swap the byte order of all words in a range of T.Buffer in place.
+ * \param   L      Lua state.
+ * \param   w      size_t; word width in bytes.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance.
+ * \lparam  pos    Position in T.Buffer where the range starts.
+ * \lparam  len    How many bytes shall be swapped; multiple of word width.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_buf_bswap( lua_State *L, size_t w )
+{
+	size_t        bLen, len;
+	int           cw   = 0;
+	char         *buf  = t_buf_checklstring( L, 1, &bLen, &cw );
+	size_t        ofs  = t_buf_checkrange( L, 2, bLen, &len );
+
+	luaL_argcheck( L, cw != 0, 1, "must be "T_BUF_TYPE" or "T_BUF_SEG_TYPE );
+	luaL_argcheck( L, 0 == len % w, 3, "length must be a multiple of the word width" );
+	t_buf_smd_bswap( buf + ofs, len, w );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Swap the byte order of all 16 bit words in a range of T.Buffer in place.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance.
+ * \lparam  pos    Position in T.Buffer where the range starts.
+ * \lparam  len    How many bytes shall be swapped; multiple of 2.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_bswap16( lua_State *L )
+{
+	return t_buf_bswap( L, 2 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Swap the byte order of all 32 bit words in a range of T.Buffer in place.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance.
+ * \lparam  pos    Position in T.Buffer where the range starts.
+ * \lparam  len    How many bytes shall be swapped; multiple of 4.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_bswap32( lua_State *L )
+{
+	return t_buf_bswap( L, 4 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Swap the byte order of all 64 bit words in a range of T.Buffer in place.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance.
+ * \lparam  pos    Position in T.Buffer where the range starts.
+ * \lparam  len    How many bytes shall be swapped; multiple of 8.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_bswap64( lua_State *L )
+{
+	return t_buf_bswap( L, 8 );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Copy bytes from T.Buffer into another or the same T.Buffer.  The ranges may
+ * overlap.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance or string.
+ * \lparam  ud     T.Buffer/T.Buffer.Segment userdata instance to copy to.
+ * \lparam  pos    Position in source where copying starts.
+ * \lparam  pos    Position in destination where copying starts.
+ * \lparam  len    How many bytes shall be copied; defaults to as many as fit.
+ * \lreturn int    number of bytes copied.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_copy( lua_State *L )
+{
+	size_t        sLen, dLen;
+	int           cw   = 0;
+	char         *src  = t_buf_checklstring( L, 1, &sLen, NULL );
+	char         *dst  = t_buf_checklstring( L, 2, &dLen, &cw );
+	lua_Integer   sIdx = luaL_optinteger( L, 3, 1 );
+	lua_Integer   dIdx = luaL_optinteger( L, 4, 1 );
+	lua_Integer   len;
+
+	luaL_argcheck( L, cw != 0, 2, "must be "T_BUF_TYPE" or "T_BUF_SEG_TYPE );
+	luaL_argcheck( L, 1 <= sIdx && (size_t) sIdx <= sLen + 1, 3, "index out of range" );
+	luaL_argcheck( L, 1 <= dIdx && (size_t) dIdx <= dLen + 1, 4, "index out of range" );
+	len = (lua_Integer) sLen - sIdx + 1;
+	if (len > (lua_Integer) dLen - dIdx + 1)
+		len = (lua_Integer) dLen - dIdx + 1;
+	len = luaL_optinteger( L, 5, len );
+	luaL_argcheck( L, 0 <= len
+	   && (size_t) (sIdx + len - 1) <= sLen
+	   && (size_t) (dIdx + len - 1) <= dLen, 5, "requested length out of range" );
+
+	memmove( dst + dIdx - 1, src + sIdx - 1, (size_t) len );
+	lua_pushinteger( L, len );
+	return 1;
+}
+
+
 /**--------------------------------------------------------------------------
  * Combines two T.Buffer into a new T.Buffer.
  * \param   L    Lua state.
@@ -372,7 +722,11 @@ static const struct luaL_Reg t_buf_fm [] = {
  * Class functions library definition
  * --------------------------------------------------------------------------*/
 static const struct luaL_Reg t_buf_cf [] = {
-	  { NULL           , NULL }
+	  { "map"          , lt_buf_map_map }
+	, { "shared"       , lt_buf_map_shared }
+	, { "unlinkShared" , lt_buf_map_unlinkShared }
+	, { "fromHex"      , lt_buf_fromHex }
+	, { NULL           , NULL }
 };
 
 /**--------------------------------------------------------------------------
@@ -390,6 +744,17 @@ static const luaL_Reg t_buf_m [] = {
 	, { "clear"        , lt_buf_clear }
 	, { "read"         , lt_buf_read }
 	, { "write"        , lt_buf_write }
+	, { "find"         , lt_buf_find }
+	, { "findByte"     , lt_buf_findByte }
+	, { "count"        , lt_buf_count }
+	, { "compare"      , lt_buf_compare }
+	, { "xor"          , lt_buf_xor }
+	, { "fill"         , lt_buf_fill }
+	, { "reverse"      , lt_buf_reverse }
+	, { "bswap16"      , lt_buf_bswap16 }
+	, { "bswap32"      , lt_buf_bswap32 }
+	, { "bswap64"      , lt_buf_bswap64 }
+	, { "copy"         , lt_buf_copy }
 	// universal stuff/helpers
 	, { "toHex"        , lt_buf_toHexString }
 	, { "toBin"        , lt_buf_toBinString }
@@ -413,11 +778,20 @@ luaopen_t_buf( lua_State *L )
 	luaL_setfuncs( L, t_buf_m, 0 );
 	luaopen_t_buf_seg( L );
 	lua_setfield( L, -2, T_BUF_SEG_NAME );
+	luaopen_t_buf_map( L );   // instances are created by Buffer.map()
 
 	// T.Buffer class
 	luaL_newlib( L, t_buf_cf );
 	lua_pushinteger( L, BUFSIZ );
 	lua_setfield( L, -2, "Size" );
+	lua_pushstring( L, t_buf_smd_init( ) );
+	lua_setfield( L, -2, "Simd" );
+	luaopen_t_buf_rng( L );
+	lua_setfield( L, -2, T_BUF_RNG_NAME );
+	luaopen_t_buf_chn( L );
+	lua_setfield( L, -2, T_BUF_CHN_NAME );
+	luaopen_t_buf_pol( L );
+	lua_setfield( L, -2, T_BUF_POL_NAME );
 	luaL_newlib( L, t_buf_fm );
 	lua_setmetatable( L, -2 );
 	return 1;
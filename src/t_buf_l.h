@@ -23,8 +23,53 @@ int            lt_buf_toHexString( lua_State *L );
 int            lt_buf_write( lua_State *L );
 int            lt_buf_read ( lua_State *L );
 int            lt_buf_clear( lua_State *L );
+int            lt_buf_find( lua_State *L );
+int            lt_buf_findByte( lua_State *L );
+int            lt_buf_count( lua_State *L );
+int            lt_buf_compare( lua_State *L );
+int            lt_buf_xor( lua_State *L );
+int            lt_buf_fill( lua_State *L );
+int            lt_buf_reverse( lua_State *L );
+int            lt_buf_bswap16( lua_State *L );
+int            lt_buf_bswap32( lua_State *L );
+int            lt_buf_bswap64( lua_State *L );
+int            lt_buf_copy( lua_State *L );
 
 // t_buf_seg.c
 // Constructors
 int               luaopen_t_buf_seg  ( lua_State *L );
 
+// t_buf_rng.c
+// Constructors
+int               luaopen_t_buf_rng  ( lua_State *L );
+struct t_buf_rng *t_buf_rng_create_ud( lua_State *L, size_t n );
+
+// t_buf_chn.c
+// Constructors
+int               luaopen_t_buf_chn  ( lua_State *L );
+struct t_buf_chn *t_buf_chn_create_ud( lua_State *L );
+
+// t_buf_map.c
+// Constructors
+int               luaopen_t_buf_map  ( lua_State *L );
+int               lt_buf_map_map     ( lua_State *L );
+int               lt_buf_map_shared  ( lua_State *L );
+int               lt_buf_map_unlinkShared( lua_State *L );
+
+// t_buf_pol.c
+// Constructors
+int               luaopen_t_buf_pol  ( lua_State *L );
+
+// t_buf_smd.c
+#define T_BUF_SMD_NONE    ((size_t) -1)     ///< returned if nothing was found
+const char       *t_buf_smd_init     ( void );
+size_t            t_buf_smd_find     ( const char *h, size_t hl, const char *n, size_t nl );
+size_t            t_buf_smd_findSet  ( const char *s, size_t sl, const char *set, size_t stl );
+size_t            t_buf_smd_count    ( const char *s, size_t sl, char c );
+size_t            t_buf_smd_mismatch ( const char *a, const char *b, size_t n );
+void              t_buf_smd_toHex    ( char *dst, const char *src, size_t n );
+void              t_buf_smd_toBin    ( char *dst, const char *src, size_t n );
+size_t            t_buf_smd_fromHex  ( char *dst, const char *src, size_t n );
+void              t_buf_smd_xor      ( char *b, size_t n, const char *k, size_t kl );
+void              t_buf_smd_reverse  ( char *b, size_t n );
+void              t_buf_smd_bswap    ( char *b, size_t n, size_t w );
@@ -0,0 +1,493 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_buf_map.c
+ * \brief     Memory mapped files as T.Buffer.Map
+ *            Makes a file available wherever lua-t accepts a T.Buffer without
+ *            reading it into a Lua string first.
+ * \detail    The mapping is shared with the file.  Pages get loaded by the
+ *            kernel when they are touched, so Pack, Crc or Base64 can operate
+ *            on files bigger than the available memory.  Writes to a writable
+ *            map go to the file; sync() flushes them.
+ *            Buffer.shared() creates maps of memory which is shared with
+ *            forked children or, if named, with any process opening the same
+ *            name.  load(), store(), fetchAdd() and cas() access 64 bit
+ *            integers atomically, which allows for lock free counters.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+#define _DEFAULT_SOURCE           // madvise(), MADV_*, MAP_ANONYMOUS
+
+#include <string.h>               // strcmp
+#include <fcntl.h>                // open
+#include <unistd.h>               // close, sysconf
+#include <sys/mman.h>             // mmap, munmap, madvise, msync, shm_open
+#include <sys/stat.h>             // fstat
+
+#include "t_buf_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+
+/// madvise() hints by name
+static const struct {
+	const char *name;
+	int         advice;
+} t_buf_map_advices[ ] = {
+	  { "normal"     , MADV_NORMAL     }
+	, { "sequential" , MADV_SEQUENTIAL }
+	, { "random"     , MADV_RANDOM     }
+	, { "willneed"   , MADV_WILLNEED   }
+	, { "dontneed"   , MADV_DONTNEED   }
+#ifdef MADV_HUGEPAGE
+	, { "hugepage"   , MADV_HUGEPAGE   }
+#endif
+	, { NULL         , 0               }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Translate a 1-based range of the map into a page aligned address range.
+ * \param   L      Lua state.
+ * \param  *map    struct t_buf_map*; the mapping.
+ * \param   pos    int; stack position of the start; the length follows.
+ * \param  *len    size_t*; receives length of the aligned range.
+ * \return  char*  page aligned start of the range.
+ * --------------------------------------------------------------------------*/
+static char
+*t_buf_map_range( lua_State *L, struct t_buf_map *map, int pos, size_t *len )
+{
+	lua_Integer  sta = luaL_optinteger( L, pos,   1 );
+	lua_Integer  cnt = luaL_optinteger( L, pos+1, (lua_Integer) map->len - sta + 1 );
+	size_t       pge = (size_t) sysconf( _SC_PAGESIZE );
+	size_t       ofs;
+
+	luaL_argcheck( L, sta >= 1 && (size_t) sta <= map->len, pos, "index out of range" );
+	luaL_argcheck( L, cnt >= 0 && (size_t) (sta + cnt - 1) <= map->len, pos+1, "requested length out of range" );
+	ofs  = ((size_t) sta - 1) & ~(pge - 1);
+	*len = (size_t) (sta - 1 + cnt) - ofs;
+	return map->b + ofs;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Map a file into memory.
+ * \param   L      Lua state.
+ * \lparam  string path of the file.
+ * \lparam  string mode; 'r' read only (default), 'w' writable.
+ * \lreturn ud     T.Buffer.Map userdata instance; nil, msg on failure.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_map_map( lua_State *L )
+{
+	const char       *pth = luaL_checkstring( L, 1 );
+	const char       *mde = luaL_optstring( L, 2, "r" );
+	int               wr  = 0;
+	int               fd;
+	struct stat       st;
+	struct t_buf_map *map;
+	void             *b   = NULL;
+
+	if ('w' == mde[ 0 ] && '\0' == mde[ 1 ])
+		wr = 1;
+	else
+		luaL_argcheck( L, 'r' == mde[ 0 ] && '\0' == mde[ 1 ], 2, "mode must be 'r' or 'w'" );
+
+	if (-1 == (fd = open( pth, (wr) ? O_RDWR : O_RDONLY )))
+		return t_push_error( L, 0, 0, "Can't open %s", pth );
+	if (-1 == fstat( fd, &st ))
+	{
+		close( fd );
+		return t_push_error( L, 0, 0, "Can't stat %s", pth );
+	}
+	if (st.st_size > 0 && MAP_FAILED == (b = mmap( NULL, (size_t) st.st_size,
+	      (wr) ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 )))
+	{
+		close( fd );
+		return t_push_error( L, 0, 0, "Can't map %s", pth );
+	}
+	close( fd );                  // the mapping keeps the file referenced
+
+	map      = (struct t_buf_map *) lua_newuserdatauv( L, sizeof( struct t_buf_map ), 0 );
+	map->b   = (char *) b;
+	map->len = (st.st_size > 0) ? (size_t) st.st_size : 0;
+	map->wr  = wr;
+	luaL_getmetatable( L, T_BUF_MAP_TYPE );
+	lua_setmetatable( L, -2 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create a map of shared memory.  An anonymous map is shared with processes
+ * forked after its creation.  A named one is a POSIX shared memory object
+ * which any process can map by the same name; it persists until
+ * Buffer.unlinkShared() removes it.  New memory is zero filled.
+ * \param   L      Lua state.
+ * \lparam  int    size in bytes.
+ *        ALTERNATIVE
+ * \lparam  string name; must start with a '/'.
+ * \lparam  int    size in bytes; grows the object if it is smaller.  Without
+ *                 size an existing object gets opened.
+ * \lreturn ud     T.Buffer.Map userdata instance; nil, msg on failure.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_map_shared( lua_State *L )
+{
+	const char       *nme = (LUA_TSTRING == lua_type( L, 1 )) ? lua_tostring( L, 1 ) : NULL;
+	lua_Integer       sz  = (NULL == nme) ? luaL_checkinteger( L, 1 ) : luaL_optinteger( L, 2, 0 );
+	int               fd;
+	struct stat       st;
+	struct t_buf_map *map;
+	void             *b   = NULL;
+
+	if (NULL == nme)
+	{
+		luaL_argcheck( L, sz > 0, 1, "size must be greater than 0" );
+		if (MAP_FAILED == (b = mmap( NULL, (size_t) sz, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0 )))
+			return t_push_error( L, 0, 0, "Can't map shared memory" );
+	}
+	else
+	{
+		luaL_argcheck( L, '/' == nme[ 0 ], 1, "name must start with '/'" );
+		luaL_argcheck( L, sz >= 0, 2, "size must not be negative" );
+		if (-1 == (fd = shm_open( nme, (sz > 0) ? O_RDWR | O_CREAT : O_RDWR, 0600 )))
+			return t_push_error( L, 0, 0, "Can't open shared memory %s", nme );
+		if (-1 == fstat( fd, &st )
+		 || (st.st_size < sz && -1 == ftruncate( fd, (off_t) sz )))
+		{
+			close( fd );
+			return t_push_error( L, 0, 0, "Can't size shared memory %s", nme );
+		}
+		if (st.st_size > sz)
+			sz = (lua_Integer) st.st_size;
+		if (sz > 0 && MAP_FAILED == (b = mmap( NULL, (size_t) sz, PROT_READ | PROT_WRITE,
+		      MAP_SHARED, fd, 0 )))
+		{
+			close( fd );
+			return t_push_error( L, 0, 0, "Can't map shared memory %s", nme );
+		}
+		close( fd );               // the mapping keeps the object referenced
+	}
+
+	map      = (struct t_buf_map *) lua_newuserdatauv( L, sizeof( struct t_buf_map ), 0 );
+	map->b   = (char *) b;
+	map->len = (size_t) sz;
+	map->wr  = 1;
+	luaL_getmetatable( L, T_BUF_MAP_TYPE );
+	lua_setmetatable( L, -2 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Remove a named shared memory object.  Existing maps stay valid.
+ * \param   L      Lua state.
+ * \lparam  string name of the shared memory object.
+ * \lreturn bool   true; false, msg on failure.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+lt_buf_map_unlinkShared( lua_State *L )
+{
+	const char *nme = luaL_checkstring( L, 1 );
+
+	if (-1 == shm_unlink( nme ))
+		return t_push_error( L, 0, 1, "Can't unlink shared memory %s", nme );
+	lua_pushboolean( L, 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Check the position of a 64 bit integer in the map.
+ * \param   L      Lua state.
+ * \param  *map    struct t_buf_map*; the mapping.
+ * \param   pos    int; stack position of the index.
+ * \param   wr     int; the access modifies the integer.
+ * \return  lua_Integer*  pointer to the integer.
+ * --------------------------------------------------------------------------*/
+static lua_Integer
+*t_buf_map_int( lua_State *L, struct t_buf_map *map, int pos, int wr )
+{
+	lua_Integer idx = luaL_checkinteger( L, pos );
+
+	luaL_argcheck( L, map->wr || ! wr, 1, "must be writable" );
+	luaL_argcheck( L, idx >= 1 && (size_t) idx + sizeof( lua_Integer ) - 1 <= map->len, pos,
+		"index out of range" );
+	// maps are page aligned; keep integers naturally aligned for atomicity
+	luaL_argcheck( L, 0 == (idx - 1) % (lua_Integer) sizeof( lua_Integer ), pos,
+		"index must be aligned to the integer size (1, 9, 17, ...)" );
+	return (lua_Integer *) (map->b + idx - 1);
+}
+
+
+/**--------------------------------------------------------------------------
+ * Atomically read a 64 bit integer in native byte order.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \lparam  int    index of the integer's first byte.
+ * \lreturn int    value.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map_load( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+	lua_Integer      *p   = t_buf_map_int( L, map, 2, 0 );
+
+	lua_pushinteger( L, __atomic_load_n( p, __ATOMIC_SEQ_CST ) );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Atomically write a 64 bit integer in native byte order.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \lparam  int    index of the integer's first byte.
+ * \lparam  int    value.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map_store( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+	lua_Integer      *p   = t_buf_map_int( L, map, 2, 1 );
+
+	__atomic_store_n( p, luaL_checkinteger( L, 3 ), __ATOMIC_SEQ_CST );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Atomically add to a 64 bit integer.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \lparam  int    index of the integer's first byte.
+ * \lparam  int    value to add; defaults to 1; may be negative.
+ * \lreturn int    value before the addition.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map_fetchAdd( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+	lua_Integer      *p   = t_buf_map_int( L, map, 2, 1 );
+
+	lua_pushinteger( L, __atomic_fetch_add( p, luaL_optinteger( L, 3, 1 ), __ATOMIC_SEQ_CST ) );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Atomically replace a 64 bit integer if it has the expected value.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \lparam  int    index of the integer's first byte.
+ * \lparam  int    expected value.
+ * \lparam  int    new value.
+ * \lreturn bool   true if the value got replaced.
+ * \lreturn int    value found before the operation.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map_cas( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+	lua_Integer      *p   = t_buf_map_int( L, map, 2, 1 );
+	lua_Integer       cmp = luaL_checkinteger( L, 3 );
+	lua_Integer       val = luaL_checkinteger( L, 4 );
+
+	lua_pushboolean( L, __atomic_compare_exchange_n( p, &cmp, val, 0,
+		__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) );
+	lua_pushinteger( L, cmp );      // on failure updated to the current value
+	return 2;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Tell the kernel how the mapping is going to be accessed.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \lparam  string hint; normal, sequential, random, willneed, dontneed or
+ *                 hugepage.
+ * \lparam  int    start of range; defaults to 1.
+ * \lparam  int    length of range; defaults to the rest of the map.
+ * \lreturn bool   true; false, msg on failure.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map_advise( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+	const char       *hnt = luaL_checkstring( L, 2 );
+	size_t            len;
+	char             *b;
+	int               i;
+
+	for (i=0; NULL != t_buf_map_advices[ i ].name && strcmp( hnt, t_buf_map_advices[ i ].name ); i++);
+	luaL_argcheck( L, NULL != t_buf_map_advices[ i ].name, 2, "unknown hint" );
+	if (NULL == map->b)
+	{
+		lua_pushboolean( L, 1 );
+		return 1;
+	}
+	b = t_buf_map_range( L, map, 3, &len );
+	if (-1 == madvise( b, len, t_buf_map_advices[ i ].advice ))
+		return t_push_error( L, 0, 1, "Can't apply hint %s", hnt );
+	lua_pushboolean( L, 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Flush changes of a writable map to the file.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \lparam  bool   async; schedule the write but don't wait for it.
+ * \lparam  int    start of range; defaults to 1.
+ * \lparam  int    length of range; defaults to the rest of the map.
+ * \lreturn bool   true; false, msg on failure.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map_sync( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+	int               asy = lua_toboolean( L, 2 );
+	size_t            len;
+	char             *b;
+
+	if (NULL == map->b || ! map->wr)
+	{
+		lua_pushboolean( L, 1 );
+		return 1;
+	}
+	b = t_buf_map_range( L, map, 3, &len );
+	if (-1 == msync( b, len, (asy) ? MS_ASYNC : MS_SYNC ))
+		return t_push_error( L, 0, 1, "Can't sync "T_BUF_MAP_TYPE );
+	lua_pushboolean( L, 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Unmap the file.  Afterwards the map is empty.  Also called by __gc.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map_close( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+
+	if (NULL != map->b)
+		munmap( map->b, map->len );
+	map->b   = NULL;
+	map->len = 0;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * __index method for T.Buffer.Map.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \lparam  string Access key value; writable or method name.
+ * \lreturn value  based on what's behind __index.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map__index( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+	const char       *key = luaL_checkstring( L, 2 );
+
+	if (0 == strcmp( key, "writable" ))
+		lua_pushboolean( L, map->wr );
+	else
+	{
+		lua_getmetatable( L, 1 );  //S: map key _mt
+		lua_pushvalue( L, 2 );     //S: map key _mt key
+		lua_gettable( L, -2 );     //S: map key _mt val
+	}
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Return Tostring representation of a map.
+ * \param   L      Lua state
+ * \lparam  ud     T.Buffer.Map userdata instance.
+ * \lreturn string Formatted string representing map.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_map__tostring( lua_State *L )
+{
+	struct t_buf_map *map = t_buf_map_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_BUF_MAP_TYPE"[%d%s]: %p", map->len, (map->wr) ? ",w" : "", map );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const luaL_Reg t_buf_map_m [] = {
+	// metamethods
+	  { "__tostring"   , lt_buf_map__tostring }
+	, { "__index"      , lt_buf_map__index }
+	, { "__len"        , lt_buf__len }
+	, { "__eq"         , lt_buf__eq }
+	, { "__gc"         , lt_buf_map_close }
+	// instance methods
+	, { "read"         , lt_buf_read }
+	, { "write"        , lt_buf_write }
+	, { "find"         , lt_buf_find }
+	, { "findByte"     , lt_buf_findByte }
+	, { "count"        , lt_buf_count }
+	, { "compare"      , lt_buf_compare }
+	, { "xor"          , lt_buf_xor }
+	, { "fill"         , lt_buf_fill }
+	, { "reverse"      , lt_buf_reverse }
+	, { "bswap16"      , lt_buf_bswap16 }
+	, { "bswap32"      , lt_buf_bswap32 }
+	, { "bswap64"      , lt_buf_bswap64 }
+	, { "copy"         , lt_buf_copy }
+	, { "advise"       , lt_buf_map_advise }
+	, { "sync"         , lt_buf_map_sync }
+	, { "close"        , lt_buf_map_close }
+	, { "load"         , lt_buf_map_load }
+	, { "store"        , lt_buf_map_store }
+	, { "fetchAdd"     , lt_buf_map_fetchAdd }
+	, { "cas"          , lt_buf_map_cas }
+	// universal stuff
+	, { "toHex"        , lt_buf_toHexString }
+	, { "toBin"        , lt_buf_toBinString }
+	, { NULL           , NULL }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Registers the T.Buffer.Map instance metatable.  Instances get created by
+ * Buffer.map() and Buffer.shared() only, so there is no class table.
+ * \param   L      The lua state.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_buf_map( lua_State *L )
+{
+	luaL_newmetatable( L, T_BUF_MAP_TYPE );
+	luaL_setfuncs( L, t_buf_map_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+	return 0;
+}
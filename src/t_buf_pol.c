@@ -0,0 +1,295 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_buf_pol.c
+ * \brief     OOP wrapper for a pool of recyclable buffers T.Buffer.Pool
+ *            Hands out fixed size buffers from a preallocated slab, so the
+ *            storage of receive buffers doesn't churn the Lua allocator.
+ * \detail    Buffers handed out are T.Buffer.Pool.Slot instances.  They are
+ *            accepted wherever lua-t accepts a T.Buffer.  release() or the
+ *            garbage collector gives them back to the pool.  If the slab is
+ *            exhausted buffers get allocated one by one; stats() reports these
+ *            misses and the high water mark to size the pool.  Each acquire
+ *            still creates a small Slot userdata with a finalizer; only the
+ *            storage is recycled.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>                // BUFSIZ
+#include <string.h>               // strcmp
+
+#include "t_buf_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+
+/** -------------------------------------------------------------------------
+ * Constructor - creates the pool and allocates the slab.
+ * \param   L      Lua state.
+ * \lparam  CLASS  table Buffer.Pool.
+ * \lparam  int    size of each buffer; defaults to Buffer.Size.
+ * \lparam  int    number of buffers in the slab; defaults to 64.
+ * \lreturn ud     T.Buffer.Pool userdata instance.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_pol__Call( lua_State *L )
+{
+	lua_Integer       sz  = luaL_optinteger( L, 2, BUFSIZ );
+	lua_Integer       cnt = luaL_optinteger( L, 3, 64 );
+	struct t_buf_pol *pol;
+	size_t            i;
+
+	luaL_argcheck( L, sz  > 0, 2, T_BUF_POL_TYPE" size must be greater than 0" );
+	luaL_argcheck( L, cnt > 0, 3, T_BUF_POL_TYPE" count must be greater than 0" );
+	pol = (struct t_buf_pol *) lua_newuserdatauv( L, sizeof( struct t_buf_pol ), 0 );
+	memset( pol, 0, sizeof( struct t_buf_pol ) );
+	pol->size  = (size_t) sz;
+	pol->count = (size_t) cnt;
+	luaL_getmetatable( L, T_BUF_POL_TYPE );
+	lua_setmetatable( L, -2 );
+	if (NULL == (pol->slab = (char *)   malloc( pol->size * pol->count ))
+	 || NULL == (pol->fre  = (size_t *) malloc( pol->count * sizeof( size_t ) )))
+		return luaL_error( L, "couldn't allocate "T_BUF_POL_TYPE );
+	for (i=0; i<pol->count; i++)       // hand out low slots first
+		pol->fre[ i ] = pol->count - i - 1;
+	pol->nfree = pol->count;
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Hand out a buffer from the pool.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Pool userdata instance.
+ * \lreturn ud     T.Buffer.Pool.Slot userdata instance.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_pol_acquire( lua_State *L )
+{
+	t_buf_pol_acquire( L, 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Usage statistics of the pool.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Pool userdata instance.
+ * \lreturn table  size, count, free, used, highWater, hits and misses.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_pol_stats( lua_State *L )
+{
+	struct t_buf_pol *pol = t_buf_pol_check_ud( L, 1, 1 );
+
+	lua_createtable( L, 0, 7 );
+	lua_pushinteger( L, (lua_Integer) pol->size );
+	lua_setfield( L, -2, "size" );
+	lua_pushinteger( L, (lua_Integer) pol->count );
+	lua_setfield( L, -2, "count" );
+	lua_pushinteger( L, (lua_Integer) pol->nfree );
+	lua_setfield( L, -2, "free" );
+	lua_pushinteger( L, (lua_Integer) pol->used );
+	lua_setfield( L, -2, "used" );
+	lua_pushinteger( L, (lua_Integer) pol->hwm );
+	lua_setfield( L, -2, "highWater" );
+	lua_pushinteger( L, (lua_Integer) pol->hits );
+	lua_setfield( L, -2, "hits" );
+	lua_pushinteger( L, (lua_Integer) pol->misses );
+	lua_setfield( L, -2, "misses" );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Return Tostring representation of a pool.
+ * \param   L      Lua state
+ * \lparam  ud     T.Buffer.Pool userdata instance.
+ * \lreturn string Formatted string representing pool.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_pol__tostring( lua_State *L )
+{
+	struct t_buf_pol *pol = t_buf_pol_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_BUF_POL_TYPE"[%d/%d*%d]: %p", pol->used, pol->count, pol->size, pol );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Garbage Collector.  Free the slab.  Slots reference the pool, so none of
+ * them can be in use anymore.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Buffer.Pool userdata instance.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_pol__gc( lua_State *L )
+{
+	struct t_buf_pol *pol = t_buf_pol_check_ud( L, 1, 1 );
+
+	free( pol->slab );
+	free( pol->fre );
+	pol->slab  = NULL;
+	pol->fre   = NULL;
+	pol->nfree = 0;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Give the buffer back to its pool.  Afterwards the slot is empty.  Also
+ * called by __gc.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Pool.Slot userdata instance.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_slt_release( lua_State *L )
+{
+	t_buf_slt_release( L, 1 );
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * __index method for T.Buffer.Pool.Slot.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Pool.Slot userdata instance.
+ * \lparam  string Access key value; pool or method name.
+ * \lreturn value  based on what's behind __index.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_slt__index( lua_State *L )
+{
+	const char *key = luaL_checkstring( L, 2 );
+
+	t_buf_slt_check_ud( L, 1, 1 );
+	if (0 == strcmp( key, "pool" ))
+		lua_getiuservalue( L, 1, T_BUF_SLT_POLIDX );
+	else
+	{
+		lua_getmetatable( L, 1 );  //S: slt key _mt
+		lua_pushvalue( L, 2 );     //S: slt key _mt key
+		lua_gettable( L, -2 );     //S: slt key _mt val
+	}
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Return Tostring representation of a pooled buffer.
+ * \param   L      Lua state
+ * \lparam  ud     T.Buffer.Pool.Slot userdata instance.
+ * \lreturn string Formatted string representing pooled buffer.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_slt__tostring( lua_State *L )
+{
+	struct t_buf_slt *slt = t_buf_slt_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_BUF_SLT_TYPE"[%d]: %p", slt->len, slt );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Class metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_buf_pol_fm [] = {
+	  { "__call"       , lt_buf_pol__Call }
+	, { NULL           , NULL }
+};
+
+/**--------------------------------------------------------------------------
+ * Class functions library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_buf_pol_cf [] = {
+	  { NULL           , NULL }
+};
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const luaL_Reg t_buf_pol_m [] = {
+	// metamethods
+	  { "__tostring"   , lt_buf_pol__tostring }
+	, { "__gc"         , lt_buf_pol__gc }
+	// instance methods
+	, { "acquire"      , lt_buf_pol_acquire }
+	, { "stats"        , lt_buf_pol_stats }
+	, { NULL           , NULL }
+};
+
+/**--------------------------------------------------------------------------
+ * Pooled buffer metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const luaL_Reg t_buf_slt_m [] = {
+	// metamethods
+	  { "__tostring"   , lt_buf_slt__tostring }
+	, { "__index"      , lt_buf_slt__index }
+	, { "__len"        , lt_buf__len }
+	, { "__eq"         , lt_buf__eq }
+	, { "__gc"         , lt_buf_slt_release }
+	// instance methods
+	, { "clear"        , lt_buf_clear }
+	, { "read"         , lt_buf_read }
+	, { "write"        , lt_buf_write }
+	, { "find"         , lt_buf_find }
+	, { "findByte"     , lt_buf_findByte }
+	, { "count"        , lt_buf_count }
+	, { "compare"      , lt_buf_compare }
+	, { "xor"          , lt_buf_xor }
+	, { "fill"         , lt_buf_fill }
+	, { "reverse"      , lt_buf_reverse }
+	, { "bswap16"      , lt_buf_bswap16 }
+	, { "bswap32"      , lt_buf_bswap32 }
+	, { "bswap64"      , lt_buf_bswap64 }
+	, { "copy"         , lt_buf_copy }
+	, { "release"      , lt_buf_slt_release }
+	// universal stuff
+	, { "toHex"        , lt_buf_toHexString }
+	, { "toBin"        , lt_buf_toBinString }
+	, { NULL           , NULL }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Pushes this library onto the stack.
+ *          - creates Metatable with functions
+ *          - creates metatable with methods
+ * \param   L      The lua state.
+ * \lreturn table  the library
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_buf_pol( lua_State *L )
+{
+	// T.Buffer.Pool.Slot instance metatable
+	luaL_newmetatable( L, T_BUF_SLT_TYPE );
+	luaL_setfuncs( L, t_buf_slt_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+
+	// T.Buffer.Pool instance metatable
+	luaL_newmetatable( L, T_BUF_POL_TYPE );
+	luaL_setfuncs( L, t_buf_pol_m, 0 );
+	lua_pushvalue( L, -1 );
+	lua_setfield( L, -2, "__index" );
+	lua_pop( L, 1 );  // balance the stack
+
+	// T.Buffer.Pool class
+	luaL_newlib( L, t_buf_pol_cf );
+	luaL_newlib( L, t_buf_pol_fm );
+	lua_setmetatable( L, -2 );
+	return 1;
+}
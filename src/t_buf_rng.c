@@ -0,0 +1,465 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_buf_rng.c
+ * \brief     OOP wrapper for a growable ring buffer T.Buffer.Ring
+ *            Collects a byte stream which arrives in fragments, eg. from a
+ *            socket, and hands it to protocol readers without concatenating
+ *            Lua strings.
+ * \detail    Data gets appended at the tail and consumed from the head.
+ *            Consuming only advances the head, nothing gets moved.  If the
+ *            ring is full the capacity doubles.  Wherever lua-t accepts a
+ *            T.Buffer the ring passes its readable bytes; if they wrap around
+ *            the end of the storage they get rotated into one piece first.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>                // BUFSIZ
+#include <string.h>               // memchr, memcmp, memcpy
+
+#include "t_buf_l.h"
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+
+/**--------------------------------------------------------------------------
+ * Get the readable bytes from ofs on as up to two contiguous parts.
+ * \param  *rng  struct t_buf_rng*; the ring.
+ * \param   ofs  size_t; offset into the readable bytes.
+ * \param  *p    char*[2]; receives start of parts.
+ * \param  *l    size_t[2]; receives length of parts; second is 0 unless wrapped.
+ * \return  void.
+ * --------------------------------------------------------------------------*/
+static void
+t_buf_rng_parts( struct t_buf_rng *rng, size_t ofs, char *p[ 2 ], size_t l[ 2 ] )
+{
+	size_t hd  = (rng->hd + ofs) & (rng->cap - 1);
+	size_t len = rng->len - ofs;
+
+	p[ 0 ] = rng->b + hd;
+	p[ 1 ] = rng->b;
+	l[ 0 ] = (hd + len > rng->cap) ? rng->cap - hd : len;
+	l[ 1 ] = len - l[ 0 ];
+}
+
+
+/**--------------------------------------------------------------------------
+ * Find a string in the readable bytes, across the wrap point.
+ * \param  *rng  struct t_buf_rng*; the ring.
+ * \param  *dlm  const char*; string to find.
+ * \param   dln  size_t; length of dlm; greater than 0.
+ * \param   ofs  size_t; offset into the readable bytes to start at.
+ * \return  lua_Integer 0-based offset of dlm; -1 if not found.
+ * --------------------------------------------------------------------------*/
+static lua_Integer
+t_buf_rng_find( struct t_buf_rng *rng, const char *dlm, size_t dln, size_t ofs )
+{
+	char   *p[ 2 ], *c;
+	size_t  l[ 2 ], i, pos, k;
+
+	if (ofs + dln > rng->len)
+		return -1;
+	t_buf_rng_parts( rng, ofs, p, l );
+	for (i=0; i<2; i++)
+	{
+		c = p[ i ];
+		while (NULL != (c = memchr( c, dlm[ 0 ], l[ i ] - (size_t) (c - p[ i ]) )))
+		{
+			pos = ofs + (size_t) (c - p[ i ]) + ((i) ? l[ 0 ] : 0);
+			if (pos + dln > rng->len)
+				return -1;
+			for (k=1; k<dln && dlm[ k ] == rng->b[ (rng->hd + pos + k) & (rng->cap - 1) ]; k++);
+			if (k == dln)
+				return (lua_Integer) pos;
+			c++;
+		}
+	}
+	return -1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push up to n readable bytes as Lua string.
+ * \param   L    Lua state.
+ * \param  *rng  struct t_buf_rng*; the ring.
+ * \param   n    size_t; number of bytes.
+ * \lreturn str  Lua string.
+ * \return  size_t number of bytes pushed.
+ * --------------------------------------------------------------------------*/
+static size_t
+t_buf_rng_push( lua_State *L, struct t_buf_rng *rng, size_t n )
+{
+	char        *p[ 2 ];
+	size_t       l[ 2 ];
+	luaL_Buffer  lB;
+
+	n = (n < rng->len) ? n : rng->len;
+	t_buf_rng_parts( rng, 0, p, l );
+	if (n <= l[ 0 ])
+		lua_pushlstring( L, p[ 0 ], n );
+	else
+	{
+		luaL_buffinitsize( L, &lB, n );
+		luaL_addlstring( &lB, p[ 0 ], l[ 0 ] );
+		luaL_addlstring( &lB, p[ 1 ], n - l[ 0 ] );
+		luaL_pushresult( &lB );
+	}
+	return n;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Create a T.Buffer.Ring and push to LuaStack.
+ * \param   L    Lua state.
+ * \param   n    size_t; initial capacity; rounded up to a power of 2.
+ * \lreturn ud   T.Buffer.Ring userdata instance.
+ * \return  struct t_buf_rng* pointer to the t_buf_rng struct
+ * --------------------------------------------------------------------------*/
+struct t_buf_rng
+*t_buf_rng_create_ud( lua_State *L, size_t n )
+{
+	struct t_buf_rng *rng = (struct t_buf_rng *) lua_newuserdatauv( L, sizeof( struct t_buf_rng ), 0 );
+	size_t            cap = 1;
+
+	while (cap < n)
+		cap <<= 1;
+	rng->cap = 0;
+	rng->hd  = 0;
+	rng->len = 0;
+	rng->b   = NULL;
+	luaL_getmetatable( L, T_BUF_RNG_TYPE );
+	lua_setmetatable( L, -2 );
+	if (NULL == (rng->b = (char *) malloc( cap )))
+		luaL_error( L, "couldn't allocate "T_BUF_RNG_TYPE );
+	rng->cap = cap;
+	return rng;
+}
+
+
+/** -------------------------------------------------------------------------
+ * Constructor - creates the ring buffer.
+ * \param   L      Lua state.
+ * \lparam  CLASS  table Buffer.Ring.
+ * \lparam  int    initial capacity; defaults to Buffer.Size.
+ * \lreturn ud     T.Buffer.Ring userdata instance.
+ * \return  int    # of values pushed onto the stack.
+ *  -------------------------------------------------------------------------*/
+static int
+lt_buf_rng__Call( lua_State *L )
+{
+	lua_Integer sz = luaL_optinteger( L, 2, BUFSIZ );
+
+	luaL_argcheck( L, sz > 0, 2, T_BUF_RNG_TYPE" size must be greater than 0" );
+	t_buf_rng_create_ud( L, (size_t) sz );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Append data to the ring; grows it if needed.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \lparam  data   T.Buffer, T.Buffer.Segment or Lua string; any number.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng_write( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+	int               n   = lua_gettop( L );
+	int               i;
+	size_t            len, fln;
+	char             *dat, *fre;
+
+	for (i=2; i<=n; i++)
+	{
+		luaL_argcheck( L, NULL == t_buf_rng_check_ud( L, i, 0 ), i, "can't write "T_BUF_RNG_TYPE" to itself" );
+		dat = t_buf_checklstring( L, i, &len, NULL );
+		if (NULL == (fre = t_buf_rng_reserve( rng, len, &fln )))
+			return luaL_error( L, "couldn't grow "T_BUF_RNG_TYPE );
+		fln = (fln < len) ? fln : len;
+		memcpy( fre, dat, fln );
+		memcpy( rng->b, dat + fln, len - fln );      // wrapped remainder
+		t_buf_rng_commit( rng, len );
+	}
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read and consume bytes from the ring.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \lparam  int    maximum number of bytes; defaults to all readable bytes.
+ * \lreturn string Lua string.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng_read( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+	lua_Integer       n   = luaL_optinteger( L, 2, (lua_Integer) rng->len );
+
+	luaL_argcheck( L, n >= 0, 2, "length must not be negative" );
+	t_buf_rng_consume( rng, t_buf_rng_push( L, rng, (size_t) n ) );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Read bytes from the ring without consuming them.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \lparam  int    maximum number of bytes; defaults to all readable bytes.
+ * \lreturn string Lua string.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng_peek( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+	lua_Integer       n   = luaL_optinteger( L, 2, (lua_Integer) rng->len );
+
+	luaL_argcheck( L, n >= 0, 2, "length must not be negative" );
+	t_buf_rng_push( L, rng, (size_t) n );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Drop bytes from the head of the ring.  Nothing gets copied.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \lparam  int    number of bytes.
+ * \lreturn int    number of bytes dropped.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng_consume( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+	lua_Integer       n   = luaL_checkinteger( L, 2 );
+
+	luaL_argcheck( L, n >= 0, 2, "length must not be negative" );
+	n = (n < (lua_Integer) rng->len) ? n : (lua_Integer) rng->len;
+	t_buf_rng_consume( rng, (size_t) n );
+	lua_pushinteger( L, n );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Find a string in the readable bytes, also across the wrap point.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \lparam  string delimiter to find.
+ * \lparam  int    position to start at; defaults to 1.
+ * \lreturn int    position of delimiter; nil if not found.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng_find( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+	size_t            dln;
+	const char       *dlm = luaL_checklstring( L, 2, &dln );
+	lua_Integer       ini = luaL_optinteger( L, 3, 1 );
+	lua_Integer       pos;
+
+	luaL_argcheck( L, dln > 0, 2, "delimiter must not be empty" );
+	luaL_argcheck( L, ini > 0, 3, "position must be greater than 0" );
+	pos = t_buf_rng_find( rng, dlm, dln, (size_t) ini - 1 );
+	if (pos < 0)
+		lua_pushnil( L );
+	else
+		lua_pushinteger( L, pos + 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Make sure n bytes can be written without growing again.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \lparam  int    number of bytes.
+ * \lreturn int    number of writable bytes.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng_reserve( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+	lua_Integer       n   = luaL_checkinteger( L, 2 );
+	size_t            fln;
+
+	luaL_argcheck( L, n >= 0, 2, "length must not be negative" );
+	if (NULL == t_buf_rng_reserve( rng, (size_t) n, &fln ))
+		return luaL_error( L, "couldn't grow "T_BUF_RNG_TYPE );
+	lua_pushinteger( L, (lua_Integer) (rng->cap - rng->len) );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Drop all readable bytes; keeps the capacity.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng_clear( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+
+	rng->hd  = 0;
+	rng->len = 0;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Returns number of readable bytes.
+ * \param   L    Lua state
+ * \lparam  ud   T.Buffer.Ring userdata instance.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng__len( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+
+	lua_pushinteger( L, (lua_Integer) rng->len );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * __index method for T.Buffer.Ring.
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \lparam  string Access key value; readable, writable, size or method name.
+ * \lreturn value  based on what's behind __index.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng__index( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+	const char       *key = luaL_checkstring( L, 2 );
+
+	if (0 == strcmp( key, "readable" ))
+		lua_pushinteger( L, (lua_Integer) rng->len );
+	else if (0 == strcmp( key, "writable" ))
+		lua_pushinteger( L, (lua_Integer) (rng->cap - rng->len) );
+	else if (0 == strcmp( key, "size" ))
+		lua_pushinteger( L, (lua_Integer) rng->cap );
+	else
+	{
+		lua_getmetatable( L, 1 );  //S: rng key _mt
+		lua_pushvalue( L, 2 );     //S: rng key _mt key
+		lua_gettable( L, -2 );     //S: rng key _mt val
+	}
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Return Tostring representation of a ring buffer.
+ * \param   L      Lua state
+ * \lparam  ud     T.Buffer.Ring userdata instance.
+ * \lreturn string Formatted string representing ring buffer.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng__tostring( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+	lua_pushfstring( L, T_BUF_RNG_TYPE"[%d/%d]: %p", rng->len, rng->cap, rng );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Garbage Collector.  Free the storage.
+ * \param   L    Lua state.
+ * \lparam  ud   T.Buffer.Ring userdata instance.
+ * \return  int  # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_rng__gc( lua_State *L )
+{
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 1, 1 );
+
+	free( rng->b );
+	rng->b   = NULL;
+	rng->cap = 0;
+	rng->len = 0;
+	return 0;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Class metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_buf_rng_fm [] = {
+	  { "__call"       , lt_buf_rng__Call }
+	, { NULL           , NULL }
+};
+
+/**--------------------------------------------------------------------------
+ * Class functions library definition
+ * --------------------------------------------------------------------------*/
+static const struct luaL_Reg t_buf_rng_cf [] = {
+	  { NULL           , NULL }
+};
+
+/**--------------------------------------------------------------------------
+ * Instance metamethods library definition
+ * --------------------------------------------------------------------------*/
+static const luaL_Reg t_buf_rng_m [] = {
+	// metamethods
+	  { "__tostring"   , lt_buf_rng__tostring }
+	, { "__index"      , lt_buf_rng__index }
+	, { "__len"        , lt_buf_rng__len }
+	, { "__gc"         , lt_buf_rng__gc }
+	// instance methods
+	, { "write"        , lt_buf_rng_write }
+	, { "read"         , lt_buf_rng_read }
+	, { "peek"         , lt_buf_rng_peek }
+	, { "consume"      , lt_buf_rng_consume }
+	, { "find"         , lt_buf_rng_find }
+	, { "reserve"      , lt_buf_rng_reserve }
+	, { "clear"        , lt_buf_rng_clear }
+	// universal stuff
+	, { "toHex"        , lt_buf_toHexString }
+	, { NULL           , NULL }
+};
+
+
+/**--------------------------------------------------------------------------
+ * Pushes this library onto the stack.
+ *          - creates Metatable with functions
+ *          - creates metatable with methods
+ * \param   L      The lua state.
+ * \lreturn table  the library
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+int
+luaopen_t_buf_rng( lua_State *L )
+{
+	// T.Buffer.Ring instance metatable
+	luaL_newmetatable( L, T_BUF_RNG_TYPE );
+	luaL_setfuncs( L, t_buf_rng_m, 0 );
+	lua_pop( L, 1 );  // balance the stack
+
+	// T.Buffer.Ring class
+	luaL_newlib( L, t_buf_rng_cf );
+	luaL_newlib( L, t_buf_rng_fm );
+	lua_setmetatable( L, -2 );
+	return 1;
+}
@@ -24,16 +24,17 @@
 /**--------------------------------------------------------------------------
  * Adjusts T.Buffer.Segment internal values.
  * \param  *L  Lua state.
- *
- * \return struct t_buf_seg*  pointer to the  t_buf_seg struct
+ * \param  *seg  struct t_buf_seg*; the segment; seg->buf must be set.
+ * \param   idx  lua_Integer; 1-based start within the parent buffer.
+ * \param   len  lua_Integer; length of the segment.
  * --------------------------------------------------------------------------*/
 static void
-t_buf_seg_set( lua_State *L, struct t_buf_seg *seg, struct t_buf *buf, lua_Integer idx, lua_Integer len )
+t_buf_seg_set( lua_State *L, struct t_buf_seg *seg, lua_Integer idx, lua_Integer len )
 {
-	//printf( "%lld    %lld    %ld (%zu  %zu)\n", idx, len, buf->len, seg->idx, seg->len );
-	luaL_argcheck( L, 1 <= idx && (size_t) idx         <= buf->len, 1,
+	//printf( "%lld    %lld    %ld (%zu  %zu)\n", idx, len, seg->buf->len, seg->idx, seg->len );
+	luaL_argcheck( L, 1 <= idx && (size_t) idx         <= seg->buf->len, 1,
 	   T_BUF_SEG_TYPE" offset relative to length of "T_BUF_TYPE" out of bound" );
-	luaL_argcheck( L, len >= 0 && (size_t) (idx+len-1) <= buf->len, 2,
+	luaL_argcheck( L, len >= 0 && (size_t) (idx+len-1) <= seg->buf->len, 2,
 	   T_BUF_SEG_TYPE" length out of bound" );
 
 	seg->len = (size_t) len;
@@ -78,7 +79,8 @@ lt_buf_seg__Call( lua_State *L )
 	seg = t_buf_seg_create_ud( L );                           //S: CLS buf idx len seg
 	lua_rotate( L, 2, -1 );                                   //S: CLS idx len seg buf
 	lua_setiuservalue( L, -2, T_BUF_SEG_BUFIDX );             //S: CLS idx len seg
-	t_buf_seg_set( L, seg, buf, idx, len );
+	seg->buf = buf;
+	t_buf_seg_set( L, seg, idx, len );
 	return 1;
 }
 
@@ -117,9 +119,7 @@ lt_buf_seg_shift( lua_State *L )
 	struct t_buf_seg *seg   = t_buf_seg_check_ud( L, 1, 1 );
 	lua_Integer       val   = luaL_checkinteger( L, 2 );
 
-	lua_getiuservalue( L, 1, T_BUF_SEG_BUFIDX );            //S: seg val buf
-	t_buf_seg_set( L, seg, t_buf_check_ud( L, -1, 1), seg->idx + val, seg->len );
-	lua_pop( L, 1 );
+	t_buf_seg_set( L, seg, seg->idx + val, seg->len );
 	lua_pushboolean( L, 1 );
 
 	return 1;
@@ -137,16 +137,13 @@ static int
 lt_buf_seg_next( lua_State *L )
 {
 	struct t_buf_seg *seg   = t_buf_seg_check_ud( L, 1, 1 );
-	struct t_buf     *buf;
+	struct t_buf     *buf   = seg->buf;
 
-	lua_getiuservalue( L, 1, T_BUF_SEG_BUFIDX );            //S: seg buf
-	buf = t_buf_check_ud( L, -1, 1 );
-	lua_pop( L, 1 );
 	if (seg->idx + seg->len > buf->len)
 		lua_pushboolean( L, 0 );
 	else
 	{
-		t_buf_seg_set( L, seg, buf,
+		t_buf_seg_set( L, seg,
 			seg->idx + seg->len,
 			(seg->idx + 2*seg->len > buf->len)
 				? buf->len - seg->idx - seg->len + 1
@@ -158,6 +155,68 @@ lt_buf_seg_next( lua_State *L )
 }
 
 
+/**--------------------------------------------------------------------------
+ * Iterator function returned by seg:iterate().  Returns the segment itself
+ * on the first call, afterwards moves it by step bytes.
+ * \param   L      Lua state.
+ * \upvalue int    step; bytes to move the window per iteration.
+ * \upvalue int    size of the window.
+ * \lparam  ud     T.Buffer.Segement userdata instance.
+ * \lparam  ud     T.Buffer.Segement userdata instance or nil on first call.
+ * \lreturn ud     T.Buffer.Segement userdata instance or nil when done.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_buf_seg_iter( lua_State *L )
+{
+	struct t_buf_seg *seg = t_buf_seg_check_ud( L, 1, 1 );
+	size_t            stp = (size_t) lua_tointeger( L, lua_upvalueindex( 1 ) );
+	size_t            sz  = (size_t) lua_tointeger( L, lua_upvalueindex( 2 ) );
+
+	if (! lua_isnil( L, 2 ))
+	{
+		if (seg->idx + stp > seg->buf->len)
+		{
+			lua_pushnil( L );
+			return 1;
+		}
+		seg->idx += stp;
+		seg->len  = (seg->idx + sz - 1 > seg->buf->len) ? seg->buf->len - seg->idx + 1 : sz;
+	}
+	lua_pushvalue( L, 1 );
+	return 1;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Walk the segment as a window over its buffer.  The loop gets the segment
+ * itself on each step; no new segments get created.  The window shrinks at
+ * the end of the buffer.
+ *     for s in buf:Segment( 1, 4096 ):iterate( ) do ... end
+ * \param   L      Lua state.
+ * \lparam  ud     T.Buffer.Segement userdata instance.
+ * \lparam  int    step; bytes to move per iteration; defaults to seg.size.
+ * \lreturn func   iterator function.
+ * \lreturn ud     T.Buffer.Segement userdata instance.
+ * \lreturn nil    initial control value.
+ * \return  int    # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+lt_buf_seg_iterate( lua_State *L )
+{
+	struct t_buf_seg *seg = t_buf_seg_check_ud( L, 1, 1 );
+	lua_Integer       stp = luaL_optinteger( L, 2, (lua_Integer) seg->len );
+
+	luaL_argcheck( L, stp > 0, 2, "step must be greater than 0" );
+	lua_pushinteger( L, stp );
+	lua_pushinteger( L, (lua_Integer) seg->len );
+	lua_pushcclosure( L, &t_buf_seg_iter, 2 );
+	lua_pushvalue( L, 1 );
+	lua_pushnil( L );
+	return 3;
+}
+
+
 /**--------------------------------------------------------------------------
  * __index method for Buffer.Segment.
  * \param   L      Lua state.
@@ -180,15 +239,14 @@ lt_buf_seg__index( lua_State *L )
 			lua_pushnil( L );
 		else
 		{
-			key = t_buf_tolstring( L, 1, NULL, NULL );
-			lua_pushinteger( L, key[ idx-1 ] );
+			lua_pushinteger( L, seg->buf->b[ seg->idx + idx - 2 ] );
 		}
 	}
 	else
 	{
 		key = lua_tostring( L, 2 );
 		if (0 == strncmp( key, "buffer", 6 ))
-			lua_getiuservalue( L, T_BUF_SEG_BUFIDX, 1 );
+			lua_getiuservalue( L, 1, T_BUF_SEG_BUFIDX );
 		else if (0 == strncmp( key, "start", 5 ) )
 			lua_pushinteger( L, seg->idx );
 		else if (0 == strncmp( key, "size", 4 ) )
@@ -221,7 +279,6 @@ lt_buf_seg__newindex( lua_State *L )
 	int               idx;
 	lua_Integer       val = luaL_checkinteger( L, 3 );
 	const char       *key;
-	char             *b;
 
 	if (lua_isinteger( L, 2 ))
 	{
@@ -230,23 +287,20 @@ lt_buf_seg__newindex( lua_State *L )
 		val = luaL_checkinteger( L, 3 );
 		// value must be byte sized
 		luaL_argcheck( L, val >= 0 && val <=            255, 3, "value out of range" );
-		b   = t_buf_tolstring( L, 1, NULL, NULL );
-		b[ idx-1 ] = val;
+		seg->buf->b[ seg->idx + idx - 2 ] = val;
 	}
 	else
 	{
 		key = luaL_checkstring( L, 2 );
-		lua_getiuservalue( L, 1, T_BUF_SEG_BUFIDX );            //S: seg idx val buf
 
 		if (0 == strncmp( key, "start", 5 ) )
-			t_buf_seg_set( L, seg, t_buf_check_ud( L, -1, 1 ), val, seg->len + seg->idx - val );
+			t_buf_seg_set( L, seg, val, seg->len + seg->idx - val );
 		else if (0 == strncmp( key, "size", 4 ) )
-			t_buf_seg_set( L, seg, t_buf_check_ud( L, -1, 1 ), seg->idx, val );
+			t_buf_seg_set( L, seg, seg->idx, val );
 		else if (0 == strncmp( key, "last", 4 ) )
-			t_buf_seg_set( L, seg, t_buf_check_ud( L, -1, 1 ), seg->idx, val - seg->idx );
+			t_buf_seg_set( L, seg, seg->idx, val - seg->idx );
 		else
 			luaL_argerror( L, 2, "Can't set this value in "T_BUF_SEG_TYPE );
-		lua_pop( L, 1 );                                        //S: seg idx val
 	}
 	return 0;
 }
@@ -280,9 +334,21 @@ static const luaL_Reg t_buf_seg_m [] = {
 	// instance methods
 	, { "shift"        , lt_buf_seg_shift }
 	, { "next"         , lt_buf_seg_next }
+	, { "iterate"      , lt_buf_seg_iterate }
 	, { "clear"        , lt_buf_clear }
 	, { "read"         , lt_buf_read }
 	, { "write"        , lt_buf_write }
+	, { "find"         , lt_buf_find }
+	, { "findByte"     , lt_buf_findByte }
+	, { "count"        , lt_buf_count }
+	, { "compare"      , lt_buf_compare }
+	, { "xor"          , lt_buf_xor }
+	, { "fill"         , lt_buf_fill }
+	, { "reverse"      , lt_buf_reverse }
+	, { "bswap16"      , lt_buf_bswap16 }
+	, { "bswap32"      , lt_buf_bswap32 }
+	, { "bswap64"      , lt_buf_bswap64 }
+	, { "copy"         , lt_buf_copy }
 	// universal stuff
 	, { "toHex"        , lt_buf_toHexString }
 	, { "toBin"        , lt_buf_toBinString }
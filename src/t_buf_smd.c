@@ -0,0 +1,745 @@
+/* vim: ts=3 sw=3 sts=3 tw=80 sta noet list
+*/
+/**
+ * \file      t_buf_smd.c
+ * \brief     Search, compare and bulk transform primitives for T.Buffer
+ *            Find substrings and bytes, count bytes and find the first
+ *            difference between two byte ranges.  Encode and decode hex,
+ *            xor with a key, reverse and byte swap ranges in place.
+ * \detail    On x86 the loops handle 16 (SSE2/SSSE3) or 32 (AVX2) bytes per
+ *            step.  The implementation gets picked at runtime by
+ *            t_buf_smd_init() depending on what the CPU supports; elsewhere
+ *            the plain C versions are used.  Substring search compares the
+ *            first and the last byte of the needle for a whole block at once
+ *            and verifies the candidates only.
+ * \author    tkieslich
+ * \copyright See Copyright notice at the end of t.h
+ */
+
+
+#include <stdint.h>               // uint64_t
+#include <string.h>               // memchr, memcmp, memcpy
+
+#include "t_buf_l.h"
+
+#if defined( __GNUC__ ) && (defined( __x86_64__ ) || defined( __i386__ ))
+#define T_BUF_SMD_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef DEBUG
+#include "t_dbg.h"
+#endif
+
+/// Longest xor key the vector versions handle; longer keys take the C path
+#define T_BUF_SMD_XORKEY 64
+
+
+/// The set of primitives in use
+static struct {
+	const char *name;
+	size_t    (*find)    ( const char *h, size_t hl, const char *n, size_t nl );
+	size_t    (*findSet) ( const char *s, size_t sl, const char *set, size_t stl );
+	size_t    (*count)   ( const char *s, size_t sl, char c );
+	size_t    (*mismatch)( const char *a, const char *b, size_t n );
+	void      (*toHex)   ( char *dst, const char *src, size_t n );
+	size_t    (*fromHex) ( char *dst, const char *src, size_t n );
+	void      (*xorKey)  ( char *b, size_t n, const char *k, size_t kl );
+	void      (*reverse) ( char *b, size_t n );
+	void      (*bswap)   ( char *b, size_t n, size_t w );
+} t_buf_smd;
+
+
+// ----------------------------- plain C versions
+
+
+static size_t
+t_buf_smd_find_c( const char *h, size_t hl, const char *n, size_t nl )
+{
+	const char *c = h;
+	const char *e;
+
+	if (nl > hl)
+		return T_BUF_SMD_NONE;
+	if (0 == nl)
+		return 0;
+	e = h + hl - nl + 1;           // last possible start + 1
+	while (c < e && NULL != (c = memchr( c, n[ 0 ], (size_t) (e - c) )))
+	{
+		if (0 == memcmp( c + 1, n + 1, nl - 1 ))
+			return (size_t) (c - h);
+		c++;
+	}
+	return T_BUF_SMD_NONE;
+}
+
+
+static size_t
+t_buf_smd_findSet_c( const char *s, size_t sl, const char *set, size_t stl )
+{
+	unsigned char tbl[ 256 ];
+	size_t        i;
+
+	memset( tbl, 0, sizeof( tbl ) );
+	for (i=0; i<stl; i++)
+		tbl[ (unsigned char) set[ i ] ] = 1;
+	for (i=0; i<sl; i++)
+		if (tbl[ (unsigned char) s[ i ] ])
+			return i;
+	return T_BUF_SMD_NONE;
+}
+
+
+static size_t
+t_buf_smd_count_c( const char *s, size_t sl, char c )
+{
+	size_t i, cnt = 0;
+
+	for (i=0; i<sl; i++)
+		cnt += (s[ i ] == c);
+	return cnt;
+}
+
+
+static size_t
+t_buf_smd_mismatch_c( const char *a, const char *b, size_t n )
+{
+	size_t i;
+
+	for (i=0; i<n && a[ i ] == b[ i ]; i++);
+	return i;
+}
+
+
+static void
+t_buf_smd_toHex_c( char *dst, const char *src, size_t n )
+{
+	static const char hx[] = "0123456789ABCDEF";
+	size_t            i;
+
+	for (i=0; i<n; i++, dst += 3)
+	{
+		dst[ 0 ] = hx[ (unsigned char) src[ i ] >> 4 ];
+		dst[ 1 ] = hx[ (unsigned char) src[ i ] & 0x0F ];
+		dst[ 2 ] = ' ';
+	}
+}
+
+
+static int
+t_buf_smd_nibble( char c )
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c |= 0x20;                     // lower case
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+
+static size_t
+t_buf_smd_fromHex_c( char *dst, const char *src, size_t n )
+{
+	size_t i;
+	int    h, l;
+
+	for (i=0; i + 1 < n; i += 2)
+	{
+		if ((h = t_buf_smd_nibble( src[ i ] )) < 0 || (l = t_buf_smd_nibble( src[ i+1 ] )) < 0)
+			break;
+		*(dst++) = (char) (h << 4 | l);
+	}
+	return i;
+}
+
+
+static void
+t_buf_smd_xor_c( char *b, size_t n, const char *k, size_t kl )
+{
+	size_t i, j;
+
+	for (i=0, j=0; i<n; i++)
+	{
+		b[ i ] ^= k[ j ];
+		if (++j == kl)
+			j = 0;
+	}
+}
+
+
+static void
+t_buf_smd_reverse_c( char *b, size_t n )
+{
+	char   c;
+	size_t i;
+
+	for (i=0; i < n/2; i++)
+	{
+		c              = b[ i ];
+		b[ i ]         = b[ n - i - 1 ];
+		b[ n - i - 1 ] = c;
+	}
+}
+
+
+static void
+t_buf_smd_bswap_c( char *b, size_t n, size_t w )
+{
+	size_t i;
+
+	for (i=0; i + w <= n; i += w)
+		t_buf_smd_reverse_c( b + i, w );
+}
+
+
+#ifdef T_BUF_SMD_X86
+// ----------------------------- SSE2 versions
+
+__attribute__ ((target( "sse2" )))
+static size_t
+t_buf_smd_find_sse2( const char *h, size_t hl, const char *n, size_t nl )
+{
+	__m128i  f, l, bf, bl;
+	unsigned m, b;
+	size_t   i, r;
+
+	if (nl < 2 || nl > hl)
+		return t_buf_smd_find_c( h, hl, n, nl );
+	f = _mm_set1_epi8( n[ 0 ] );
+	l = _mm_set1_epi8( n[ nl - 1 ] );
+	for (i=0; i + nl - 1 + 16 <= hl; i += 16)
+	{
+		bf = _mm_loadu_si128( (const __m128i *) (h + i) );
+		bl = _mm_loadu_si128( (const __m128i *) (h + i + nl - 1) );
+		m  = (unsigned) _mm_movemask_epi8( _mm_and_si128( _mm_cmpeq_epi8( f, bf ), _mm_cmpeq_epi8( l, bl ) ) );
+		while (m)
+		{
+			b = (unsigned) __builtin_ctz( m );
+			if (0 == memcmp( h + i + b + 1, n + 1, nl - 2 ))
+				return i + b;
+			m &= m - 1;
+		}
+	}
+	r = t_buf_smd_find_c( h + i, hl - i, n, nl );
+	return (T_BUF_SMD_NONE == r) ? r : i + r;
+}
+
+
+__attribute__ ((target( "sse2" )))
+static size_t
+t_buf_smd_findSet_sse2( const char *s, size_t sl, const char *set, size_t stl )
+{
+	__m128i  blk, acc;
+	unsigned m;
+	size_t   i, k, r;
+
+	if (stl > 16)
+		return t_buf_smd_findSet_c( s, sl, set, stl );
+	for (i=0; i + 16 <= sl; i += 16)
+	{
+		blk = _mm_loadu_si128( (const __m128i *) (s + i) );
+		acc = _mm_setzero_si128( );
+		for (k=0; k<stl; k++)
+			acc = _mm_or_si128( acc, _mm_cmpeq_epi8( blk, _mm_set1_epi8( set[ k ] ) ) );
+		if (0 != (m = (unsigned) _mm_movemask_epi8( acc )))
+			return i + (unsigned) __builtin_ctz( m );
+	}
+	r = t_buf_smd_findSet_c( s + i, sl - i, set, stl );
+	return (T_BUF_SMD_NONE == r) ? r : i + r;
+}
+
+
+__attribute__ ((target( "sse2" )))
+static size_t
+t_buf_smd_count_sse2( const char *s, size_t sl, char c )
+{
+	__m128i  v = _mm_set1_epi8( c );
+	size_t   i, cnt = 0;
+
+	for (i=0; i + 16 <= sl; i += 16)
+		cnt += (size_t) __builtin_popcount( (unsigned) _mm_movemask_epi8(
+			_mm_cmpeq_epi8( v, _mm_loadu_si128( (const __m128i *) (s + i) ) ) ) );
+	return cnt + t_buf_smd_count_c( s + i, sl - i, c );
+}
+
+
+__attribute__ ((target( "sse2" )))
+static size_t
+t_buf_smd_mismatch_sse2( const char *a, const char *b, size_t n )
+{
+	unsigned m;
+	size_t   i;
+
+	for (i=0; i + 16 <= n; i += 16)
+	{
+		m = (unsigned) _mm_movemask_epi8( _mm_cmpeq_epi8(
+			_mm_loadu_si128( (const __m128i *) (a + i) ),
+			_mm_loadu_si128( (const __m128i *) (b + i) ) ) );
+		if (0xFFFF != m)
+			return i + (unsigned) __builtin_ctz( ~m );
+	}
+	return i + t_buf_smd_mismatch_c( a + i, b + i, n - i );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Translate 16 hex digits into their values.
+ * \param   v       __m128i; 16 characters.
+ * \param  *valid   unsigned*; bitmask of characters which are hex digits.
+ * \return  __m128i values of the hex digits; 0 for other characters.
+ * --------------------------------------------------------------------------*/
+__attribute__ ((target( "sse2" )))
+static __m128i
+t_buf_smd_nibble_sse2( __m128i v, unsigned *valid )
+{
+	// signed compares; bytes >127 wrap to values out of both ranges
+	__m128i d   = _mm_sub_epi8( v, _mm_set1_epi8( '0' ) );
+	__m128i l   = _mm_sub_epi8( _mm_or_si128( v, _mm_set1_epi8( 0x20 ) ), _mm_set1_epi8( 'a' ) );
+	__m128i isD = _mm_and_si128( _mm_cmpgt_epi8( d, _mm_set1_epi8( -1 ) ), _mm_cmplt_epi8( d, _mm_set1_epi8( 10 ) ) );
+	__m128i isL = _mm_and_si128( _mm_cmpgt_epi8( l, _mm_set1_epi8( -1 ) ), _mm_cmplt_epi8( l, _mm_set1_epi8(  6 ) ) );
+
+	*valid = (unsigned) _mm_movemask_epi8( _mm_or_si128( isD, isL ) );
+	return _mm_or_si128( _mm_and_si128( isD, d ), _mm_and_si128( isL, _mm_add_epi8( l, _mm_set1_epi8( 10 ) ) ) );
+}
+
+
+__attribute__ ((target( "sse2" )))
+static size_t
+t_buf_smd_fromHex_sse2( char *dst, const char *src, size_t n )
+{
+	const __m128i lo = _mm_set1_epi16( 0x00FF );
+	__m128i       n0, n1;
+	unsigned      v0, v1;
+	size_t        i;
+
+	for (i=0; i + 32 <= n; i += 32)
+	{
+		n0 = t_buf_smd_nibble_sse2( _mm_loadu_si128( (const __m128i *) (src + i) ), &v0 );
+		n1 = t_buf_smd_nibble_sse2( _mm_loadu_si128( (const __m128i *) (src + i + 16) ), &v1 );
+		if (0xFFFF != (v0 & v1))
+			break;
+		// each 16 bit lane holds the high nibble in the low byte
+		n0 = _mm_or_si128( _mm_slli_epi16( _mm_and_si128( n0, lo ), 4 ), _mm_srli_epi16( n0, 8 ) );
+		n1 = _mm_or_si128( _mm_slli_epi16( _mm_and_si128( n1, lo ), 4 ), _mm_srli_epi16( n1, 8 ) );
+		_mm_storeu_si128( (__m128i *) (dst + i/2), _mm_packus_epi16( n0, n1 ) );
+	}
+	return i + t_buf_smd_fromHex_c( dst + i/2, src + i, n - i );
+}
+
+
+__attribute__ ((target( "sse2" )))
+static void
+t_buf_smd_xor_sse2( char *b, size_t n, const char *k, size_t kl )
+{
+	char   pat[ 16 * T_BUF_SMD_XORKEY ];
+	size_t i, p = 16 * kl;          // pattern repeats key and is 16 aligned
+
+	if (kl > T_BUF_SMD_XORKEY)
+	{
+		t_buf_smd_xor_c( b, n, k, kl );
+		return;
+	}
+	for (i=0; i<p; i++)
+		pat[ i ] = k[ i % kl ];
+	for (i=0; i + 16 <= n; i += 16)
+		_mm_storeu_si128( (__m128i *) (b + i), _mm_xor_si128(
+			_mm_loadu_si128( (const __m128i *) (b + i) ),
+			_mm_loadu_si128( (const __m128i *) (pat + i % p) ) ) );
+	t_buf_smd_xor_c( b + i, n - i, pat + i % p, n - i );
+}
+
+
+// ----------------------------- SSSE3 versions
+
+__attribute__ ((target( "ssse3" )))
+static void
+t_buf_smd_toHex_ssse3( char *dst, const char *src, size_t n )
+{
+	const __m128i hx = _mm_setr_epi8( '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F' );
+	const __m128i nb = _mm_set1_epi8( 0x0F );
+	// spread 16 digit pairs over 48 bytes; -1 picks 0 which gets or'ed to ' '
+	const __m128i a0 = _mm_setr_epi8(  0, 1,-1, 2, 3,-1, 4, 5,-1, 6, 7,-1, 8, 9,-1,10 );
+	const __m128i a1 = _mm_setr_epi8( 11,-1,12,13,-1,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1 );
+	const __m128i b1 = _mm_setr_epi8( -1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1, 2, 3,-1, 4, 5 );
+	const __m128i b2 = _mm_setr_epi8( -1, 6, 7,-1, 8, 9,-1,10,11,-1,12,13,-1,14,15,-1 );
+	const __m128i s0 = _mm_setr_epi8(  0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0 );
+	const __m128i s1 = _mm_setr_epi8(  0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0 );
+	const __m128i s2 = _mm_setr_epi8( 32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32 );
+	__m128i       v, h, l, p0, p1;
+	size_t        i;
+
+	for (i=0; i + 16 <= n; i += 16, dst += 48)
+	{
+		v  = _mm_loadu_si128( (const __m128i *) (src + i) );
+		h  = _mm_shuffle_epi8( hx, _mm_and_si128( _mm_srli_epi16( v, 4 ), nb ) );
+		l  = _mm_shuffle_epi8( hx, _mm_and_si128( v, nb ) );
+		p0 = _mm_unpacklo_epi8( h, l );
+		p1 = _mm_unpackhi_epi8( h, l );
+		_mm_storeu_si128( (__m128i *) (dst     ), _mm_or_si128( _mm_shuffle_epi8( p0, a0 ), s0 ) );
+		_mm_storeu_si128( (__m128i *) (dst + 16), _mm_or_si128( _mm_or_si128(
+			_mm_shuffle_epi8( p0, a1 ), _mm_shuffle_epi8( p1, b1 ) ), s1 ) );
+		_mm_storeu_si128( (__m128i *) (dst + 32), _mm_or_si128( _mm_shuffle_epi8( p1, b2 ), s2 ) );
+	}
+	t_buf_smd_toHex_c( dst, src + i, n - i );
+}
+
+
+__attribute__ ((target( "ssse3" )))
+static void
+t_buf_smd_reverse_ssse3( char *b, size_t n )
+{
+	const __m128i r = _mm_setr_epi8( 15,14,13,12,11,10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 );
+	__m128i       x, y;
+	size_t        i = 0, j = n;
+
+	// swap and reverse 16 byte blocks from both ends until they meet
+	for (; j - i >= 32; i += 16, j -= 16)
+	{
+		x = _mm_loadu_si128( (const __m128i *) (b + i) );
+		y = _mm_loadu_si128( (const __m128i *) (b + j - 16) );
+		_mm_storeu_si128( (__m128i *) (b + i),      _mm_shuffle_epi8( y, r ) );
+		_mm_storeu_si128( (__m128i *) (b + j - 16), _mm_shuffle_epi8( x, r ) );
+	}
+	t_buf_smd_reverse_c( b + i, j - i );
+}
+
+
+__attribute__ ((target( "ssse3" )))
+static void
+t_buf_smd_bswap_ssse3( char *b, size_t n, size_t w )
+{
+	char    m[ 16 ];
+	__m128i msk;
+	size_t  i;
+
+	for (i=0; i<16; i++)
+		m[ i ] = (char) (i - i % w + w - 1 - i % w);
+	msk = _mm_loadu_si128( (const __m128i *) m );
+	for (i=0; i + 16 <= n; i += 16)
+		_mm_storeu_si128( (__m128i *) (b + i),
+			_mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) (b + i) ), msk ) );
+	t_buf_smd_bswap_c( b + i, n - i, w );
+}
+
+
+// ----------------------------- AVX2 versions
+
+__attribute__ ((target( "avx2" )))
+static size_t
+t_buf_smd_find_avx2( const char *h, size_t hl, const char *n, size_t nl )
+{
+	__m256i  f, l, bf, bl;
+	unsigned m, b;
+	size_t   i, r;
+
+	if (nl < 2 || nl > hl)
+		return t_buf_smd_find_c( h, hl, n, nl );
+	f = _mm256_set1_epi8( n[ 0 ] );
+	l = _mm256_set1_epi8( n[ nl - 1 ] );
+	for (i=0; i + nl - 1 + 32 <= hl; i += 32)
+	{
+		bf = _mm256_loadu_si256( (const __m256i *) (h + i) );
+		bl = _mm256_loadu_si256( (const __m256i *) (h + i + nl - 1) );
+		m  = (unsigned) _mm256_movemask_epi8( _mm256_and_si256( _mm256_cmpeq_epi8( f, bf ), _mm256_cmpeq_epi8( l, bl ) ) );
+		while (m)
+		{
+			b = (unsigned) __builtin_ctz( m );
+			if (0 == memcmp( h + i + b + 1, n + 1, nl - 2 ))
+				return i + b;
+			m &= m - 1;
+		}
+	}
+	r = t_buf_smd_find_sse2( h + i, hl - i, n, nl );
+	return (T_BUF_SMD_NONE == r) ? r : i + r;
+}
+
+
+__attribute__ ((target( "avx2" )))
+static size_t
+t_buf_smd_findSet_avx2( const char *s, size_t sl, const char *set, size_t stl )
+{
+	__m256i  blk, acc;
+	unsigned m;
+	size_t   i, k, r;
+
+	if (stl > 16)
+		return t_buf_smd_findSet_c( s, sl, set, stl );
+	for (i=0; i + 32 <= sl; i += 32)
+	{
+		blk = _mm256_loadu_si256( (const __m256i *) (s + i) );
+		acc = _mm256_setzero_si256( );
+		for (k=0; k<stl; k++)
+			acc = _mm256_or_si256( acc, _mm256_cmpeq_epi8( blk, _mm256_set1_epi8( set[ k ] ) ) );
+		if (0 != (m = (unsigned) _mm256_movemask_epi8( acc )))
+			return i + (unsigned) __builtin_ctz( m );
+	}
+	r = t_buf_smd_findSet_sse2( s + i, sl - i, set, stl );
+	return (T_BUF_SMD_NONE == r) ? r : i + r;
+}
+
+
+__attribute__ ((target( "avx2" )))
+static size_t
+t_buf_smd_count_avx2( const char *s, size_t sl, char c )
+{
+	__m256i  v = _mm256_set1_epi8( c );
+	size_t   i, cnt = 0;
+
+	for (i=0; i + 32 <= sl; i += 32)
+		cnt += (size_t) __builtin_popcount( (unsigned) _mm256_movemask_epi8(
+			_mm256_cmpeq_epi8( v, _mm256_loadu_si256( (const __m256i *) (s + i) ) ) ) );
+	return cnt + t_buf_smd_count_sse2( s + i, sl - i, c );
+}
+
+
+__attribute__ ((target( "avx2" )))
+static size_t
+t_buf_smd_mismatch_avx2( const char *a, const char *b, size_t n )
+{
+	unsigned m;
+	size_t   i;
+
+	for (i=0; i + 32 <= n; i += 32)
+	{
+		m = (unsigned) _mm256_movemask_epi8( _mm256_cmpeq_epi8(
+			_mm256_loadu_si256( (const __m256i *) (a + i) ),
+			_mm256_loadu_si256( (const __m256i *) (b + i) ) ) );
+		if (0xFFFFFFFF != m)
+			return i + (unsigned) __builtin_ctz( ~m );
+	}
+	return i + t_buf_smd_mismatch_sse2( a + i, b + i, n - i );
+}
+
+
+__attribute__ ((target( "avx2" )))
+static void
+t_buf_smd_xor_avx2( char *b, size_t n, const char *k, size_t kl )
+{
+	char   pat[ 32 * T_BUF_SMD_XORKEY ];
+	size_t i, p = 32 * kl;          // pattern repeats key and is 32 aligned
+
+	if (kl > T_BUF_SMD_XORKEY)
+	{
+		t_buf_smd_xor_c( b, n, k, kl );
+		return;
+	}
+	for (i=0; i<p; i++)
+		pat[ i ] = k[ i % kl ];
+	for (i=0; i + 32 <= n; i += 32)
+		_mm256_storeu_si256( (__m256i *) (b + i), _mm256_xor_si256(
+			_mm256_loadu_si256( (const __m256i *) (b + i) ),
+			_mm256_loadu_si256( (const __m256i *) (pat + i % p) ) ) );
+	t_buf_smd_xor_c( b + i, n - i, pat + i % p, n - i );
+}
+#endif
+
+
+// ----------------------------- dispatch
+
+/**--------------------------------------------------------------------------
+ * Pick the fastest implementation the CPU supports.  Safe to call repeatedly.
+ * The hex encoder, reverse and byte swap use SSSE3 where available.
+ * \return  const char*  name of the implementation; avx2, sse2 or c.
+ * --------------------------------------------------------------------------*/
+const char
+*t_buf_smd_init( void )
+{
+	t_buf_smd.name     = "c";
+	t_buf_smd.find     = t_buf_smd_find_c;
+	t_buf_smd.findSet  = t_buf_smd_findSet_c;
+	t_buf_smd.count    = t_buf_smd_count_c;
+	t_buf_smd.mismatch = t_buf_smd_mismatch_c;
+	t_buf_smd.toHex    = t_buf_smd_toHex_c;
+	t_buf_smd.fromHex  = t_buf_smd_fromHex_c;
+	t_buf_smd.xorKey   = t_buf_smd_xor_c;
+	t_buf_smd.reverse  = t_buf_smd_reverse_c;
+	t_buf_smd.bswap    = t_buf_smd_bswap_c;
+#ifdef T_BUF_SMD_X86
+	__builtin_cpu_init( );
+	if (__builtin_cpu_supports( "sse2" ))
+	{
+		t_buf_smd.name     = "sse2";
+		t_buf_smd.find     = t_buf_smd_find_sse2;
+		t_buf_smd.findSet  = t_buf_smd_findSet_sse2;
+		t_buf_smd.count    = t_buf_smd_count_sse2;
+		t_buf_smd.mismatch = t_buf_smd_mismatch_sse2;
+		t_buf_smd.fromHex  = t_buf_smd_fromHex_sse2;
+		t_buf_smd.xorKey   = t_buf_smd_xor_sse2;
+	}
+	if (__builtin_cpu_supports( "ssse3" ))
+	{
+		t_buf_smd.toHex    = t_buf_smd_toHex_ssse3;
+		t_buf_smd.reverse  = t_buf_smd_reverse_ssse3;
+		t_buf_smd.bswap    = t_buf_smd_bswap_ssse3;
+	}
+	if (__builtin_cpu_supports( "avx2" ))
+	{
+		t_buf_smd.name     = "avx2";
+		t_buf_smd.find     = t_buf_smd_find_avx2;
+		t_buf_smd.findSet  = t_buf_smd_findSet_avx2;
+		t_buf_smd.count    = t_buf_smd_count_avx2;
+		t_buf_smd.mismatch = t_buf_smd_mismatch_avx2;
+		t_buf_smd.xorKey   = t_buf_smd_xor_avx2;
+	}
+#endif
+	return t_buf_smd.name;
+}
+
+
+/**--------------------------------------------------------------------------
+ * Find a byte sequence.
+ * \param  *h    const char*; haystack.
+ * \param   hl   size_t; length of haystack.
+ * \param  *n    const char*; needle.
+ * \param   nl   size_t; length of needle.
+ * \return  size_t offset of needle in haystack; T_BUF_SMD_NONE if not found.
+ * --------------------------------------------------------------------------*/
+size_t
+t_buf_smd_find( const char *h, size_t hl, const char *n, size_t nl )
+{
+	return t_buf_smd.find( h, hl, n, nl );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Find the first byte which is any of a set of bytes.
+ * \param  *s    const char*; bytes to search.
+ * \param   sl   size_t; length of s.
+ * \param  *set  const char*; set of bytes to find.
+ * \param   stl  size_t; length of set.
+ * \return  size_t offset of the byte in s; T_BUF_SMD_NONE if not found.
+ * --------------------------------------------------------------------------*/
+size_t
+t_buf_smd_findSet( const char *s, size_t sl, const char *set, size_t stl )
+{
+	return t_buf_smd.findSet( s, sl, set, stl );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Count the occurences of a byte.
+ * \param  *s    const char*; bytes to search.
+ * \param   sl   size_t; length of s.
+ * \param   c    char; byte to count.
+ * \return  size_t number of occurences.
+ * --------------------------------------------------------------------------*/
+size_t
+t_buf_smd_count( const char *s, size_t sl, char c )
+{
+	return t_buf_smd.count( s, sl, c );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Find the first byte which differs between two ranges.
+ * \param  *a    const char*; first range.
+ * \param  *b    const char*; second range.
+ * \param   n    size_t; number of bytes to compare.
+ * \return  size_t offset of first difference; n if equal.
+ * --------------------------------------------------------------------------*/
+size_t
+t_buf_smd_mismatch( const char *a, const char *b, size_t n )
+{
+	return t_buf_smd.mismatch( a, b, n );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Write bytes as upper case hex digits; each pair followed by a blank.
+ * \param  *dst  char*; 3*n bytes of space.
+ * \param  *src  const char*; bytes to encode.
+ * \param   n    size_t; number of bytes to encode.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_smd_toHex( char *dst, const char *src, size_t n )
+{
+	t_buf_smd.toHex( dst, src, n );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Write bytes as strings of 0 and 1; each followed by a blank.
+ * \param  *dst  char*; 9*n bytes of space.
+ * \param  *src  const char*; bytes to encode.
+ * \param   n    size_t; number of bytes to encode.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_smd_toBin( char *dst, const char *src, size_t n )
+{
+	size_t   i;
+#if defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t bits;
+
+	// spread the 8 bits into 8 bytes, most significant first, and add '0'
+	for (i=0; i<n; i++, dst += 9)
+	{
+		bits = ((((uint64_t) (unsigned char) src[ i ] * 0x8040201008040201ULL) >> 7)
+		         & 0x0101010101010101ULL) | 0x3030303030303030ULL;
+		memcpy( dst, &bits, 8 );
+		dst[ 8 ] = ' ';
+	}
+#else
+	size_t   x;
+
+	for (i=0; i<n; i++, dst += 9)
+	{
+		for (x=0; x<8; x++)
+			dst[ x ] = ((src[ i ] >> (7-x)) & 0x01) ? '1' : '0';
+		dst[ 8 ] = ' ';
+	}
+#endif
+}
+
+
+/**--------------------------------------------------------------------------
+ * Decode pairs of hex digits until a character is not a hex digit.
+ * \param  *dst  char*; n/2 bytes of space.
+ * \param  *src  const char*; hex digits.
+ * \param   n    size_t; number of characters in src.
+ * \return  size_t number of characters consumed; always even.
+ * --------------------------------------------------------------------------*/
+size_t
+t_buf_smd_fromHex( char *dst, const char *src, size_t n )
+{
+	return t_buf_smd.fromHex( dst, src, n );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Xor bytes with a repeating key in place.
+ * \param  *b    char*; bytes to modify.
+ * \param   n    size_t; number of bytes.
+ * \param  *k    const char*; key.
+ * \param   kl   size_t; length of key; must be greater than 0.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_smd_xor( char *b, size_t n, const char *k, size_t kl )
+{
+	t_buf_smd.xorKey( b, n, k, kl );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Reverse the order of bytes in place.
+ * \param  *b    char*; bytes to modify.
+ * \param   n    size_t; number of bytes.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_smd_reverse( char *b, size_t n )
+{
+	t_buf_smd.reverse( b, n );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Swap the byte order of each w byte wide word in place.
+ * \param  *b    char*; bytes to modify.
+ * \param   n    size_t; number of bytes; multiple of w.
+ * \param   w    size_t; word width; 2, 4 or 8.
+ * --------------------------------------------------------------------------*/
+void
+t_buf_smd_bswap( char *b, size_t n, size_t w )
+{
+	t_buf_smd.bswap( b, n, w );
+}
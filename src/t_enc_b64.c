@@ -10,6 +10,7 @@
 #include <stdio.h>
 
 #include "t_enc_l.h"
+#include "t_buf.h"            // t_buf_checklstring
 
 #ifdef DEBUG
 #include "t_dbg.h"
@@ -97,7 +98,7 @@ lt_enc_b64_encode( lua_State *L )
 {
 	luaL_Buffer         lB;
 	size_t              bLen;                                     ///< length of body
-	const char         *body   = luaL_checklstring( L, 1, &bLen );
+	const char         *body   = t_buf_checklstring( L, 1, &bLen, NULL );
 	size_t              rLen   = B64_RESULT_SIZE( bLen, 1 );      ///< length of result
 	char               *res    = luaL_buffinitsize( L, &lB, rLen );
 
@@ -119,7 +120,7 @@ lt_enc_b64_decode( lua_State *L )
 {
 	luaL_Buffer         lB;
 	size_t              bLen;                                     ///< length of body
-	const char         *body   = luaL_checklstring( L, 1, &bLen );
+	const char         *body   = t_buf_checklstring( L, 1, &bLen, NULL );
 	size_t              rLen   = B64_RESULT_SIZE( bLen, 0 );      ///< length of result
 	char               *res    = luaL_buffinitsize( L, &lB, rLen );
 
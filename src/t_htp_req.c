@@ -369,6 +369,7 @@ t_htp_req_parseHeaders( lua_State *L, const char **data, const char *end )
  * \param   L      Lua state.
  * \lparam  table  t.Http.Request userdata.
  * \lparam  string Lua string of received data.
+ *                 OR T.Buffer.Ring; the parsed bytes get consumed.
  * \lparam  status current parsing status.
  * \return  int    # of values pushed onto the stack.
  * --------------------------------------------------------------------------*/
@@ -376,8 +377,12 @@ static int
 lt_htp_req_parse( lua_State *L )
 {
 	size_t      d_len;
-	const char  *data = luaL_checklstring( L, 2, &d_len );
+	struct t_buf_rng *rng = t_buf_rng_check_ud( L, 2, 0 );
+	const char  *data = (NULL != rng)
+	                    ? t_buf_checklstring( L, 2, &d_len, NULL )
+	                    : luaL_checklstring( L, 2, &d_len );
 	const char   *end = data + d_len-1; // marks the last character
+	const char *start = data;           // tail moves data along
 	const char **tail = &data;
 	size_t      state = (size_t) luaL_checkinteger( L, 3 );
 	lua_pop( L, 1 );  // pop state
@@ -407,7 +412,12 @@ lt_htp_req_parse( lua_State *L )
 		default:
 			break;
 	}
-	if (*tail == end)
+	if (NULL != rng)  // the ring keeps the unparsed tail
+	{
+		t_buf_rng_consume( rng, (*tail == end) ? d_len : (size_t) (*tail - start) );
+		lua_pushnil( L );
+	}
+	else if (*tail == end)
 		lua_pushnil( L );
 	else
 		lua_pushlstring( L, *tail, end - (*tail) + 1 );
@@ -35,6 +35,10 @@ extern int _t_net_default_family;
 #endif  // T_NET_DEF_FAM_H
 
 
+/// Maximum number of Buffer.Chain entries passed to one sendmsg(); the rest
+/// goes out with the next send.
+#define T_NET_SCK_IOV_MAX   64
+
 // Socket option handling type declaration
 enum t_net_sck_optionType {
 	T_NET_SCK_OTP_BOOL,
@@ -92,6 +96,7 @@ int    p_net_sck_connect        (               struct t_net_sck *sck, struct so
 int    p_net_sck_accept         (               struct t_net_sck *srv, struct t_net_sck *cli, struct sockaddr_storage *adr );
 ssize_t p_net_sck_send          (               struct t_net_sck *sck, struct sockaddr_storage *adr, const char* buf, size_t len );
 ssize_t p_net_sck_recv          (               struct t_net_sck *sck, struct sockaddr_storage *adr,       char *buf, size_t len );
+ssize_t p_net_sck_sendv         (               struct t_net_sck *sck, struct sockaddr_storage *adr, char **buf, size_t *len, int n );
 int    p_net_sck_shutDown       (               struct t_net_sck *sck, int shutVal );
 int    p_net_sck_close          (               struct t_net_sck *sck );
 int    p_net_sck_setSocketOption( lua_State *L, struct t_net_sck *sck, struct t_net_sck_option *opt );
@@ -212,6 +217,9 @@ int    luaopen_t_net_sck_typ    ( lua_State *L );
 static const struct t_net_sck_option t_net_sck_options[ ] =
 {
 	{ "broadcast"   , SOL_SOCKET  , 0       , SO_BROADCAST   , T_NET_SCK_OTP_BOOL   , 1 , 1 } ,
+#ifdef SO_BUSY_POLL
+	{ "busypoll"    , SOL_SOCKET  , 0       , SO_BUSY_POLL   , T_NET_SCK_OTP_INT    , 1 , 1 } ,
+#endif
 #ifdef FD_CLOEXEC
 	{ "closeexec"   , F_GETFD     , F_SETFD , FD_CLOEXEC     , T_NET_SCK_OTP_FCNTL  , 1 , 1 } ,
 #endif
@@ -229,6 +237,9 @@ static const struct t_net_sck_option t_net_sck_options[ ] =
 	{ "nosigpipe"   , SOL_SOCKET  , 0       , SO_NOSIGPIPE   , T_NET_SCK_OTP_BOOL   , 1 , 1 } ,
 #endif
 	{ "oobinline"   , SOL_SOCKET  , 0       , SO_OOBINLINE   , T_NET_SCK_OTP_BOOL   , 1 , 1 } ,
+#ifdef SO_PREFER_BUSY_POLL
+	{ "preferbusypoll", SOL_SOCKET, 0       , SO_PREFER_BUSY_POLL, T_NET_SCK_OTP_BOOL, 1 , 1 } ,
+#endif
 #ifdef SO_PROTOCOL
 	{ "protocol"    , SOL_SOCKET  , 0       , SO_PROTOCOL    , T_NET_SCK_OTP_PRTC   , 1 , 0 } ,
 #endif
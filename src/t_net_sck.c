@@ -36,6 +36,45 @@ static const char
 }
 
 
+/**--------------------------------------------------------------------------
+ * Shall a failed operation wait for the socket instead of returning an error?
+ * Only operations which would block and are called from a coroutine started
+ * by T.Loop:spawn() wait.  Everything else gets the error returned as usual.
+ * \param   L         Lua State.
+ * \return  int       boolean; use t_await().
+ * --------------------------------------------------------------------------*/
+static inline int
+t_net_sck_mustWait( lua_State *L )
+{
+	return (EAGAIN == errno || EWOULDBLOCK == errno || EINPROGRESS == errno)
+	       && t_isAwaitable( L );
+}
+
+
+/**--------------------------------------------------------------------------
+ * Push the error of a failed send() or recv() including the errno.
+ * The errno allows to tell EAGAIN on a non blocking socket from real errors.
+ * \param   L         Lua State.
+ * \param  *adr       struct sockaddr_storage*; peer address or NULL.
+ * \param  *op        const char*; "send" or "receive".
+ * \param  *prp       const char*; "to" or "from".
+ * \lreturn false, error message, errno.
+ * \return  int       # of values pushed onto the stack.
+ * --------------------------------------------------------------------------*/
+static int
+t_net_sck_ioError( lua_State *L, struct sockaddr_storage *adr, const char *op, const char *prp )
+{
+	int err = errno;
+
+	if (NULL == adr)
+		t_push_error( L, 0, 1, "Can't %s message", op );
+	else
+		t_push_error( L, 0, 1, "Can't %s Message %s %s", op, prp, t_net_sck_getAddrString( L, adr ) );
+	lua_pushinteger( L, err );
+	return 3;
+}
+
+
 /**--------------------------------------------------------------------------
  * Create a socket and push to LuaStack.
  * \param   L        Lua state.
@@ -181,6 +220,8 @@ lt_net_sck_binder( lua_State *L )
  * \lparam  port   integer; port number.
  * \lreturn adr    userdata; t_net_adr userdata instance (optional).
  * \return  int    # of values pushed onto the stack.
+ * Inside T.Loop:spawn() a non-blocking connect waits until it is established;
+ * connecting again then reports EISCONN which counts as success.
  *-------------------------------------------------------------------------*/
 static int
 lt_net_sck_connecter( lua_State *L )
@@ -188,8 +229,12 @@ lt_net_sck_connecter( lua_State *L )
 	struct t_net_sck        *sck = t_net_sck_check_ud( L, 1, 1 );
 	struct sockaddr_storage *adr = t_net_adr_check_ud( L, 2, 1 );
 
-	if (-1 == p_net_sck_connect( sck, adr ))
+	if (-1 == p_net_sck_connect( sck, adr ) && EISCONN != errno)
+	{
+		if (t_net_sck_mustWait( L ))
+			return t_await( L, 2, 2, lt_net_sck_connecter );
 		return t_push_error( L, 0, 0, "Can't connect socket to %s", t_net_sck_getAddrString( L, adr ) );
+	}
 	else
 	{
 		lua_pushboolean( L, 1==1 );
@@ -213,7 +258,9 @@ lt_net_sck_accept( lua_State *L )
 	struct t_net_sck        *cli = t_net_sck_create_ud( L );      // accepted socket
 	struct sockaddr_storage *adr = t_net_adr_create_ud( L );      // peer address
 	if (-1 == p_net_sck_accept( srv, cli, adr ))
-		return t_push_error( L, 0, 0, "Can't accept on socket bound on %s", t_net_sck_getAddrString( L, adr ) );
+		return (t_net_sck_mustWait( L ))
+			? t_await( L, 1, 1, lt_net_sck_accept )
+			: t_push_error( L, 0, 0, "Can't accept on socket bound on %s", t_net_sck_getAddrString( L, adr ) );
 	else
 		return 2;
 }
@@ -222,19 +269,22 @@ lt_net_sck_accept( lua_State *L )
 /** -------------------------------------------------------------------------
  * Send data to a socket.
  *
- * A Buffer, Buffer.Segment or Lua string is mandatory as second parameter.  If
- * the third parameter is a Net.Address it will be passed to sendto and used
- * for an unconnected socket to determine where it goes to.  A fourth parameter,
- * or if Net.Address is omitted a third, is an integer and determines the number
- * of bytes to send.  The following permutations are possible:
- *     cnt,err = s:send( buf/seg/str )
- *     cnt,err = s:send( buf/seg/str, adr )
- *     cnt,err = s:send( buf/seg/str, max )
- *     cnt,err = s:send( buf/seg/str, adr, max )
- * \usage   int cnt = sck:send( Buffer/Segment/string buf[, Net.Address adr, int size ] )
+ * A Buffer, Buffer.Segment, Buffer.Chain or Lua string is mandatory as second
+ * parameter.  If the third parameter is a Net.Address it will be passed to
+ * sendto and used for an unconnected socket to determine where it goes to.  A
+ * fourth parameter, or if Net.Address is omitted a third, is an integer and
+ * determines the number of bytes to send.  The following permutations are
+ * possible:
+ *     cnt,err = s:send( buf/seg/chn/str )
+ *     cnt,err = s:send( buf/seg/chn/str, adr )
+ *     cnt,err = s:send( buf/seg/chn/str, max )
+ *     cnt,err = s:send( buf/seg/chn/str, adr, max )
+ * A Buffer.Chain gets sent with a single sendmsg() and the sent bytes get
+ * consumed from it.
+ * \usage   int cnt = sck:send( Buffer/Segment/Chain/string buf[, Net.Address adr, int size ] )
  * \param   L      Lua state.
  * \lparam  sck    Net.Socket  userdata instance.       -> mandatory
- * \lparam  msg    Buffer/Segment/string instance.      -> mandatory
+ * \lparam  msg    Buffer/Segment/Chain/string.         -> mandatory
  * \lparam  adr    Net.Address userdata instance.       -> optional
  * \lparam  max    size of msg t be send in bytes.      -> optional
  * \lreturn sent   number of bytes sent.
@@ -243,26 +293,43 @@ lt_net_sck_accept( lua_State *L )
 static int
 lt_net_sck_send( lua_State *L )
 {
+	int                      n   = lua_gettop( L );
 	size_t                   len; // length of message to send
 	ssize_t                  snt; // actually sent bytes
 	struct t_net_sck        *sck = t_net_sck_check_ud( L, 1, 1 );
-	char                    *msg = t_buf_checklstring( L, 2, &len, NULL );
+	struct t_buf_chn        *chn = t_buf_chn_check_ud( L, 2, 0 );
+	char                    *msg = (NULL == chn) ? t_buf_checklstring( L, 2, &len, NULL ) : NULL;
 	struct sockaddr_storage *adr = t_net_adr_check_ud( L, 3, 0 );
-	size_t                   max = (lua_gettop( L ) == ((NULL==adr) ?3 :4))
-	                               ? (size_t) luaL_checkinteger( L, (NULL==adr) ?3 :4 )
-	                               : len;
-
-	snt = p_net_sck_send( sck, adr, msg, (max<len) ? max : len );
+	size_t                   max;
+	char                    *prt[ T_NET_SCK_IOV_MAX ];
+	size_t                   pln[ T_NET_SCK_IOV_MAX ];
+	int                      cnt, i;
+
+	if (NULL != chn)
+		len = chn->len;
+	max = (n == ((NULL==adr) ?3 :4))
+	      ? (size_t) luaL_checkinteger( L, (NULL==adr) ?3 :4 )
+	      : len;
+	if (NULL == chn)
+		snt = p_net_sck_send( sck, adr, msg, (max<len) ? max : len );
+	else
+	{
+		cnt = t_buf_chn_parts( L, 2, prt, pln, T_NET_SCK_IOV_MAX );
+		for (i=0, len=0; i<cnt && len<max; len += pln[ i++ ])
+			pln[ i ] = (pln[ i ] < max - len) ? pln[ i ] : max - len;
+		snt = p_net_sck_sendv( sck, adr, prt, pln, i );
+		if (snt > 0)
+			t_buf_chn_consume( L, 2, (size_t) snt );
+	}
 	if (snt > -1)
 	{
 		lua_pushinteger( L, snt );
 		return 1;
 	}
+	else if (t_net_sck_mustWait( L ))
+		return t_await( L, n, 2, lt_net_sck_send );
 	else
-		return ((NULL == adr)
-			? t_push_error( L, 0, 1, "Can't send message" )
-			: t_push_error( L, 0, 1, "Can't send Message to %s", t_net_sck_getAddrString( L, adr ) )
-		);
+		return t_net_sck_ioError( L, adr, "send", "to" );
 }
 
 
@@ -285,12 +352,18 @@ lt_net_sck_send( lua_State *L )
  *   bool,int = sck:recv( adr, buf/seg )
  *   bool,int = sck:recv( buf/seg, max )
  *   bool,int = sck:recv( adr, buf/seg, max )
+ * A Buffer.Ring gets the data appended to its readable bytes.  Without max
+ * up to BUFSIZ bytes get received, the ring grows if less space is free.
+ *   bool,int = sck:recv( [adr,] rng[, max] )
+ * If it is a Buffer.Pool the data gets received into a buffer from the pool
+ * which gets returned instead of a string.
+ *   slt ,int = sck:recv( [adr,] pol[, max] )
  * \usage   string msg, int cnt = sck:recv( [Net.Address adr, int size ] )
  * \usage   bool rcvd, int cnt  = sck:recv( [Net.Address adr,] Buffer/Segment buf[, int size ] )
  * \param   L      Lua state.
  * \lparam  sck    Net.Socket  userdata instance.       -> mandatory
  * \lparam  adr    Net.Address userdata instance.       -> optional
- * \lparam  buf    Buffer/Segment userdata instance.    -> optional
+ * \lparam  buf    Buffer/Segment/Ring/Pool instance.   -> optional
  * \lparam  int    size of msg t be received in bytes.  -> optional
  * \lreturn msg    Lua string of received message or boolean true if written to Buffer.
  *                 Is nil or false if nothing was received.
@@ -309,8 +382,38 @@ lt_net_sck_recv( lua_State *L )
 	size_t                   args = lua_gettop( L );
 	struct t_net_sck        *sck  = t_net_sck_check_ud( L, 1, 1 );
 	struct sockaddr_storage *adr  = t_net_adr_check_ud( L, 2, 0 );
+	struct t_buf_rng        *rng  = t_buf_rng_check_ud( L, (NULL==adr) ?2 :3, 0 );
+	struct t_buf_slt        *slt;
 
-	if (t_buf_isstring( L, (NULL==adr) ?2 :3, &cw ) && cw)  // is writable -> buffer
+	if (NULL != t_buf_pol_check_ud( L, (NULL==adr) ?2 :3, 0 ))  // into a buffer from the pool
+	{
+		slt  = t_buf_pol_acquire( L, (NULL==adr) ?2 :3 );
+		max  = (args == ((NULL==adr) ?3 :4)) ? (size_t) luaL_checkinteger( L, (NULL==adr) ?3 :4 ) : slt->len;
+		rcvd = p_net_sck_recv( sck, adr, slt->b, (max<slt->len) ? max : slt->len );
+		if (rcvd > 0)
+			slt->len = (size_t) rcvd;
+		else             // nothing received or failed; hand it back right away
+		{
+			t_buf_slt_release( L, -1 );
+			lua_pop( L, 1 );
+			if (0 == rcvd)
+				lua_pushnil( L );
+		}
+	}
+	else if (NULL != rng)  // append to ring; grow it if less than max is free
+	{
+		max = (args == ((NULL==adr) ?3 :4)) ? (size_t) luaL_checkinteger( L, (NULL==adr) ?3 :4 ) : BUFSIZ;
+		luaL_argcheck( L, (lua_Integer) max > 0, (NULL==adr) ?3 :4, "max must be greater than 0" );
+		if (NULL == (msg = t_buf_rng_reserve( rng, max, &len )))
+			return luaL_error( L, "couldn't grow "T_BUF_RNG_TYPE );
+		rcvd = p_net_sck_recv( sck, adr, msg, (max<len) ? max : len );
+		if (rcvd > -1 )  // 0 for nothing received
+		{
+			t_buf_rng_commit( rng, (size_t) rcvd );
+			lua_pushboolean( L, rcvd > 0 );
+		}
+	}
+	else if (t_buf_isstring( L, (NULL==adr) ?2 :3, &cw ) && cw)  // is writable -> buffer
 	{
 		msg = t_buf_checklstring( L, (NULL==adr) ?2 :3, &len, &cw );
 		max = (args == ((NULL==adr) ?3 :4)) ? (size_t) luaL_checkinteger( L, (NULL==adr) ?3 :4 ) : len;
@@ -335,11 +438,10 @@ lt_net_sck_recv( lua_State *L )
 		else
 			luaL_pushresultsize( &lB, rcvd );
 	}
+	if (-1 == rcvd && t_net_sck_mustWait( L ))
+		return t_await( L, (int) args, 1, lt_net_sck_recv );
 	if (-1 == rcvd)
-		return ((NULL == adr)
-			? t_push_error( L, 0, 1, "Can't receive message" )
-			: t_push_error( L, 0, 1, "Can't receive Message from %s", t_net_sck_getAddrString( L, adr ) )
-		);
+		return t_net_sck_ioError( L, adr, "receive", "from" );
 	lua_pushinteger( L, (lua_Integer) rcvd );
 	return 2;
 }
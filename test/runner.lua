@@ -11,6 +11,9 @@ local T, Suite, Oht =
 local suites = {
 	"t_ael",
 	"t_buf"                 , "t_buf_seg",
+	"t_buf_rng"             , "t_buf_chn",
+	"t_buf_map"             , "t_buf_pol",
+	"t_buf_shm"             ,
 	"t_net_adr"             , "t_net_ifc",
 	"t_net_sck_create"      , "t_net_sck_bind",
 	"t_net_sck_connect"     , "t_net_sck_listen",
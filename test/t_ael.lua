@@ -6,6 +6,7 @@ local Loop      = require't.Loop'
 local Socket    = require't.Net.Socket'
 local Address   = require't.Net.Address'
 local Interface = require't.Net.Interface'
+local Buffer    = require't.Buffer'
 
 
 return {
@@ -70,7 +71,7 @@ return {
 			print(a)
 		end
 		local tsk = self.loop:addTask( 1234 , tf, msg )
-		local tsk_r = debug.getuservalue( tsk, 2 ) -- 2 == T_AEL_TSK_FNCIDX in t_ael_l.h
+		local tsk_r = debug.getuservalue( tsk, 1 ) -- 1 == T_AEL_TSK_FNCIDX in t_ael_l.h
 		assert( 'table' == type(tsk_r), ("Expected reference to be `%s`, got `%s`"):format( 'table', type(tsk_r) ) )
 		assert( tf   == tsk_r[1], ("Expected function to be `%s`, got `%s`"):format( tsk_r[1], tf ) )
 		assert( msg  == tsk_r[2], ("Expected argument to be `%s`, got `%s`"):format( tsk_r[2], msg  ) )
@@ -96,22 +97,601 @@ return {
 	end,
 
 	TimerOrder = function( self )
-		Test.describe( "Proper timer insertion requires ordering" )
+		Test.describe( "Timers execute in order of expiry regardless of insertion order" )
 		local order = { 5, 7, 1, 4, 2, 9, 3, 8, 6 }  -- insertion order
-		local cnt, time, tasks = 0, math.random(10,60), { }
-		local inc = function( ) cnt = cnt+1 end
-		local chk = function( )
-			assert( cnt == 9, ("%d timers should have been executed. Counted: %d"):format( 9, cnt ) )
-		end
+		local time, ran = math.random(10,60), { }
+		local inc = function( n ) table.insert( ran, n ) end
 		for _, n in ipairs( order ) do
-			tasks[n] = self.loop:addTask( n*time, inc )
+			self.loop:addTask( n*time, inc, n )
 		end
-		tasks[#order+1] = self.loop:addTask( (#order+1)*time, chk )
+		self.loop:run()
+		assert( #ran == #order, ("%d timers should have been executed. Counted: %d"):format( #order, #ran ) )
 		for i=1,#order do
-			local t_nxt = debug.getuservalue( tasks[ i ], 1 )  -- get the next uservalue
-			assert( t_nxt == tasks[ i+1 ], ("Expected next task <%s>, but was <%s>"):format( t_nxt, tasks[1+1] ) )
+			assert( ran[ i ] == i, ("Expected task <%d> at position %d, but was <%d>"):format( i, i, ran[ i ] ) )
+		end
+	end,
+
+	CancelManyTasks = function( self )
+		Test.describe( "Cancel every other of many tasks with identical deadline" )
+		local cnt, tasks, time = 0, { }, math.random(10,60)
+		local inc = function( ) cnt = cnt+1 end
+		for i=1,1000 do
+			tasks[ i ] = self.loop:addTask( time, inc )
+		end
+		for i=1,1000,2 do
+			assert( self.loop:cancelTask( tasks[ i ] ), "Scheduled task should be cancellable" )
 		end
+		assert( not self.loop:cancelTask( tasks[ 1 ] ), "Cancelled task shouldn't be cancelled twice" )
 		self.loop:run()
+		assert( cnt == 500, ("%d timers should have been executed. Counted: %d"):format( 500, cnt ) )
+	end,
+
+	HiResTimer = function( self )
+		local time = math.random( 20, 80 ) / 10
+		Test.describe( "Execute Task after %.1fms with high resolution mode", time )
+		local start, ns = Loop.hrtime( ), nil
+		local tf = function( ) ns = Loop.hrtime( ) - start end
+		self.loop.hires = true
+		assert( self.loop.hires, "Loop option `hires` should be set" )
+		self.loop:addTask( time, tf )
+		self.loop:run( )
+		self.loop.hires = false
+		assert( ns >= time*1000000, ("Task should run after %dns, but ran after %dns"):format( time*1000000, ns ) )
+		assert( ns <  time*1000000 + 2000000, ("Task should run within 2ms of %dns, but ran after %dns"):format( time*1000000, ns ) )
+	end,
+
+	PostFunctions = function( self )
+		Test.describe( "Posted functions get executed in posting order" )
+		local res = { }
+		local add = function( i ) res[ #res+1 ] = i end
+		self.loop:addTask( 1, function( )
+			for i=1,1000 do self.loop:post( add, i ) end
+		end )
+		self.loop:run( )
+		assert( #res == 1000, ("Expected 1000 posted functions to run, but %d did"):format( #res ) )
+		for i=1,1000 do
+			assert( res[ i ] == i, ("Expected %d at position %d, but got %d"):format( i, i, res[ i ] ) )
+		end
+	end,
+
+	PostFromPosted = function( self )
+		Test.describe( "Function posted by posted function runs on next wakeup" )
+		local cnt  = 0
+		local post
+		post = function( )
+			cnt = cnt + 1
+			if cnt < 10 then self.loop:post( post ) end
+		end
+		self.loop:post( post )
+		self.loop:run( )
+		assert( cnt == 10, ("Expected 10 executions, but got %d"):format( cnt ) )
+		assert( #self.loop == 0, "Post queue shouldn't count as observed handle" )
+	end,
+
+	PostErrorKeepsBatch = function( self )
+		Test.describe( "Posted functions after one that failed run on the next run( )" )
+		local res = { }
+		local add = function( i ) res[ #res+1 ] = i end
+		self.loop:post( add, 1 )
+		self.loop:post( error, 'boom' )
+		self.loop:post( add, 2 )
+		local ok, err = pcall( self.loop.run, self.loop )
+		assert( not ok and err:match( 'boom' ), "Error of posted function should be raised" )
+		assert( #res == 1, ("Expected 1 posted function to run, but %d did"):format( #res ) )
+		self.loop:addTask( 200, function( ) self.loop:stop( ) end )
+		self.loop:run( )
+		assert( #res == 2 and res[ 2 ] == 2, "Rest of the batch should run on the next wakeup" )
+	end,
+
+	Stats = function( self )
+		Test.describe( "Loop collects statistics only while enabled" )
+		assert( self.loop:stats( ) == nil, "Statistics shouldn't exist before enabled" )
+		self.loop.stats = true
+		for i=1,3 do self.loop:addTask( i*5, function( ) end ) end
+		self.loop:run( )
+		self.loop.stats = false
+		self.loop:addTask( 5, function( ) end )
+		self.loop:run( )
+		local st = self.loop:stats( true )
+		assert( st.task.count == 3, ("Expected 3 recorded tasks, but got %d"):format( st.task.count ) )
+		assert( st.lag.count  == 3, ("Expected 3 lag values, but got %d"):format( st.lag.count ) )
+		assert( st.iterations >= 3, "Should have counted iterations" )
+		assert( st.pollTime > 0, "Should have waited in poll" )
+		assert( st.lag.p50 <= st.lag.p99 and st.lag.p99 <= st.lag.max, "Percentiles should be ordered" )
+		assert( self.loop:stats( ).task.count == 0, "Statistics should be reset" )
+	end,
+
+	EventBudget = function( self )
+		Test.describe( "Budget carries ready events into the next iteration" )
+		local sck, snd, cnt = { }, Socket( 'udp' ), 0
+		local rcv = function( s ) s:recv( ); cnt = cnt + 1 end
+		for i=1,4 do
+			sck[ i ] = Socket( 'udp' )
+			sck[ i ]:bind( '127.0.0.1', 0 )
+			snd:send( 'ping', sck[ i ]:getsockname( ) )
+			self.loop:addHandle( sck[ i ], 'read', rcv, sck[ i ] )
+		end
+		self.loop:addTask( 50, function( ) self.loop:stop( ) end )
+		self.loop.budget = 1
+		self.loop:run( )
+		self.loop.budget = 0
+		for i=1,4 do
+			self.loop:removeHandle( sck[ i ], 'read' )
+			sck[ i ]:close( )
+		end
+		snd:close( )
+		assert( cnt == 4, ("Expected 4 received datagrams, but got %d"):format( cnt ) )
+		assert( self.loop.budgetHits > 0, "Budget should have cut batches short" )
+		assert( self.loop.carried > 0, "Events should have been carried over" )
+	end,
+
+	SmallEventArray = function( self )
+		Test.describe( "Loop with a single event slot dispatches all ready handles" )
+		local l, snd, sck, cnt = Loop( 1 ), Socket( 'udp' ), { }, 0
+		local rcv = function( s ) s:recv( ); cnt = cnt + 1; l:removeHandle( s, 'read' ) end
+		for i=1,8 do
+			sck[ i ] = Socket( 'udp' )
+			sck[ i ]:bind( '127.0.0.1', 0 )
+			snd:send( 'ping', sck[ i ]:getsockname( ) )
+			l:addHandle( sck[ i ], 'read', rcv, sck[ i ] )
+		end
+		l:run( )
+		for i=1,8 do sck[ i ]:close( ) end
+		snd:close( )
+		assert( cnt == 8, ("Expected 8 received datagrams, but got %d"):format( cnt ) )
+		assert( not pcall( Loop, -1 ), "Negative size should fail" )
+	end,
+
+	SpinBeforeBlocking = function( self )
+		Test.describe( "Spinning loop picks up events without blocking" )
+		local sck, snd, got = Socket( 'udp' ), Socket( 'udp' ), nil
+		sck:bind( '127.0.0.1', 0 )
+		self.loop:addHandle( sck, 'read', function( )
+			got = sck:recv( )
+			self.loop:removeHandle( sck, 'read' )
+		end )
+		self.loop:addTask( 5, function( ) snd:send( 'ping', sck:getsockname( ) ) end )
+		self.loop.stats, self.loop.spin = true, 50000
+		local hits = self.loop:stats( ).spinHits
+		self.loop:run( )
+		self.loop.stats, self.loop.spin = false, 0
+		sck:close( )
+		snd:close( )
+		assert( got == 'ping', "Datagram should be received" )
+		assert( self.loop:stats( ).spinHits > hits, "Datagram should be picked up while spinning" )
+	end,
+
+	-- -----------------------------------------------------------------------
+	-- Phase Tests
+	-- -----------------------------------------------------------------------
+	DeferAfterBatch = function( self )
+		Test.describe( "Deferred functions run after the current batch in order" )
+		local res = { }
+		local add = function( v ) res[ #res+1 ] = v end
+		self.loop:addTask( 5, function( )
+			self.loop:defer( add, 'd1' )
+			self.loop:defer( function( ) add( 'd2' ); self.loop:defer( add, 'd3' ) end )
+			self.loop:addTask( 0, add, 't2' )
+			add( 't1' )
+		end )
+		self.loop:run( )
+		local exp = { 't1', 'd1', 'd2', 'd3', 't2' }
+		for i,v in ipairs( exp ) do
+			assert( res[ i ] == v, ("Expected `%s` at %d, but got `%s`"):format( v, i, res[ i ] ) )
+		end
+	end,
+
+	Hooks = function( self )
+		Test.describe( "Prepare and check hooks run around each iteration" )
+		local res = { }
+		local add = function( v ) res[ #res+1 ] = v end
+		self.loop:addHook( 'prepare', add, 'prepare' )
+		self.loop:addHook( 'check', add, 'check' )
+		self.loop:addTask( 5, add, 'task' )
+		self.loop:run( )
+		assert( self.loop:removeHook( 'prepare', add ), "Prepare hook should be removed" )
+		assert( self.loop:removeHook( 'check', add ), "Check hook should be removed" )
+		assert( not self.loop:removeHook( 'check', add ), "Removed hook shouldn't be found" )
+		local i = 1
+		while res[ i ] ~= 'task' do i = i+1 end
+		assert( res[ i-1 ] == 'prepare' and res[ i+1 ] == 'check', "Task should run between prepare and check" )
+	end,
+
+	HookRemovingItself = function( self )
+		Test.describe( "Hook removing itself doesn't make a second copy get skipped" )
+		local cnt, seen = 0, nil
+		local hook, mark
+		hook = function( )
+			cnt = cnt + 1
+			self.loop:removeHook( 'check', hook )
+		end
+		mark = function( )
+			seen = cnt
+			self.loop:stop( )
+		end
+		self.loop:addHook( 'check', hook )
+		self.loop:addHook( 'check', hook )
+		self.loop:addHook( 'check', mark )
+		self.loop:addTask( 5, function( ) end )
+		self.loop:run( )
+		self.loop:removeHook( 'check', mark )
+		assert( seen == 2, ("Both copies should run in one iteration, but %s did"):format( seen ) )
+	end,
+
+	HookRemovingLaterHook = function( self )
+		Test.describe( "Hook removing a later hook doesn't run itself again" )
+		local cnt = 0
+		local rm, later
+		later = function( ) end
+		rm = function( )
+			cnt = cnt + 1
+			self.loop:removeHook( 'check', later )
+			self.loop:stop( )
+		end
+		self.loop:addHook( 'check', function( ) end )
+		self.loop:addHook( 'check', rm )
+		self.loop:addHook( 'check', later )
+		self.loop:addTask( 5, function( ) end )
+		self.loop:run( )
+		self.loop:removeHook( 'check', rm )
+		assert( cnt == 1, ("Hook should run once per iteration, but ran %d times"):format( cnt ) )
+	end,
+
+	IdleHook = function( self )
+		Test.describe( "Idle hooks keep poll from blocking" )
+		local cnt  = 0
+		local idle = function( ) cnt = cnt + 1 end
+		self.loop:addHook( 'idle', idle )
+		self.loop:addTask( 20, function( ) end )
+		self.loop:run( )
+		self.loop:removeHook( 'idle', idle )
+		assert( cnt > 1, ("Idle hook should run in many iterations, but ran %d times"):format( cnt ) )
+	end,
+
+	-- -----------------------------------------------------------------------
+	-- Signal Tests
+	-- -----------------------------------------------------------------------
+	Signal = function( self )
+		Test.describe( "Signal gets delivered as loop event" )
+		local got
+		self.loop:addSignal( 'SIGUSR1', function( a ) got = a; self.loop:stop( ) end, 'arg' )
+		self.loop:addTask( 1000, function( ) end )  -- don't wait forever
+		os.execute( "kill -USR1 $PPID" )            -- the shell's parent is us
+		self.loop:run( )
+		assert( got == 'arg', "Signal handler should have run with its argument" )
+		assert( #self.loop == 0, "Signals shouldn't count as observed handle" )
+		assert( self.loop:removeSignal( Loop.SIGUSR1 ), "Observed signal should be removed" )
+		assert( not self.loop:removeSignal( 'SIGUSR1' ), "Removed signal shouldn't be observed" )
+	end,
+
+	-- -----------------------------------------------------------------------
+	-- Coroutine Tests
+	-- -----------------------------------------------------------------------
+	SpawnSleep = function( self )
+		Test.describe( "Loop.sleep() inside a coroutine yields to the loop" )
+		local res = { }
+		local nap = function( ms, n ) Loop.sleep( ms ); res[ #res+1 ] = n end
+		self.loop:spawn( nap, 20, 'slow' )
+		self.loop:spawn( nap, 10, 'fast' )
+		self.loop:run( )
+		assert( res[1] == 'fast' and res[2] == 'slow', "Shorter sleep should finish first" )
 	end,
-}
 
+	SpawnSocket = function( self )
+		Test.describe( "Sockets inside a coroutine wait instead of failing with EAGAIN" )
+		local srv, adr = Socket.listen( '127.0.0.1', 0 )
+		local got
+		srv.nonblock = true
+		self.loop:spawn( function( )
+			local cli = srv:accept( )
+			cli.nonblock = true
+			local msg = cli:recv( )
+			cli:send( msg )
+			cli:close( )
+		end )
+		self.loop:spawn( function( )
+			local cli = Socket( 'tcp' )
+			cli.nonblock = true
+			assert( cli:connect( adr ), "Connect should succeed" )
+			cli:send( 'echo' )
+			got = cli:recv( )
+			cli:close( )
+		end )
+		self.loop:run( )
+		srv:close( )
+		assert( got == 'echo', ("Expected `echo`, but got `%s`"):format( tostring( got ) ) )
+		assert( #self.loop == 0, "Finished coroutines shouldn't leave observed handles" )
+	end,
+
+	SpawnError = function( self )
+		Test.describe( "Errors inside a coroutine get raised" )
+		local ok, err = pcall( self.loop.spawn, self.loop, function( ) error( 'boom' ) end )
+		assert( not ok and err:match( 'boom' ), "Error of coroutine should be raised" )
+	end,
+
+	TouchTaskFromOwnFunction = function( self )
+		Test.describe( "Task touching itself and returning a timeout stays scheduled once" )
+		local cnt, tsk, start = 0, nil, Loop.time( )
+		tsk = self.loop:addTask( 5, function( )
+			cnt = cnt + 1
+			if cnt < 3 then
+				self.loop:touchTask( tsk, 100 )
+				return 5
+			end
+		end )
+		self.loop:run( )
+		assert( cnt == 3, ("Expected 3 executions, but got %d"):format( cnt ) )
+		assert( Loop.time( ) - start < 90, "Returned timeout should win over the touched one" )
+	end,
+
+	TouchTaskLater = function( self )
+		Test.describe( "Touched task executes at its new deadline, once" )
+		local res = { }
+		local tsk = self.loop:addTask( 10, function( ) res[ #res+1 ] = 'touched' end )
+		self.loop:addTask( 30, function( ) res[ #res+1 ] = 'fixed' end )
+		for i=1,100 do self.loop:touchTask( tsk, 60 ) end
+		self.loop:run( )
+		assert( #res == 2, ("Expected 2 executions, but got %d"):format( #res ) )
+		assert( res[1] == 'fixed' and res[2] == 'touched', "Touched task should execute last" )
+	end,
+
+	TouchTaskEarlier = function( self )
+		Test.describe( "Touching a task to an earlier deadline or after it ran schedules it" )
+		local res = { }
+		local tsk = self.loop:addTask( 60, function( ) res[ #res+1 ] = 'touched' end )
+		self.loop:addTask( 30, function( ) res[ #res+1 ] = 'fixed' end )
+		self.loop:touchTask( tsk, 10 )
+		self.loop:run( )
+		assert( res[1] == 'touched' and res[2] == 'fixed', "Touched task should execute first" )
+		self.loop:touchTask( tsk, 1 )
+		self.loop:run( )
+		assert( res[3] == 'touched', "Executed task should get scheduled again" )
+	end,
+
+	TouchTaskSlack = function( self )
+		Test.describe( "Tasks with slack in the same window execute in the same iteration" )
+		local itr, at = 0, { }
+		self.loop:addHook( 'check', function( ) itr = itr + 1 end )
+		for i=1,3 do
+			local tsk = self.loop:addTask( 1000, function( ) at[ #at+1 ] = itr end )
+			self.loop:touchTask( tsk, 10, 200 )
+		end
+		self.loop:run( )
+		assert( #at == 3, "All tasks should execute" )
+		assert( at[1] == at[2] and at[2] == at[3], "Tasks should execute in the same iteration" )
+	end,
+
+	-- -----------------------------------------------------------------------
+	-- Thread Pool Tests
+	-- -----------------------------------------------------------------------
+	OffloadCallback = function( self )
+		Test.describe( "Offloaded write and read execute handlers on the loop" )
+		local f   = io.tmpfile( )
+		local buf = Buffer( 5 )
+		local got
+		self.loop:offload( 'write', f, 'lua-t', 0, function( n )
+			assert( n == 5, ("Expected 5 bytes written, but got %s"):format( tostring( n ) ) )
+			self.loop:offload( 'read', f, buf, 0, function( name, r ) got = name .. r end, 'read:' )
+		end )
+		assert( self.loop.jobs == 1, "Offloaded job should be pending" )
+		self.loop:run( )
+		f:close( )
+		assert( got == 'read:5', ("Expected `read:5`, but got `%s`"):format( tostring( got ) ) )
+		assert( buf:read( ) == 'lua-t', "Buffer should hold the data read by the pool" )
+		assert( self.loop.jobs == 0, "No job should be pending" )
+	end,
+
+	OffloadCoroutine = function( self )
+		Test.describe( "Offload without handler suspends the coroutine" )
+		local f   = io.tmpfile( )
+		local res = { }
+		self.loop:spawn( function( )
+			res[1] = self.loop:offload( 'write', f, 'data', 0 )
+			res[2] = self.loop:offload( 'fsync', f )
+			res[3], res[4] = self.loop:offload( 'read', f, Buffer( 4 ), 99 )
+		end )
+		self.loop:run( )
+		f:close( )
+		assert( res[1] == 4 and res[2] == true, "Write and fsync should succeed" )
+		assert( res[3] == 0, "Reading past the end should return 0 bytes" )
+		assert( not pcall( self.loop.offload, self.loop, 'fsync', io.stdout ),
+		   "Offload without handler outside of a coroutine should fail" )
+	end,
+
+	OffloadCrcWritesBack = function( self )
+		Test.describe( "Offloaded crc updates the running value of the Crc on completion" )
+		local Crc = require't.Encode.Crc'
+		local c, r = Crc( 4 ), nil
+		self.loop:offload( 'crc', c, '12345', function( res ) r = res end )
+		self.loop:run( )
+		local exp = Crc( 4 )
+		assert( r == exp:calc( '12345' ), "Offloaded crc should match calc( )" )
+		assert( c:calc( '6789' ) == exp:calc( '6789' ), "Running value should be written back" )
+	end,
+
+	-- -----------------------------------------------------------------------
+	-- Process Tests
+	-- -----------------------------------------------------------------------
+	SpawnProcessCallback = function( self )
+		Test.describe( "Spawned process passes its output and exit status to the loop" )
+		local out, res = { }, nil
+		local prc, i, o, e = self.loop:spawnProcess( { 'sh', '-c', 'echo hi; exit 3', stdout = true },
+			function( tag, ok, what, code ) res = { tag, ok, what, code } end, 'exited' )
+		assert( i == nil and e == nil, "Only stdout should be piped" )
+		assert( #self.loop == 2, "Pidfd and stdout should be observed" )
+		self.loop:addHandle( o, 'read', function( )
+			local s = o:recv( )
+			if s then out[ #out+1 ] = s else self.loop:removeHandle( o, 'read' ); o:close( ) end
+		end )
+		self.loop:run( )
+		assert( table.concat( out ) == 'hi\n', "Expected output `hi`" )
+		assert( res[1] == 'exited' and res[2] == nil and res[3] == 'exit' and res[4] == 3,
+		   ("Expected exit code 3, but got %s %s"):format( tostring( res[3] ), tostring( res[4] ) ) )
+		assert( prc:status( ) == nil and select( 3, prc:status( ) ) == 3, "Status should be kept" )
+		assert( prc:kill( ) == false, "Reaped process can't be signalled" )
+	end,
+
+	SpawnProcessCoroutine = function( self )
+		Test.describe( "Coroutine writes stdin, reads stdout and waits for the process" )
+		local res = { }
+		self.loop:spawn( function( )
+			local prc, i, o = self.loop:spawnProcess( { 'cat', stdin = true, stdout = true } )
+			i:send( 'lua-t' )
+			i:close( )
+			res[1] = o:recv( )
+			res[2], res[3], res[4] = prc:wait( )
+			o:close( )
+		end )
+		self.loop:run( )
+		assert( res[1] == 'lua-t', ("Expected `lua-t`, but got `%s`"):format( tostring( res[1] ) ) )
+		assert( res[2] == true and res[3] == 'exit' and res[4] == 0, "cat should exit successfully" )
+		assert( not pcall( self.loop.spawnProcess, self.loop, { } ), "Empty command line should fail" )
+	end,
+
+	KillSpawnedProcess = function( self )
+		Test.describe( "Killed process reports the signal" )
+		local res
+		local prc = self.loop:spawnProcess( { 'sleep', '10' }, function( ... ) res = { ... } end )
+		assert( prc:pid( ) > 0 and prc:status( ) == nil, "Process should be running" )
+		assert( prc:kill( Loop.SIGTERM ), "Running process should be signalled" )
+		self.loop:run( )
+		assert( res[1] == nil and res[2] == 'signal' and res[3] == Loop.SIGTERM,
+		   "Process should be terminated by SIGTERM" )
+	end,
+
+	-- -----------------------------------------------------------------------
+	-- Handle Tests
+	-- -----------------------------------------------------------------------
+	EdgeTriggeredHandle = function( self )
+		Test.describe( "Edge triggered handler fires once for multiple pending datagrams" )
+		local srv, snd = Socket( 'udp' ), Socket( 'udp' )
+		srv:bind( '127.0.0.1', 0 )
+		srv.nonblock = true
+		local adr, calls, rcvd = srv:getsockname( ), 0, 0
+		for i=1,3 do snd:send( 'message ' .. i, adr ) end
+		local drain = function( s )
+			calls = calls + 1
+			while s:recv( ) do rcvd = rcvd + 1 end
+		end
+		self.loop:addHandle( srv, Loop.READ | Loop.EDGE, drain, srv )
+		self.loop:addTask( 50, function( ) self.loop:stop( ) end )
+		self.loop:run( )
+		self.loop:removeHandle( srv, 'read' )
+		srv:close( )
+		snd:close( )
+		assert( calls == 1, ("Handler should fire once, but fired %d times"):format( calls ) )
+		assert( rcvd  == 3, ("Should receive 3 datagrams, but got %d"):format( rcvd ) )
+	end,
+
+	OneShotHandle = function( self )
+		Test.describe( "One shot handler fires once until added again" )
+		local srv, snd = Socket( 'udp' ), Socket( 'udp' )
+		srv:bind( '127.0.0.1', 0 )
+		srv.nonblock = true
+		local adr, calls = srv:getsockname( ), 0
+		for i=1,3 do snd:send( 'message ' .. i, adr ) end
+		local once = function( s )
+			calls = calls + 1
+			s:recv( )
+		end
+		self.loop:addHandle( srv, Loop.READ | Loop.ONESHOT, once, srv )
+		self.loop:addTask( 50, function( ) self.loop:stop( ) end )
+		self.loop:run( )
+		assert( calls == 1, ("Handler should fire once, but fired %d times"):format( calls ) )
+		self.loop:addHandle( srv, Loop.READ | Loop.ONESHOT, once, srv )
+		self.loop:addTask( 50, function( ) self.loop:stop( ) end )
+		self.loop:run( )
+		self.loop:removeHandle( srv, 'read' )
+		srv:close( )
+		snd:close( )
+		assert( calls == 2, ("Re-armed handler should fire once more, but fired %d times"):format( calls ) )
+	end,
+
+	ImplementationChoice = function( self )
+		Test.describe( "Loop( sz, impl ) picks the implementation of a loop" )
+		local impl = self.loop.impl
+		assert( 'string' == type( impl ), "Loop should report its implementation" )
+		local l = Loop( 1, impl )
+		assert( l.impl == impl, ("Expected `%s` but got `%s`"):format( impl, l.impl ) )
+		l:clean( )
+		assert( not pcall( Loop, 1, 'kqueue-not-compiled' ), "Unknown implementation should fail" )
+	end,
+
+	ConflictingModeFails = function( self )
+		Test.describe( "Adding a direction in another mode than the observed one fails" )
+		local sck = Socket( 'udp' )
+		local f   = function( ) end
+		self.loop:addHandle( sck, Loop.READ | Loop.EDGE, f )
+		local ok, e = pcall( self.loop.addHandle, self.loop, sck, 'write', f )
+		assert( not ok and e:match( "another mode" ), "Level triggered write should fail" )
+		assert( self.loop:addHandle( sck, Loop.WRITE | Loop.EDGE, f ), "Same mode should be accepted" )
+		self.loop:removeHandle( sck, 'write' )
+		assert( self.loop:addHandle( sck, 'read', f ), "Re-adding the only direction should change the mode" )
+		self.loop:removeHandle( sck, 'read' )
+		sck:close( )
+	end,
+
+	HandlerDoesNotPinLoop = function( self )
+		Test.describe( "Loop with a handler capturing the loop gets collected" )
+		local weak = setmetatable( { }, { __mode = 'v' } )
+		local sck  = Socket( 'udp' )
+		do
+			local l = Loop( )
+			l:addHandle( sck, 'read', function( ) l:stop( ) end )
+			weak.loop = l
+		end
+		collectgarbage( )
+		collectgarbage( )
+		sck:close( )
+		assert( nil == weak.loop, "Unreferenced loop should have been collected" )
+	end,
+
+	-- -----------------------------------------------------------------------
+	-- Worker Tests
+	-- -----------------------------------------------------------------------
+	Worker = function( self )
+		Test.describe( "Start and join worker processes" )
+		local wrk = Loop.Worker( 3, function( id, x ) assert( x == 'arg' ) end, 'arg' )
+		assert( #wrk == 3, ("Expected 3 workers, but got %d"):format( #wrk ) )
+		assert( 'number' == type( wrk:pid( 1 ) ), "Running worker should have a pid" )
+		local ok, failed = wrk:join( )
+		assert( ok,          "All workers should exit successfully" )
+		assert( failed == 0, ("No worker should fail, but %d did"):format( failed ) )
+		assert( nil == wrk:pid( 1 ), "Joined worker shouldn't have a pid" )
+	end,
+
+	WorkerFailure = function( self )
+		Test.describe( "Failing worker gets reported by join()" )
+		local wrk = Loop.Worker( 2, function( id ) assert( id ~= 2, "worker 2 fails" ) end )
+		local ok, failed = wrk:join( )
+		assert( not ok,      "Not all workers should exit successfully" )
+		assert( failed == 1, ("One worker should fail, but %d did"):format( failed ) )
+	end,
+
+	WorkerStop = function( self )
+		Test.describe( "Stop workers running their own loop" )
+		local wrk = Loop.Worker( 2, function( )
+			local l = Loop( )
+			l:addTask( 10000, function( ) end )
+			l:run( )
+		end )
+		assert( wrk:stop( ) == 2, "Both workers should get signalled" )
+		local ok, failed = wrk:join( )
+		assert( failed == 2, ("Killed workers should be reported as failed, but %d were"):format( failed ) )
+	end,
+
+	WorkerCollected = function( self )
+		Test.describe( "Collected workers get terminated and reaped" )
+		local wrk = Loop.Worker( 1, function( )
+			local l = Loop( )
+			l:addTask( 10000, function( ) end )
+			l:run( )
+		end )
+		local pid = wrk:pid( 1 )
+		wrk = nil
+		collectgarbage( )
+		collectgarbage( )
+		assert( not os.execute( ('kill -0 %d 2>/dev/null'):format( pid ) ),
+		   "Collected worker should neither run nor be a zombie" )
+	end,
+}
@@ -268,5 +268,174 @@ return {
 		local X = ("%02X %02X %02X %02X %02X %02X"):format(  a[1], a[2], a[3], a[4], a[5], a[6] )
 		local b = Buffer( x )
 		assert( b:toHex() == X, ("Expected HexString: `%s` but got `%s`"):format( X, b:toHex() ) )
+	end,
+
+	ConstantSimd = function( self )
+		Test.describe( "t.Buffer.Simd names the search implementation in use" )
+		local s = Buffer.Simd
+		assert( s == 'avx2' or s == 'sse2' or s == 'c', ("Unexpected `t.Buffer.Simd` value `%s`"):format( tostring( s ) ) )
+	end,
+
+	Find = function( self )
+		Test.describe( "T.Buffer:find() matches plain string.find()" )
+		for _,ini in ipairs( { 1, 17, math.floor( #self.s/2 ), -40, #self.s+1 } ) do
+			for _,len in ipairs( { 1, 2, 5, 33 } ) do
+				local p = math.random( 1, #self.s - len + 1 )
+				local n = self.s:sub( p, p+len-1 )
+				local eS,eE = self.s:find( n, ini, true )
+				local rS,rE = self.b:find( n, ini )
+				assert( eS == rS and eE == rE, ("Expected find(`%s`,%d) to return %s,%s but got %s,%s"):format(
+					n, ini, eS, eE, rS, rE ) )
+			end
+		end
+		assert( nil == self.b:find( self.s .. 'x' ), "Needle longer than buffer mustn't be found" )
+		assert( 1   == self.b:find( Buffer( self.s:sub( 1, 20 ) ) ), "T.Buffer as needle should be found" )
+	end,
+
+	FindUnaligned = function( self )
+		Test.describe( "T.Buffer:find() finds needles at each offset across block boundaries" )
+		local s = ('a'):rep( 200 )
+		for i=1,197 do
+			local b   = Buffer( s:sub( 1, i-1 ) .. 'xyz' .. s:sub( i+3 ) )
+			local x,y = b:find( 'xyz' )
+			assert( x == i and y == i+2, ("Expected %d,%d but got %s,%s"):format( i, i+2, x, y ) )
+		end
+	end,
+
+	FindByte = function( self )
+		Test.describe( "T.Buffer:findByte() finds first byte of a set" )
+		local b = Buffer( ('a'):rep( 100 ) .. 'b' .. ('a'):rep( 50 ) .. 'c' )
+		assert( 101 == b:findByte( 'cb' ),       "Expected to find `b` at 101" )
+		assert( 152 == b:findByte( 'cb', 102 ),  "Expected to find `c` at 152" )
+		assert( 152 == b:findByte( 'c', -1 ),    "Expected to find `c` at 152" )
+		assert( nil == b:findByte( 'xyz' ),      "Expected not to find any of `xyz`" )
+		assert( self.s:find( '[ ,.]' ) == self.b:findByte( ' ,.' ), "Expected to match string.find()" )
+	end,
+
+	Count = function( self )
+		Test.describe( "T.Buffer:count() counts occurences of a byte" )
+		local _,e = self.s:gsub( ' ', ' ' )
+		assert( e == self.b:count( ' ' ),  ("Expected %d blanks but got %d"):format( e, self.b:count( ' ' ) ) )
+		assert( e == self.b:count( 32 ),   ("Expected %d blanks but got %d"):format( e, self.b:count( 32 ) ) )
+		assert( 0 == Buffer( 100 ):count( 1 ), "Empty buffer mustn't contain any 1" )
+		assert( 100 == Buffer( 100 ):count( 0 ), "Empty buffer must contain 100 zeros" )
+		local r,err = pcall( self.b.count, self.b, 'ab' )
+		assert( not r and err:match( "must be a single byte" ), "Multi char string should fail" )
+	end,
+
+	Compare = function( self )
+		Test.describe( "T.Buffer:compare() reports order and first difference" )
+		local b = Buffer( self.b )
+		assert( 0 == b:compare( self.b ), "Clone should compare equal" )
+		local p = math.random( 1, #b )
+		b[ p ]  = (b[ p ] + 1) % 256
+		local c,d = b:compare( self.b )
+		assert( d == p, ("Expected first difference at %d but got %s"):format( p, d ) )
+		assert( c == (b[ p ] < self.b[ p ] and -1 or 1), "Unexpected compare result" )
+		c,d = self.b:compare( self.s .. 'x' )
+		assert( c == -1 and d == #self.s+1, "Shorter buffer should compare smaller" )
+	end,
+
+	ToHexLong = function( self )
+		Test.describe( "T.Buffer:toHex() matches byte wise formatting for all byte values" )
+		local t = { }
+		for i=0,255 do t[ #t+1 ] = string.char( i ) end
+		local s = table.concat( t ):rep( 3 )
+		local x = s:gsub( '.', function( c ) return ('%02X '):format( c:byte( ) ) end ):sub( 1, -2 )
+		assert( Buffer( s ):toHex( ) == x, "Hex string doesn't match string.format() output" )
+	end,
+
+	ToBin = function( self )
+		Test.describe( "T.Buffer:toBin() creates a proper binary string" )
+		local b = Buffer( string.char( 0, 1, 0x80, 0xA5, 0xFF ) )
+		local X = "00000000 00000001 10000000 10100101 11111111 "
+		assert( b:toBin() == X, ("Expected BinString: `%s` but got `%s`"):format( X, b:toBin() ) )
+	end,
+
+	FromHex = function( self )
+		Test.describe( "Buffer.fromHex() reads back toHex() and compact hex" )
+		local b = Buffer.fromHex( self.b:toHex( ) )
+		assert( b == self.b, "Buffer from toHex() output should equal original" )
+		local x = self.b:toHex( ):gsub( ' ', '' ):lower( )
+		assert( Buffer.fromHex( x ) == self.b, "Buffer from compact lower case hex should equal original" )
+		assert( Buffer.fromHex( "0aFf\n10" ):read( ) == "\10\255\16", "Mixed case and whitespace should be accepted" )
+	end,
+
+	FromHexInvalid = function( self )
+		Test.describe( "Buffer.fromHex() fails on invalid input" )
+		for _,x in ipairs( { "", "ABC", "4 1", "0G", "A1 ZZ" } ) do
+			local r,e = pcall( Buffer.fromHex, x )
+			assert( not r, ("Buffer.fromHex( '%s' ) should have failed"):format( x ) )
+			assert( e:match( "hex digit" ), "Wrong Error message: "..e )
+		end
+	end,
+
+	Xor = function( self )
+		Test.describe( "T.Buffer:xor() applies a repeating key in place" )
+		for _,key in ipairs( { "k", "key", ('0123456789'):rep( 7 ) } ) do
+			local b = Buffer( self.b )
+			b:xor( key )
+			for i=1,#b,97 do
+				local k = key:byte( (i-1) % #key + 1 )
+				assert( b[ i ] ~ k == self.b[ i ], ("Byte %d wasn't xored with key"):format( i ) )
+			end
+			b:xor( key )
+			assert( b == self.b, "Xor twice should restore original" )
+		end
+		local b = Buffer( 'aaaaaaaa' )
+		b:xor( ' ', 3, 4 )
+		assert( b:read( ) == 'aaAAAAaa', "Xor should only modify range; got "..b:read( ) )
+	end,
+
+	Fill = function( self )
+		Test.describe( "T.Buffer:fill() sets a range to a byte value" )
+		local b = Buffer( 'abcdefgh' )
+		b:fill( 'x', 2, 3 )
+		assert( b:read( ) == 'axxxefgh', "Expected `axxxefgh` but got "..b:read( ) )
+		b:fill( 0x41, -2 )
+		assert( b:read( ) == 'axxxefAA', "Expected `axxxefAA` but got "..b:read( ) )
+		local r,e = pcall( b.fill, b, 'x', 5, 10 )
+		assert( not r and e:match( "requested length out of range" ), "Fill beyond end should fail" )
+	end,
+
+	Reverse = function( self )
+		Test.describe( "T.Buffer:reverse() reverses bytes in place" )
+		local b = Buffer( self.b )
+		b:reverse( )
+		assert( b:read( ) == self.s:reverse( ), "Buffer should be reversed" )
+		b = Buffer( '0123456789' )
+		b:reverse( 3, 5 )
+		assert( b:read( ) == '0165432789', "Expected `0165432789` but got "..b:read( ) )
+	end,
+
+	Bswap = function( self )
+		Test.describe( "T.Buffer:bswap16/32/64() swap byte order of words" )
+		local s = '0123456789abcdef0123456789ABCDEF'
+		local b = Buffer( s )
+		b:bswap16( )
+		assert( b:read( 1, 4 ) == '1032', "bswap16 failed: "..b:read( ) )
+		b:bswap16( )
+		b:bswap32( 5, 8 )
+		assert( b:read( ) == '01237654ba98cdef0123456789ABCDEF', "bswap32 failed: "..b:read( ) )
+		b = Buffer( s )
+		b:bswap64( )
+		assert( b:read( ) == '76543210fedcba9876543210FEDCBA98', "bswap64 failed: "..b:read( ) )
+		local r,e = pcall( b.bswap32, b, 1, 6 )
+		assert( not r and e:match( "multiple of the word width" ), "Uneven length should fail" )
+	end,
+
+	Copy = function( self )
+		Test.describe( "T.Buffer:copy() copies between and within buffers" )
+		local d = Buffer( 10 )
+		local n = Buffer( 'abcdef' ):copy( d, 2, 5 )
+		assert( n == 5, "Expected 5 bytes copied but got "..n )
+		assert( d:read( 5, 5 ) == 'bcdef', "Expected `bcdef` but got "..d:read( 5, 5 ) )
+		local b = Buffer( '0123456789' )
+		b:copy( b, 1, 3, 6 )
+		assert( b:read( ) == '0101234589', "Overlapping copy failed: "..b:read( ) )
+		b:copy( b, 3, 1 )
+		assert( b:read( ) == '0123458989', "Overlapping copy failed: "..b:read( ) )
+		local r,e = pcall( b.copy, 'abc', b, 1, 9, 3 )
+		assert( not r and e:match( "requested length out of range" ), "Copy beyond end should fail" )
 	end
 }
@@ -0,0 +1,54 @@
+---
+-- \file    t_buf_chn.lua
+-- \brief   Test for the T.Buffer.Chain implementation
+local Test    = require( "t.Test" )
+local Buffer  = require( "t.Buffer" )
+local format  = string.format
+
+return {
+	beforeEach = function( self )
+		self.buf = Buffer( 'buffer' )
+		self.chn = Buffer.Chain( 'abc', self.buf, self.buf:Segment( 2, 3 ) )
+	end,
+
+	Constructor = function( self )
+		Test.describe( "Buffer.Chain( ... ) references strings, buffers and segments" )
+		assert( #self.chn == 12, format( "Expected 12 readable bytes but got %d", #self.chn ) )
+		assert( self.chn.count == 3, format( "Expected 3 entries but got %d", self.chn.count ) )
+		assert( #Buffer.Chain( ) == 0, "Empty chain should have no bytes" )
+		assert( not pcall( Buffer.Chain, 5 ), "Numbers should be rejected" )
+		assert( not pcall( Buffer.Chain, Buffer.Ring( ) ), "Rings should be rejected" )
+	end,
+
+	WriteByReference = function( self )
+		Test.describe( "Changes to a referenced Buffer are visible in the chain" )
+		self.chn:write( 'xyz' )
+		self.buf:write( 'BUF' )
+		assert( self.chn:peek( ) == 'abcBUFfer' .. 'UFf' .. 'xyz',
+			format( "Unexpected content `%s`", self.chn:peek( ) ) )
+	end,
+
+	ConsumeTrims = function( self )
+		Test.describe( "consume() releases sent entries and moves into a partial one" )
+		assert( self.chn:consume( 5 ) == 5, "Should consume 5 bytes" )
+		assert( self.chn.count == 2, format( "Expected 2 entries but got %d", self.chn.count ) )
+		assert( self.chn:peek( ) == 'fferuff', format( "Unexpected content `%s`", self.chn:peek( ) ) )
+		assert( self.chn:consume( 100 ) == 7, "Should consume what is readable only" )
+		assert( #self.chn == 0 and self.chn.count == 0, "Chain should be empty" )
+	end,
+
+	ReadAcrossEntries = function( self )
+		Test.describe( "read( n ) reads across entries and consumes" )
+		assert( self.chn:read( 4 ) == 'abcb', "Read should span entries" )
+		assert( self.chn:read( ) == 'ufferuff', "Read should return the rest" )
+		assert( #self.chn == 0, "Chain should be empty" )
+		self.chn:write( 'again' )
+		assert( self.chn:read( ) == 'again', "Chain should be reusable" )
+	end,
+
+	Clear = function( self )
+		Test.describe( "clear() releases all entries" )
+		self.chn:clear( )
+		assert( #self.chn == 0 and self.chn.count == 0, "Chain should be empty" )
+	end,
+}
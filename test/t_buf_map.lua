@@ -0,0 +1,82 @@
+---
+-- \file    t_buf_map.lua
+-- \brief   Test for the T.Buffer.Map implementation
+local Test    = require( "t.Test" )
+local Buffer  = require( "t.Buffer" )
+local Pack    = require( "t.Pack" )
+local format  = string.format
+
+local writeFile = function( name, content )
+	local f = io.open( name, 'wb' )
+	f:write( content )
+	f:close( )
+end
+
+local readFile = function( name )
+	local f = io.open( name, 'rb' )
+	local s = f:read( 'a' )
+	f:close( )
+	return s
+end
+
+return {
+	beforeEach = function( self )
+		self.name    = os.tmpname( )
+		self.content = string.rep( 'This is the content of a mapped file.\n', 1000 )
+		writeFile( self.name, self.content )
+	end,
+
+	afterEach = function( self )
+		os.remove( self.name )
+	end,
+
+	MapRead = function( self )
+		Test.describe( "Buffer.map( path ) maps a file read only" )
+		local map = Buffer.map( self.name )
+		assert( #map == #self.content, format( "Map should have length %d but had %d", #self.content, #map ) )
+		assert( not map.writable, "Map should not be writable" )
+		assert( map:read( ) == self.content, "Map content should match the file" )
+		assert( map:read( 6, 2 ) == 'is', "Partial read should match" )
+		assert( map == Buffer( self.content ), "Map should equal a Buffer with the same content" )
+		assert( not pcall( map.write, map, 'that' ), "Read only map should not be writable" )
+		map:close( )
+		assert( #map == 0, "Closed map should be empty" )
+	end,
+
+	MapAsBuffer = function( self )
+		Test.describe( "Buffer.Map is accepted where a Buffer is accepted" )
+		local map = Buffer.map( self.name )
+		local p   = Pack( '>I4' )
+		assert( p( map ) == 0x54686973, format( "Expected `This` as integer but got %X", p( map ) ) )
+		assert( require( "t.Encode.Base64" ).encode( map ) == require( "t.Encode.Base64" ).encode( self.content ),
+			"Base64 of map should match Base64 of content" )
+	end,
+
+	MapWriteSync = function( self )
+		Test.describe( "Buffer.map( path, 'w' ) writes through to the file" )
+		local map = Buffer.map( self.name, 'w' )
+		assert( map.writable, "Map should be writable" )
+		map:write( 'That', 1 )
+		assert( map:sync( ), "Sync should succeed" )
+		assert( readFile( self.name ):sub( 1, 8 ) == 'That is ', "File should reflect the write" )
+		map:close( )
+	end,
+
+	MapAdvise = function( self )
+		Test.describe( "map:advise( hint ) accepts known hints only" )
+		local map = Buffer.map( self.name )
+		assert( map:advise( 'sequential' ), "Sequential hint should succeed" )
+		assert( map:advise( 'willneed', 100, 200 ), "Hint on a range should succeed" )
+		assert( not pcall( map.advise, map, 'fast' ), "Unknown hint should fail" )
+	end,
+
+	MapEmptyOrMissing = function( self )
+		Test.describe( "Empty files map to an empty map; missing files return nil, msg" )
+		writeFile( self.name, '' )
+		local map = Buffer.map( self.name )
+		assert( #map == 0 and map:read( ) == '', "Empty file should map to empty map" )
+		local nomap, msg = Buffer.map( self.name .. '.does.not.exist' )
+		assert( nil == nomap and msg:match( "Can't open" ), "Missing file should fail" )
+		assert( not pcall( Buffer.map, self.name, 'x' ), "Bad mode should fail" )
+	end,
+}
@@ -0,0 +1,63 @@
+---
+-- \file    t_buf_pol.lua
+-- \brief   Test for the T.Buffer.Pool implementation
+local Test    = require( "t.Test" )
+local Buffer  = require( "t.Buffer" )
+local format  = string.format
+
+return {
+	beforeEach = function( self )
+		self.pool = Buffer.Pool( 16, 2 )
+	end,
+
+	Constructor = function( self )
+		Test.describe( "Buffer.Pool( size, count ) preallocates count buffers" )
+		local st = self.pool:stats( )
+		assert( st.size == 16 and st.count == 2, format( "Expected 2*16 but got %d*%d", st.count, st.size ) )
+		assert( st.free == 2 and st.used == 0, "All buffers should be free" )
+		assert( not pcall( Buffer.Pool, 0 ), "Size 0 should fail" )
+		assert( not pcall( Buffer.Pool, 16, 0 ), "Count 0 should fail" )
+	end,
+
+	AcquireAsBuffer = function( self )
+		Test.describe( "Acquired buffers work like a Buffer" )
+		local slt = self.pool:acquire( )
+		assert( #slt == 16, format( "Slot should have 16 bytes but had %d", #slt ) )
+		slt:write( 'pooled' )
+		assert( slt:read( 1, 6 ) == 'pooled', "Read should return written content" )
+		assert( Buffer( slt ):read( 1, 6 ) == 'pooled', "Buffer should clone a slot" )
+		assert( slt.pool == self.pool, "Slot should reference its pool" )
+	end,
+
+	ReleaseRecycles = function( self )
+		Test.describe( "Released buffers get handed out again" )
+		local a = self.pool:acquire( )
+		a:write( 'first' )
+		a:release( )
+		assert( #a == 0, "Released slot should be empty" )
+		local b = self.pool:acquire( )
+		assert( b:read( 1, 5 ) == 'first', "Released storage should be reused" )
+		a:release( )                        -- releasing twice is harmless
+		assert( self.pool:stats( ).used == 1, "One buffer should be in use" )
+	end,
+
+	MissAndHighWater = function( self )
+		Test.describe( "Exhausted pool allocates and counts misses and high water" )
+		local s = { self.pool:acquire( ), self.pool:acquire( ), self.pool:acquire( ) }
+		local st = self.pool:stats( )
+		assert( st.hits == 2 and st.misses == 1, format( "Expected 2 hits, 1 miss but got %d, %d", st.hits, st.misses ) )
+		assert( st.highWater == 3 and st.free == 0, "High water should be 3" )
+		for _,slt in ipairs( s ) do slt:release( ) end
+		st = self.pool:stats( )
+		assert( st.used == 0 and st.free == 2 and st.highWater == 3, "All slab buffers should be back" )
+	end,
+
+	GcReleases = function( self )
+		Test.describe( "Collected buffers return to the pool" )
+		self.pool:acquire( )
+		self.pool:acquire( )
+		collectgarbage( )
+		collectgarbage( )
+		assert( self.pool:stats( ).free == 2, "Collected buffers should be free again" )
+	end,
+}
@@ -0,0 +1,91 @@
+---
+-- \file    t_buf_rng.lua
+-- \brief   Test for the T.Buffer.Ring implementation
+local Test    = require( "t.Test" )
+local Buffer  = require( "t.Buffer" )
+local Pack    = require( "t.Pack" )
+local format  = string.format
+
+return {
+	beforeEach = function( self )
+		self.rng = Buffer.Ring( 8 )
+	end,
+
+	Constructor = function( self )
+		Test.describe( "Buffer.Ring( n ) rounds the capacity up to a power of 2" )
+		local rng = Buffer.Ring( 100 )
+		assert( rng.size == 128, format( "Size should be 128 but was %d", rng.size ) )
+		assert( #rng == 0 and rng.readable == 0 and rng.writable == 128, "Ring should be empty" )
+		assert( Buffer.Ring( ).size >= Buffer.Size, "Default size should be at least Buffer.Size" )
+		assert( not pcall( Buffer.Ring, 0 ), "Size 0 should fail" )
+	end,
+
+	WriteRead = function( self )
+		Test.describe( "Write strings, buffers and segments; read consumes" )
+		local b = Buffer( 'buffer' )
+		self.rng:write( 'abc', b, b:Segment( 2, 3 ) )
+		assert( #self.rng == 12, format( "Expected 12 readable bytes but got %d", #self.rng ) )
+		assert( self.rng:peek( 3 ) == 'abc', "Peek should not consume" )
+		assert( self.rng:read( 3 ) == 'abc', "Read should return the first bytes" )
+		assert( self.rng:read( ) == 'bufferuff', "Read should return the rest" )
+		assert( #self.rng == 0, "Ring should be empty" )
+	end,
+
+	ConsumeWraps = function( self )
+		Test.describe( "Consumed space gets reused without growing; data wraps around" )
+		self.rng:write( 'abcdef' )
+		assert( self.rng:consume( 4 ) == 4, "Should consume 4 bytes" )
+		self.rng:write( 'ghij' )
+		assert( self.rng.size == 8, format( "Ring should not grow but has size %d", self.rng.size ) )
+		assert( self.rng:peek( ) == 'efghij', format( "Expected `efghij` but got `%s`", self.rng:peek( ) ) )
+		assert( self.rng:consume( 100 ) == 6, "Should consume what is readable only" )
+	end,
+
+	Grow = function( self )
+		Test.describe( "Ring grows and keeps wrapped data in order" )
+		self.rng:write( 'abcdef' )
+		self.rng:consume( 4 )
+		self.rng:write( 'ghij', 'klmnopqrs' )
+		assert( self.rng.size == 16, format( "Ring should have size 16 but has %d", self.rng.size ) )
+		assert( self.rng:read( ) == 'efghijklmnopqrs', "Content should survive growing" )
+		assert( self.rng:reserve( 100 ) >= 100, "Reserve should make room" )
+	end,
+
+	ReserveOverflow = function( self )
+		Test.describe( "Reserving more than the capacity can double to fails and keeps the ring" )
+		self.rng:write( 'abc' )
+		local r,e = pcall( self.rng.reserve, self.rng, math.maxinteger )
+		assert( not r and e:match( "couldn't grow" ), "Huge reserve should fail" )
+		assert( self.rng.size == 8 and self.rng:peek( ) == 'abc', "Ring should be untouched" )
+		local Socket = require( "t.Net.Socket" )
+		local s      = Socket( 'udp' )
+		r,e = pcall( s.recv, s, self.rng, -1 )
+		s:close( )
+		assert( not r and e:match( "max must be greater than 0" ), "Negative max should fail" )
+	end,
+
+	FindAcrossWrap = function( self )
+		Test.describe( "find() finds a delimiter spanning the end of the storage" )
+		self.rng:write( 'xxxxx' )
+		self.rng:consume( 4 )
+		self.rng:write( 'ab\r\ncd' )
+		self.rng:consume( 1 )               -- \r at offset 7, \n at offset 0 of the storage
+		assert( self.rng.size == 8, "Ring should not grow" )
+		assert( self.rng:find( '\r\n' ) == 3, format( "Expected 3 but got %s", self.rng:find( '\r\n' ) ) )
+		assert( self.rng:find( 'cd' ) == 5, "Should find `cd` at 5" )
+		assert( self.rng:find( 'ab', 2 ) == nil, "Should not find `ab` from 2" )
+		assert( self.rng:find( 'dx' ) == nil, "Should not find `dx`" )
+	end,
+
+	AsBuffer = function( self )
+		Test.describe( "Wrapped ring passes its readable bytes where a Buffer is accepted" )
+		self.rng:write( 'xxxxxx' )
+		self.rng:consume( 5 )
+		self.rng:write( '\0\0\1\2' )
+		self.rng:consume( 1 )
+		local p = Pack( '>I4' )
+		assert( p( self.rng ) == 0x0102, format( "Expected 258 but got %s", p( self.rng ) ) )
+		assert( self.rng:toHex( ) == '00 00 01 02', "Hex representation should match" )
+		assert( #self.rng == 4, "Unpacking should not consume" )
+	end,
+}
@@ -268,6 +268,40 @@ return {
 		assert( nxtLen < len, "Last seg:next() segment should be shorter than original" )
 	end,
 
+	Iterate = function( self )
+		Test.describe( "seg:iterate() walks the buffer in windows reusing the segment" )
+		local b     = Buffer( '0123456789' )
+		local seg   = b:Segment( 1, 4 )
+		local parts = { }
+		for s in seg:iterate( ) do
+			assert( s == seg, "Iterator should return the same segment instance" )
+			parts[ #parts+1 ] = s:read( )
+		end
+		assert( table.concat( parts, '|' ) == '0123|4567|89', "Unexpected windows: "..table.concat( parts, '|' ) )
+		assert( seg.start == 9 and #seg == 2, "Segment should stay on the last window" )
+	end,
+
+	IterateStep = function( self )
+		Test.describe( "seg:iterate( step ) moves by step bytes" )
+		local b     = Buffer( '0123456789' )
+		local parts = { }
+		for s in b:Segment( 2, 3 ):iterate( 2 ) do
+			parts[ #parts+1 ] = s:read( )
+		end
+		assert( table.concat( parts, '|' ) == '123|345|567|789|9', "Unexpected windows: "..table.concat( parts, '|' ) )
+		local r,e = pcall( b:Segment( 1, 3 ).iterate, b:Segment( 1, 3 ), 0 )
+		assert( not r and e:match( "step must be greater than 0" ), "Step 0 should fail" )
+	end,
+
+	IterateCoversBuffer = function( self )
+		Test.describe( "Windows from seg:iterate() cover the entire buffer" )
+		local parts = { }
+		for s in self.b:Segment( 1, 97 ):iterate( ) do
+			parts[ #parts+1 ] = s:read( )
+		end
+		assert( table.concat( parts ) == self.s, "Concatenated windows should equal buffer content" )
+	end,
+
 	ReadPartialSegment = function( self )
 		Test.describe( "Reading partial Buffer.Segment content matches string" )
 		local buf,ofs,len = self.seg.buffer, self.seg.start, self.seg.size
@@ -358,5 +392,43 @@ return {
 		local b = Buffer( x )
 		local s = b:Segment( )
 		assert( s:toHex() == X, ("Expected HexString: `%s` but got `%s`"):format( X, s:toHex() ) )
+	end,
+
+	Find = function( self )
+		Test.describe( "T.Buffer.Segment:find() searches within the segment only" )
+		local str = self.seg:read( )
+		local n   = str:sub( 10, 20 )
+		local eS,eE = str:find( n, 1, true )
+		local rS,rE = self.seg:find( n )
+		assert( eS == rS and eE == rE, ("Expected %s,%s but got %s,%s"):format( eS, eE, rS, rE ) )
+		local b   = Buffer( 'xyz' .. ('a'):rep( 100 ) .. 'xyz' )
+		assert( nil == b:Segment( 4, 100 ):find( 'xyz' ), "Needle outside of segment mustn't be found" )
+		assert( nil == b:Segment( 4, 100 ):findByte( 'xyz' ), "Byte outside of segment mustn't be found" )
+	end,
+
+	CountAndCompare = function( self )
+		Test.describe( "T.Buffer.Segment:count() and compare() work on segment content" )
+		local str = self.seg:read( )
+		local _,e = str:gsub( ' ', ' ' )
+		assert( e == self.seg:count( ' ' ), ("Expected %d blanks but got %d"):format( e, self.seg:count( ' ' ) ) )
+		assert( 0 == self.seg:compare( str ),           "Segment should equal its content" )
+		assert( 0 == self.seg:compare( Buffer( str ) ), "Segment should equal T.Buffer of its content" )
+	end,
+
+	Transforms = function( self )
+		Test.describe( "T.Buffer.Segment transforms only touch the segment" )
+		local b = Buffer( '0123456789abcdef' )
+		local s = b:Segment( 5, 8 )
+		s:reverse( )
+		assert( b:read( ) == '0123ba987654cdef', "reverse failed: "..b:read( ) )
+		s:reverse( )
+		s:bswap32( )
+		assert( b:read( ) == '01237654ba98cdef', "bswap32 failed: "..b:read( ) )
+		s:fill( '-' )
+		assert( b:read( ) == '0123--------cdef', "fill failed: "..b:read( ) )
+		s:xor( ' ' )                  -- '-' becomes '\r'
+		b:Segment( 13 ):copy( s, 1, 3 )
+		assert( b:read( ) == '0123\r\rcdef\r\rcdef', "copy failed: "..b:read( ) )
+		assert( Buffer.fromHex( s:toHex( ) ) == s, "fromHex( toHex( ) ) should equal segment" )
 	end
 }
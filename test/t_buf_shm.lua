@@ -0,0 +1,121 @@
+---
+-- \file    t_buf_shm.lua
+-- \brief   Test for shared memory T.Buffer.Map created by Buffer.shared()
+local Test    = require( "t.Test" )
+local Buffer  = require( "t.Buffer" )
+local Pack    = require( "t.Pack" )
+local format  = string.format
+
+return {
+	beforeEach = function( self )
+		self.name = format( "/t_buf_shm_%d_%d", os.time( ), math.random( 1, 1000000 ) )
+	end,
+
+	afterEach = function( self )
+		Buffer.unlinkShared( self.name )
+	end,
+
+	SharedAnonymous = function( self )
+		Test.describe( "Buffer.shared( size ) creates zero filled writable memory" )
+		local m = Buffer.shared( 4096 )
+		assert( #m == 4096, format( "Shared memory should have length 4096 but had %d", #m ) )
+		assert( m.writable, "Shared memory should be writable" )
+		assert( 4096 == m:count( 0 ), "Shared memory should be zero filled" )
+		m:write( 'shared' )
+		assert( m:read( 1, 6 ) == 'shared', "Written content should be readable" )
+		local r,e = pcall( Buffer.shared, 0 )
+		assert( not r and e:match( "size must be greater than 0" ), "Zero size should fail" )
+	end,
+
+	SharedNamed = function( self )
+		Test.describe( "Buffer.shared( name, size ) maps the same memory twice" )
+		local a = Buffer.shared( self.name, 1024 )
+		local b = Buffer.shared( self.name )
+		assert( #b == 1024, format( "Opened shared memory should have length 1024 but had %d", #b ) )
+		a:write( 'visible through both', 100 )
+		assert( b:read( 100, 20 ) == 'visible through both', "Write should be visible in second map" )
+		assert( Buffer.unlinkShared( self.name ), "Unlink should succeed" )
+		assert( a:read( 100, 20 ) == 'visible through both', "Map should stay valid after unlink" )
+		local m,e = Buffer.shared( self.name )
+		assert( nil == m and e:match( "Can't open shared memory" ), "Opening unlinked name should fail" )
+		Buffer.shared( self.name, 8 )   -- recreate for afterEach
+	end,
+
+	SharedNameMustStartWithSlash = function( self )
+		Test.describe( "Buffer.shared( name ) requires a name starting with '/'" )
+		local r,e = pcall( Buffer.shared, 'noSlash', 8 )
+		assert( not r and e:match( "name must start with '/'" ), "Name without '/' should fail" )
+	end,
+
+	Atomics = function( self )
+		Test.describe( "load, store, fetchAdd and cas operate on 64 bit integers" )
+		local m = Buffer.shared( 64 )
+		m:store( 9, 41 )
+		assert( m:load( 9 ) == 41, "load should return stored value" )
+		assert( m:fetchAdd( 9 ) == 41, "fetchAdd should return previous value" )
+		assert( m:fetchAdd( 9, -2 ) == 42, "fetchAdd should return previous value" )
+		assert( m:load( 9 ) == 40, "fetchAdd should have added" )
+		local ok,v = m:cas( 9, 1, 2 )
+		assert( not ok and v == 40, "cas with wrong expectation should fail and return current value" )
+		ok,v = m:cas( 9, 40, math.maxinteger )
+		assert( ok and v == 40, "cas with right expectation should succeed" )
+		assert( m:load( 9 ) == math.maxinteger, "cas should have stored new value" )
+		assert( m:load( 1 ) == 0, "Neighbouring integer should be untouched" )
+	end,
+
+	AtomicsCheckIndex = function( self )
+		Test.describe( "Atomic operations require aligned indexes within the map" )
+		local m = Buffer.shared( 16 )
+		for _,i in ipairs( { 0, 2, 16, 17 } ) do
+			local r,e = pcall( m.load, m, i )
+			assert( not r and (e:match( "index out of range" ) or e:match( "aligned" )),
+				format( "load( %d ) should have failed", i ) )
+		end
+	end,
+
+	AtomicsReadOnlyMap = function( self )
+		Test.describe( "Modifying atomics fail on read only maps" )
+		local f = os.tmpname( )
+		local h = io.open( f, 'wb' ); h:write( ('\0'):rep( 16 ) ); h:close( )
+		local m = Buffer.map( f )
+		assert( m:load( 1 ) == 0, "load should work on read only map" )
+		local r,e = pcall( m.fetchAdd, m, 1 )
+		assert( not r and e:match( "must be writable" ), "fetchAdd should fail on read only map" )
+		m:close( )
+		os.remove( f )
+	end,
+
+	PackOverlay = function( self )
+		Test.describe( "Pack structs can overlay shared memory" )
+		local m = Buffer.shared( self.name, 16 )
+		local s = Pack( { count = '<i8' }, { flags = 'B' } )
+		s.count( m, 1234 )
+		s.flags( m, 7 )
+		local o = Buffer.shared( self.name )
+		assert( s.count( o ) == 1234, "Count should be visible through second map" )
+		assert( s.flags( o ) == 7, "Flags should be visible through second map" )
+	end,
+
+	FetchAddAcrossProcesses = function( self )
+		Test.describe( "fetchAdd() from several processes doesn't lose updates" )
+		local lua = arg and arg[ -1 ]
+		if not lua then Test.skip( "Can't determine Lua interpreter" ) end
+		local Loop  = require( "t.Loop" )
+		local l     = Loop( )
+		local m     = Buffer.shared( self.name, 8 )
+		local n, k  = 4, 10000
+		local code  = format( "package.path=%q package.cpath=%q "..
+			"local m=require't.Buffer'.shared(%q) for i=1,%d do m:fetchAdd(1) end",
+			package.path, package.cpath, self.name, k )
+		local done  = 0
+		for i=1,n do
+			l:spawnProcess( { lua, '-e', code }, function( ok )
+				assert( ok, "Child process failed" )
+				done = done + 1
+			end )
+		end
+		l:run( )
+		assert( done == n, format( "Expected %d processes to finish but %d did", n, done ) )
+		assert( m:load( 1 ) == n*k, format( "Expected counter %d but got %d", n*k, m:load( 1 ) ) )
+	end,
+}
@@ -323,6 +323,24 @@ return {
 		assert( r.state == Request.State.Headers, format( "State must be %d but was %d", Request.State.Headers, r.state ) )
 	end,
 
+	ContinuedUrlRing = function( self )
+		Test.describe( "request:recv() from a Buffer.Ring keeps the unparsed tail in the ring" )
+		local r      = makeRequest( )
+		local rng    = Buffer.Ring( 16 )
+		local u1, u2 = '/go/wherever/it/wil', 'l/be/index.html'
+		local v      = Version[3] -- HTTP/1.1
+		rng:write( 'GET ' .. u1 )
+		assert( not r:receive( rng ), "Request must not be done" )
+		assert( r.state == Request.State.Url, format( "State must be %d but was %d", Request.State.Url, r.state ) )
+		assert( rng:peek( ) == (' ' .. u1), format( "Ring shall hold `%s` but was `%s`", ' ' .. u1, rng:peek( ) ) )
+		assert( not r.tail, "The request mustn't keep a tail" )
+		rng:write( u2 .. ' ' .. v .. '\r\nHost: lua-t\r\n\r\n' )
+		assert( r:receive( rng ), "Request must be done" )
+		assert( r.url == u1 .. u2, format( "URL must be `%s` but was `%s`", u1 .. u2, r.url ) )
+		assert( r.headers.host == 'lua-t', "Host header must be parsed" )
+		assert( #rng == 0, format( "Ring shall be consumed but holds %d bytes", #rng ) )
+	end,
+
 	HeaderConnectionClose = function( self )
 		Test.describe( "Connection: close shall set request to close" )
 		local r = makeRequest( )
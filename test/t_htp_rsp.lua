@@ -49,11 +49,11 @@ return {
 		r:writeHead( 200 )
 		assert( r.state   == Response.State.Written, format( "State must be %d but was %d", Response.State.Written, r.state ) )
 		assert( r.chunked, "Response must be chunked" )
-		assert( #r.buf == 1, "Response Buffer must be length 1 but was " .. #r.buf )
-		assert( r.buf[1]:match("\r\nTransfer%-Encoding: chunked\r\n"), "Response Buffer should match 'Transfer-Encoding: chunked'" )
-		assert( r.buf[1]:match("\r\nConnection: keep%-alive\r\n"), "Response Buffer should match 'Connection: keep-alive'" )
+		assert( r.buf.count == 1, "Response Buffer must have 1 entry but had " .. r.buf.count )
+		assert( r.buf:peek( ):match("\r\nTransfer%-Encoding: chunked\r\n"), "Response Buffer should match 'Transfer-Encoding: chunked'" )
+		assert( r.buf:peek( ):match("\r\nConnection: keep%-alive\r\n"), "Response Buffer should match 'Connection: keep-alive'" )
 		local dtStr = "Date: " .. os.date( "%a, %d %b %Y %H:%M:", os.time() )
-		assert( r.buf[1]:match("\r\n" .. dtStr ), format( "Response Buffer should match '%s' but found '%s'", dtStr, r.buf[1] ) )
+		assert( r.buf:peek( ):match("\r\n" .. dtStr ), format( "Response Buffer should match '%s' but found '%s'", dtStr, r.buf:peek( ) ) )
 	end,
 
 	WriteheadLength = function( self )
@@ -63,8 +63,8 @@ return {
 		r.contentLength = l
 		r:writeHead( 200 )
 		assert( not r.chunked, "Response must not be chunked" )
-		assert( not r.buf[1]:match("\r\nTransfer%-Encoding: chunked\r\n"), "Response Buffer should not match 'Transfer-Encoding: chunked'" )
-		assert( r.buf[1]:match("\r\nContent%-Length%: " ..l.. "\r\n"), "Response Buffer should match 'Content-Length: " ..l.. "' but found `%s`", l, r.buf[1] )
+		assert( not r.buf:peek( ):match("\r\nTransfer%-Encoding: chunked\r\n"), "Response Buffer should not match 'Transfer-Encoding: chunked'" )
+		assert( r.buf:peek( ):match("\r\nContent%-Length%: " ..l.. "\r\n"), "Response Buffer should match 'Content-Length: " ..l.. "' but found `%s`", l, r.buf:peek( ) )
 	end,
 
 	WriteheadStatusCode = function( self )
@@ -73,7 +73,7 @@ return {
 			local r = makeResonse( )
 			r:writeHead( cde )
 			local term = format( "^%s %d %s\r\n", Version[3], cde, msg ):gsub( '%-', '%%-' )
-			assert( r.buf[1]:match( term), format( "Response Buffer should match '%s' but found `%s`", term, r.buf[1] ) )
+			assert( r.buf:peek( ):match( term), format( "Response Buffer should match '%s' but found `%s`", term, r.buf:peek( ) ) )
 		end
 	end,
 
@@ -82,7 +82,7 @@ return {
 		local r = makeResonse( )
 		local l = 500
 		r:writeHead( 200, {['Content-Disposition']='attachment; filename="fname.ext"', ['ETag']='"737060cd8c284d8af7ad3082f209582d"'} )
-		local rbuf = table.concat( r.buf )
+		local rbuf = r.buf:peek( )
 		assert( rbuf:match('\r\nContent%-Disposition: attachment; filename="fname.ext"\r\n'),
 				format( "Response Buffer should match '%s' but found `%s`", 'Content-Disposition: attachment; filename="fname.ext"', rbuf ) )
 		assert( rbuf:match('\r\nETag: "737060cd8c284d8af7ad3082f209582d"\r\n'),
@@ -96,9 +96,9 @@ return {
 		local payload = '{"random":"data of the payload", "is":true, "just":"A simple JSON content"}'
 		r:finish( payload )
 		assert( not r.chunked, "Response must not be chunked" )
-		assert( r.buf[1]:match("\r\nContent%-Length%: " ..#payload.. "\r\n"),
-			format("Response Buffer should match 'Content-Length: %d' but found `%s`", #payload, r.buf[1] ) )
-		assert( r.buf[1]:match(payload), format( "Response Buffer should match `%s` but found `%s`", payload, r.buf[1]) )
+		assert( r.buf:peek( ):match("\r\nContent%-Length%: " ..#payload.. "\r\n"),
+			format("Response Buffer should match 'Content-Length: %d' but found `%s`", #payload, r.buf:peek( ) ) )
+		assert( r.buf:peek( ):match(payload), format( "Response Buffer should match `%s` but found `%s`", payload, r.buf:peek( )) )
 	end,
 
 	FinishFinalStatusCode = function( self )
@@ -108,9 +108,9 @@ return {
 		r:finish( 404, payload )
 		assert( 404 == r.statusCode, format( "response.statusCode must be 404 but was `%d`", r.statusCode ) )
 		assert( not r.chunked, "Response must not be chunked" )
-		assert( r.buf[1]:match("\r\nContent%-Length%: " ..#payload.. "\r\n"),
-			format("Response Buffer should match 'Content-Length: %d' but found `%s`", #payload, r.buf[1] ) )
-		assert( r.buf[1]:match(payload), format( "Response Buffer should match `%s` but found `%s`", payload, r.buf[1]) )
+		assert( r.buf:peek( ):match("\r\nContent%-Length%: " ..#payload.. "\r\n"),
+			format("Response Buffer should match 'Content-Length: %d' but found `%s`", #payload, r.buf:peek( ) ) )
+		assert( r.buf:peek( ):match(payload), format( "Response Buffer should match `%s` but found `%s`", payload, r.buf:peek( )) )
 	end,
 
 	WriteHeadThenFinish = function( self )
@@ -121,7 +121,7 @@ return {
 		r:finish( )
 		assert( 200 == r.statusCode, format( "response.statusCode must be 200 but was `%d`", r.statusCode ) )
 		assert( r.chunked, "Response must be chunked" )
-		assert( r.buf[1]:match(payload), format( "Response Buffer should match `%s` but found `%s`", payload, r.buf[1]) )
+		assert( r.buf:peek( ):match(payload), format( "Response Buffer should match `%s` but found `%s`", payload, r.buf:peek( )) )
 	end,
 
 }
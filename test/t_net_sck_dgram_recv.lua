@@ -12,6 +12,7 @@
 --    msg, len  = sck:recv( buf, max )
 --    msg, len  = sck:recv( adr, buf )
 --    msg, len  = sck:recv( adr, buf, max )
+--    slt, len  = sck:recv( pol )
 --    msg, len  = sck:recv( [bad arguments] )
 --
 -- These tests run (semi-)asynchronously.  A UDP server socket is listening while each
@@ -278,4 +279,32 @@ return {
 		makeSender( self, payload )
 	end,
 
+	recvWouldBlockReturnsErrno = function( self )
+		Test.describe( "false,msg,errno = sck.recv( ) on an empty non blocking socket" )
+		self.sndSck          = Socket( 'udp' )   -- gets closed by afterEach
+		self.srvSck.nonblock = true
+		local suc,msg,eNo    = self.srvSck:recv( )
+		self.srvSck.nonblock = false
+		assert( false == suc, "Receiving from an empty socket should fail" )
+		assert( 'string' == type( msg ), "Second value should be the error message" )
+		assert( 11 == eNo, ("Expected errno EAGAIN(11) but got %s"):format( eNo ) )
+	end,
+
+	recvPool = function( self )
+		Test.describe( "slt,len = sck.recv( pol )" )
+		local payload  = string.rep( 'Receiving into a Buffer from a Buffer.Pool -- ', 12 )
+		local pool     = Buffer.Pool( 1024, 2 )
+		local receiver = function( s )
+			local slt,len = s.srvSck:recv( pool )
+			assert( len==#payload, ("Expected %d but got %d bytes"):format( #payload, len) )
+			assert( #slt==#payload, ("Expected slot of %d but got %d bytes"):format( #payload, #slt) )
+			assert( slt:read()==payload, ("Expected\n%s\nbut got\n%s\b"):format( payload, slt:read()) )
+			assert( pool:stats( ).used == 1, "Pool should have handed out one buffer" )
+			slt:release( )
+			assert( pool:stats( ).free == 2, "Buffer should be back in the pool" )
+			s.loop:removeHandle( s.srvSck, 'read' )
+		end
+		self.loop:addHandle( self.srvSck, 'read', receiver, self )
+		makeSender( self, payload )
+	end,
 }
@@ -9,6 +9,7 @@
 --                   s:snd( str, size )
 --                   s:snd( buf, size )
 --                   s:snd( buf_seg, size )
+--                   s:snd( chn )
 -- In reality, sending to a Net.Address via a "SOCK_STREAM" type socket is not
 -- really a reasonable application and hence is not covered in unit tests.
 -- These tests run (semi-)asynchronously.  A TCP server socket is listening
@@ -236,4 +237,30 @@ return {
 		makeReceiver( self, #payload, payload )
 		makeSender( self, sender, true )
 	end,
+
+	sendChainNonBlocking = function( self )
+		Test.describe( "cnt = sck.send( chn ) -- on nonblocking socket consumes what got sent" )
+		local sendCount, outCount, part = 0, 0,
+			string.rep( 'THis Is a LittLe Test-MEsSage To bE sEnt ACcroSS the WIrE ...!_', 100000 )
+		local buf     = Buffer( part )
+		local chn     = Buffer.Chain( part, buf, buf:Segment( 11, 1000 ), 'tail' )
+		local payload = part .. part .. part:sub( 11, 1010 ) .. 'tail'
+		local sender  = function( s )
+			local before = #chn
+			local cnt    = s.sndSck:send( chn )
+			if cnt > 0 then
+				assert( #chn == before - cnt, ("Chain should be trimmed to %d but was %d"):format( before - cnt, #chn ) )
+				sendCount = sendCount+1
+				outCount  = cnt + outCount
+			else
+				assert( sendCount>1, ("Non blocking should have broken up sending: %d "):format( sendCount) )
+				assert( outCount  == #payload, ("send() should accumulate to (%d) but sent(%d)"):format( #payload, outCount ) )
+				assert( 0 == chn.count, "All entries should be released" )
+				s.loop:removeHandle( s.sndSck, "write" )
+				s.sndSck:close( )
+			end
+		end
+		makeReceiver( self, #payload, payload )
+		makeSender( self, sender, true )
+	end,
 }